@@ -3,7 +3,9 @@
 /* uses standard glfw gl header instead of glad, but only for constants and typedefs, the function pointers are loaded manually. */
 #include <GLFW/glfw3.h>
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 
 
@@ -546,12 +548,24 @@ and functions already covered by the callbacks like glfwGetKey
 */
 
 /* internal GL utils: */
+#define GFX_ERROR_SCOPE_MAX_DEPTH 16
 static struct g_gl {
     bool                                initialized;
     enum { GLES2, GL3Core, GL2}         version;
     gfx_fixed_function_state_t          state;
     gfx_image_data_rgba_t               screenshot;
     gfx_driver_limits_t                 limits;
+    gfx_frame_stats_t                   frame_stats, last_frame_stats;
+    struct {
+        gfx_error_check_mode_t          mode;
+        bool                            escalated; /* check immediately until the next gfx_render */
+        PFNGLGETERRORPROC               immediate_GetError; /* g_gl.GetError as it is in immediate mode */
+        const char*                     scopes[GFX_ERROR_SCOPE_MAX_DEPTH];
+        uint32_t                        depth;
+        gfx_error_site_t                sites[GFX_ERROR_SITE_RING_SIZE];
+        uint64_t                        sequence;
+        gfx_error_report_t              report;
+    }                                   errors;
     /* all functions supported by all three of GL ES 2.0, GL 3+ Core and GL 2.1 */
     PFNGLACTIVETEXTUREPROC              ActiveTexture;
     PFNGLBINDATTRIBLOCATIONPROC         AttachShader;
@@ -680,7 +694,215 @@ static struct g_gl {
     PFNGLVERTEXATTRIB4FVPROC            VertexAttrib4fv;
     PFNGLVERTEXATTRIBPOINTERPROC        VertexAttribPointer;
     PFNGLVIEWPORTPROC                   Viewport;
+    /* optional timer queries from ARB_timer_query (GL 3.3 Core) or EXT_disjoint_timer_query (GL ES 2), used by the profiler */
+    bool                                timer_queries_available;
+    bool                                timer_queries_disjoint;
+    PFNGLDELETEQUERIESPROC              DeleteQueries;
+    PFNGLGENQUERIESPROC                 GenQueries;
+    PFNGLGETQUERYOBJECTIVPROC           GetQueryObjectiv;
+    PFNGLGETQUERYOBJECTUI64VPROC        GetQueryObjectui64v;
+    PFNGLQUERYCOUNTERPROC               QueryCounter;
+    /* framebuffer objects, core in GL ES 2 and GL 3, from ARB_framebuffer_object or EXT_framebuffer_object on GL 2.1 */
+    GLuint                              bound_framebuffer;
+    PFNGLBINDFRAMEBUFFERPROC            BindFramebuffer;
+    PFNGLBINDRENDERBUFFERPROC           BindRenderbuffer;
+    PFNGLCHECKFRAMEBUFFERSTATUSPROC     CheckFramebufferStatus;
+    PFNGLDELETEFRAMEBUFFERSPROC         DeleteFramebuffers;
+    PFNGLDELETERENDERBUFFERSPROC        DeleteRenderbuffers;
+    PFNGLFRAMEBUFFERRENDERBUFFERPROC    FramebufferRenderbuffer;
+    PFNGLFRAMEBUFFERTEXTURE2DPROC       FramebufferTexture2D;
+    PFNGLGENFRAMEBUFFERSPROC            GenFramebuffers;
+    PFNGLGENRENDERBUFFERSPROC           GenRenderbuffers;
+    PFNGLRENDERBUFFERSTORAGEPROC        RenderbufferStorage;
+    /* the driver functions that got replaced by the counting wrappers below */
+    struct {
+        PFNGLBINDBUFFERPROC             BindBuffer;
+        PFNGLBINDTEXTUREPROC            BindTexture;
+        PFNGLBUFFERDATAPROC             BufferData;
+        PFNGLBUFFERSUBDATAPROC          BufferSubData;
+        PFNGLDRAWARRAYSPROC             DrawArrays;
+        PFNGLDRAWELEMENTSPROC           DrawElements;
+        PFNGLGETERRORPROC               GetError;
+        PFNGLTEXIMAGE2DPROC             TexImage2D;
+        PFNGLTEXSUBIMAGE2DPROC          TexSubImage2D;
+        PFNGLUSEPROGRAMPROC             UseProgram;
+    } uncounted;
 } g_gl;
+
+#ifndef GFX_NO_FRAME_STATS
+#define GFX_FRAME_STAT_ADD(counter, amount) (g_gl.frame_stats.counter += (amount))
+#else
+#define GFX_FRAME_STAT_ADD(counter, amount) ((void) 0)
+#endif
+
+#ifndef GFX_NO_FRAME_STATS
+/* Counting wrappers: load_gl puts these into g_gl in place of the driver functions,
+ * so every call site is counted without touching it. */
+static uint64_t gfx_frame_stats_triangles(GLenum mode, GLsizei count) {
+    switch(mode) {
+        case GL_TRIANGLES:
+            return count / 3;
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN:
+            return count > 2 ? count - 2 : 0;
+        default:
+            return 0;
+    }
+}
+static uint64_t gfx_frame_stats_pixel_bytes(GLenum format, GLenum type) {
+    switch(type) {
+        case GL_UNSIGNED_SHORT_5_6_5:
+        case GL_UNSIGNED_SHORT_4_4_4_4:
+        case GL_UNSIGNED_SHORT_5_5_5_1:
+            return 2;
+        default:
+            break;
+    }
+    switch(format) {
+        case GL_RGBA:
+            return 4;
+        case GL_RGB:
+            return 3;
+        case GL_LUMINANCE_ALPHA:
+            return 2;
+        default:
+            return 1;
+    }
+}
+static void APIENTRY gfx_counted_BindBuffer(GLenum target, GLuint buffer) {
+    g_gl.frame_stats.buffer_binds++;
+    g_gl.uncounted.BindBuffer(target, buffer);
+}
+static void APIENTRY gfx_counted_BindTexture(GLenum target, GLuint texture) {
+    g_gl.frame_stats.texture_binds++;
+    g_gl.uncounted.BindTexture(target, texture);
+}
+static void APIENTRY gfx_counted_BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    if(data != NULL) {
+        g_gl.frame_stats.buffer_bytes_uploaded += size;
+    }
+    g_gl.uncounted.BufferData(target, size, data, usage);
+}
+static void APIENTRY gfx_counted_BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    g_gl.frame_stats.buffer_bytes_uploaded += size;
+    g_gl.uncounted.BufferSubData(target, offset, size, data);
+}
+static void APIENTRY gfx_counted_DrawArrays(GLenum mode, GLint first, GLsizei count) {
+    g_gl.frame_stats.draw_calls++;
+    g_gl.frame_stats.triangles_submitted += gfx_frame_stats_triangles(mode, count);
+    g_gl.uncounted.DrawArrays(mode, first, count);
+}
+static void APIENTRY gfx_counted_DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    g_gl.frame_stats.draw_calls++;
+    g_gl.frame_stats.triangles_submitted += gfx_frame_stats_triangles(mode, count);
+    g_gl.uncounted.DrawElements(mode, count, type, indices);
+}
+static GLenum APIENTRY gfx_counted_GetError(void) {
+    g_gl.frame_stats.get_error_calls++;
+    return g_gl.uncounted.GetError();
+}
+static void APIENTRY gfx_counted_TexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+                                            GLint border, GLenum format, GLenum type, const void* pixels) {
+    if(pixels != NULL) {
+        g_gl.frame_stats.texture_bytes_uploaded += (uint64_t) width * height * gfx_frame_stats_pixel_bytes(format, type);
+    }
+    g_gl.uncounted.TexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+}
+static void APIENTRY gfx_counted_TexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+                                               GLenum format, GLenum type, const void* pixels) {
+    g_gl.frame_stats.texture_bytes_uploaded += (uint64_t) width * height * gfx_frame_stats_pixel_bytes(format, type);
+    g_gl.uncounted.TexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+static void APIENTRY gfx_counted_UseProgram(GLuint program) {
+    g_gl.frame_stats.program_switches++;
+    g_gl.uncounted.UseProgram(program);
+}
+/* a function the driver doesn't have stays NULL, so it's still seen as missing */
+#define GFX_INSTALL_COUNTER(name) \
+    if(g_gl.name != NULL) { \
+        g_gl.uncounted.name = g_gl.name; \
+        g_gl.name = gfx_counted_##name; \
+    }
+static void install_frame_stats_counters(void) {
+    GFX_INSTALL_COUNTER(BindBuffer)
+    GFX_INSTALL_COUNTER(BindTexture)
+    GFX_INSTALL_COUNTER(BufferData)
+    GFX_INSTALL_COUNTER(BufferSubData)
+    GFX_INSTALL_COUNTER(DrawArrays)
+    GFX_INSTALL_COUNTER(DrawElements)
+    GFX_INSTALL_COUNTER(GetError)
+    GFX_INSTALL_COUNTER(TexImage2D)
+    GFX_INSTALL_COUNTER(TexSubImage2D)
+    GFX_INSTALL_COUNTER(UseProgram)
+}
+#undef GFX_INSTALL_COUNTER
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define GFX_CALLER_ADDRESS() __builtin_return_address(0)
+#else
+#define GFX_CALLER_ADDRESS() NULL
+#endif
+/* stands in for g_gl.GetError in deferred mode */
+static GLenum APIENTRY gfx_deferred_GetError(void) {
+    gfx_error_site_t* site = &g_gl.errors.sites[g_gl.errors.sequence % GFX_ERROR_SITE_RING_SIZE];
+    GLenum error;
+    
+    site[0].scope = g_gl.errors.depth > 0 ? g_gl.errors.scopes[g_gl.errors.depth-1] : NULL;
+    site[0].caller = GFX_CALLER_ADDRESS();
+    site[0].sequence = g_gl.errors.sequence++;
+    
+    if(!g_gl.errors.escalated) {
+        return GL_NO_ERROR;
+    }
+    error = g_gl.errors.immediate_GetError();
+    if(error != GL_NO_ERROR) {
+        g_gl.errors.report.gl_error = error;
+        g_gl.errors.report.exact = true;
+        g_gl.errors.report.nr_sites = 1;
+        g_gl.errors.report.sites[0] = site[0];
+    }
+    return error;
+}
+/* reads (and clears) the GL error state for the deferred mode, and fills the report with the recorded candidates */
+static gfx_result_t gfx_deferred_errors_check(void) {
+    GLenum error, first_error = GL_NO_ERROR;
+    uint32_t nr_sites;
+    
+#ifdef GFX_NO_CHECKS
+    return GFX_OK;
+#endif
+    if(g_gl.errors.mode != GFX_ERROR_CHECK_MODE_DEFERRED) {
+        return GFX_OK;
+    }
+    /* GL may have one error flag per implementation defined unit, so drain them all */
+    for(int i = 0; i < 8; i++) {
+        error = g_gl.errors.immediate_GetError();
+        if(error == GL_NO_ERROR) {
+            break;
+        }
+        if(first_error == GL_NO_ERROR) {
+            first_error = error;
+        }
+    }
+    if(first_error == GL_NO_ERROR) {
+        return GFX_OK;
+    }
+    
+    nr_sites = g_gl.errors.sequence < GFX_ERROR_SITE_RING_SIZE ? g_gl.errors.sequence : GFX_ERROR_SITE_RING_SIZE;
+    g_gl.errors.report.gl_error = first_error;
+    g_gl.errors.report.exact = false;
+    g_gl.errors.report.nr_sites = nr_sites;
+    for(uint32_t i = 0; i < nr_sites; i++) {
+        g_gl.errors.report.sites[i] = g_gl.errors.sites[(g_gl.errors.sequence - 1 - i) % GFX_ERROR_SITE_RING_SIZE];
+    }
+    g_gl.errors.escalated = true;
+#ifdef GFX_DEBUG
+    fprintf(stderr, "GL error 0x%x detected by deferred check, last call site %p in scope %s\n", first_error,
+            nr_sites > 0 ? g_gl.errors.report.sites[0].caller : NULL,
+            nr_sites > 0 && g_gl.errors.report.sites[0].scope != NULL ? g_gl.errors.report.sites[0].scope : "(none)");
+#endif
+    return GFX_ERROR_UNKNOWN;
+}
 static void load_gl(void) {
     /* We don't do error checking here since not available functions will just become NULL pointers */
     g_gl.ActiveTexture                  = (PFNGLACTIVETEXTUREPROC             ) glfwGetProcAddress("glActiveTexture");
@@ -810,6 +1032,54 @@ static void load_gl(void) {
     g_gl.VertexAttrib4fv                = (PFNGLVERTEXATTRIB4FVPROC           ) glfwGetProcAddress("glVertexAttrib4fv");
     g_gl.VertexAttribPointer            = (PFNGLVERTEXATTRIBPOINTERPROC       ) glfwGetProcAddress("glVertexAttribPointer");
     g_gl.Viewport                       = (PFNGLVIEWPORTPROC                  ) glfwGetProcAddress("glViewport");
+    
+    g_gl.BindFramebuffer                = (PFNGLBINDFRAMEBUFFERPROC           ) glfwGetProcAddress("glBindFramebuffer");
+    g_gl.BindRenderbuffer               = (PFNGLBINDRENDERBUFFERPROC          ) glfwGetProcAddress("glBindRenderbuffer");
+    g_gl.CheckFramebufferStatus         = (PFNGLCHECKFRAMEBUFFERSTATUSPROC    ) glfwGetProcAddress("glCheckFramebufferStatus");
+    g_gl.DeleteFramebuffers             = (PFNGLDELETEFRAMEBUFFERSPROC        ) glfwGetProcAddress("glDeleteFramebuffers");
+    g_gl.DeleteRenderbuffers            = (PFNGLDELETERENDERBUFFERSPROC       ) glfwGetProcAddress("glDeleteRenderbuffers");
+    g_gl.FramebufferRenderbuffer        = (PFNGLFRAMEBUFFERRENDERBUFFERPROC   ) glfwGetProcAddress("glFramebufferRenderbuffer");
+    g_gl.FramebufferTexture2D           = (PFNGLFRAMEBUFFERTEXTURE2DPROC      ) glfwGetProcAddress("glFramebufferTexture2D");
+    g_gl.GenFramebuffers                = (PFNGLGENFRAMEBUFFERSPROC           ) glfwGetProcAddress("glGenFramebuffers");
+    g_gl.GenRenderbuffers               = (PFNGLGENRENDERBUFFERSPROC          ) glfwGetProcAddress("glGenRenderbuffers");
+    g_gl.RenderbufferStorage            = (PFNGLRENDERBUFFERSTORAGEPROC       ) glfwGetProcAddress("glRenderbufferStorage");
+    if(g_gl.BindFramebuffer == NULL && glfwExtensionSupported("GL_EXT_framebuffer_object")) {
+        g_gl.BindFramebuffer            = (PFNGLBINDFRAMEBUFFERPROC           ) glfwGetProcAddress("glBindFramebufferEXT");
+        g_gl.BindRenderbuffer           = (PFNGLBINDRENDERBUFFERPROC          ) glfwGetProcAddress("glBindRenderbufferEXT");
+        g_gl.CheckFramebufferStatus     = (PFNGLCHECKFRAMEBUFFERSTATUSPROC    ) glfwGetProcAddress("glCheckFramebufferStatusEXT");
+        g_gl.DeleteFramebuffers         = (PFNGLDELETEFRAMEBUFFERSPROC        ) glfwGetProcAddress("glDeleteFramebuffersEXT");
+        g_gl.DeleteRenderbuffers        = (PFNGLDELETERENDERBUFFERSPROC       ) glfwGetProcAddress("glDeleteRenderbuffersEXT");
+        g_gl.FramebufferRenderbuffer    = (PFNGLFRAMEBUFFERRENDERBUFFERPROC   ) glfwGetProcAddress("glFramebufferRenderbufferEXT");
+        g_gl.FramebufferTexture2D       = (PFNGLFRAMEBUFFERTEXTURE2DPROC      ) glfwGetProcAddress("glFramebufferTexture2DEXT");
+        g_gl.GenFramebuffers            = (PFNGLGENFRAMEBUFFERSPROC           ) glfwGetProcAddress("glGenFramebuffersEXT");
+        g_gl.GenRenderbuffers           = (PFNGLGENRENDERBUFFERSPROC          ) glfwGetProcAddress("glGenRenderbuffersEXT");
+        g_gl.RenderbufferStorage        = (PFNGLRENDERBUFFERSTORAGEPROC       ) glfwGetProcAddress("glRenderbufferStorageEXT");
+    }
+    
+    if(glfwExtensionSupported("GL_ARB_timer_query")) {
+        g_gl.DeleteQueries              = (PFNGLDELETEQUERIESPROC             ) glfwGetProcAddress("glDeleteQueries");
+        g_gl.GenQueries                 = (PFNGLGENQUERIESPROC                ) glfwGetProcAddress("glGenQueries");
+        g_gl.GetQueryObjectiv           = (PFNGLGETQUERYOBJECTIVPROC          ) glfwGetProcAddress("glGetQueryObjectiv");
+        g_gl.GetQueryObjectui64v        = (PFNGLGETQUERYOBJECTUI64VPROC       ) glfwGetProcAddress("glGetQueryObjectui64v");
+        g_gl.QueryCounter               = (PFNGLQUERYCOUNTERPROC              ) glfwGetProcAddress("glQueryCounter");
+    } else if(glfwExtensionSupported("GL_EXT_disjoint_timer_query")) {
+        g_gl.DeleteQueries              = (PFNGLDELETEQUERIESPROC             ) glfwGetProcAddress("glDeleteQueriesEXT");
+        g_gl.GenQueries                 = (PFNGLGENQUERIESPROC                ) glfwGetProcAddress("glGenQueriesEXT");
+        g_gl.GetQueryObjectiv           = (PFNGLGETQUERYOBJECTIVPROC          ) glfwGetProcAddress("glGetQueryObjectivEXT");
+        g_gl.GetQueryObjectui64v        = (PFNGLGETQUERYOBJECTUI64VPROC       ) glfwGetProcAddress("glGetQueryObjectui64vEXT");
+        g_gl.QueryCounter               = (PFNGLQUERYCOUNTERPROC              ) glfwGetProcAddress("glQueryCounterEXT");
+        g_gl.timer_queries_disjoint = true;
+    }
+    g_gl.timer_queries_available = g_gl.DeleteQueries != NULL && g_gl.GenQueries != NULL && g_gl.GetQueryObjectiv != NULL
+                                && g_gl.GetQueryObjectui64v != NULL && g_gl.QueryCounter != NULL;
+    
+#ifndef GFX_NO_FRAME_STATS
+    install_frame_stats_counters();
+#endif
+    g_gl.errors.immediate_GetError = g_gl.GetError;
+    if(g_gl.errors.mode == GFX_ERROR_CHECK_MODE_DEFERRED) {
+        g_gl.GetError = gfx_deferred_GetError;
+    }
 }
 static gfx_fixed_function_state_t default_state(int width, int height) {
     gfx_fixed_function_state_t s;
@@ -1989,15 +2259,703 @@ static bool check_params(gfx_fixed_function_state_t state) {
             return false;
     }
 #endif
-
-    return true;
+
+    return true;
+}
+
+
+/* internal profiler: */
+#ifndef GL_TIMESTAMP
+#define GL_TIMESTAMP 0x8E28
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+#define GFX_PROFILER_MAX_SCOPES_PER_FRAME 128
+#define GFX_PROFILER_MAX_SCOPE_DEPTH 16
+#define GFX_PROFILER_MAX_SCOPE_NAMES 64
+/* frames whose timer queries may still be in flight, each owns two queries per scope in the query ring */
+#define GFX_PROFILER_FRAMES_IN_FLIGHT 4
+/* resolved frames kept for the timeline and the stats */
+#define GFX_PROFILER_HISTORY_FRAMES 128
+#define GFX_PROFILER_NO_SCOPE 0xFFFFFFFF
+
+typedef struct gfx_profiler_scope_record_t {
+    uint32_t name_index, depth;
+    uint64_t cpu_begin, cpu_end; /* in glfw timer ticks */
+    uint64_t gpu_begin, gpu_end; /* in nanoseconds, only valid if gpu_valid */
+    bool gpu_timed, gpu_valid;
+} gfx_profiler_scope_record_t;
+typedef struct gfx_profiler_frame_t {
+    uint64_t index;
+    uint32_t nr_scopes;
+    bool gpu_timed; /* at least one scope issued queries */
+    gfx_profiler_scope_record_t scopes[GFX_PROFILER_MAX_SCOPES_PER_FRAME];
+} gfx_profiler_frame_t;
+static struct g_profiler {
+    bool enabled;
+    uint64_t timer_frequency;
+    const char* names[GFX_PROFILER_MAX_SCOPE_NAMES];
+    uint32_t nr_names;
+    uint32_t open_scopes[GFX_PROFILER_MAX_SCOPE_DEPTH];
+    uint32_t depth;
+    /* frames [oldest_pending, frame_index] are in flight, frame i lives in in_flight[i % GFX_PROFILER_FRAMES_IN_FLIGHT]
+     * and uses the queries starting at queries[(i % GFX_PROFILER_FRAMES_IN_FLIGHT) * 2 * GFX_PROFILER_MAX_SCOPES_PER_FRAME] */
+    uint64_t frame_index, oldest_pending;
+    gfx_profiler_frame_t* in_flight;
+    GLuint* queries;
+    /* resolved frame i lives in history[i % GFX_PROFILER_HISTORY_FRAMES] */
+    gfx_profiler_frame_t* history;
+    uint64_t nr_resolved;
+    gfx_profiler_scope_stats_t stats[GFX_PROFILER_MAX_SCOPE_NAMES];
+    double *cpu_samples, *gpu_samples;
+} g_profiler;
+
+static GLuint* gfx_profiler_frame_queries(uint64_t frame_index) {
+    return &g_profiler.queries[(frame_index % GFX_PROFILER_FRAMES_IN_FLIGHT) * 2 * GFX_PROFILER_MAX_SCOPES_PER_FRAME];
+}
+static gfx_profiler_frame_t* gfx_profiler_current_frame(void) {
+    return &g_profiler.in_flight[g_profiler.frame_index % GFX_PROFILER_FRAMES_IN_FLIGHT];
+}
+static uint32_t gfx_profiler_name_index(const char* name) {
+    for(uint32_t i = 0; i < g_profiler.nr_names; i++) {
+        if(g_profiler.names[i] == name || strcmp(g_profiler.names[i], name) == 0) {
+            return i;
+        }
+    }
+    if(g_profiler.nr_names >= GFX_PROFILER_MAX_SCOPE_NAMES) {
+        return GFX_PROFILER_NO_SCOPE;
+    }
+    g_profiler.names[g_profiler.nr_names] = name;
+    return g_profiler.nr_names++;
+}
+/* Reads back the timer queries of a frame and moves it into the history.
+ * If the results are not available yet, resolved is set to false and nothing happens, unless discard_gpu is set,
+ * in which case the frame is moved over with only its CPU times, so that we never have to wait on the GPU. */
+static gfx_result_t gfx_profiler_frame_resolve(gfx_profiler_frame_t* frame, bool discard_gpu, bool* resolved) {
+    GLuint* queries = gfx_profiler_frame_queries(frame[0].index);
+    GLint available = GL_TRUE;
+    GLuint64 value;
+    
+    if(frame[0].gpu_timed && !discard_gpu) {
+        /* every query, the outer scopes end last, so the last recorded scope's isn't the one issued last */
+        for(uint32_t i = 0; i < 2 * frame[0].nr_scopes && available == GL_TRUE; i++) {
+            if(frame[0].scopes[i/2].gpu_timed) {
+                g_gl.GetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+#ifndef GFX_NO_CHECKS
+                if(g_gl.GetError() != GL_NO_ERROR) {
+                    return GFX_ERROR_UNKNOWN;
+                }
+#endif
+            }
+        }
+        if(available != GL_TRUE) {
+            resolved[0] = false;
+            return GFX_OK;
+        }
+    }
+    
+    for(uint32_t i = 0; i < frame[0].nr_scopes; i++) {
+        gfx_profiler_scope_record_t* scope = &frame[0].scopes[i];
+        scope[0].gpu_valid = false;
+        if(!scope[0].gpu_timed || discard_gpu) {
+            continue;
+        }
+        g_gl.GetQueryObjectui64v(queries[2*i], GL_QUERY_RESULT, &value);
+#ifndef GFX_NO_CHECKS
+        if(g_gl.GetError() != GL_NO_ERROR) {
+            return GFX_ERROR_UNKNOWN;
+        }
+#endif
+        scope[0].gpu_begin = value;
+        g_gl.GetQueryObjectui64v(queries[2*i+1], GL_QUERY_RESULT, &value);
+#ifndef GFX_NO_CHECKS
+        if(g_gl.GetError() != GL_NO_ERROR) {
+            return GFX_ERROR_UNKNOWN;
+        }
+#endif
+        scope[0].gpu_end = value;
+        scope[0].gpu_valid = true;
+    }
+    
+    g_profiler.history[g_profiler.nr_resolved % GFX_PROFILER_HISTORY_FRAMES] = frame[0];
+    g_profiler.nr_resolved++;
+    resolved[0] = true;
+    return GFX_OK;
+}
+/* called by gfx_render: closes the current frame, resolves finished frames and opens the next one */
+static gfx_result_t gfx_profiler_frame_end(void) {
+    gfx_result_t r, unbalanced = GFX_OK;
+    gfx_profiler_frame_t* frame;
+    bool resolved, discard_gpu = false;
+    GLint disjoint;
+    
+    if(!g_profiler.enabled) {
+        return GFX_OK;
+    }
+    
+    /* close the implicit frame scope, and any the user forgot, which is reported as an error after the bookkeeping is done */
+    if(g_profiler.depth != 1) {
+        unbalanced = GFX_ERROR_OPERATION_INVALID;
+    }
+    while(g_profiler.depth > 0) {
+        gfx_profiler_scope_end();
+    }
+    
+    if(g_gl.timer_queries_available && g_gl.timer_queries_disjoint) {
+        /* on EXT_disjoint_timer_query, results are meaningless if the GPU got disjoint (e.g. by power management) */
+        g_gl.GetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+#ifndef GFX_NO_CHECKS
+        if(g_gl.GetError() != GL_NO_ERROR) {
+            return GFX_ERROR_UNKNOWN;
+        }
+#endif
+        discard_gpu = disjoint != 0;
+    }
+    
+    while(g_profiler.oldest_pending <= g_profiler.frame_index) {
+        frame = &g_profiler.in_flight[g_profiler.oldest_pending % GFX_PROFILER_FRAMES_IN_FLIGHT];
+        r = gfx_profiler_frame_resolve(frame, discard_gpu, &resolved);
+#ifndef GFX_NO_CHECKS
+        if(r != GFX_OK) { return r; }
+#endif
+        if(!resolved) {
+            break;
+        }
+        g_profiler.oldest_pending++;
+    }
+    
+    g_profiler.frame_index++;
+    if(g_profiler.frame_index - g_profiler.oldest_pending >= GFX_PROFILER_FRAMES_IN_FLIGHT) {
+        /* the GPU is too far behind; drop the GPU part of the oldest frame instead of stalling */
+        frame = &g_profiler.in_flight[g_profiler.oldest_pending % GFX_PROFILER_FRAMES_IN_FLIGHT];
+        r = gfx_profiler_frame_resolve(frame, true, &resolved);
+#ifndef GFX_NO_CHECKS
+        if(r != GFX_OK) { return r; }
+#endif
+        g_profiler.oldest_pending++;
+    }
+    
+    frame = gfx_profiler_current_frame();
+    frame[0].index = g_profiler.frame_index;
+    frame[0].nr_scopes = 0;
+    frame[0].gpu_timed = false;
+    
+    r = gfx_profiler_scope_begin("frame", true);
+#ifndef GFX_NO_CHECKS
+    if(r != GFX_OK) { return r; }
+#endif
+    return unbalanced;
+}
+static int gfx_profiler_compare_samples(const void* a, const void* b) {
+    double x = ((const double*) a)[0], y = ((const double*) b)[0];
+    return (x > y) - (x < y);
+}
+/* nearest rank percentile of sorted samples */
+static double gfx_profiler_percentile(double* sorted_samples, uint32_t count, uint32_t percent) {
+    uint32_t rank;
+    if(count == 0) {
+        return 0.0;
+    }
+    rank = (count * percent + 99) / 100;
+    return sorted_samples[rank > 0 ? rank-1 : 0];
+}
+static double gfx_profiler_ticks_to_us(uint64_t ticks) {
+    return (double) ticks * 1000000.0 / (double) g_profiler.timer_frequency;
+}
+/* scope names are user strings, quotes, backslashes and control characters have to be escaped */
+static void gfx_profiler_json_string_write(FILE* file, const char* str) {
+    fputc('"', file);
+    for(const unsigned char* c = (const unsigned char*) str; c[0] != '\0'; c++) {
+        if(c[0] == '"' || c[0] == '\\') {
+            fputc('\\', file);
+            fputc(c[0], file);
+        } else if(c[0] < 0x20) {
+            fprintf(file, "\\u%04x", c[0]);
+        } else {
+            fputc(c[0], file);
+        }
+    }
+    fputc('"', file);
+}
+
+/* internal state blocks: */
+#define GFX_STATE_BLOCK_MAX_SUBSTATES 11
+#define GFX_STATE_BLOCK_INITIAL_CAP 64
+static const uint32_t gfx_state_block_nr_substates[] = { 9, 11, 6 }; /* blend, depth-stencil, raster */
+
+/* A sub-state is the part of a block that is set by one GL call. Each gets a 64 bit key: small sub-states are packed
+ * exactly, the blend color and the stencil functions are hashed, so for those equal keys are checked against the
+ * state before a GL call is skipped or a block is reused (see gfx_state_block_changed). */
+typedef struct gfx_internal_state_block_t {
+    gfx_state_block_type_t type;
+    uint64_t hash;
+    uint64_t keys[GFX_STATE_BLOCK_MAX_SUBSTATES];
+    gfx_fixed_function_state_t state; /* only the fields belonging to type are used */
+    /* pre-translated GL enums, so that binding does not need to switch */
+    GLenum blend_equations[2]; /* rgb, alpha */
+    GLenum blend_factors[4]; /* src_rgb, dst_rgb, src_alpha, dst_alpha */
+    GLenum depth_func, front_face, cull_face;
+    GLenum stencil_funcs[2]; /* front, back */
+    GLenum stencil_ops[2][3]; /* front, back x sfail, dpfail, dppass */
+} gfx_internal_state_block_t;
+static struct g_state_blocks {
+    gfx_internal_state_block_t* data;
+    uint32_t count, capacity;
+    /* index+1 of the bound block per type, 0 if unknown (e.g. after gfx_params_set) */
+    uint32_t bound[3];
+} g_state_blocks;
+
+static const GLenum gfx_gl_blend_equations[] = { GL_FUNC_ADD, GL_FUNC_SUBTRACT, GL_FUNC_REVERSE_SUBTRACT };
+static const GLenum gfx_gl_blend_factors[] = {
+    GL_ZERO, GL_ONE, GL_SRC_COLOR, GL_ONE_MINUS_SRC_COLOR, GL_DST_COLOR, GL_ONE_MINUS_DST_COLOR, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+    GL_DST_ALPHA, GL_ONE_MINUS_DST_ALPHA, GL_CONSTANT_COLOR, GL_ONE_MINUS_CONSTANT_COLOR, GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA,
+    GL_SRC_ALPHA_SATURATE
+};
+static const GLenum gfx_gl_comparison_functions[] = { GL_NEVER, GL_LESS, GL_EQUAL, GL_LEQUAL, GL_GREATER, GL_NOTEQUAL, GL_GEQUAL, GL_ALWAYS };
+static const GLenum gfx_gl_stencil_operations[] = { GL_KEEP, GL_ZERO, GL_REPLACE, GL_INCR, GL_INCR_WRAP, GL_DECR, GL_DECR_WRAP, GL_INVERT };
+static const GLenum gfx_gl_cull_faces[] = { GL_FRONT, GL_BACK, GL_FRONT_AND_BACK };
+static const GLenum gfx_gl_front_faces[] = { GL_CW, GL_CCW };
+
+static uint64_t gfx_state_block_hash_bytes(uint64_t h, const void* data, size_t size) {
+    /* FNV-1a */
+    const uint8_t* bytes = data;
+    for(size_t i = 0; i < size; i++) {
+        h ^= bytes[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+static uint64_t gfx_state_block_float_bits(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+static bool gfx_state_block_clamped(float f) {
+    return f >= 0.0f && f <= 1.0f;
+}
+/* validates the fields of the block type in state and translates them into block */
+static gfx_result_t gfx_state_block_translate(gfx_state_block_type_t type, const gfx_fixed_function_state_t* state, gfx_internal_state_block_t* block) {
+    uint64_t h;
+    
+    memset(block, 0, sizeof(block[0]));
+    block[0].type = type;
+    block[0].state = state[0];
+    
+    switch(type) {
+    case GFX_STATE_BLOCK_TYPE_BLEND:
+        if(state[0].blend.rgb_equation > GFX_BLEND_EQUATION_TYPE_REVERSE_SUBTRACT || state[0].blend.alpha_equation > GFX_BLEND_EQUATION_TYPE_REVERSE_SUBTRACT) {
+            return GFX_ERROR_INVALID_PARAM;
+        }
+        if(state[0].blend.src_rgb > GFX_BLEND_FACTOR_TYPE_SRC_ALPHA_SATURATE || state[0].blend.src_alpha > GFX_BLEND_FACTOR_TYPE_SRC_ALPHA_SATURATE
+        || state[0].blend.dst_rgb >= GFX_BLEND_FACTOR_TYPE_SRC_ALPHA_SATURATE || state[0].blend.dst_alpha >= GFX_BLEND_FACTOR_TYPE_SRC_ALPHA_SATURATE) {
+            return GFX_ERROR_INVALID_PARAM;
+        }
+        if(!gfx_state_block_clamped(state[0].blend.color.r) || !gfx_state_block_clamped(state[0].blend.color.g)
+        || !gfx_state_block_clamped(state[0].blend.color.b) || !gfx_state_block_clamped(state[0].blend.color.a)
+        || !gfx_state_block_clamped(state[0].sample_coverage.coverage_value)) {
+            return GFX_ERROR_INVALID_PARAM;
+        }
+        block[0].blend_equations[0] = gfx_gl_blend_equations[state[0].blend.rgb_equation];
+        block[0].blend_equations[1] = gfx_gl_blend_equations[state[0].blend.alpha_equation];
+        block[0].blend_factors[0] = gfx_gl_blend_factors[state[0].blend.src_rgb];
+        block[0].blend_factors[1] = gfx_gl_blend_factors[state[0].blend.dst_rgb];
+        block[0].blend_factors[2] = gfx_gl_blend_factors[state[0].blend.src_alpha];
+        block[0].blend_factors[3] = gfx_gl_blend_factors[state[0].blend.dst_alpha];
+        
+        block[0].keys[0] = state[0].blend.enabled;
+        block[0].keys[1] = gfx_state_block_hash_bytes(0xcbf29ce484222325ULL, &state[0].blend.color, sizeof(state[0].blend.color));
+        block[0].keys[2] = ((uint64_t) block[0].blend_equations[0] << 16) | block[0].blend_equations[1];
+        block[0].keys[3] = ((uint64_t) block[0].blend_factors[0] << 48) | ((uint64_t) block[0].blend_factors[1] << 32)
+                         | ((uint64_t) block[0].blend_factors[2] << 16) | block[0].blend_factors[3];
+        block[0].keys[4] = state[0].mask.color.r | (state[0].mask.color.g << 1) | (state[0].mask.color.b << 2) | (state[0].mask.color.a << 3);
+        block[0].keys[5] = state[0].sample_coverage.enabled;
+        block[0].keys[6] = state[0].sample_coverage.convert_alpha_to_coverage_value;
+        block[0].keys[7] = (gfx_state_block_float_bits(state[0].sample_coverage.coverage_value) << 1) | state[0].sample_coverage.invert_coverage_mask;
+        block[0].keys[8] = state[0].dithering_enabled;
+        break;
+    case GFX_STATE_BLOCK_TYPE_DEPTH_STENCIL:
+        if(state[0].depth.comparison_function > GFX_TEST_COMPARISON_FUNCTION_ALWAYS_ACCEPT
+        || state[0].stencil.front_face.comparison_function > GFX_TEST_COMPARISON_FUNCTION_ALWAYS_ACCEPT
+        || state[0].stencil.back_face.comparison_function > GFX_TEST_COMPARISON_FUNCTION_ALWAYS_ACCEPT) {
+            return GFX_ERROR_INVALID_PARAM;
+        }
+        if(state[0].stencil.front_face.if_stencil_fails > GFX_STENCIL_OPERATION_BIT_INVERT_CURRENT_VALUE
+        || state[0].stencil.front_face.if_stencil_passes_and_depth_fails > GFX_STENCIL_OPERATION_BIT_INVERT_CURRENT_VALUE
+        || state[0].stencil.front_face.if_stencil_passes_and_depth_passes_or_is_not_available > GFX_STENCIL_OPERATION_BIT_INVERT_CURRENT_VALUE
+        || state[0].stencil.back_face.if_stencil_fails > GFX_STENCIL_OPERATION_BIT_INVERT_CURRENT_VALUE
+        || state[0].stencil.back_face.if_stencil_passes_and_depth_fails > GFX_STENCIL_OPERATION_BIT_INVERT_CURRENT_VALUE
+        || state[0].stencil.back_face.if_stencil_passes_and_depth_passes_or_is_not_available > GFX_STENCIL_OPERATION_BIT_INVERT_CURRENT_VALUE) {
+            return GFX_ERROR_INVALID_PARAM;
+        }
+        if(!gfx_state_block_clamped(state[0].depth.range.near) || !gfx_state_block_clamped(state[0].depth.range.far)) {
+            return GFX_ERROR_INVALID_PARAM;
+        }
+        block[0].depth_func = gfx_gl_comparison_functions[state[0].depth.comparison_function];
+        block[0].stencil_funcs[0] = gfx_gl_comparison_functions[state[0].stencil.front_face.comparison_function];
+        block[0].stencil_funcs[1] = gfx_gl_comparison_functions[state[0].stencil.back_face.comparison_function];
+        block[0].stencil_ops[0][0] = gfx_gl_stencil_operations[state[0].stencil.front_face.if_stencil_fails];
+        block[0].stencil_ops[0][1] = gfx_gl_stencil_operations[state[0].stencil.front_face.if_stencil_passes_and_depth_fails];
+        block[0].stencil_ops[0][2] = gfx_gl_stencil_operations[state[0].stencil.front_face.if_stencil_passes_and_depth_passes_or_is_not_available];
+        block[0].stencil_ops[1][0] = gfx_gl_stencil_operations[state[0].stencil.back_face.if_stencil_fails];
+        block[0].stencil_ops[1][1] = gfx_gl_stencil_operations[state[0].stencil.back_face.if_stencil_passes_and_depth_fails];
+        block[0].stencil_ops[1][2] = gfx_gl_stencil_operations[state[0].stencil.back_face.if_stencil_passes_and_depth_passes_or_is_not_available];
+        
+        block[0].keys[0] = state[0].depth.test_enabled;
+        block[0].keys[1] = block[0].depth_func;
+        block[0].keys[2] = (gfx_state_block_float_bits(state[0].depth.range.near) << 32) | gfx_state_block_float_bits(state[0].depth.range.far);
+        block[0].keys[3] = state[0].mask.depth;
+        block[0].keys[4] = state[0].stencil.test_enabled;
+        h = gfx_state_block_hash_bytes(0xcbf29ce484222325ULL, &block[0].stencil_funcs[0], sizeof(GLenum));
+        h = gfx_state_block_hash_bytes(h, &state[0].stencil.front_face.reference_value, sizeof(int));
+        block[0].keys[5] = gfx_state_block_hash_bytes(h, &state[0].stencil.front_face.compare_mask, sizeof(uint32_t));
+        h = gfx_state_block_hash_bytes(0xcbf29ce484222325ULL, &block[0].stencil_funcs[1], sizeof(GLenum));
+        h = gfx_state_block_hash_bytes(h, &state[0].stencil.back_face.reference_value, sizeof(int));
+        block[0].keys[6] = gfx_state_block_hash_bytes(h, &state[0].stencil.back_face.compare_mask, sizeof(uint32_t));
+        block[0].keys[7] = state[0].stencil.front_face.write_mask;
+        block[0].keys[8] = state[0].stencil.back_face.write_mask;
+        block[0].keys[9] = ((uint64_t) block[0].stencil_ops[0][0] << 32) | ((uint64_t) block[0].stencil_ops[0][1] << 16) | block[0].stencil_ops[0][2];
+        block[0].keys[10] = ((uint64_t) block[0].stencil_ops[1][0] << 32) | ((uint64_t) block[0].stencil_ops[1][1] << 16) | block[0].stencil_ops[1][2];
+        break;
+    case GFX_STATE_BLOCK_TYPE_RASTER:
+        if(state[0].cull.front_face_orientation > GFX_FACE_ORIENTATION_COUNTER_CLOCKWISE || state[0].cull.which_face > GFX_CULL_FACE_TYPE_BOTH) {
+            return GFX_ERROR_INVALID_PARAM;
+        }
+        if(state[0].line_width <= 0 || state[0].line_width < g_gl.limits.line_width.min || state[0].line_width > g_gl.limits.line_width.max) {
+            return GFX_ERROR_INVALID_PARAM;
+        }
+        block[0].front_face = gfx_gl_front_faces[state[0].cull.front_face_orientation];
+        block[0].cull_face = gfx_gl_cull_faces[state[0].cull.which_face];
+        
+        block[0].keys[0] = state[0].cull.enabled;
+        block[0].keys[1] = block[0].front_face;
+        block[0].keys[2] = block[0].cull_face;
+        block[0].keys[3] = state[0].polygon_offset.fill_enabled;
+        block[0].keys[4] = (gfx_state_block_float_bits(state[0].polygon_offset.scale_factor) << 32) | gfx_state_block_float_bits(state[0].polygon_offset.units);
+        block[0].keys[5] = gfx_state_block_float_bits(state[0].line_width);
+        break;
+    default:
+        return GFX_ERROR_INVALID_PARAM;
+    }
+    
+    h = gfx_state_block_hash_bytes(0xcbf29ce484222325ULL, &block[0].type, sizeof(block[0].type));
+    h = gfx_state_block_hash_bytes(h, block[0].keys, sizeof(block[0].keys));
+    block[0].hash = h != 0 ? h : 1;
+    return GFX_OK;
+}
+/* the sub-states of b that differ from a, bit i standing for keys[i]; a and b have the same type */
+static uint32_t gfx_state_block_changed(const gfx_internal_state_block_t* a, const gfx_internal_state_block_t* b) {
+    uint32_t changed = 0;
+    
+    for(uint32_t k = 0; k < GFX_STATE_BLOCK_MAX_SUBSTATES; k++) {
+        changed |= (uint32_t) ((a[0].keys[k] ^ b[0].keys[k]) != 0) << k;
+    }
+    /* the hashed keys can collide */
+    switch(b[0].type) {
+    case GFX_STATE_BLOCK_TYPE_BLEND:
+        if(memcmp(&a[0].state.blend.color, &b[0].state.blend.color, sizeof(b[0].state.blend.color)) != 0) {
+            changed |= 1 << 1;
+        }
+        break;
+    case GFX_STATE_BLOCK_TYPE_DEPTH_STENCIL:
+        if(a[0].stencil_funcs[0] != b[0].stencil_funcs[0]
+        || a[0].state.stencil.front_face.reference_value != b[0].state.stencil.front_face.reference_value
+        || a[0].state.stencil.front_face.compare_mask != b[0].state.stencil.front_face.compare_mask) {
+            changed |= 1 << 5;
+        }
+        if(a[0].stencil_funcs[1] != b[0].stencil_funcs[1]
+        || a[0].state.stencil.back_face.reference_value != b[0].state.stencil.back_face.reference_value
+        || a[0].state.stencil.back_face.compare_mask != b[0].state.stencil.back_face.compare_mask) {
+            changed |= 1 << 6;
+        }
+        break;
+    default:
+        break;
+    }
+    return changed;
+}
+static gfx_result_t gfx_state_toggle(GLenum capability, bool enabled) {
+    if(enabled) {
+        g_gl.Enable(capability);
+    } else {
+        g_gl.Disable(capability);
+    }
+#ifndef GFX_NO_CHECKS
+    if(g_gl.GetError() != GL_NO_ERROR) {
+        return GFX_ERROR_UNKNOWN;
+    }
+#endif
+    return GFX_OK;
+}
+/* issues the GL calls for the sub-states set in changed, bit i standing for keys[i] */
+static gfx_result_t gfx_state_block_apply(const gfx_internal_state_block_t* block, uint32_t changed) {
+    gfx_result_t r = GFX_OK;
+    const gfx_fixed_function_state_t* s = &block[0].state;
+    
+    switch(block[0].type) {
+    case GFX_STATE_BLOCK_TYPE_BLEND:
+        if(changed & (1 << 0)) {
+            r = gfx_state_toggle(GL_BLEND, s[0].blend.enabled);
+#ifndef GFX_NO_CHECKS
+            if(r != GFX_OK) { return r; }
+#endif
+        }
+        g_gl.state.blend.enabled = s[0].blend.enabled;
+        if(changed & (1 << 1)) {
+            g_gl.BlendColor(s[0].blend.color.r, s[0].blend.color.g, s[0].blend.color.b, s[0].blend.color.a);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.blend.color = s[0].blend.color;
+        if(changed & (1 << 2)) {
+            g_gl.BlendEquationSeparate(block[0].blend_equations[0], block[0].blend_equations[1]);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.blend.rgb_equation = s[0].blend.rgb_equation;
+        g_gl.state.blend.alpha_equation = s[0].blend.alpha_equation;
+        if(changed & (1 << 3)) {
+            g_gl.BlendFuncSeparate(block[0].blend_factors[0], block[0].blend_factors[1], block[0].blend_factors[2], block[0].blend_factors[3]);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.blend.src_rgb = s[0].blend.src_rgb;
+        g_gl.state.blend.dst_rgb = s[0].blend.dst_rgb;
+        g_gl.state.blend.src_alpha = s[0].blend.src_alpha;
+        g_gl.state.blend.dst_alpha = s[0].blend.dst_alpha;
+        if(changed & (1 << 4)) {
+            g_gl.ColorMask(s[0].mask.color.r ? GL_TRUE : GL_FALSE, s[0].mask.color.g ? GL_TRUE : GL_FALSE,
+                           s[0].mask.color.b ? GL_TRUE : GL_FALSE, s[0].mask.color.a ? GL_TRUE : GL_FALSE);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.mask.color = s[0].mask.color;
+        if(changed & (1 << 5)) {
+            r = gfx_state_toggle(GL_SAMPLE_COVERAGE, s[0].sample_coverage.enabled);
+#ifndef GFX_NO_CHECKS
+            if(r != GFX_OK) { return r; }
+#endif
+        }
+        g_gl.state.sample_coverage.enabled = s[0].sample_coverage.enabled;
+        if(changed & (1 << 6)) {
+            r = gfx_state_toggle(GL_SAMPLE_ALPHA_TO_COVERAGE, s[0].sample_coverage.convert_alpha_to_coverage_value);
+#ifndef GFX_NO_CHECKS
+            if(r != GFX_OK) { return r; }
+#endif
+        }
+        g_gl.state.sample_coverage.convert_alpha_to_coverage_value = s[0].sample_coverage.convert_alpha_to_coverage_value;
+        if(changed & (1 << 7)) {
+            g_gl.SampleCoverage(s[0].sample_coverage.coverage_value, s[0].sample_coverage.invert_coverage_mask ? GL_TRUE : GL_FALSE);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.sample_coverage.coverage_value = s[0].sample_coverage.coverage_value;
+        g_gl.state.sample_coverage.invert_coverage_mask = s[0].sample_coverage.invert_coverage_mask;
+        if(changed & (1 << 8)) {
+            r = gfx_state_toggle(GL_DITHER, s[0].dithering_enabled);
+#ifndef GFX_NO_CHECKS
+            if(r != GFX_OK) { return r; }
+#endif
+        }
+        g_gl.state.dithering_enabled = s[0].dithering_enabled;
+        break;
+    case GFX_STATE_BLOCK_TYPE_DEPTH_STENCIL:
+        if(changed & (1 << 0)) {
+            r = gfx_state_toggle(GL_DEPTH_TEST, s[0].depth.test_enabled);
+#ifndef GFX_NO_CHECKS
+            if(r != GFX_OK) { return r; }
+#endif
+        }
+        g_gl.state.depth.test_enabled = s[0].depth.test_enabled;
+        if(changed & (1 << 1)) {
+            g_gl.DepthFunc(block[0].depth_func);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.depth.comparison_function = s[0].depth.comparison_function;
+        if(changed & (1 << 2)) {
+            if(g_gl.version == GLES2) {
+                g_gl.DepthRangef(s[0].depth.range.near, s[0].depth.range.far);
+            } else {
+                g_gl.DepthRange(s[0].depth.range.near, s[0].depth.range.far);
+            }
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.depth.range = s[0].depth.range;
+        if(changed & (1 << 3)) {
+            g_gl.DepthMask(s[0].mask.depth ? GL_TRUE : GL_FALSE);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.mask.depth = s[0].mask.depth;
+        if(changed & (1 << 4)) {
+            r = gfx_state_toggle(GL_STENCIL_TEST, s[0].stencil.test_enabled);
+#ifndef GFX_NO_CHECKS
+            if(r != GFX_OK) { return r; }
+#endif
+        }
+        g_gl.state.stencil.test_enabled = s[0].stencil.test_enabled;
+        if(changed & (1 << 5)) {
+            g_gl.StencilFuncSeparate(GL_FRONT, block[0].stencil_funcs[0], s[0].stencil.front_face.reference_value, s[0].stencil.front_face.compare_mask);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.stencil.front_face.comparison_function = s[0].stencil.front_face.comparison_function;
+        g_gl.state.stencil.front_face.reference_value = s[0].stencil.front_face.reference_value;
+        g_gl.state.stencil.front_face.compare_mask = s[0].stencil.front_face.compare_mask;
+        if(changed & (1 << 6)) {
+            g_gl.StencilFuncSeparate(GL_BACK, block[0].stencil_funcs[1], s[0].stencil.back_face.reference_value, s[0].stencil.back_face.compare_mask);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.stencil.back_face.comparison_function = s[0].stencil.back_face.comparison_function;
+        g_gl.state.stencil.back_face.reference_value = s[0].stencil.back_face.reference_value;
+        g_gl.state.stencil.back_face.compare_mask = s[0].stencil.back_face.compare_mask;
+        if(changed & (1 << 7)) {
+            g_gl.StencilMaskSeparate(GL_FRONT, s[0].stencil.front_face.write_mask);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.stencil.front_face.write_mask = s[0].stencil.front_face.write_mask;
+        if(changed & (1 << 8)) {
+            g_gl.StencilMaskSeparate(GL_BACK, s[0].stencil.back_face.write_mask);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.stencil.back_face.write_mask = s[0].stencil.back_face.write_mask;
+        if(changed & (1 << 9)) {
+            g_gl.StencilOpSeparate(GL_FRONT, block[0].stencil_ops[0][0], block[0].stencil_ops[0][1], block[0].stencil_ops[0][2]);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.stencil.front_face.if_stencil_fails = s[0].stencil.front_face.if_stencil_fails;
+        g_gl.state.stencil.front_face.if_stencil_passes_and_depth_fails = s[0].stencil.front_face.if_stencil_passes_and_depth_fails;
+        g_gl.state.stencil.front_face.if_stencil_passes_and_depth_passes_or_is_not_available = s[0].stencil.front_face.if_stencil_passes_and_depth_passes_or_is_not_available;
+        if(changed & (1 << 10)) {
+            g_gl.StencilOpSeparate(GL_BACK, block[0].stencil_ops[1][0], block[0].stencil_ops[1][1], block[0].stencil_ops[1][2]);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.stencil.back_face.if_stencil_fails = s[0].stencil.back_face.if_stencil_fails;
+        g_gl.state.stencil.back_face.if_stencil_passes_and_depth_fails = s[0].stencil.back_face.if_stencil_passes_and_depth_fails;
+        g_gl.state.stencil.back_face.if_stencil_passes_and_depth_passes_or_is_not_available = s[0].stencil.back_face.if_stencil_passes_and_depth_passes_or_is_not_available;
+        break;
+    case GFX_STATE_BLOCK_TYPE_RASTER:
+        if(changed & (1 << 0)) {
+            r = gfx_state_toggle(GL_CULL_FACE, s[0].cull.enabled);
+#ifndef GFX_NO_CHECKS
+            if(r != GFX_OK) { return r; }
+#endif
+        }
+        g_gl.state.cull.enabled = s[0].cull.enabled;
+        if(changed & (1 << 1)) {
+            g_gl.FrontFace(block[0].front_face);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.cull.front_face_orientation = s[0].cull.front_face_orientation;
+        if(changed & (1 << 2)) {
+            g_gl.CullFace(block[0].cull_face);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.cull.which_face = s[0].cull.which_face;
+        if(changed & (1 << 3)) {
+            r = gfx_state_toggle(GL_POLYGON_OFFSET_FILL, s[0].polygon_offset.fill_enabled);
+#ifndef GFX_NO_CHECKS
+            if(r != GFX_OK) { return r; }
+#endif
+        }
+        g_gl.state.polygon_offset.fill_enabled = s[0].polygon_offset.fill_enabled;
+        if(changed & (1 << 4)) {
+            g_gl.PolygonOffset(s[0].polygon_offset.scale_factor, s[0].polygon_offset.units);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.polygon_offset.scale_factor = s[0].polygon_offset.scale_factor;
+        g_gl.state.polygon_offset.units = s[0].polygon_offset.units;
+        if(changed & (1 << 5)) {
+            g_gl.LineWidth(s[0].line_width);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        g_gl.state.line_width = s[0].line_width;
+        break;
+    default:
+        return GFX_ERROR_INVALID_PARAM;
+    }
+    return r;
 }
 
-
 /* public API: */
 gfx_result_t gfx_init(const char* window_name, int width, int height, gfx_window_icon_t* icon) {
+    /* a mode set before gfx_init is installed by load_gl */
+    gfx_error_check_mode_t error_check_mode = g_gl.errors.mode;
     memset(g_gl, 0, sizeof(g_gl));
     memset(g_glfw, 0, sizeof(g_glfw));
+    g_gl.errors.mode = error_check_mode;
     
     init_event_queue();
     
@@ -2408,6 +3366,13 @@ gfx_result_t gfx_init(const char* window_name, int width, int height, gfx_window
     return GFX_OK;
 }
 gfx_result_t gfx_exit(void) {
+    gfx_result_t r;
+    
+    r = gfx_profiler_enable(false);
+#ifndef GFX_NO_CHECKS
+    if(r != GFX_OK) { return r; }
+#endif
+    
     g_gl.Finish();
 #ifndef GFX_NO_CHECKS
     if(g_gl.GetError() != GL_NO_ERROR) {
@@ -2418,6 +3383,8 @@ gfx_result_t gfx_exit(void) {
     if(g_gl.screenshot.pixel_data != NULL) {
         free(g_gl.screenshot.pixel_data);
     }
+    free(g_state_blocks.data);
+    memset(&g_state_blocks, 0, sizeof(g_state_blocks));
     
     glfwDestroyWindow(g_glfw.window);
     
@@ -2674,6 +3641,280 @@ gfx_result_t gfx_timestamp(uint64_t* ticks) {
     return GFX_OK;
 }
 
+gfx_result_t gfx_profiler_enable(bool enabled) {
+    uint64_t frequency;
+    gfx_result_t r;
+    
+    if(enabled == g_profiler.enabled) {
+        return GFX_OK;
+    }
+    
+    if(!enabled) {
+        if(g_profiler.queries != NULL) {
+            g_gl.DeleteQueries(2 * GFX_PROFILER_FRAMES_IN_FLIGHT * GFX_PROFILER_MAX_SCOPES_PER_FRAME, g_profiler.queries);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        free(g_profiler.queries);
+        free(g_profiler.in_flight);
+        free(g_profiler.history);
+        free(g_profiler.cpu_samples);
+        free(g_profiler.gpu_samples);
+        memset(&g_profiler, 0, sizeof(g_profiler));
+        return GFX_OK;
+    }
+    
+    r = gfx_timestamp_frequency(&frequency);
+#ifndef GFX_NO_CHECKS
+    if(r != GFX_OK) { return r; }
+#endif
+    
+    memset(&g_profiler, 0, sizeof(g_profiler));
+    g_profiler.timer_frequency = frequency;
+    g_profiler.in_flight = calloc(GFX_PROFILER_FRAMES_IN_FLIGHT, sizeof(gfx_profiler_frame_t));
+    g_profiler.history = calloc(GFX_PROFILER_HISTORY_FRAMES, sizeof(gfx_profiler_frame_t));
+    g_profiler.cpu_samples = calloc(GFX_PROFILER_HISTORY_FRAMES, sizeof(double));
+    g_profiler.gpu_samples = calloc(GFX_PROFILER_HISTORY_FRAMES, sizeof(double));
+    if(g_gl.timer_queries_available) {
+        g_profiler.queries = calloc(2 * GFX_PROFILER_FRAMES_IN_FLIGHT * GFX_PROFILER_MAX_SCOPES_PER_FRAME, sizeof(GLuint));
+    }
+    if(g_profiler.in_flight == NULL || g_profiler.history == NULL || g_profiler.cpu_samples == NULL || g_profiler.gpu_samples == NULL
+    || (g_gl.timer_queries_available && g_profiler.queries == NULL)) {
+        free(g_profiler.queries);
+        free(g_profiler.in_flight);
+        free(g_profiler.history);
+        free(g_profiler.cpu_samples);
+        free(g_profiler.gpu_samples);
+        memset(&g_profiler, 0, sizeof(g_profiler));
+        return GFX_ERROR_OUT_OF_MEMORY;
+    }
+    if(g_profiler.queries != NULL) {
+        g_gl.GenQueries(2 * GFX_PROFILER_FRAMES_IN_FLIGHT * GFX_PROFILER_MAX_SCOPES_PER_FRAME, g_profiler.queries);
+#ifndef GFX_NO_CHECKS
+        if(g_gl.GetError() != GL_NO_ERROR) {
+            return GFX_ERROR_UNKNOWN;
+        }
+#endif
+    }
+    
+    g_profiler.enabled = true;
+    return gfx_profiler_scope_begin("frame", true);
+}
+gfx_result_t gfx_profiler_scope_begin(const char* name, bool gpu_timed) {
+    gfx_profiler_frame_t* frame;
+    gfx_profiler_scope_record_t* scope;
+    uint32_t name_index, scope_index;
+    uint64_t ticks;
+    
+#ifndef GFX_NO_CHECKS
+    if(name == NULL) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+#endif
+    if(!g_profiler.enabled) {
+        return GFX_OK;
+    }
+#ifndef GFX_NO_CHECKS
+    if(g_profiler.depth >= GFX_PROFILER_MAX_SCOPE_DEPTH) {
+        return GFX_ERROR_OPERATION_INVALID;
+    }
+#endif
+    
+    frame = gfx_profiler_current_frame();
+    name_index = gfx_profiler_name_index(name);
+    if(name_index == GFX_PROFILER_NO_SCOPE || frame[0].nr_scopes >= GFX_PROFILER_MAX_SCOPES_PER_FRAME) {
+        /* out of room: the scope is still tracked for nesting, but not recorded */
+        g_profiler.open_scopes[g_profiler.depth++] = GFX_PROFILER_NO_SCOPE;
+        return GFX_OK;
+    }
+    scope_index = frame[0].nr_scopes++;
+    scope = &frame[0].scopes[scope_index];
+    scope[0].name_index = name_index;
+    scope[0].depth = g_profiler.depth;
+    scope[0].gpu_timed = gpu_timed && g_gl.timer_queries_available;
+    scope[0].gpu_valid = false;
+    g_profiler.open_scopes[g_profiler.depth++] = scope_index;
+    
+    if(scope[0].gpu_timed) {
+        g_gl.QueryCounter(gfx_profiler_frame_queries(frame[0].index)[2*scope_index], GL_TIMESTAMP);
+#ifndef GFX_NO_CHECKS
+        if(g_gl.GetError() != GL_NO_ERROR) {
+            return GFX_ERROR_UNKNOWN;
+        }
+#endif
+        frame[0].gpu_timed = true;
+    }
+    
+    /* taken last so that the query submission is not part of the scope */
+    ticks = glfwGetTimerValue();
+    scope[0].cpu_begin = ticks;
+    scope[0].cpu_end = ticks;
+    return GFX_OK;
+}
+gfx_result_t gfx_profiler_scope_end(void) {
+    gfx_profiler_frame_t* frame;
+    gfx_profiler_scope_record_t* scope;
+    uint32_t scope_index;
+    uint64_t ticks;
+    
+    if(!g_profiler.enabled) {
+        return GFX_OK;
+    }
+    ticks = glfwGetTimerValue();
+#ifndef GFX_NO_CHECKS
+    if(g_profiler.depth == 0) {
+        return GFX_ERROR_OPERATION_INVALID;
+    }
+#endif
+    
+    scope_index = g_profiler.open_scopes[--g_profiler.depth];
+    if(scope_index == GFX_PROFILER_NO_SCOPE) {
+        return GFX_OK;
+    }
+    frame = gfx_profiler_current_frame();
+    scope = &frame[0].scopes[scope_index];
+    scope[0].cpu_end = ticks;
+    
+    if(scope[0].gpu_timed) {
+        g_gl.QueryCounter(gfx_profiler_frame_queries(frame[0].index)[2*scope_index+1], GL_TIMESTAMP);
+#ifndef GFX_NO_CHECKS
+        if(g_gl.GetError() != GL_NO_ERROR) {
+            return GFX_ERROR_UNKNOWN;
+        }
+#endif
+    }
+    return GFX_OK;
+}
+gfx_result_t gfx_profiler_stats(int* nr_scopes, const gfx_profiler_scope_stats_t** stats) {
+    uint64_t first, nr_frames;
+    uint32_t nr_cpu, nr_gpu;
+    double cpu_ms, gpu_ms;
+    bool seen, gpu_seen;
+    
+#ifndef GFX_NO_CHECKS
+    if(nr_scopes == NULL || stats == NULL) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+    if(!g_profiler.enabled) {
+        return GFX_ERROR_OPERATION_INVALID;
+    }
+#endif
+    
+    nr_frames = g_profiler.nr_resolved < GFX_PROFILER_HISTORY_FRAMES ? g_profiler.nr_resolved : GFX_PROFILER_HISTORY_FRAMES;
+    first = g_profiler.nr_resolved - nr_frames;
+    for(uint32_t n = 0; n < g_profiler.nr_names; n++) {
+        nr_cpu = 0;
+        nr_gpu = 0;
+        for(uint64_t f = first; f < g_profiler.nr_resolved; f++) {
+            gfx_profiler_frame_t* frame = &g_profiler.history[f % GFX_PROFILER_HISTORY_FRAMES];
+            cpu_ms = 0.0;
+            gpu_ms = 0.0;
+            seen = false;
+            gpu_seen = false;
+            for(uint32_t i = 0; i < frame[0].nr_scopes; i++) {
+                gfx_profiler_scope_record_t* scope = &frame[0].scopes[i];
+                if(scope[0].name_index != n) {
+                    continue;
+                }
+                seen = true;
+                cpu_ms += gfx_profiler_ticks_to_us(scope[0].cpu_end - scope[0].cpu_begin) / 1000.0;
+                if(scope[0].gpu_valid) {
+                    gpu_seen = true;
+                    gpu_ms += (double) (scope[0].gpu_end - scope[0].gpu_begin) / 1000000.0;
+                }
+            }
+            if(seen) {
+                g_profiler.cpu_samples[nr_cpu++] = cpu_ms;
+            }
+            if(gpu_seen) {
+                g_profiler.gpu_samples[nr_gpu++] = gpu_ms;
+            }
+        }
+        qsort(g_profiler.cpu_samples, nr_cpu, sizeof(double), gfx_profiler_compare_samples);
+        qsort(g_profiler.gpu_samples, nr_gpu, sizeof(double), gfx_profiler_compare_samples);
+        
+        g_profiler.stats[n].name = g_profiler.names[n];
+        g_profiler.stats[n].nr_frames = nr_cpu;
+        g_profiler.stats[n].cpu_ms.p50 = gfx_profiler_percentile(g_profiler.cpu_samples, nr_cpu, 50);
+        g_profiler.stats[n].cpu_ms.p95 = gfx_profiler_percentile(g_profiler.cpu_samples, nr_cpu, 95);
+        g_profiler.stats[n].cpu_ms.p99 = gfx_profiler_percentile(g_profiler.cpu_samples, nr_cpu, 99);
+        g_profiler.stats[n].gpu_ms.p50 = gfx_profiler_percentile(g_profiler.gpu_samples, nr_gpu, 50);
+        g_profiler.stats[n].gpu_ms.p95 = gfx_profiler_percentile(g_profiler.gpu_samples, nr_gpu, 95);
+        g_profiler.stats[n].gpu_ms.p99 = gfx_profiler_percentile(g_profiler.gpu_samples, nr_gpu, 99);
+    }
+    
+    nr_scopes[0] = (int) g_profiler.nr_names;
+    stats[0] = g_profiler.stats;
+    return GFX_OK;
+}
+gfx_result_t gfx_profiler_trace_dump(const char* path) {
+    FILE* file;
+    uint64_t first, nr_frames;
+    double gpu_offset_us;
+    bool first_event = true;
+    
+#ifndef GFX_NO_CHECKS
+    if(path == NULL) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+    if(!g_profiler.enabled) {
+        return GFX_ERROR_OPERATION_INVALID;
+    }
+#endif
+    
+    file = fopen(path, "w");
+    if(file == NULL) {
+        return GFX_ERROR_FILE_IO;
+    }
+    
+    fprintf(file, "{\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+    first_event = false;
+    
+    nr_frames = g_profiler.nr_resolved < GFX_PROFILER_HISTORY_FRAMES ? g_profiler.nr_resolved : GFX_PROFILER_HISTORY_FRAMES;
+    first = g_profiler.nr_resolved - nr_frames;
+    for(uint64_t f = first; f < g_profiler.nr_resolved; f++) {
+        gfx_profiler_frame_t* frame = &g_profiler.history[f % GFX_PROFILER_HISTORY_FRAMES];
+        /* GPU timestamps have their own time base, so each frame's GPU events are aligned to the CPU start of the first GPU timed scope */
+        gpu_offset_us = 0.0;
+        for(uint32_t i = 0; i < frame[0].nr_scopes; i++) {
+            if(frame[0].scopes[i].gpu_valid) {
+                gpu_offset_us = gfx_profiler_ticks_to_us(frame[0].scopes[i].cpu_begin) - (double) frame[0].scopes[i].gpu_begin / 1000.0;
+                break;
+            }
+        }
+        for(uint32_t i = 0; i < frame[0].nr_scopes; i++) {
+            gfx_profiler_scope_record_t* scope = &frame[0].scopes[i];
+            fprintf(file, "%s\n{\"name\":", first_event ? "" : ",");
+            gfx_profiler_json_string_write(file, g_profiler.names[scope[0].name_index]);
+            fprintf(file, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+                    gfx_profiler_ticks_to_us(scope[0].cpu_begin), gfx_profiler_ticks_to_us(scope[0].cpu_end - scope[0].cpu_begin),
+                    (unsigned long long) frame[0].index);
+            if(scope[0].gpu_valid) {
+                fprintf(file, ",\n{\"name\":");
+                gfx_profiler_json_string_write(file, g_profiler.names[scope[0].name_index]);
+                fprintf(file, ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+                        (double) scope[0].gpu_begin / 1000.0 + gpu_offset_us, (double) (scope[0].gpu_end - scope[0].gpu_begin) / 1000.0,
+                        (unsigned long long) frame[0].index);
+            }
+        }
+    }
+    fprintf(file, "\n]}\n");
+    
+    if(ferror(file)) {
+        fclose(file);
+        return GFX_ERROR_FILE_IO;
+    }
+    if(fclose(file) != 0) {
+        return GFX_ERROR_FILE_IO;
+    }
+    return GFX_OK;
+}
+
 gfx_result_t gfx_params_get(gfx_fixed_function_state_t* state) {
     assert(state != NULL);
     
@@ -2698,6 +3939,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     
     if(set_all || state.blend.enabled != g_gl.state.blend.enabled) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         if(state.blend.enabled == true) {
             g_gl.Enable(GL_BLEND);
         } else if (state.blend.enabled == false) {
@@ -2713,6 +3955,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.blend.color != g_gl.state.blend.color) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
 #ifndef GFX_NO_CHECKS
         if(state.blend.color.r < 0.0f || state.blend.color.r > 1.0f) {
             return GFX_ERROR_INVALID_PARAM;
@@ -2736,6 +3979,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
     }
     if(set_all || state.blend.rgb_equation != g_gl.state.blend.rgb_equation
                || state.blend.alpha_equation != g_gl.state.blend.alpha_equation) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLenum modeRGB, modeAlpha;
         switch(state.blend.rgb_equation) {
             case GFX_BLEND_EQUATION_TYPE_ADD:
@@ -2774,6 +4018,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
                || state.blend.src_alpha != g_gl.state.blend.src_alpha
                || state.blend.dst_rgb != g_gl.state.blend.dst_rgb
                || state.blend.dst_alpha != g_gl.state.blend.dst_alpha) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLenum src_rgb, src_alpha, dst_rgb, dst_alpha;
         switch(state.blend.src_rgb) {
             case GFX_BLEND_FACTOR_TYPE_CONSTANT_ZERO            :
@@ -2973,6 +4218,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.clear.color != g_gl.state.clear.color) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
 #ifndef GFX_NO_CHECKS
         if(state.clear.color.r < 0.0f || state.clear.color.r > 1.0f) {
             return GFX_ERROR_INVALID_PARAM;
@@ -2995,6 +4241,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.clear.depth_value != g_gl.state.clear.depth_value) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
 #ifndef GFX_NO_CHECKS
         if(state.clear.depth_value < 0.0f || state.clear.depth_value > 1.0f) {
             return GFX_ERROR_INVALID_PARAM;
@@ -3012,6 +4259,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.clear.stencil_index != g_gl.state.clear.stencil_index) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         g_gl.ClearStencil(state.clear.stencil_index);
 #ifndef GFX_NO_CHECKS
         if(g_gl.GetError() != GL_NO_ERROR) {
@@ -3020,6 +4268,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.mask.color != g_gl.state.mask.color) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLboolean r,g,b,a;
         switch(state.mask.color.r) {
             case true:
@@ -3069,6 +4318,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.mask.depth != g_gl.state.mask.depth) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLboolean flag;
         switch(state.mask.depth) {
             case true:
@@ -3088,6 +4338,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.cull.enabled != g_gl.state.cull.enabled) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         if(state.cull.enabled == true) {
             g_gl.Enable(GL_CULL_FACE);
         } else if (state.cull.enabled == false) {
@@ -3103,6 +4354,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.cull.front_face_orientation != g_gl.state.cull.front_face_orientation) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLenum mode;
         switch(state.cull.front_face_orientation) {
             case GFX_FACE_ORIENTATION_CLOCKWISE:
@@ -3122,6 +4374,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.cull.which_face != g_gl.state.cull.which_face) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLenum mode;
         switch(state.cull.which_face) {
             case GFX_CULL_FACE_TYPE_FRONT:
@@ -3144,6 +4397,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.depth.test_enabled != g_gl.state.depth.test_enabled) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         if(state.depth.test_enabled == true) {
             g_gl.Enable(GL_DEPTH_TEST);
         } else if (state.depth.test_enabled == false) {
@@ -3159,6 +4413,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.depth.comparison_function != g_gl.state.depth.comparison_function) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLenum func;
         switch(state.depth.comparison_function) {
         case GFX_TEST_COMPARISON_FUNCTION_NEVER_ACCEPT                             :
@@ -3196,6 +4451,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.depth.range != g_gl.state.depth.range) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
 #ifndef GFX_NO_CHECKS
         if(state.depth.range.near < 0.0f || state.depth.range.near > 1.0f) {
             return GFX_ERROR_INVALID_PARAM;
@@ -3216,6 +4472,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.polygon_offset.fill_enabled != g_gl.state.polygon_offset.fill_enabled) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         if(state.polygon_offset.fill_enabled == true) {
             g_gl.Enable(GL_POLYGON_OFFSET_FILL);
         } else if (state.polygon_offset.fill_enabled == false) {
@@ -3232,6 +4489,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
     }
     if(set_all || state.polygon_offset.scale_factor != g_gl.state.polygon_offset.scale_factor
         || state.polygon_offset.units != g_gl.state.polygon_offset.units) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         g_gl.PolygonOffset(state.polygon_offset.scale_factor, state.polygon_offset.units);
 #ifndef GFX_NO_CHECKS
         if(g_gl.GetError() != GL_NO_ERROR) {
@@ -3240,6 +4498,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.scissor.enabled != g_gl.state.scissor.enabled) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         if(state.scissor.enabled == true) {
             g_gl.Enable(GL_SCISSOR_TEST);
         } else if (state.scissor.enabled == false) {
@@ -3258,6 +4517,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
                || state.scissor.y != g_gl.state.scissor.y
                || state.scissor.width != g_gl.state.scissor.width
                || state.scissor.height != g_gl.state.scissor.height) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
 #ifndef GFX_NO_CHECKS
         if(state.scissor.x < 0 || state.scissor.y < 0 || state.scissor.width < 0 || state.scissor.height < 0) {
             return GFX_ERROR_INVALID_PARAM;
@@ -3273,6 +4533,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.stencil.test_enabled != g_gl.state.stencil.test_enabled) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         if(state.stencil.test_enabled == true) {
             g_gl.Enable(GL_STENCIL_TEST);
         } else if (state.stencil.test_enabled == false) {
@@ -3290,6 +4551,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
     if(set_all || state.stencil.front_face.comparison_function != g_gl.state.stencil.front_face.comparison_function
          || state.stencil.front_face.reference_value != g_gl.state.stencil.front_face.reference_value
          || state.stencil.front_face.compare_mask != g_gl.state.stencil.front_face.compare_mask) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLenum func;
         switch(state.stencil.front_face.comparison_function) {
         case GFX_TEST_COMPARISON_FUNCTION_NEVER_ACCEPT                             :
@@ -3329,6 +4591,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
     if(set_all || state.stencil.back_face.comparison_function != g_gl.state.stencil.back_face.comparison_function
          || state.stencil.back_face.reference_value != g_gl.state.stencil.back_face.reference_value
          || state.stencil.back_face.compare_mask != g_gl.state.stencil.back_face.compare_mask) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLenum func;
         switch(state.stencil.back_face.comparison_function) {
         case GFX_TEST_COMPARISON_FUNCTION_NEVER_ACCEPT                             :
@@ -3366,6 +4629,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.stencil.front_face.write_mask != g_gl.state.stencil.front_face.write_mask) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         g_gl.StencilMaskSeparate(GL_FRONT, state.stencil.front_face.write_mask);
 #ifndef GFX_NO_CHECKS
         if(g_gl.GetError() != GL_NO_ERROR) {
@@ -3374,6 +4638,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.stencil.back_face.write_mask != g_gl.state.stencil.back_face.write_mask) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         g_gl.StencilMaskSeparate(GL_BACK, state.stencil.back_face.write_mask);
 #ifndef GFX_NO_CHECKS
         if(g_gl.GetError() != GL_NO_ERROR) {
@@ -3384,6 +4649,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
     if(set_all || state.stencil.front_face.if_stencil_fails != g_gl.state.stencil.front_face.if_stencil_fails
          || state.stencil.front_face.if_stencil_passes_and_depth_fails != g_gl.state.stencil.front_face.if_stencil_passes_and_depth_fails
          || state.stencil.front_face.if_stencil_passes_and_depth_passes_or_is_not_available != g_gl.state.stencil.front_face.if_stencil_passes_and_depth_passes_or_is_not_available) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLenum sfail, dpfail, dppass;
         switch(state.stencil.front_face.if_stencil_fails) {
             case GFX_STENCIL_OPERATION_KEEP_CURRENT_VALUE                      :
@@ -3479,6 +4745,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
     if(set_all || state.stencil.back_face.if_stencil_fails != g_gl.state.stencil.back_face.if_stencil_fails
          || state.stencil.back_face.if_stencil_passes_and_depth_fails != g_gl.state.stencil.back_face.if_stencil_passes_and_depth_fails
          || state.stencil.back_face.if_stencil_passes_and_depth_passes_or_is_not_available != g_gl.state.stencil.back_face.if_stencil_passes_and_depth_passes_or_is_not_available) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLenum sfail, dpfail, dppass;
         switch(state.stencil.back_face.if_stencil_fails) {
             case GFX_STENCIL_OPERATION_KEEP_CURRENT_VALUE                      :
@@ -3572,6 +4839,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.pixel_storage.pack_alignment != g_gl.state.pixel_storage.pack_alignment) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLint param;
         switch(state.pixel_storage.pack_alignment) {
             case GFX_PIXEL_STORAGE_BYTE_ALIGNED:
@@ -3597,6 +4865,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.pixel_storage.unpack_alignment != g_gl.state.pixel_storage.unpack_alignment) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLint param;
         switch(state.pixel_storage.unpack_alignment) {
             case GFX_PIXEL_STORAGE_BYTE_ALIGNED:
@@ -3622,6 +4891,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.sample_coverage.enabled != g_gl.state.sample_coverage.enabled) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         if(state.sample_coverage.enabled == true) {
             g_gl.Enable(GL_SAMPLE_COVERAGE);
         } else if (state.sample_coverage.enabled == false) {
@@ -3637,6 +4907,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.sample_coverage.convert_alpha_to_coverage_value != g_gl.state.sample_coverage.convert_alpha_to_coverage_value) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         if(state.sample_coverage.convert_alpha_to_coverage_value == true) {
             g_gl.Enable(GL_SAMPLE_ALPHA_TO_COVERAGE);
         } else if (state.sample_coverage.convert_alpha_to_coverage_value == false) {
@@ -3653,6 +4924,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
     }
     if(set_all || state.sample_coverage.invert_coverage_mask != g_gl.state.sample_coverage.invert_coverage_mask
              || state.sample_coverage.coverage_value != g_gl.state.sample_coverage.coverage_value) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         GLboolean invert;
         if(state.sample_coverage.invert_coverage_mask == true) {
             invert = GL_TRUE;
@@ -3674,6 +4946,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.dithering_enabled != g_gl.state.dithering_enabled) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
         if(state.dithering_enabled == true) {
             g_gl.Enable(GL_DITHER);
         } else if (state.dithering_enabled == false) {
@@ -3689,6 +4962,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.line_width != g_gl.state.line_width) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
 #ifndef GFX_NO_CHECKS
         if(state.line_width <= 0) {
             return GFX_ERROR_INVALID_PARAM;
@@ -3705,6 +4979,7 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
 #endif
     }
     if(set_all || state.viewport != g_gl.state.viewport) {
+        GFX_FRAME_STAT_ADD(state_transitions, 1);
 #ifndef GFX_NO_CHECKS
         if(state.viewport.x < 0 || state.viewport.y < 0 || state.viewport.width < 0 || state.viewport.height < 0) {
             return GFX_ERROR_INVALID_PARAM;
@@ -3719,39 +4994,217 @@ gfx_result_t gfx_params_set(gfx_fixed_function_state_t state) {
             return set_all ? GFX_ERROR_API_INIT_ERROR : GFX_ERROR_API_UPDATE_ERROR;
         }
 #endif
-        /* (re)set screenshot buffer for gfx_screenshot */
-        g_gl.screenshot.width = g_gl.state.viewport.width;
-        g_gl.screenshot.height = g_gl.state.viewport.height;
-        g_gl.screenshot.pixel_data = realloc(g_gl.screenshot.pixel_data, sizeof(uint32_t)*g_gl.screenshot.width*g_gl.screenshot.height);
+        /* (re)set screenshot buffer for gfx_screenshot */
+        g_gl.screenshot.width = g_gl.state.viewport.width;
+        g_gl.screenshot.height = g_gl.state.viewport.height;
+        g_gl.screenshot.pixel_data = realloc(g_gl.screenshot.pixel_data, sizeof(uint32_t)*g_gl.screenshot.width*g_gl.screenshot.height);
+    }
+
+#ifndef GFX_NO_CHECKS
+    /* check if we actually could update the state */
+    if(!load_or_check_limits() || !check_params(state)) {
+        return GFX_ERROR_API_OTHER;
+    }
+#endif
+    
+    g_gl.state = state;
+    g_gl.initialized = true;
+    /* the bound state blocks may not match GL anymore */
+    memset(g_state_blocks.bound, 0, sizeof(g_state_blocks.bound));
+    return GFX_OK;
+}
+gfx_result_t gfx_params_reset(void) {
+    int fb_width, fb_height;
+    glfwGetFramebufferSize(g_glfw.window, &fb_width, &fb_height);
+    return gfx_params_set(default_state(fb_width, fb_height));
+}
+gfx_result_t gfx_state_block_create(gfx_state_block_type_t type, const gfx_fixed_function_state_t* state, gfx_state_block_t* block) {
+    gfx_internal_state_block_t new_block;
+    gfx_internal_state_block_t* data;
+    gfx_result_t r;
+    
+#ifndef GFX_NO_CHECKS
+    if(state == NULL || block == NULL) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+#endif
+    
+    /* validation happens here once, and never again when binding */
+    r = gfx_state_block_translate(type, state, &new_block);
+    if(r != GFX_OK) {
+        return r;
+    }
+    
+    for(uint32_t i = 0; i < g_state_blocks.count; i++) {
+        if(g_state_blocks.data[i].hash == new_block.hash && g_state_blocks.data[i].type == new_block.type
+        && gfx_state_block_changed(&g_state_blocks.data[i], &new_block) == 0) {
+            block[0].type = type;
+            block[0].index = i;
+            block[0].hash = new_block.hash;
+            return GFX_OK;
+        }
+    }
+    
+    if(g_state_blocks.count == g_state_blocks.capacity) {
+        uint32_t capacity = g_state_blocks.capacity == 0 ? GFX_STATE_BLOCK_INITIAL_CAP : 2*g_state_blocks.capacity;
+        data = realloc(g_state_blocks.data, capacity * sizeof(gfx_internal_state_block_t));
+        if(data == NULL) {
+            return GFX_ERROR_OUT_OF_MEMORY;
+        }
+        g_state_blocks.data = data;
+        g_state_blocks.capacity = capacity;
+    }
+    g_state_blocks.data[g_state_blocks.count] = new_block;
+    
+    block[0].type = type;
+    block[0].index = g_state_blocks.count++;
+    block[0].hash = new_block.hash;
+    return GFX_OK;
+}
+gfx_result_t gfx_state_blocks_bind(size_t nr_blocks, const gfx_state_block_t* blocks) {
+    const gfx_internal_state_block_t *block, *bound;
+    uint32_t changed;
+    gfx_result_t r;
+    
+#ifndef GFX_NO_CHECKS
+    if(blocks == NULL && nr_blocks > 0) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+#endif
+    
+    for(size_t i = 0; i < nr_blocks; i++) {
+#ifndef GFX_NO_CHECKS
+        if(blocks[i].index >= g_state_blocks.count || blocks[i].type > GFX_STATE_BLOCK_TYPE_RASTER
+        || g_state_blocks.data[blocks[i].index].hash != blocks[i].hash) {
+            return GFX_ERROR_INVALID_PARAM;
+        }
+#endif
+        block = &g_state_blocks.data[blocks[i].index];
+        if(g_state_blocks.bound[block[0].type] == 0) {
+            changed = 0xFFFFFFFF;
+        } else {
+            /* equal blocks share an index, see gfx_state_block_create */
+            if(g_state_blocks.bound[block[0].type] == blocks[i].index + 1) {
+                continue;
+            }
+            bound = &g_state_blocks.data[g_state_blocks.bound[block[0].type] - 1];
+            changed = gfx_state_block_changed(bound, block);
+        }
+        
+        for(uint32_t k = 0; k < gfx_state_block_nr_substates[block[0].type]; k++) {
+            GFX_FRAME_STAT_ADD(state_transitions, (changed >> k) & 1);
+        }
+        r = gfx_state_block_apply(block, changed);
+        if(r != GFX_OK) {
+            /* GL may now be partially set, so compare against nothing on the next bind */
+            g_state_blocks.bound[block[0].type] = 0;
+            return r;
+        }
+        g_state_blocks.bound[block[0].type] = blocks[i].index + 1;
+    }
+    return GFX_OK;
+}
+
+gfx_result_t gfx_render(void) {
+    gfx_result_t r, deferred;
+    
+    g_gl.Flush(); /* This might be unnecessary but we keep it in just in case */
+    
+    /* the escalation for an earlier error ends with this frame, a new one is started by the check */
+    g_gl.errors.escalated = false;
+    deferred = gfx_deferred_errors_check();
+    
+    glfwSwapBuffers(g_glfw.window);
+    r = GFX_OK;
+#ifndef GFX_NO_CHECKS
+    if(glfwGetError(NULL)) {
+        r = GFX_ERROR_API_OTHER;
+    }
+#endif
+    
+    if(r == GFX_OK) {
+        r = gfx_profiler_frame_end();
+    }
+    
+    /* a failed frame ends here too, or its counts would go into the next one */
+#ifndef GFX_NO_FRAME_STATS
+    g_gl.last_frame_stats = g_gl.frame_stats;
+    memset(&g_gl.frame_stats, 0, sizeof(g_gl.frame_stats));
+    g_gl.frame_stats.frame_index = g_gl.last_frame_stats.frame_index + 1;
+#endif
+    
+    return r != GFX_OK ? r : deferred;
+}
+gfx_result_t gfx_frame_stats_get(gfx_frame_stats_t* stats) {
+#ifndef GFX_NO_CHECKS
+    if(stats == NULL) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+#endif
+    stats[0] = g_gl.last_frame_stats;
+    return GFX_OK;
+}
+gfx_result_t gfx_error_check_mode_set(gfx_error_check_mode_t mode) {
+    gfx_result_t r;
+    
+#ifndef GFX_NO_CHECKS
+    if(mode != GFX_ERROR_CHECK_MODE_IMMEDIATE && mode != GFX_ERROR_CHECK_MODE_DEFERRED) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+#endif
+    if(mode == g_gl.errors.mode) {
+        return GFX_OK;
     }
-
+    if(g_gl.errors.immediate_GetError == NULL) {
+        /* GL isn't loaded yet, load_gl picks the mode up */
+        g_gl.errors.mode = mode;
+        return GFX_OK;
+    }
+    if(mode == GFX_ERROR_CHECK_MODE_DEFERRED) {
+        g_gl.GetError = gfx_deferred_GetError;
+        g_gl.errors.mode = mode;
+        return GFX_OK;
+    }
+    /* report what accumulated so far before the immediate checks take over again */
+    g_gl.errors.escalated = false;
+    r = gfx_deferred_errors_check();
+    g_gl.errors.escalated = false;
+    g_gl.GetError = g_gl.errors.immediate_GetError;
+    g_gl.errors.mode = mode;
+    return r;
+}
+gfx_result_t gfx_error_scope_begin(const char* name) {
 #ifndef GFX_NO_CHECKS
-    /* check if we actually could update the state */
-    if(!load_or_check_limits() || !check_params(state)) {
-        return GFX_ERROR_API_OTHER;
+    if(name == NULL) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+    if(g_gl.errors.depth >= GFX_ERROR_SCOPE_MAX_DEPTH) {
+        return GFX_ERROR_OPERATION_INVALID;
     }
 #endif
-    
-    g_gl.state = state;
-    g_gl.initialized = true;
+    g_gl.errors.scopes[g_gl.errors.depth++] = name;
     return GFX_OK;
 }
-gfx_result_t gfx_params_reset(void) {
-    int fb_width, fb_height;
-    glfwGetFramebufferSize(g_glfw.window, &fb_width, &fb_height);
-    return gfx_params_set(default_state(fb_width, fb_height));
-}
-
-gfx_result_t gfx_render(void) {
-    g_gl.Flush(); /* This might be unnecessary but we keep it in just in case */
+gfx_result_t gfx_error_scope_end(void) {
+    gfx_result_t r;
     
-    glfwSwapBuffers(g_glfw.window);
 #ifndef GFX_NO_CHECKS
-    if(glfwGetError(NULL)) {
-        return GFX_ERROR_API_OTHER;
+    if(g_gl.errors.depth == 0) {
+        return GFX_ERROR_OPERATION_INVALID;
     }
 #endif
-    
+    /* checked before popping, so the candidates still carry this scope's name */
+    r = gfx_deferred_errors_check();
+    g_gl.errors.depth--;
+    return r;
+}
+gfx_result_t gfx_error_report_get(gfx_error_report_t* report) {
+#ifndef GFX_NO_CHECKS
+    if(report == NULL) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+#endif
+    report[0] = g_gl.errors.report;
     return GFX_OK;
 }
 gfx_result_t gfx_clear(void) {
@@ -3831,7 +5284,7 @@ static gfx_result_t gfx_buffer_bind_safe(GLenum target, GLuint old_id, GLuint ne
     if(g_gl.GetError() != GL_NO_ERROR) {
         return GFX_ERROR_UNKNOWN;
     }
-    if(i != old_id) {
+    if((GLuint) i != old_id) {
         return GFX_ERROR_API_OTHER;
     }
 #endif
@@ -3848,7 +5301,7 @@ static gfx_result_t gfx_buffer_bind_safe(GLenum target, GLuint old_id, GLuint ne
     if(g_gl.GetError() != GL_NO_ERROR) {
         return GFX_ERROR_UNKNOWN;
     }
-    if(i != new_id) {
+    if((GLuint) i != new_id) {
         return GFX_ERROR_API_OTHER;
     }
 #endif
@@ -4069,7 +5522,7 @@ static gfx_result_t gfx_texture_bind_safe(GLenum texture_unit, GLenum target, GL
     if(g_gl.GetError() != GL_NO_ERROR) {
         return GFX_ERROR_UNKNOWN;
     }
-    if(i != old_id) {
+    if((GLuint) i != old_id) {
         return GFX_ERROR_API_OTHER;
     }
 #endif
@@ -4086,7 +5539,7 @@ static gfx_result_t gfx_texture_bind_safe(GLenum texture_unit, GLenum target, GL
     if(g_gl.GetError() != GL_NO_ERROR) {
         return GFX_ERROR_UNKNOWN;
     }
-    if(i != new_id) {
+    if((GLuint) i != new_id) {
         return GFX_ERROR_API_OTHER;
     }
 #endif
@@ -5216,6 +6669,334 @@ gfx_result_t gfx_cubemap_destroy(gfx_cubemap_t cubemap) {
     return gfx_texture_destroy_generic(cubemap.id);
 }
 
+static gfx_result_t gfx_framebuffer_bind_safe(GLuint old_id, GLuint new_id) {
+#ifdef GFX_DEBUG
+    GLint i;
+#endif
+    
+#ifndef GFX_NO_CHECKS
+    if(g_gl.BindFramebuffer == NULL) {
+        return GFX_ERROR_API_UNAVAILABLE;
+    }
+#endif
+#ifdef GFX_DEBUG
+    g_gl.GetIntegerv(GL_FRAMEBUFFER_BINDING, &i);
+    if(g_gl.GetError() != GL_NO_ERROR) {
+        return GFX_ERROR_UNKNOWN;
+    }
+    if((GLuint) i != old_id) {
+        return GFX_ERROR_API_OTHER;
+    }
+#endif
+
+    g_gl.BindFramebuffer(GL_FRAMEBUFFER, new_id);
+#ifndef GFX_NO_CHECKS
+    if(g_gl.GetError() != GL_NO_ERROR) {
+        return GFX_ERROR_UNKNOWN;
+    }
+#endif
+
+#ifdef GFX_DEBUG
+    g_gl.GetIntegerv(GL_FRAMEBUFFER_BINDING, &i);
+    if(g_gl.GetError() != GL_NO_ERROR) {
+        return GFX_ERROR_UNKNOWN;
+    }
+    if((GLuint) i != new_id) {
+        return GFX_ERROR_API_OTHER;
+    }
+#endif
+    
+    g_gl.bound_framebuffer = new_id;
+    return GFX_OK;
+}
+/* attaches a 2D image (texture or cubemap face) as the color attachment of the framebuffer and checks completeness */
+static gfx_result_t gfx_framebuffer_attach_color_generic(gfx_framebuffer_t framebuffer, GLenum image_target, GLuint texture_id) {
+    gfx_result_t r;
+    GLenum status;
+    GLuint old_id = g_gl.bound_framebuffer;
+    
+    r = gfx_framebuffer_bind_safe(old_id, framebuffer.id);
+#ifndef GFX_NO_CHECKS
+    if(r != GFX_OK) { return r; }
+#endif
+    
+    g_gl.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, image_target, texture_id, 0);
+#ifndef GFX_NO_CHECKS
+    if(g_gl.GetError() != GL_NO_ERROR) {
+        return GFX_ERROR_UNKNOWN;
+    }
+#endif
+    
+    status = g_gl.CheckFramebufferStatus(GL_FRAMEBUFFER);
+#ifndef GFX_NO_CHECKS
+    if(g_gl.GetError() != GL_NO_ERROR) {
+        return GFX_ERROR_UNKNOWN;
+    }
+#endif
+    
+#ifndef GFX_NO_UNBIND
+    r = gfx_framebuffer_bind_safe(framebuffer.id, old_id);
+#endif
+#ifndef GFX_NO_CHECKS
+    if(r != GFX_OK) { return r; }
+#endif
+    
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        return GFX_ERROR_FRAMEBUFFER_INCOMPLETE;
+    }
+    return GFX_OK;
+}
+/* for the error paths of gfx_framebuffer_create: deletes what was generated so far and rebinds the caller's framebuffer */
+static void gfx_framebuffer_create_undo(GLuint id, GLuint rb_id, GLuint old_id) {
+    if(g_gl.bound_framebuffer != old_id) {
+        g_gl.BindFramebuffer(GL_FRAMEBUFFER, old_id);
+        g_gl.bound_framebuffer = old_id;
+    }
+    if(rb_id != 0) {
+        g_gl.DeleteRenderbuffers(1, &rb_id);
+    }
+    if(id != 0) {
+        g_gl.DeleteFramebuffers(1, &id);
+    }
+    g_gl.GetError();
+}
+gfx_result_t gfx_framebuffer_create(gfx_texture_dimensions_t dimensions, gfx_framebuffer_depth_stencil_t depth_stencil, gfx_framebuffer_t* framebuffer) {
+    GLuint id = 0, rb_id = 0;
+    GLuint old_id = g_gl.bound_framebuffer;
+    GLenum internal_format;
+    GLint max_size;
+    gfx_result_t r;
+    
+#ifndef GFX_NO_CHECKS
+    if(framebuffer == NULL || dimensions.width <= 0 || dimensions.height <= 0) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+    if(g_gl.GenFramebuffers == NULL) {
+        return GFX_ERROR_API_UNAVAILABLE;
+    }
+#endif
+    
+    switch(depth_stencil) {
+    case GFX_FRAMEBUFFER_DEPTH_STENCIL_NONE:
+        internal_format = GL_NONE;
+        break;
+    case GFX_FRAMEBUFFER_DEPTH_STENCIL_DEPTH16:
+        internal_format = GL_DEPTH_COMPONENT16;
+        break;
+    case GFX_FRAMEBUFFER_DEPTH_STENCIL_STENCIL8:
+        internal_format = GL_STENCIL_INDEX8;
+        break;
+    case GFX_FRAMEBUFFER_DEPTH_STENCIL_DEPTH24_STENCIL8:
+        /* core in GL 3, an extension before; GL 2 drivers mostly only name the EXT one */
+        if(g_gl.version != GL3Core && !glfwExtensionSupported("GL_OES_packed_depth_stencil")
+        && !glfwExtensionSupported("GL_EXT_packed_depth_stencil") && !glfwExtensionSupported("GL_ARB_framebuffer_object")) {
+            return GFX_ERROR_API_UNAVAILABLE;
+        }
+        internal_format = GL_DEPTH24_STENCIL8;
+        break;
+    default:
+        return GFX_ERROR_INVALID_PARAM;
+    }
+    
+    g_gl.GetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size);
+#ifndef GFX_NO_CHECKS
+    if(g_gl.GetError() != GL_NO_ERROR) {
+        return GFX_ERROR_UNKNOWN;
+    }
+#endif
+    if(dimensions.width > max_size || dimensions.height > max_size) {
+        return GFX_ERROR_TEXTURE_TOO_BIG;
+    }
+    
+    g_gl.GenFramebuffers(1, &id);
+#ifndef GFX_NO_CHECKS
+    if(g_gl.GetError() != GL_NO_ERROR || id == 0) {
+        gfx_framebuffer_create_undo(id, rb_id, old_id);
+        return GFX_ERROR_UNKNOWN;
+    }
+#endif
+    
+    if(depth_stencil != GFX_FRAMEBUFFER_DEPTH_STENCIL_NONE) {
+        g_gl.GenRenderbuffers(1, &rb_id);
+#ifndef GFX_NO_CHECKS
+        if(g_gl.GetError() != GL_NO_ERROR || rb_id == 0) {
+            gfx_framebuffer_create_undo(id, rb_id, old_id);
+            return GFX_ERROR_UNKNOWN;
+        }
+#endif
+        g_gl.BindRenderbuffer(GL_RENDERBUFFER, rb_id);
+#ifndef GFX_NO_CHECKS
+        if(g_gl.GetError() != GL_NO_ERROR) {
+            gfx_framebuffer_create_undo(id, rb_id, old_id);
+            return GFX_ERROR_UNKNOWN;
+        }
+#endif
+        g_gl.RenderbufferStorage(GL_RENDERBUFFER, internal_format, dimensions.width, dimensions.height);
+        switch(g_gl.GetError()) {
+        case GL_NO_ERROR:
+            break;
+        case GL_OUT_OF_MEMORY:
+            gfx_framebuffer_create_undo(id, rb_id, old_id);
+            return GFX_ERROR_OUT_OF_MEMORY;
+        default:
+            gfx_framebuffer_create_undo(id, rb_id, old_id);
+            return GFX_ERROR_UNKNOWN;
+        }
+        
+        r = gfx_framebuffer_bind_safe(old_id, id);
+#ifndef GFX_NO_CHECKS
+        if(r != GFX_OK) {
+            gfx_framebuffer_create_undo(id, rb_id, old_id);
+            return r;
+        }
+#endif
+        /* packed depth stencil is attached to both points, since GL ES 2 has no GL_DEPTH_STENCIL_ATTACHMENT */
+        if(depth_stencil != GFX_FRAMEBUFFER_DEPTH_STENCIL_STENCIL8) {
+            g_gl.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rb_id);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                gfx_framebuffer_create_undo(id, rb_id, old_id);
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        if(depth_stencil != GFX_FRAMEBUFFER_DEPTH_STENCIL_DEPTH16) {
+            g_gl.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rb_id);
+#ifndef GFX_NO_CHECKS
+            if(g_gl.GetError() != GL_NO_ERROR) {
+                gfx_framebuffer_create_undo(id, rb_id, old_id);
+                return GFX_ERROR_UNKNOWN;
+            }
+#endif
+        }
+        
+#ifndef GFX_NO_UNBIND
+        g_gl.BindRenderbuffer(GL_RENDERBUFFER, 0);
+#ifndef GFX_NO_CHECKS
+        if(g_gl.GetError() != GL_NO_ERROR) {
+            gfx_framebuffer_create_undo(id, rb_id, old_id);
+            return GFX_ERROR_UNKNOWN;
+        }
+#endif
+        r = gfx_framebuffer_bind_safe(id, old_id);
+#endif
+#ifndef GFX_NO_CHECKS
+        if(r != GFX_OK) {
+            gfx_framebuffer_create_undo(id, rb_id, old_id);
+            return r;
+        }
+#endif
+    }
+    
+    framebuffer[0].id = id;
+    framebuffer[0].depth_stencil_id = rb_id;
+    framebuffer[0].depth_stencil = depth_stencil;
+    framebuffer[0].dimensions = dimensions;
+    
+    return GFX_OK;
+}
+gfx_result_t gfx_framebuffer_attach_texture(gfx_framebuffer_t framebuffer, gfx_texture_t texture) {
+#ifndef GFX_NO_CHECKS
+    if(framebuffer.id == 0 || texture.id == 0) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+    if(texture.dimensions.width != framebuffer.dimensions.width || texture.dimensions.height != framebuffer.dimensions.height) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+#endif
+    return gfx_framebuffer_attach_color_generic(framebuffer, GL_TEXTURE_2D, texture.id);
+}
+gfx_result_t gfx_framebuffer_attach_cubemap_face(gfx_framebuffer_t framebuffer, gfx_cubemap_t cubemap, gfx_cubemap_facetype_t face) {
+    GLenum image_target;
+    gfx_cubemap_face_data_t* data_ptr;
+    
+#ifndef GFX_NO_CHECKS
+    if(framebuffer.id == 0 || cubemap.id == 0) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+#endif
+    
+    switch(face) {
+    case GFX_CUBE_MAP_FACETYPE_POSITIVE_X:
+        image_target = GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+        data_ptr = &(cubemap.face_data.positive_x);
+        break;
+    case GFX_CUBE_MAP_FACETYPE_NEGATIVE_X:
+        image_target = GL_TEXTURE_CUBE_MAP_NEGATIVE_X;
+        data_ptr = &(cubemap.face_data.negative_x);
+        break;
+    case GFX_CUBE_MAP_FACETYPE_POSITIVE_Y:
+        image_target = GL_TEXTURE_CUBE_MAP_POSITIVE_Y;
+        data_ptr = &(cubemap.face_data.positive_y);
+        break;
+    case GFX_CUBE_MAP_FACETYPE_NEGATIVE_Y:
+        image_target = GL_TEXTURE_CUBE_MAP_NEGATIVE_Y;
+        data_ptr = &(cubemap.face_data.negative_y);
+        break;
+    case GFX_CUBE_MAP_FACETYPE_POSITIVE_Z:
+        image_target = GL_TEXTURE_CUBE_MAP_POSITIVE_Z;
+        data_ptr = &(cubemap.face_data.positive_z);
+        break;
+    case GFX_CUBE_MAP_FACETYPE_NEGATIVE_Z:
+        image_target = GL_TEXTURE_CUBE_MAP_NEGATIVE_Z;
+        data_ptr = &(cubemap.face_data.negative_z);
+        break;
+    default:
+        return GFX_ERROR_INVALID_PARAM;
+    }
+    
+#ifndef GFX_NO_CHECKS
+    if(!data_ptr[0].created) {
+        return GFX_ERROR_OPERATION_INVALID;
+    }
+    if(data_ptr[0].dimensions.width != framebuffer.dimensions.width || data_ptr[0].dimensions.height != framebuffer.dimensions.height) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+#endif
+    return gfx_framebuffer_attach_color_generic(framebuffer, image_target, cubemap.id);
+}
+gfx_result_t gfx_framebuffer_bind(gfx_framebuffer_t* framebuffer) {
+    GLuint new_id = framebuffer == NULL ? 0 : framebuffer[0].id;
+    
+    if(new_id == g_gl.bound_framebuffer) {
+        return GFX_OK;
+    }
+    return gfx_framebuffer_bind_safe(g_gl.bound_framebuffer, new_id);
+}
+gfx_result_t gfx_framebuffer_destroy(gfx_framebuffer_t framebuffer) {
+    gfx_result_t r;
+    
+#ifndef GFX_NO_CHECKS
+    if(framebuffer.id == 0) {
+        return GFX_ERROR_INVALID_PARAM;
+    }
+#endif
+    
+    if(g_gl.bound_framebuffer == framebuffer.id) {
+        r = gfx_framebuffer_bind_safe(framebuffer.id, 0);
+#ifndef GFX_NO_CHECKS
+        if(r != GFX_OK) { return r; }
+#endif
+    }
+    
+    g_gl.DeleteFramebuffers(1, &framebuffer.id);
+#ifndef GFX_NO_CHECKS
+    if(g_gl.GetError() != GL_NO_ERROR) {
+        return GFX_ERROR_UNKNOWN;
+    }
+#endif
+    if(framebuffer.depth_stencil_id != 0) {
+        g_gl.DeleteRenderbuffers(1, &framebuffer.depth_stencil_id);
+#ifndef GFX_NO_CHECKS
+        if(g_gl.GetError() != GL_NO_ERROR) {
+            return GFX_ERROR_UNKNOWN;
+        }
+#endif
+    }
+    
+    return GFX_OK;
+}
+
 
 static gfx_result_t gfx_shader_create_shader_object(GLenum type, const char* source, GLuint* out_id) {
     GLuint id;
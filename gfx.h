@@ -21,6 +21,11 @@
 #define GFX_NO_UNBIND
 #endif
 
+/* This macro turns off the per-frame GL call counters behind gfx_frame_stats_get */
+#if 0
+#define GFX_NO_FRAME_STATS
+#endif
+
 
 /* TODO: differentiate between [0,1] and [-1,1] clamping with type names */
 typedef float  gfx_clamp_f;
@@ -47,6 +52,8 @@ typedef enum gfx_result_t {
     GFX_ERROR_UNIFORM_NOT_FOUND = -18,
     GFX_ERROR_NOT_ENOUGH_TEXTURE_UNITS = -19,
     GFX_ERROR_UNKNOWN = -20,
+    GFX_ERROR_FILE_IO = -21,
+    GFX_ERROR_FRAMEBUFFER_INCOMPLETE = -22,
     
     GFX_RESULT_MAX_ENUM = 0x7FFFFFFF,
 } gfx_result_t;
@@ -365,6 +372,14 @@ typedef enum gfx_cubemap_facetype_t {
     GFX_CUBE_MAP_FACETYPE_NEGATIVE_Z = 5,
     GFX_CUBE_MAP_FACETYPE_MAX_ENUM = 0x7f
 } gfx_cubemap_facetype_t;
+typedef enum gfx_framebuffer_depth_stencil_t {
+    GFX_FRAMEBUFFER_DEPTH_STENCIL_NONE = 0,
+    GFX_FRAMEBUFFER_DEPTH_STENCIL_DEPTH16 = 1,
+    GFX_FRAMEBUFFER_DEPTH_STENCIL_STENCIL8 = 2,
+    /* needs OES_packed_depth_stencil on GL ES 2 */
+    GFX_FRAMEBUFFER_DEPTH_STENCIL_DEPTH24_STENCIL8 = 3,
+    GFX_FRAMEBUFFER_DEPTH_STENCIL_MAX_ENUM = 0x7f
+} gfx_framebuffer_depth_stencil_t;
 typedef enum gfx_uniform_data_type_t {
     GFX_UNIFORM_DATA_TYPE_INT = 0,
     GFX_UNIFORM_DATA_TYPE_IVEC2 = 1,
@@ -598,6 +613,12 @@ typedef struct gfx_cubemap_t {
     gfx_cubemap_config_t config;
     struct { gfx_cubemap_face_data_t positive_x, negative_x, positive_y, negative_y, positive_z, negative_z; } face_data;
 } gfx_cubemap_t;
+typedef struct gfx_framebuffer_t {
+    uint32_t id;
+    uint32_t depth_stencil_id; /* renderbuffer, 0 for GFX_FRAMEBUFFER_DEPTH_STENCIL_NONE */
+    gfx_framebuffer_depth_stencil_t depth_stencil;
+    gfx_texture_dimensions_t dimensions;
+} gfx_framebuffer_t;
 typedef struct gfx_screen_rect_t {
     int x, y, width, height;
 } gfx_screen_rect_t;
@@ -616,6 +637,53 @@ typedef struct gfx_uniform_data_info_t {
         gfx_cubemap_t* cubemap;
     } data;
 } gfx_uniform_data_info_t;
+typedef enum gfx_error_check_mode_t {
+    GFX_ERROR_CHECK_MODE_IMMEDIATE = 0, /* GetError after every GL call */
+    GFX_ERROR_CHECK_MODE_DEFERRED = 1, /* GetError once per gfx_render or gfx_error_scope_end */
+    
+    GFX_ERROR_CHECK_MODE_MAX_ENUM = 0x7f,
+} gfx_error_check_mode_t;
+typedef enum gfx_state_block_type_t {
+    GFX_STATE_BLOCK_TYPE_BLEND = 0, /* blend, mask.color, sample_coverage and dithering_enabled */
+    GFX_STATE_BLOCK_TYPE_DEPTH_STENCIL = 1, /* depth, mask.depth and stencil */
+    GFX_STATE_BLOCK_TYPE_RASTER = 2, /* cull, polygon_offset and line_width */
+    
+    GFX_STATE_BLOCK_TYPE_MAX_ENUM = 0x7f
+} gfx_state_block_type_t;
+typedef struct gfx_frame_stats_t {
+    uint64_t frame_index;
+    uint32_t draw_calls;
+    uint64_t triangles_submitted; /* strips and fans count as count-2, other shapes as 0 */
+    uint64_t buffer_bytes_uploaded, texture_bytes_uploaded;
+    uint32_t program_switches, buffer_binds, texture_binds;
+    uint32_t get_error_calls;
+    uint32_t state_transitions; /* GL calls changing fixed function state, by gfx_params_set and gfx_state_blocks_bind */
+} gfx_frame_stats_t;
+typedef struct gfx_state_block_t {
+    gfx_state_block_type_t type;
+    uint32_t index;
+    uint64_t hash; /* equal for blocks with equal state */
+} gfx_state_block_t;
+#define GFX_ERROR_SITE_RING_SIZE 16
+typedef struct gfx_error_site_t {
+    const char* scope; /* innermost gfx_error_scope_begin name, NULL outside of scopes */
+    const void* caller; /* address inside gfx where the check happened, for addr2line; NULL if the compiler can't provide it */
+    uint64_t sequence; /* running number of the check */
+} gfx_error_site_t;
+typedef struct gfx_error_report_t {
+    uint32_t gl_error; /* GL error enum of the last detected error, 0 if there was none */
+    bool exact; /* if true, sites[0] is the failing call, otherwise the sites are the most recent candidates before the check */
+    uint32_t nr_sites;
+    gfx_error_site_t sites[GFX_ERROR_SITE_RING_SIZE]; /* newest first */
+} gfx_error_report_t;
+typedef struct gfx_profiler_percentiles_t {
+    double p50, p95, p99;
+} gfx_profiler_percentiles_t;
+typedef struct gfx_profiler_scope_stats_t {
+    const char* name;
+    uint32_t nr_frames; /* number of resolved frames in the history in which the scope was seen */
+    gfx_profiler_percentiles_t cpu_ms, gpu_ms; /* summed per frame; gpu_ms is zero if there are no timer queries or the scope is not GPU timed */
+} gfx_profiler_scope_stats_t;
 
 
 /* icon is optional and can be left NULL */
@@ -637,14 +705,44 @@ gfx_result_t gfx_clipboard_set(const char* string);
 gfx_result_t gfx_timestamp_frequency(uint64_t* frequency_in_hz);
 gfx_result_t gfx_timestamp(uint64_t* ticks);
 
+/* The profiler records nested scopes per frame, gfx_render closes the frame. Scopes may wrap any code (gfx, snd or user code),
+ * but have to be opened and closed on the thread that calls gfx_render. name has to stay valid while the profiler is enabled.
+ * GPU timing uses ARB_timer_query / EXT_disjoint_timer_query and is read back a few frames later without stalling;
+ * if neither is available only CPU time is recorded. Scope calls are no-ops while the profiler is disabled. */
+gfx_result_t gfx_profiler_enable(bool enabled);
+gfx_result_t gfx_profiler_scope_begin(const char* name, bool gpu_timed);
+gfx_result_t gfx_profiler_scope_end(void);
+/* stats are over the last resolved frames and valid until the next call to gfx_profiler_stats or gfx_profiler_enable */
+gfx_result_t gfx_profiler_stats(int* nr_scopes, const gfx_profiler_scope_stats_t** stats);
+/* writes the resolved frame timeline in the Chrome trace event JSON format (chrome://tracing, Perfetto) */
+gfx_result_t gfx_profiler_trace_dump(const char* path);
+
 gfx_result_t gfx_params_get(gfx_fixed_function_state_t* state);
 gfx_result_t gfx_params_set(gfx_fixed_function_state_t state);
 gfx_result_t gfx_params_reset(void);
+
+/* State blocks are validated and translated once at creation and stay valid until gfx_exit; creating a block with the
+ * same state as an existing one returns that one. Binding only issues the GL calls for the parts that differ from the
+ * currently bound block of the same type; the rest of the fixed function state is still set with gfx_params_set. */
+gfx_result_t gfx_state_block_create(gfx_state_block_type_t type, const gfx_fixed_function_state_t* state, gfx_state_block_t* block);
+gfx_result_t gfx_state_blocks_bind(size_t nr_blocks, const gfx_state_block_t* blocks);
 gfx_result_t gfx_driver_limits(const gfx_driver_limits_t** limits);
 
 gfx_result_t gfx_render(void);
 gfx_result_t gfx_clear(void);
 
+/* In deferred mode the per call checks of gfx only record their call site, and the GL error state is only read
+ * at gfx_render and at gfx_error_scope_end, which then return GFX_ERROR_UNKNOWN. After an error was detected,
+ * the next frame is checked immediately, so that a repeating error gets an exact site in gfx_error_report_get.
+ * May be called before gfx_init. Has no effect with GFX_NO_CHECKS. */
+gfx_result_t gfx_error_check_mode_set(gfx_error_check_mode_t mode);
+gfx_result_t gfx_error_scope_begin(const char* name);
+gfx_result_t gfx_error_scope_end(void);
+gfx_result_t gfx_error_report_get(gfx_error_report_t* report);
+
+/* counters of the last frame finished by gfx_render; all zero with GFX_NO_FRAME_STATS */
+gfx_result_t gfx_frame_stats_get(gfx_frame_stats_t* stats);
+
 /* data in img is only valid before next call to gfx_screenshot */
 gfx_result_t gfx_screenshot(gfx_image_data_rgba_t* img);
 
@@ -675,6 +773,15 @@ gfx_result_t gfx_cubemap_rewrite_face(gfx_cubemap_t cubemap, gfx_cubemap_facetyp
 gfx_result_t gfx_cubemap_rewrite_face_from_screen(gfx_cubemap_t cubemap, gfx_cubemap_facetype_t face, gfx_texture_dimensions_t offset_rect. gfx_screen_rect_t rect);
 gfx_result_t gfx_cubemap_destroy(gfx_cubemap_t cubemap);
 
+/* Framebuffers render into a texture or cubemap face instead of the screen. The color attachment must have the
+ * dimensions of the framebuffer; create it with NULL pixel data to only allocate it. Attaching checks completeness.
+ * The viewport is not changed by binding, set it with gfx_params_set. Binding NULL returns to the screen. */
+gfx_result_t gfx_framebuffer_create(gfx_texture_dimensions_t dimensions, gfx_framebuffer_depth_stencil_t depth_stencil, gfx_framebuffer_t* framebuffer);
+gfx_result_t gfx_framebuffer_attach_texture(gfx_framebuffer_t framebuffer, gfx_texture_t texture);
+gfx_result_t gfx_framebuffer_attach_cubemap_face(gfx_framebuffer_t framebuffer, gfx_cubemap_t cubemap, gfx_cubemap_facetype_t face);
+gfx_result_t gfx_framebuffer_bind(gfx_framebuffer_t* framebuffer);
+gfx_result_t gfx_framebuffer_destroy(gfx_framebuffer_t framebuffer);
+
 
 /* the shade source should _not_ include the #version line, that will be added in depending on GL version. In terms of version, use GL2 1.10 / GLES2 1.00 GLSL features. */
 gfx_result_t gfx_shader_create(const char* vertex_shader_source, const char* fragment_shader_source, gfx_shader_t* shader);
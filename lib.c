@@ -1,6 +1,7 @@
 #include "lib.c"
 
 #include <time.h>
+#include <stdatomic.h>
 #if !defined(_WIN32) && (defined(__WIN32__) || defined(WIN32) || defined(__MINGW32__))
 #include <Windows.h>
 bool32_t RtlGenRandom(void* RandomBuffer, uint32_t RandomBufferLength);
@@ -189,6 +190,554 @@ uint64_t entropy_uint64(void) {
 
 
 
+/* int math library: */
+
+/* checked arithmetic:
+    the scalar functions are just the compiler overflow builtins, which compute the exact result for any mix of
+    argument and result types and compile to the operation and a test of the overflow flag.
+    The array variants OR the overflow flags of all elements together instead of testing them one by one, so their
+    loops have no branches and can be vectorized. For that they avoid the builtins where they can: if the exact
+    result always fits into int32 or int64, they compute it there and compare it to the truncated result; addition
+    and subtraction of one 64 or 128 bit type use the carry/sign bit formulations, and only the rest (mostly
+    multiplication of the wide types) calls the builtins per element.
+    Conversions check that the value survives the round trip through the target type and, between signed and
+    unsigned types, that the sign didn't change.
+*/
+<?c
+const char* int_types[] = {"int8", "int16", "int32", "int64", "int128", "intmax",
+                            "uint8", "uint16", "uint32", "uint64", "uint128", "uintmax"};
+const int int_type_bits[] = {8, 16, 32, 64, 128, 128, 8, 16, 32, 64, 128, 128};
+const char* checked_ops[] = {"addition", "subtraction", "multiplication"};
+const char* checked_builtins[] = {"add", "sub", "mul"};
+const char* checked_operators[] = {"+", "-", "*"};
+
+for(int i = 0; i < sizeof(int_types)/sizeof(char*); i++) {
+    char* t1 = int_types[i];
+    /* bits needed for the magnitude of the values of a type, without the sign */
+    int m1 = int_type_bits[i] - (i < 6);
+    for(int j = 0; j < sizeof(int_types)/sizeof(char*); j++) {
+        char* t2 = int_types[j];
+        char* sign_check = "";
+        if(i < 6 && j >= 6) sign_check = " | (v < 0)";
+        if(i >= 6 && j < 6) sign_check = " | (val[i] < 0)";
+?>
+bool32_t @t1@_checked_conversion_from_@t2@(@t1@_t* result, @t2@_t val) {
+    return __builtin_add_overflow(val, 0, result);
+}
+bool32_t @t1@_checked_conversion_from_@t2@_array(@t1@_t* result, const @t2@_t* val, size_t len) {
+    bool32_t overflow = false;
+    for(size_t i = 0; i < len; i++) {
+        @t1@_t v = (@t1@_t) val[i];
+        result[i] = v;
+        overflow |= ((@t2@_t) v != val[i])@sign_check@;
+    }
+    return overflow;
+}
+<?c
+        int m2 = int_type_bits[j] - (j < 6);
+        for(int k = 0; k < sizeof(int_types)/sizeof(char*); k++) {
+            char* t3 = int_types[k];
+            int m3 = int_type_bits[k] - (k < 6);
+            for(int l = 0; l < sizeof(checked_ops)/sizeof(char*); l++) {
+                char* F = checked_ops[l];
+                char* B = checked_builtins[l];
+                char* op = checked_operators[l];
+                /* magnitude bits of the exact result */
+                int mr = (l == 2) ? m2 + m3 + 1 : (m2 > m3 ? m2 : m3) + 1;
+                char* W = NULL;
+                if(mr <= 31 && m1 <= 31) W = "int32";
+                else if(mr <= 63 && m1 <= 63) W = "int64";
+                bool same_wide_type = (l < 2 && int_type_bits[i] >= 64 &&
+                                       int_type_bits[i] == int_type_bits[j] && int_type_bits[i] == int_type_bits[k] &&
+                                       (i < 6) == (j < 6) && (i < 6) == (k < 6));
+?>
+bool32_t @t1@_checked_@F@_of_@t2@_and_@t3@(@t1@_t* result, @t2@_t a, @t3@_t b) {
+    return __builtin_@B@_overflow(a, b, result);
+}
+bool32_t @t1@_checked_@F@_of_@t2@_and_@t3@_array(@t1@_t* result, const @t2@_t* a, const @t3@_t* b, size_t len) {
+<?c
+                if(W != NULL) {
+?>
+    @W@_t overflow = 0;
+    for(size_t i = 0; i < len; i++) {
+        @W@_t exact = (@W@_t) a[i] @op@ (@W@_t) b[i];
+        @t1@_t v = (@t1@_t) exact;
+        result[i] = v;
+        overflow |= exact ^ (@W@_t) v;
+    }
+    return overflow != 0;
+<?c
+                } else if(same_wide_type && i < 6) {
+                    char* U = int_types[i + 6];
+                    char* sign_bit = (int_type_bits[i] == 64) ? "63" : "127";
+?>
+    @U@_t overflow = 0;
+    for(size_t i = 0; i < len; i++) {
+        @U@_t r = (@U@_t) a[i] @op@ (@U@_t) b[i];
+        result[i] = (@t1@_t) r;
+<?c
+                    if(l == 0) {
+?>
+        /* the operands have the same sign and the result has the other one */
+        overflow |= ((@U@_t) a[i] ^ r) & ((@U@_t) b[i] ^ r);
+<?c
+                    } else {
+?>
+        /* the operands have different signs and the result has the sign of b */
+        overflow |= ((@U@_t) a[i] ^ (@U@_t) b[i]) & ((@U@_t) a[i] ^ r);
+<?c
+                    }
+?>
+    }
+    return (overflow >> @sign_bit@) != 0;
+<?c
+                } else if(same_wide_type) {
+                    char* carry = (l == 0) ? "r < a[i]" : "a[i] < b[i]";
+?>
+    @t1@_t overflow = 0;
+    for(size_t i = 0; i < len; i++) {
+        @t1@_t r = a[i] @op@ b[i];
+        result[i] = r;
+        overflow |= (@t1@_t) (@carry@);
+    }
+    return overflow != 0;
+<?c
+                } else {
+?>
+    bool32_t overflow = false;
+    for(size_t i = 0; i < len; i++) {
+        overflow |= __builtin_@B@_overflow(a[i], b[i], &result[i]);
+    }
+    return overflow;
+<?c
+                }
+?>
+}
+<?c
+            }
+        }
+    }
+}
+?>
+
+
+
+/* float math library: */
+
+/* SIMD kernels for the float32 array functions:
+    every kernel is written once with the GCC/Clang vector extensions and expanded below for each instruction set
+    we dispatch to at runtime: 4 lanes for the baseline (SSE2 on x86-64, NEON etc. elsewhere), 8 lanes for
+    AVX2 + FMA and 16 lanes for AVX-512. The polynomials are the Cephes single precision ones for exp, log, sin and cos
+    and a degree 7 Taylor polynomial for exp2; the ULP bounds in lib.h were measured exhaustively against libm in
+    double precision and hold for every ISA, even though the FMA paths may round differently in the last bit.
+    sin/cos reduce the argument in double precision up to |x| <= 16384 and hand larger and non-finite arguments
+    to libm, which does the full Payne-Hanek reduction.
+    Everything without a kernel here (and every other float type) loops over the scalar function instead.
+*/
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FLOAT_SIMD_X86_DISPATCH 1
+#define FLOAT_SIMD_AVX2 __attribute__((target("avx2,fma")))
+#define FLOAT_SIMD_AVX512 __attribute__((target("avx512f")))
+#else
+#define FLOAT_SIMD_X86_DISPATCH 0
+#endif
+#define FLOAT_SIMD_BASELINE
+
+static once_flag g_float_simd_isa_once = ONCE_FLAG_INIT;
+static float_simd_isa_t g_float_simd_isa_supported;
+static _Atomic(float_simd_isa_t) g_float_simd_isa; /* may be set while other threads dispatch */
+static void float_simd_isa_detect(void) {
+    g_float_simd_isa_supported = FLOAT_SIMD_ISA_BASELINE;
+#if FLOAT_SIMD_X86_DISPATCH
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        g_float_simd_isa_supported = FLOAT_SIMD_ISA_AVX2;
+    }
+    if(__builtin_cpu_supports("avx512f")) {
+        g_float_simd_isa_supported = FLOAT_SIMD_ISA_AVX512;
+    }
+#endif
+    atomic_store_explicit(&g_float_simd_isa, g_float_simd_isa_supported, memory_order_relaxed);
+}
+float_simd_isa_t float_simd_isa_get(void) {
+    call_once(&g_float_simd_isa_once, float_simd_isa_detect);
+    return atomic_load_explicit(&g_float_simd_isa, memory_order_relaxed);
+}
+bool32_t float_simd_isa_set(float_simd_isa_t isa) {
+    call_once(&g_float_simd_isa_once, float_simd_isa_detect);
+    if(isa < FLOAT_SIMD_ISA_BASELINE || isa > g_float_simd_isa_supported) return false;
+    atomic_store_explicit(&g_float_simd_isa, isa, memory_order_relaxed);
+    return true;
+}
+
+<?c
+const char* simd_isas[] = {"baseline", "avx2", "avx512"};
+const char* simd_targets[] = {"FLOAT_SIMD_BASELINE", "FLOAT_SIMD_AVX2", "FLOAT_SIMD_AVX512"};
+const char* simd_widths[] = {"4", "8", "16"};
+const char* simd_unary_kernels[] = {"sin", "cos", "exp", "exp2", "log", "log2", "abs"};
+const char* simd_binary_kernels[] = {"add", "sub", "mul", "div", "min", "max"};
+const char* simd_trinary_kernels[] = {"clamp", "lerp"};
+
+for(int i = 0; i < sizeof(simd_isas)/sizeof(char*); i++) {
+    char* isa = simd_isas[i];
+    char* target = simd_targets[i];
+    char* W = simd_widths[i];
+    if(i > 0) {
+?>
+#if FLOAT_SIMD_X86_DISPATCH
+<?c
+    }
+?>
+typedef float32_t float32x@W@_t __attribute__((vector_size(@W@ * sizeof(float32_t))));
+typedef float64_t float64x@W@_t __attribute__((vector_size(@W@ * sizeof(float64_t))));
+typedef int32_t int32x@W@_t __attribute__((vector_size(@W@ * sizeof(int32_t))));
+typedef uint32_t uint32x@W@_t __attribute__((vector_size(@W@ * sizeof(uint32_t))));
+
+@target@ static inline float32x@W@_t float32x@W@_splat(float32_t c) {
+    return (float32x@W@_t){0} + c;
+}
+@target@ static inline float32x@W@_t float32x@W@_select(int32x@W@_t mask, float32x@W@_t a, float32x@W@_t b) {
+    return (float32x@W@_t) ((mask & (int32x@W@_t) a) | (~mask & (int32x@W@_t) b));
+}
+@target@ static inline bool float32x@W@_all(int32x@W@_t mask) {
+    uint64_t words[@W@ / 2], all = ~0ull;
+    memcpy(words, &mask, sizeof(mask));
+    for(int k = 0; k < @W@ / 2; k++) {
+        all &= words[k];
+    }
+    return all == ~0ull;
+}
+/* 2^n for n in [-150, 128], split into two factors so both stay normal */
+@target@ static inline float32x@W@_t float32x@W@_scale(float32x@W@_t p, int32x@W@_t n) {
+    int32x@W@_t h = n >> 1;
+    return p * (float32x@W@_t) ((h + 127) << 23) * (float32x@W@_t) ((n - h + 127) << 23);
+}
+@target@ static inline float32x@W@_t float32x@W@_exp(float32x@W@_t x) {
+    float32x@W@_t n, r, p; int32x@W@_t is_nan = (x != x);
+    x = float32x@W@_select(x < -104.0f, float32x@W@_splat(-104.0f), x);
+    x = float32x@W@_select(x > 89.0f, float32x@W@_splat(89.0f), x);
+    /* round to nearest by the 1.5 * 2^23 trick, so no rounding instruction is needed */
+    n = (x * 1.44269504089f + 12582912.0f) - 12582912.0f;
+    r = x - n * 0.693359375f;
+    r = r - n * -2.12194440e-4f;
+    p = ((((1.9875691500e-4f * r + 1.3981999507e-3f) * r + 8.3334519073e-3f) * r
+            + 4.1665795894e-2f) * r + 1.6666665459e-1f) * r + 5.0000001201e-1f;
+    p = p * r * r + r + 1.0f;
+    p = float32x@W@_scale(p, __builtin_convertvector(n, int32x@W@_t));
+    return float32x@W@_select(is_nan, x, p);
+}
+@target@ static inline float32x@W@_t float32x@W@_exp2(float32x@W@_t x) {
+    float32x@W@_t n, r, p; int32x@W@_t is_nan = (x != x);
+    x = float32x@W@_select(x < -150.0f, float32x@W@_splat(-150.0f), x);
+    x = float32x@W@_select(x > 129.0f, float32x@W@_splat(129.0f), x);
+    n = (x + 12582912.0f) - 12582912.0f;
+    r = x - n;
+    p = ((((((1.5252734e-5f * r + 1.5403530e-4f) * r + 1.3333558e-3f) * r + 9.6181291e-3f) * r
+            + 5.5504109e-2f) * r + 2.4022651e-1f) * r + 6.9314718e-1f) * r + 1.0f;
+    p = float32x@W@_scale(p, __builtin_convertvector(n, int32x@W@_t));
+    return float32x@W@_select(is_nan, x, p);
+}
+/* splits x into 2^e * (1 + f) with 1 + f in [sqrt(1/2), sqrt(2)) and returns log(1 + f) - f */
+@target@ static inline float32x@W@_t float32x@W@_log_split(float32x@W@_t x, float32x@W@_t* out_f, float32x@W@_t* out_e) {
+    float32x@W@_t f, z, y, e; uint32x@W@_t u; int32x@W@_t is_subnormal, is_big;
+    /* subnormals are scaled up by 2^23 first */
+    is_subnormal = (x < 1.17549435e-38f);
+    x = float32x@W@_select(is_subnormal, x * 8388608.0f, x);
+    u = (uint32x@W@_t) x;
+    e = __builtin_convertvector((int32x@W@_t) (u >> 23) - 127, float32x@W@_t);
+    e = float32x@W@_select(is_subnormal, e - 23.0f, e);
+    f = (float32x@W@_t) ((u & 0x007fffffu) | 0x3f800000u);
+    is_big = (f > 1.41421356f);
+    e = float32x@W@_select(is_big, e + 1.0f, e);
+    f = float32x@W@_select(is_big, f * 0.5f, f) - 1.0f;
+    z = f * f;
+    y = ((((((((7.0376836292e-2f * f - 1.1514610310e-1f) * f + 1.1676998740e-1f) * f
+            - 1.2420140846e-1f) * f + 1.4249322787e-1f) * f - 1.6668057665e-1f) * f
+            + 2.0000714765e-1f) * f - 2.4999993993e-1f) * f + 3.3333331174e-1f) * f * z;
+    out_f[0] = f;
+    out_e[0] = e;
+    return y - 0.5f * z;
+}
+@target@ static inline float32x@W@_t float32x@W@_log_special(float32x@W@_t x, float32x@W@_t r) {
+    r = float32x@W@_select(x == 0.0f, float32x@W@_splat(-FLOAT32_INFINITY), r);
+    r = float32x@W@_select(x < 0.0f, float32x@W@_splat(FLOAT32_NAN), r);
+    r = float32x@W@_select(x == FLOAT32_INFINITY, x, r);
+    return float32x@W@_select(x != x, x, r);
+}
+@target@ static inline float32x@W@_t float32x@W@_log(float32x@W@_t x) {
+    float32x@W@_t f, e, y;
+    y = float32x@W@_log_split(x, &f, &e);
+    y = y + e * -2.12194440e-4f;
+    return float32x@W@_log_special(x, f + y + e * 0.693359375f);
+}
+@target@ static inline float32x@W@_t float32x@W@_log2(float32x@W@_t x) {
+    float32x@W@_t f, e, y;
+    y = float32x@W@_log_split(x, &f, &e);
+    return float32x@W@_log_special(x, (f + y) * 1.44269504089f + e);
+}
+/* quadrant 0 gives sin(x), quadrant 1 gives cos(x) */
+@target@ static inline float32x@W@_t float32x@W@_sincos(float32x@W@_t x, uint32_t quadrant) {
+    float32x@W@_t ax, r, z, s, c; float64x@W@_t y; int32x@W@_t in_range; uint32x@W@_t j, sign;
+    ax = (float32x@W@_t) ((uint32x@W@_t) x & 0x7fffffffu);
+    in_range = (ax <= 16384.0f);
+    ax = float32x@W@_select(in_range, ax, float32x@W@_splat(0.0f));
+    /* j is the nearest even octant, pi/4 is split so that y * 0x1.921fb544p-1 is exact for y < 2^20 */
+    j = (uint32x@W@_t) __builtin_convertvector(ax * 1.27323954474f, int32x@W@_t);
+    j = (j + 1) & ~1u;
+    y = __builtin_convertvector(j, float64x@W@_t);
+    r = __builtin_convertvector((__builtin_convertvector(ax, float64x@W@_t) - y * 0x1.921fb544p-1) - y * 0x1.0b4611a626331p-35,
+                                float32x@W@_t);
+    z = r * r;
+    s = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * r + r;
+    c = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+    j = (j >> 1) + quadrant;
+    r = float32x@W@_select((int32x@W@_t) ((j & 1) != 0), c, s);
+    /* sin is odd, cos is even */
+    sign = ((j << 30) & 0x80000000u) ^ ((uint32x@W@_t) x & (0x80000000u & (quadrant - 1)));
+    r = (float32x@W@_t) ((uint32x@W@_t) r ^ sign);
+    if(!float32x@W@_all(in_range)) {
+        for(int k = 0; k < @W@; k++) {
+            if(!in_range[k]) {
+                r[k] = (quadrant == 0) ? sinf(x[k]) : cosf(x[k]);
+            }
+        }
+    }
+    return r;
+}
+@target@ static inline float32x@W@_t float32x@W@_sin(float32x@W@_t x) {
+    return float32x@W@_sincos(x, 0);
+}
+@target@ static inline float32x@W@_t float32x@W@_cos(float32x@W@_t x) {
+    return float32x@W@_sincos(x, 1);
+}
+@target@ static inline float32x@W@_t float32x@W@_abs(float32x@W@_t x) {
+    return (float32x@W@_t) ((uint32x@W@_t) x & 0x7fffffffu);
+}
+@target@ static inline float32x@W@_t float32x@W@_add(float32x@W@_t x, float32x@W@_t y) {
+    return x + y;
+}
+@target@ static inline float32x@W@_t float32x@W@_sub(float32x@W@_t x, float32x@W@_t y) {
+    return x - y;
+}
+@target@ static inline float32x@W@_t float32x@W@_mul(float32x@W@_t x, float32x@W@_t y) {
+    return x * y;
+}
+@target@ static inline float32x@W@_t float32x@W@_div(float32x@W@_t x, float32x@W@_t y) {
+    return x / y;
+}
+/* min/max follow fmin/fmax and only return NaN if both are NaN */
+@target@ static inline float32x@W@_t float32x@W@_min(float32x@W@_t x, float32x@W@_t y) {
+    float32x@W@_t r = float32x@W@_select(x < y, x, y);
+    r = float32x@W@_select(y != y, x, r);
+    return float32x@W@_select(x != x, y, r);
+}
+@target@ static inline float32x@W@_t float32x@W@_max(float32x@W@_t x, float32x@W@_t y) {
+    float32x@W@_t r = float32x@W@_select(x > y, x, y);
+    r = float32x@W@_select(y != y, x, r);
+    return float32x@W@_select(x != x, y, r);
+}
+@target@ static inline float32x@W@_t float32x@W@_clamp(float32x@W@_t x, float32x@W@_t y, float32x@W@_t z) {
+    x = float32x@W@_select(x < y, y, x);
+    return float32x@W@_select(x > z, z, x);
+}
+@target@ static inline float32x@W@_t float32x@W@_lerp(float32x@W@_t x, float32x@W@_t y, float32x@W@_t z) {
+    return x + z * (y - x);
+}
+<?c
+    /* the tail is padded with 1.0 so the unused lanes don't raise any float exceptions */
+    for(int k = 0; k < sizeof(simd_unary_kernels)/sizeof(char*); k++) {
+        char* F = simd_unary_kernels[k];
+?>
+@target@ static void float32_@F@_array_@isa@(const float32_t* x, float32_t* result, size_t len) {
+    float32x@W@_t vx; size_t i;
+    for(i = 0; i + @W@ <= len; i += @W@) {
+        memcpy(&vx, &x[i], sizeof(vx));
+        vx = float32x@W@_@F@(vx);
+        memcpy(&result[i], &vx, sizeof(vx));
+    }
+    if(i < len) {
+        vx = float32x@W@_splat(1.0f);
+        memcpy(&vx, &x[i], (len - i) * sizeof(float32_t));
+        vx = float32x@W@_@F@(vx);
+        memcpy(&result[i], &vx, (len - i) * sizeof(float32_t));
+    }
+}
+<?c
+    }
+    for(int k = 0; k < sizeof(simd_binary_kernels)/sizeof(char*); k++) {
+        char* F = simd_binary_kernels[k];
+?>
+@target@ static void float32_@F@_array_@isa@(const float32_t* x, const float32_t* y, float32_t* result, size_t len) {
+    float32x@W@_t vx, vy; size_t i;
+    for(i = 0; i + @W@ <= len; i += @W@) {
+        memcpy(&vx, &x[i], sizeof(vx));
+        memcpy(&vy, &y[i], sizeof(vy));
+        vx = float32x@W@_@F@(vx, vy);
+        memcpy(&result[i], &vx, sizeof(vx));
+    }
+    if(i < len) {
+        vx = vy = float32x@W@_splat(1.0f);
+        memcpy(&vx, &x[i], (len - i) * sizeof(float32_t));
+        memcpy(&vy, &y[i], (len - i) * sizeof(float32_t));
+        vx = float32x@W@_@F@(vx, vy);
+        memcpy(&result[i], &vx, (len - i) * sizeof(float32_t));
+    }
+}
+<?c
+    }
+    for(int k = 0; k < sizeof(simd_trinary_kernels)/sizeof(char*); k++) {
+        char* F = simd_trinary_kernels[k];
+?>
+@target@ static void float32_@F@_array_@isa@(const float32_t* x, const float32_t* y, const float32_t* z, float32_t* result, size_t len) {
+    float32x@W@_t vx, vy, vz; size_t i;
+    for(i = 0; i + @W@ <= len; i += @W@) {
+        memcpy(&vx, &x[i], sizeof(vx));
+        memcpy(&vy, &y[i], sizeof(vy));
+        memcpy(&vz, &z[i], sizeof(vz));
+        vx = float32x@W@_@F@(vx, vy, vz);
+        memcpy(&result[i], &vx, sizeof(vx));
+    }
+    if(i < len) {
+        vx = vy = vz = float32x@W@_splat(1.0f);
+        memcpy(&vx, &x[i], (len - i) * sizeof(float32_t));
+        memcpy(&vy, &y[i], (len - i) * sizeof(float32_t));
+        memcpy(&vz, &z[i], (len - i) * sizeof(float32_t));
+        vx = float32x@W@_@F@(vx, vy, vz);
+        memcpy(&result[i], &vx, (len - i) * sizeof(float32_t));
+    }
+}
+<?c
+    }
+    if(i > 0) {
+?>
+#endif
+<?c
+    }
+}
+?>
+
+<?c
+const char* float_types[] = {"float16", "float32", "float64", "float80", "float128",
+                             "decimal32", "decimal64", "decimal128"};
+const char* unary_functions[] = {
+    "acos", "asin", "atan", "cos", "sin", "tan",
+    "acospi", "asinpi", "atanpi", "cospi", "sinpi", "tanpi",
+    "acosh", "asinh", "atanh", "cosh", "sinh", "tanh",
+    "exp", "exp2", "exp10", "expm1", "exp2m1", "exp10m1",
+    "log", "log2", "log10", "logp1", "log2p1", "log10p1",
+    "sign", "abs", "sqrt", "rsqrt", "cbrt", "erf", "erfc", "lgamma", "tgamma",
+    "radians_from_degrees", "degrees_from_radians",
+    "ceil", "floor", "fract_from_floor", "trunc",
+    "round_default", "round_default_raise_inexact", "round_with_half_away_from_zero",
+    "round_with_half_to_even", "next_greater", "next_lesser"
+};
+const char* binary_functions[] = {
+    "atan2", "atan2pi", "hypot", "pow", "powr", "fdim", "step",
+    "add", "sub", "mul", "div", "mod", "IEEE_remainder", "copysign_over_value", "next_in_direction_of",
+    "max", "min", "max_abs", "min_abs"
+};
+const char* trinary_functions[] = {
+    "fma", "clamp", "lerp", "smoothstep"
+};
+
+for(int i = 0; i < sizeof(float_types)/sizeof(char*); i++) {
+    char* T = float_types[i];
+    for(int k = 0; k < sizeof(unary_functions)/sizeof(char*); k++) {
+        char* F = unary_functions[k];
+        bool has_kernel = false;
+        for(int m = 0; m < sizeof(simd_unary_kernels)/sizeof(char*); m++) {
+            has_kernel |= (strcmp(T, "float32") == 0 && strcmp(F, simd_unary_kernels[m]) == 0);
+        }
+?>
+void @T@_@F@_array(const @T@_t* x, @T@_t* result, size_t len) {
+<?c
+        if(has_kernel) {
+?>
+    switch(float_simd_isa_get()) {
+#if FLOAT_SIMD_X86_DISPATCH
+    case FLOAT_SIMD_ISA_AVX512: float32_@F@_array_avx512(x, result, len); return;
+    case FLOAT_SIMD_ISA_AVX2: float32_@F@_array_avx2(x, result, len); return;
+#endif
+    default: float32_@F@_array_baseline(x, result, len); return;
+    }
+<?c
+        } else {
+?>
+    for(size_t i = 0; i < len; i++) {
+        result[i] = @T@_@F@(x[i]);
+    }
+<?c
+        }
+?>
+}
+<?c
+    }
+    for(int k = 0; k < sizeof(binary_functions)/sizeof(char*); k++) {
+        char* F = binary_functions[k];
+        bool has_kernel = false;
+        for(int m = 0; m < sizeof(simd_binary_kernels)/sizeof(char*); m++) {
+            has_kernel |= (strcmp(T, "float32") == 0 && strcmp(F, simd_binary_kernels[m]) == 0);
+        }
+?>
+void @T@_@F@_array(const @T@_t* x, const @T@_t* y, @T@_t* result, size_t len) {
+<?c
+        if(has_kernel) {
+?>
+    switch(float_simd_isa_get()) {
+#if FLOAT_SIMD_X86_DISPATCH
+    case FLOAT_SIMD_ISA_AVX512: float32_@F@_array_avx512(x, y, result, len); return;
+    case FLOAT_SIMD_ISA_AVX2: float32_@F@_array_avx2(x, y, result, len); return;
+#endif
+    default: float32_@F@_array_baseline(x, y, result, len); return;
+    }
+<?c
+        } else {
+?>
+    for(size_t i = 0; i < len; i++) {
+        result[i] = @T@_@F@(x[i], y[i]);
+    }
+<?c
+        }
+?>
+}
+<?c
+    }
+    for(int k = 0; k < sizeof(trinary_functions)/sizeof(char*); k++) {
+        char* F = trinary_functions[k];
+        bool has_kernel = false;
+        for(int m = 0; m < sizeof(simd_trinary_kernels)/sizeof(char*); m++) {
+            has_kernel |= (strcmp(T, "float32") == 0 && strcmp(F, simd_trinary_kernels[m]) == 0);
+        }
+?>
+void @T@_@F@_array(const @T@_t* x, const @T@_t* y, const @T@_t* z, @T@_t* result, size_t len) {
+<?c
+        if(has_kernel) {
+?>
+    switch(float_simd_isa_get()) {
+#if FLOAT_SIMD_X86_DISPATCH
+    case FLOAT_SIMD_ISA_AVX512: float32_@F@_array_avx512(x, y, z, result, len); return;
+    case FLOAT_SIMD_ISA_AVX2: float32_@F@_array_avx2(x, y, z, result, len); return;
+#endif
+    default: float32_@F@_array_baseline(x, y, z, result, len); return;
+    }
+<?c
+        } else {
+?>
+    for(size_t i = 0; i < len; i++) {
+        result[i] = @T@_@F@(x[i], y[i], z[i]);
+    }
+<?c
+        }
+?>
+}
+<?c
+    }
+}
+?>
+
+
+
+
 /* memory library */
 
 mem_t mem_alloc(size_t size) {
@@ -764,9 +1313,9 @@ static strbuf_result_t strbuf_fmtstr_float(strbuf_t* fmt, size_t bits, format_pa
 
 <?c
 enum {T_INT, T_UINT, T_FLOAT} type_kind[10] = {T_INT, T_INT, T_INT, T_INT, T_UINT, T_UINT, T_UINT, T_UINT, T_FLOAT, T_FLOAT};
-char** type_size[10] = {"8", "16", "32", "64", "8", "16", "32", "64", "32", "64"};
+const char* type_size[10] = {"8", "16", "32", "64", "8", "16", "32", "64", "32", "64"};
 for(int i = 0; i < 10; i++) {
-    char* tk, ts, params_end, fmststr_params_end;
+    char *tk, *ts, *params_end, *fmststr_params_end;
     ts = type_size[i];
     switch(type_kind[i]) {
     case T_INT:
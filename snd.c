@@ -4,6 +4,15 @@
 #define ALC_NO_PROTOTYPES
 #include <AL/al.h>
 #include <AL/alc.h>
+#include <AL/alext.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <float.h>
+#include <math.h>
+#include <threads.h>
+#include <stdatomic.h>
+#include <stdalign.h>
 
 /* Function loading facilities from alad: modelled after GLFW 3.3, see win32_module.c and posix_module.c specifically */
 #if defined(_WIN32) || defined(__WIN32__) || defined(WIN32) || defined(__MINGW32__)
@@ -25,10 +34,66 @@ TODO: add constraints for the getters/setters according to property info in spec
 
 
 #define SND_INITIAL_ARRAY_CAP 1024
+#define SND_INITIAL_SHADOW_CAP 256
+#define SND_FORMAT_COUNT (SND_FORMAT_PCM_FLOAT32_7_1_INTERLEAVED + 1)
+
+#ifndef ALC_SOFT_reopen_device
+typedef ALCboolean (ALC_APIENTRY* LPALCREOPENDEVICESOFT)(ALCdevice* device, const ALCchar* device_name, const ALCint* attribs);
+#endif
+#ifndef ALC_CONNECTED
+#define ALC_CONNECTED 0x313
+#endif
+#ifndef AL_SOFT_source_start_delay
+/* newer than some alext.h versions */
+typedef void (AL_APIENTRY* LPALSOURCEPLAYATTIMEVSOFT)(ALsizei n, const ALuint* sources, ALint64SOFT start_time);
+#endif
+
+/* last values written to a source through this library, so batched updates can skip the AL call if nothing changed */
+typedef struct snd_source_shadow_t {
+    ALuint id;
+    uint32_t valid_fields;
+    snd_source_params_t params;
+    /* for telling underruns from sources stopped on purpose in snd_listener_context_stats_get */
+    ALint last_state;
+    bool stop_requested;
+    uint32_t nr_underruns;
+    /* the last snd_sources_play_at, 0 if there was none */
+    uint64_t scheduled_ns;
+    double lead_in_seconds;
+} snd_source_shadow_t;
+/* per context state; the AL extensions are checked on first use because they need the context to be current */
+typedef struct snd_context_info_t {
+    ALCcontext* handle;
+    bool extensions_checked;
+    bool deferred_updates;
+    LPALDEFERUPDATESSOFT DeferUpdatesSOFT;
+    LPALPROCESSUPDATESSOFT ProcessUpdatesSOFT;
+    /* open addressing on the source id, capacity is a power of two */
+    uint32_t nr_shadows, shadows_cap;
+    snd_source_shadow_t* shadows;
+    /* what the device actually mixes at, buffers are converted to it on upload unless the quality is NONE */
+    uint32_t mixing_frequency_hz;
+    snd_resample_quality_t resample_quality;
+    /* ALC_SOFT_device_clock and AL_SOFT_source_latency, NULL without them */
+    LPALCGETINTEGER64VSOFT GetInteger64vSOFT;
+    LPALGETSOURCEDVSOFT GetSourcedvSOFT;
+    /* AL_SOFT_source_start_delay, without it snd_sources_play_at queues silence in front */
+    LPALSOURCEPLAYATTIMEVSOFT SourcePlayAtTimevSOFT;
+    /* buffer is the silence, 0 once it's unqueued; content the static buffer the source had before */
+    struct { ALuint source, buffer, content; }* lead_ins;
+    uint32_t nr_lead_ins, lead_ins_cap;
+    /* time spent inside snd calls on this context, only collected with SND_PROFILE; the running totals are added to
+     * by every thread calling into the context, the rest is only touched by snd_listener_context_frame_end */
+    atomic_uint_fast64_t api_ns;
+    atomic_uint nr_api_calls;
+    double api_seconds_last_frame, api_seconds_max_frame;
+    uint32_t nr_api_calls_last_frame;
+} snd_context_info_t;
 
 
 static struct g_al {
     void*                            module;
+    snd_backend_type_t               backend;
     snd_device_list_t                devices;
     ALCdevice**                      playback_device_handles;
     struct {
@@ -49,7 +114,37 @@ static struct g_al {
         LPALCCAPTURESTART                CaptureStart;
         LPALCCAPTURESTOP                 CaptureStop;
         LPALCCAPTURESAMPLES              CaptureSamples;
+        LPALCISEXTENSIONPRESENT          IsExtensionPresent;
+        LPALCGETPROCADDRESS              GetProcAddress;
     } c;
+    /* extension functions, loaded by snd_load_al_extensions; NULL if the extension is not present */
+    struct {
+        bool                             thread_local_context;
+    } ext;
+    PFNALCSETTHREADCONTEXTPROC       SetThreadContext;
+    PFNALCGETTHREADCONTEXTPROC       GetThreadContext;
+    /* probed on the first context, unsupported formats are converted before upload */
+    bool                             formats_supported[SND_FORMAT_COUNT];
+    bool                             formats_probed;
+    /* open devices that vanished from the list on a refresh, still used by their contexts */
+    ALCdevice**                      orphan_devices;
+    uint32_t                         nr_orphan_devices;
+    LPALCREOPENDEVICESOFT            ReopenDeviceSOFT;
+#ifdef ALC_SOFT_system_events
+    LPALCEVENTCALLBACKSOFT           EventCallbackSOFT;
+#endif
+    /* snd_device_event_bits_t set from the ALC_SOFT_system_events callback, taken by snd_devices_poll */
+    atomic_uint                      device_events;
+    snd_context_info_t*              contexts;
+    uint32_t                         nr_contexts, contexts_cap;
+    /* guards contexts and what they point to, a command queue drains on its own thread into the same context as the
+     * app; recursive, because the shadow helpers take it too */
+    mtx_t                            contexts_lock;
+    /* the format each open recording device was opened with, AL can't be asked for it */
+    struct { ALCdevice* handle; snd_format_t format; }* recording_formats;
+    uint32_t                         nr_recording_formats, recording_formats_cap;
+    LPALISEXTENSIONPRESENT           IsExtensionPresent;
+    LPALGETPROCADDRESS               GetProcAddress;
     LPALGETSTRING                    GetString;
     LPALGETINTEGER                   GetInteger;
     LPALGETFLOAT                     GetFloat;
@@ -105,10 +200,14 @@ static void snd_load_al(snd_loader loader) {
     g_al.c.CaptureStart       = (LPALCCAPTURESTART)        (loader(g_al.module, "alcCaptureStart"));
     g_al.c.CaptureStop        = (LPALCCAPTURESTOP)         (loader(g_al.module, "alcCaptureStop"));
     g_al.c.CaptureSamples     = (LPALCCAPTURESAMPLES)      (loader(g_al.module, "alcCaptureSamples"));
+    g_al.c.IsExtensionPresent = (LPALCISEXTENSIONPRESENT)  (loader(g_al.module, "alcIsExtensionPresent"));
+    g_al.c.GetProcAddress     = (LPALCGETPROCADDRESS)      (loader(g_al.module, "alcGetProcAddress"));
     g_al.GetString            = (LPALGETSTRING)            (loader(g_al.module, "alGetString"));
     g_al.GetInteger           = (LPALGETINTEGER)           (loader(g_al.module, "alGetInteger"));
     g_al.GetFloat             = (LPALGETFLOAT)             (loader(g_al.module, "alGetFloat"));
     g_al.GetError             = (LPALGETERROR)             (loader(g_al.module, "alGetError"));
+    g_al.IsExtensionPresent   = (LPALISEXTENSIONPRESENT)   (loader(g_al.module, "alIsExtensionPresent"));
+    g_al.GetProcAddress       = (LPALGETPROCADDRESS)       (loader(g_al.module, "alGetProcAddress"));
     g_al.DopplerFactor        = (LPALDOPPLERFACTOR)        (loader(g_al.module, "alDopplerFactor"));
     g_al.SpeedOfSound         = (LPALSPEEDOFSOUND)         (loader(g_al.module, "alSpeedOfSound"));
     g_al.DistanceModel        = (LPALDISTANCEMODEL)        (loader(g_al.module, "alDistanceModel"));
@@ -137,6 +236,56 @@ static void snd_load_al(snd_loader loader) {
     g_al.BufferData           = (LPALBUFFERDATA)           (loader(g_al.module, "alBufferData"));
     g_al.GetBufferi           = (LPALGETBUFFERI)           (loader(g_al.module, "alGetBufferi"));
 }
+/* device independent ALC extensions; AL extensions need a current context and are checked where they are used */
+#ifdef ALC_SOFT_system_events
+/* called on an AL thread, so it only leaves a note for snd_devices_poll */
+static void ALC_APIENTRY snd_device_event_callback(ALCenum event_type, ALCenum device_type, ALCdevice* device, ALCsizei length, const ALCchar* message, void* user_param) {
+    unsigned bit = 0;
+
+    if(device_type != ALC_PLAYBACK_DEVICE_SOFT && device_type != ALC_CAPTURE_DEVICE_SOFT) {
+        return;
+    }
+    switch(event_type) {
+    case ALC_EVENT_TYPE_DEFAULT_DEVICE_CHANGED_SOFT:
+        bit = SND_DEVICE_EVENT_DEFAULT_CHANGED_BIT;
+        break;
+    case ALC_EVENT_TYPE_DEVICE_ADDED_SOFT:
+        bit = SND_DEVICE_EVENT_DEVICE_ADDED_BIT;
+        break;
+    case ALC_EVENT_TYPE_DEVICE_REMOVED_SOFT:
+        bit = SND_DEVICE_EVENT_DEVICE_REMOVED_BIT;
+        break;
+    default:
+        break;
+    }
+    atomic_fetch_or(&(g_al.device_events), bit);
+}
+#endif
+static void snd_load_al_extensions(void) {
+    if(g_al.c.IsExtensionPresent(NULL, "ALC_EXT_thread_local_context") == ALC_TRUE) {
+        g_al.SetThreadContext = (PFNALCSETTHREADCONTEXTPROC) g_al.c.GetProcAddress(NULL, "alcSetThreadContext");
+        g_al.GetThreadContext = (PFNALCGETTHREADCONTEXTPROC) g_al.c.GetProcAddress(NULL, "alcGetThreadContext");
+        g_al.ext.thread_local_context = g_al.SetThreadContext != NULL && g_al.GetThreadContext != NULL;
+    }
+    g_al.ReopenDeviceSOFT = NULL;
+    if(g_al.c.IsExtensionPresent(NULL, "ALC_SOFT_reopen_device") == ALC_TRUE) {
+        g_al.ReopenDeviceSOFT = (LPALCREOPENDEVICESOFT) g_al.c.GetProcAddress(NULL, "alcReopenDeviceSOFT");
+    }
+#ifdef ALC_SOFT_system_events
+    g_al.EventCallbackSOFT = NULL;
+    if(g_al.c.IsExtensionPresent(NULL, "ALC_SOFT_system_events") == ALC_TRUE) {
+        LPALCEVENTCONTROLSOFT EventControlSOFT = (LPALCEVENTCONTROLSOFT) g_al.c.GetProcAddress(NULL, "alcEventControlSOFT");
+        ALCenum types[] = { ALC_EVENT_TYPE_DEFAULT_DEVICE_CHANGED_SOFT, ALC_EVENT_TYPE_DEVICE_ADDED_SOFT, ALC_EVENT_TYPE_DEVICE_REMOVED_SOFT };
+        g_al.EventCallbackSOFT = (LPALCEVENTCALLBACKSOFT) g_al.c.GetProcAddress(NULL, "alcEventCallbackSOFT");
+        if(EventControlSOFT != NULL && g_al.EventCallbackSOFT != NULL) {
+            g_al.EventCallbackSOFT(snd_device_event_callback, NULL);
+            EventControlSOFT(3, types, ALC_TRUE);
+        } else {
+            g_al.EventCallbackSOFT = NULL;
+        }
+    }
+#endif
+}
 static snd_loader snd_load_al_dll(void) {
 /* since we only use core functions, it's enough to load all function pointers once at init from the DLL.
  * This would be different for direct functions, but since they're newer we avoid them here.
@@ -224,22 +373,22 @@ static snd_result_t split_device_string(const char* str, int* out_num_strings, c
     return SND_OK;
 }
 
-snd_result_t snd_init(snd_device_list_t* out_device_list) {
-    snd_result_t r; const ALCchar* str;
-    
-#ifndef SND_NO_CHECKS
-    if(out_device_list == NULL) {
-        return SND_ERROR_INVALID_PARAM;
+static void snd_device_list_free(snd_device_list_t* list) {
+    for(int i = 0; i < list->nr_playback_devices; i++) {
+        free((char*) list->playback_devices[i]);
     }
-#endif
-    
-    snd_loader loader = snd_load_al_dll();
-    if(loader == NULL) {
-        return SND_ERROR_AL_NOT_PRESENT;
+    for(int i = 0; i < list->nr_recording_devices; i++) {
+        free((char*) list->recording_devices[i]);
     }
-    snd_load_al(loader);
-    
-    str = alcGetString(NULL, ALC_DEVICE_SPECIFIER);
+    free(list->playback_devices);
+    free(list->recording_devices);
+    memset(list, 0, sizeof(snd_device_list_t));
+}
+/* the playback and recording device lists as AL reports them right now */
+static snd_result_t snd_devices_enumerate(snd_device_list_t* list) {
+    snd_result_t r; const ALCchar* str;
+
+    str = g_al.c.GetString(NULL, ALC_DEVICE_SPECIFIER);
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
@@ -248,14 +397,14 @@ snd_result_t snd_init(snd_device_list_t* out_device_list) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    r = split_device_string(str, &(g_al.devices.nr_playback_devices), &(g_al.devices.playback_devices));
+    r = split_device_string(str, &(list->nr_playback_devices), &(list->playback_devices));
 #ifndef SND_NO_CHECKS
     if(r != SND_OK) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
     
-    str = alcGetString(NULL, ALC_DEFAULT_DEVICE_SPECIFIER);
+    str = g_al.c.GetString(NULL, ALC_DEFAULT_DEVICE_SPECIFIER);
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
@@ -264,20 +413,20 @@ snd_result_t snd_init(snd_device_list_t* out_device_list) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    g_al.devices.playback_devices_default_id = -1;
-    for(int i = 0; i < g_al.devices.nr_playback_devices; i++) {
-        if(strcmp(g_al.devices.playback_devices[i], str) == 0) {
-            g_al.devices.playback_devices_default_id = i;
+    list->playback_devices_default_id = -1;
+    for(int i = 0; i < list->nr_playback_devices; i++) {
+        if(strcmp(list->playback_devices[i], str) == 0) {
+            list->playback_devices_default_id = i;
             break;
         }
     }
 #ifndef SND_NO_CHECKS
-    if(g_al.devices.playback_devices_default_id < 0) {
+    if(list->playback_devices_default_id < 0) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
 
-    str = alcGetString(NULL, ALC_CAPTURE_DEVICE_SPECIFIER);
+    str = g_al.c.GetString(NULL, ALC_CAPTURE_DEVICE_SPECIFIER);
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
@@ -286,14 +435,14 @@ snd_result_t snd_init(snd_device_list_t* out_device_list) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    r = split_device_string(str, &(g_al.devices.nr_recording_devices), &(g_al.devices.recording_devices));
+    r = split_device_string(str, &(list->nr_recording_devices), &(list->recording_devices));
 #ifndef SND_NO_CHECKS
     if(r != SND_OK) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
     
-    str = alcGetString(NULL, ALC_CAPTURE_DEFAULT_DEVICE_SPECIFIER);
+    str = g_al.c.GetString(NULL, ALC_CAPTURE_DEFAULT_DEVICE_SPECIFIER);
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
@@ -302,29 +451,82 @@ snd_result_t snd_init(snd_device_list_t* out_device_list) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    g_al.devices.recording_devices_default_id = -1;
-    for(int i = 0; i < g_al.devices.nr_recording_devices; i++) {
-        if(strcmp(g_al.devices.recording_devices[i], str) == 0) {
-            g_al.devices.recording_devices_default_id = i;
+    list->recording_devices_default_id = -1;
+    for(int i = 0; i < list->nr_recording_devices; i++) {
+        if(strcmp(list->recording_devices[i], str) == 0) {
+            list->recording_devices_default_id = i;
             break;
         }
     }
 #ifndef SND_NO_CHECKS
-    if(g_al.devices.recording_devices_default_id < 0) {
+    /* the software backend has nothing to record from */
+    if(list->nr_recording_devices > 0 && list->recording_devices_default_id < 0) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    return SND_OK;
+}
+
+static snd_result_t snd_probe_formats(ALCdevice* dev);
+static snd_result_t snd_soft_init(const snd_software_backend_params_t* params);
+static void snd_soft_exit(void);
+
+snd_result_t snd_init(snd_device_list_t* out_device_list) {
+    return snd_init_backend(SND_BACKEND_TYPE_OPENAL, NULL, out_device_list);
+}
+snd_result_t snd_init_backend(snd_backend_type_t backend, const snd_software_backend_params_t* software_params, snd_device_list_t* out_device_list) {
+    snd_result_t r; snd_loader loader;
+    
+#ifndef SND_NO_CHECKS
+    if(out_device_list == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    if(backend == SND_BACKEND_TYPE_SOFTWARE && software_params == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    
+    if(mtx_init(&g_al.contexts_lock, mtx_plain | mtx_recursive) != thrd_success) {
         return SND_ERROR_UNKNOWN;
     }
+    g_al.backend = backend;
+    if(backend == SND_BACKEND_TYPE_SOFTWARE) {
+        r = snd_soft_init(software_params);
+        if(r != SND_OK) {
+            mtx_destroy(&g_al.contexts_lock);
+            return r;
+        }
+    } else {
+        loader = snd_load_al_dll();
+        if(loader == NULL) {
+            mtx_destroy(&g_al.contexts_lock);
+            return SND_ERROR_AL_NOT_PRESENT;
+        }
+        snd_load_al(loader);
+    }
+    snd_load_al_extensions();
+    
+    r = snd_devices_enumerate(&(g_al.devices));
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) {
+        return r;
+    }
 #endif
 
     g_al.playback_device_handles = calloc(g_al.devices.nr_playback_devices, sizeof(ALCdevice*));
 
+    /* the rest is probed on the first device a context is created on, nothing is opened before that */
+    for(int f = SND_FORMAT_PCM_UINT8_MONO; f <= SND_FORMAT_PCM_INT16_STEREO_INTERLEAVED_LR; f++) {
+        g_al.formats_supported[f] = true;
+    }
+
     out_device_list[0] = g_al.devices;
     
     return SND_OK;
 }
 snd_result_t snd_exit(void) {
-    snd_unload_al_dll();
-    
-    for(int i = 0; i < g_al.devices.nr_playback_devices) {
+    for(int i = 0; i < g_al.devices.nr_playback_devices; i++) {
         if(g_al.playback_device_handles[i] != NULL) {
             g_al.c.CloseDevice(g_al.playback_device_handles[i]);
 #ifndef SND_NO_CHECKS
@@ -334,12 +536,156 @@ snd_result_t snd_exit(void) {
 #endif
         }
     }
-    if(g_al.devices.playback_devices != NULL) {
-        free(g_al.devices.playback_devices);
+    for(uint32_t i = 0; i < g_al.nr_orphan_devices; i++) {
+        g_al.c.CloseDevice(g_al.orphan_devices[i]);
+    }
+    free(g_al.orphan_devices);
+    g_al.orphan_devices = NULL;
+    g_al.nr_orphan_devices = 0;
+    free(g_al.playback_device_handles);
+    g_al.playback_device_handles = NULL;
+    snd_device_list_free(&(g_al.devices));
+    g_al.formats_probed = false;
+#ifdef ALC_SOFT_system_events
+    if(g_al.EventCallbackSOFT != NULL) {
+        g_al.EventCallbackSOFT(NULL, NULL);
+        g_al.EventCallbackSOFT = NULL;
+    }
+#endif
+    for(uint32_t i = 0; i < g_al.nr_contexts; i++) {
+        free(g_al.contexts[i].shadows);
+        free(g_al.contexts[i].lead_ins);
+    }
+    free(g_al.contexts);
+    g_al.contexts = NULL;
+    g_al.nr_contexts = g_al.contexts_cap = 0;
+    mtx_destroy(&g_al.contexts_lock);
+    free(g_al.recording_formats);
+    g_al.recording_formats = NULL;
+    g_al.nr_recording_formats = g_al.recording_formats_cap = 0;
+
+    /* last, the device handles above still need the functions */
+    if(g_al.backend == SND_BACKEND_TYPE_SOFTWARE) {
+        snd_soft_exit();
+    } else {
+        snd_unload_al_dll();
+    }
+    return SND_OK;
+}
+
+snd_result_t snd_devices_refresh(snd_device_list_t* out_device_list) {
+    snd_result_t r; snd_device_list_t list; ALCdevice** handles; ALCdevice** new_orphans; int found;
+
+#ifndef SND_NO_CHECKS
+    if(out_device_list == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    memset(&list, 0, sizeof(snd_device_list_t));
+    r = snd_devices_enumerate(&list);
+    if(r != SND_OK) {
+        snd_device_list_free(&list);
+        return r;
+    }
+    handles = calloc(list.nr_playback_devices > 0 ? list.nr_playback_devices : 1, sizeof(ALCdevice*));
+    new_orphans = realloc(g_al.orphan_devices, (g_al.nr_orphan_devices + g_al.devices.nr_playback_devices + 1) * sizeof(ALCdevice*));
+    if(handles == NULL || new_orphans == NULL) {
+        free(handles);
+        if(new_orphans != NULL) {
+            g_al.orphan_devices = new_orphans;
+        }
+        snd_device_list_free(&list);
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    g_al.orphan_devices = new_orphans;
+
+    /* open devices keep their handle under their new id; the ones that are gone stay open for their contexts */
+    for(int i = 0; i < g_al.devices.nr_playback_devices; i++) {
+        if(g_al.playback_device_handles[i] == NULL) {
+            continue;
+        }
+        found = -1;
+        for(int j = 0; j < list.nr_playback_devices; j++) {
+            if(strcmp(g_al.devices.playback_devices[i], list.playback_devices[j]) == 0) {
+                found = j;
+                break;
+            }
+        }
+        if(found >= 0) {
+            handles[found] = g_al.playback_device_handles[i];
+        } else {
+            g_al.orphan_devices[g_al.nr_orphan_devices++] = g_al.playback_device_handles[i];
+        }
+    }
+
+    free(g_al.playback_device_handles);
+    g_al.playback_device_handles = handles;
+    snd_device_list_free(&(g_al.devices));
+    g_al.devices = list;
+
+    out_device_list[0] = g_al.devices;
+    return SND_OK;
+}
+snd_result_t snd_devices_poll(uint32_t* out_event_bits, uint32_t max_disconnected, uint32_t* out_disconnected_ids, uint32_t* out_nr_disconnected) {
+    ALCint connected; uint32_t bits, nr = 0;
+
+#ifndef SND_NO_CHECKS
+    if(out_event_bits == NULL || (max_disconnected > 0 && out_disconnected_ids == NULL)) {
+        return SND_ERROR_INVALID_PARAM;
     }
-    if(g_al.devices.recording_devices != NULL) {
-        free(g_al.devices.recording_devices);
+#endif
+
+    bits = atomic_exchange(&(g_al.device_events), 0);
+    /* ALC_EXT_disconnect; a device without it reports an error here and counts as connected */
+    for(int i = 0; i < g_al.devices.nr_playback_devices; i++) {
+        if(g_al.playback_device_handles[i] == NULL) {
+            continue;
+        }
+        connected = ALC_TRUE;
+        g_al.c.GetIntegerv(g_al.playback_device_handles[i], ALC_CONNECTED, 1, &connected);
+        if(g_al.c.GetError(g_al.playback_device_handles[i]) != ALC_NO_ERROR) {
+            connected = ALC_TRUE;
+        }
+        if(connected == ALC_FALSE) {
+            bits |= SND_DEVICE_EVENT_DISCONNECTED_BIT;
+            if(nr < max_disconnected) {
+                out_disconnected_ids[nr] = (uint32_t) i;
+            }
+            nr++;
+        }
+    }
+
+    out_event_bits[0] = bits;
+    if(out_nr_disconnected != NULL) {
+        out_nr_disconnected[0] = nr;
+    }
+    return SND_OK;
+}
+snd_result_t snd_playback_device_reopen(uint32_t playback_device_id, uint32_t new_playback_device_id) {
+    ALCdevice* dev; ALCboolean b;
+
+#ifndef SND_NO_CHECKS
+    if(playback_device_id >= (uint32_t) g_al.devices.nr_playback_devices || new_playback_device_id >= (uint32_t) g_al.devices.nr_playback_devices) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    dev = g_al.playback_device_handles[playback_device_id];
+    if(dev == NULL || (new_playback_device_id != playback_device_id && g_al.playback_device_handles[new_playback_device_id] != NULL)) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    if(g_al.ReopenDeviceSOFT == NULL) {
+        return SND_ERROR_BACKEND_NOT_SUPPORTED;
     }
+
+    /* the contexts, sources and buffers move along with the device handle */
+    b = g_al.ReopenDeviceSOFT(dev, g_al.devices.playback_devices[new_playback_device_id], NULL);
+    if(b != ALC_TRUE) {
+        g_al.c.GetError(dev);
+        return SND_ERROR_UNKNOWN;
+    }
+    g_al.playback_device_handles[playback_device_id] = NULL;
+    g_al.playback_device_handles[new_playback_device_id] = dev;
     return SND_OK;
 }
 
@@ -393,6 +739,19 @@ snd_result_t snd_recording_device_open(uint32_t recording_device_id, snd_format_
     }
 #endif
 
+    if(g_al.nr_recording_formats == g_al.recording_formats_cap) {
+        void* new_formats = realloc(g_al.recording_formats, (g_al.recording_formats_cap + 8) * sizeof(g_al.recording_formats[0]));
+        if(new_formats == NULL) {
+            g_al.c.CaptureCloseDevice(handle);
+            return SND_ERROR_OUT_OF_MEMORY;
+        }
+        g_al.recording_formats = new_formats;
+        g_al.recording_formats_cap += 8;
+    }
+    g_al.recording_formats[g_al.nr_recording_formats].handle = handle;
+    g_al.recording_formats[g_al.nr_recording_formats].format = format;
+    g_al.nr_recording_formats++;
+
     device[0].handle = handle;
     return SND_OK;
 }
@@ -402,6 +761,12 @@ snd_result_t snd_recording_device_close(snd_recording_device_t device) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
+    for(uint32_t i = 0; i < g_al.nr_recording_formats; i++) {
+        if(g_al.recording_formats[i].handle == (ALCdevice*) device.handle) {
+            g_al.recording_formats[i] = g_al.recording_formats[--g_al.nr_recording_formats];
+            break;
+        }
+    }
     g_al.c.CaptureCloseDevice((ALCdevice*)device.handle);
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
@@ -458,17 +823,81 @@ snd_result_t snd_recording_retrieve_samples_nonblocking(snd_recording_device_t d
     return SND_OK;
 }
 
+/* Context bound with snd_listener_context_bind on this thread, NULL outside of such a scope. While it is set,
+ * snd_context_set is free for this context. thread_bound marks that it was set with alcSetThreadContext,
+ * in which case switching to other contexts has to go through the thread context as well. */
+static thread_local struct {
+    ALCcontext* context;
+    ALCcontext* previous;
+    uint32_t depth;
+    bool thread_bound;
+} snd_bound;
+
+static double snd_seconds_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+static snd_context_info_t* snd_context_info_find(ALCcontext* handle) {
+    for(uint32_t i = 0; i < g_al.nr_contexts; i++) {
+        if(g_al.contexts[i].handle == handle) {
+            return &(g_al.contexts[i]);
+        }
+    }
+    return NULL;
+}
+#ifdef SND_PROFILE
+/* Every snd call on a context enters it through snd_context_set(context, &old) and leaves through
+ * snd_context_set(old, NULL), so the time in between is the time spent in that call. A call returning early on an
+ * error never leaves, so each enter starts a new measurement and drops one left open, unless the outer call set nested
+ * around its own snd call: then that one is counted as part of the outer one. */
+static thread_local struct {
+    ALCcontext* context;
+    double start;
+    uint32_t depth;
+    bool nested;
+} snd_profile;
+#endif
+
 static snd_result_t snd_context_set(ALCcontext* new, ALCcontext** old) {
     ALCcontext* old_con; ALCboolean b;
+#ifdef SND_PROFILE
+    snd_context_info_t* profiled;
+#endif
     
 #ifndef SND_NO_CHECKS
     if(new == NULL) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
+#ifdef SND_PROFILE
+    if(old != NULL && snd_profile.nested && snd_profile.depth > 0) {
+        snd_profile.depth++;
+    } else if(old != NULL) {
+        snd_profile.context = new;
+        snd_profile.start = snd_seconds_now();
+        snd_profile.depth = 1;
+    } else if(snd_profile.depth > 0 && --snd_profile.depth == 0) {
+        mtx_lock(&g_al.contexts_lock);
+        profiled = snd_context_info_find(snd_profile.context);
+        if(profiled != NULL) {
+            atomic_fetch_add_explicit(&(profiled->api_ns), (uint_fast64_t)((snd_seconds_now() - snd_profile.start) * 1e9), memory_order_relaxed);
+            atomic_fetch_add_explicit(&(profiled->nr_api_calls), 1, memory_order_relaxed);
+        }
+        mtx_unlock(&g_al.contexts_lock);
+        snd_profile.context = NULL;
+    }
+#endif
+
+    if(snd_bound.context != NULL && new == snd_bound.context) {
+        /* inside snd_listener_context_bind, nothing to switch or restore */
+        if(old != NULL)
+            old[0] = new;
+        return SND_OK;
+    }
 
     if(old != NULL) {
-        old_con = g_al.c.GetCurrentContext();
+        old_con = snd_bound.thread_bound ? g_al.GetThreadContext() : g_al.c.GetCurrentContext();
 #ifndef SND_NO_CHECKS
         if(g_al.GetError() != AL_NO_ERROR) {
             return SND_ERROR_UNKNOWN;
@@ -480,7 +909,7 @@ static snd_result_t snd_context_set(ALCcontext* new, ALCcontext** old) {
     }
     
     if(old == NULL || new != old_con) {
-        b = g_al.c.MakeContextCurrent(new);
+        b = snd_bound.thread_bound ? g_al.SetThreadContext(new) : g_al.c.MakeContextCurrent(new);
 #ifndef SND_NO_CHECKS
         if(g_al.GetError() != AL_NO_ERROR) {
             return SND_ERROR_UNKNOWN;
@@ -497,8 +926,217 @@ static snd_result_t snd_context_set(ALCcontext* new, ALCcontext** old) {
     return SND_OK;
 }
 
+static snd_result_t snd_context_info_add(ALCcontext* handle, uint32_t mixing_frequency_hz) {
+    snd_context_info_t* new_contexts;
+
+    mtx_lock(&g_al.contexts_lock);
+    if(g_al.nr_contexts == g_al.contexts_cap) {
+        new_contexts = realloc(g_al.contexts, (g_al.contexts_cap + 16) * sizeof(snd_context_info_t));
+        if(new_contexts == NULL) {
+            mtx_unlock(&g_al.contexts_lock);
+            return SND_ERROR_OUT_OF_MEMORY;
+        }
+        g_al.contexts = new_contexts;
+        g_al.contexts_cap += 16;
+    }
+    memset(&(g_al.contexts[g_al.nr_contexts]), 0, sizeof(snd_context_info_t));
+    g_al.contexts[g_al.nr_contexts].handle = handle;
+    g_al.contexts[g_al.nr_contexts].mixing_frequency_hz = mixing_frequency_hz;
+    g_al.nr_contexts++;
+    mtx_unlock(&g_al.contexts_lock);
+
+    return SND_OK;
+}
+static void snd_context_info_remove(ALCcontext* handle) {
+    mtx_lock(&g_al.contexts_lock);
+    for(uint32_t i = 0; i < g_al.nr_contexts; i++) {
+        if(g_al.contexts[i].handle == handle) {
+            free(g_al.contexts[i].shadows);
+            free(g_al.contexts[i].lead_ins);
+            g_al.contexts[i] = g_al.contexts[g_al.nr_contexts-1];
+            g_al.nr_contexts--;
+            break;
+        }
+    }
+    mtx_unlock(&g_al.contexts_lock);
+}
+/* handle has to be the current context, and the result is only valid while g_al.contexts_lock is held */
+static snd_context_info_t* snd_context_info_get(ALCcontext* handle) {
+    snd_context_info_t* info; ALCdevice* dev;
+
+    info = snd_context_info_find(handle);
+    if(info == NULL || info->extensions_checked) {
+        return info;
+    }
+
+    if(g_al.IsExtensionPresent("AL_SOFT_deferred_updates") == AL_TRUE) {
+        info->DeferUpdatesSOFT   = (LPALDEFERUPDATESSOFT)   g_al.GetProcAddress("alDeferUpdatesSOFT");
+        info->ProcessUpdatesSOFT = (LPALPROCESSUPDATESSOFT) g_al.GetProcAddress("alProcessUpdatesSOFT");
+        info->deferred_updates = info->DeferUpdatesSOFT != NULL && info->ProcessUpdatesSOFT != NULL;
+    }
+    if(g_al.IsExtensionPresent("AL_SOFT_source_start_delay") == AL_TRUE) {
+        info->SourcePlayAtTimevSOFT = (LPALSOURCEPLAYATTIMEVSOFT) g_al.GetProcAddress("alSourcePlayAtTimevSOFT");
+    }
+    if(g_al.IsExtensionPresent("AL_SOFT_source_latency") == AL_TRUE) {
+        info->GetSourcedvSOFT = (LPALGETSOURCEDVSOFT) g_al.GetProcAddress("alGetSourcedvSOFT");
+    }
+    dev = g_al.c.GetContextsDevice(handle);
+    if(dev != NULL && g_al.c.IsExtensionPresent(dev, "ALC_SOFT_device_clock") == ALC_TRUE) {
+        info->GetInteger64vSOFT = (LPALCGETINTEGER64VSOFT) g_al.c.GetProcAddress(dev, "alcGetInteger64vSOFT");
+    }
+    info->extensions_checked = true;
+
+    return info;
+}
+static uint32_t snd_source_shadow_slot(uint32_t cap, ALuint id) {
+    /* Fibonacci hashing, ids are mostly small and sequential */
+    return (uint32_t)(id * 2654435769u) & (cap - 1);
+}
+/* returns NULL if the source isn't shadowed yet and create is false, or if growing the table failed */
+static snd_source_shadow_t* snd_source_shadow_get(snd_context_info_t* info, ALuint id, bool create) {
+    snd_source_shadow_t* old_shadows; uint32_t old_cap, slot;
+
+    if(info->shadows != NULL) {
+        slot = snd_source_shadow_slot(info->shadows_cap, id);
+        while(info->shadows[slot].id != 0) {
+            if(info->shadows[slot].id == id) {
+                return &(info->shadows[slot]);
+            }
+            slot = (slot + 1) & (info->shadows_cap - 1);
+        }
+    }
+    if(!create) {
+        return NULL;
+    }
+
+    /* slots are never freed, deleted sources are only invalidated and AL reuses their ids */
+    if(info->shadows == NULL || (info->nr_shadows + 1) * 4 > info->shadows_cap * 3) {
+        old_shadows = info->shadows;
+        old_cap = info->shadows_cap;
+        info->shadows_cap = old_cap == 0 ? SND_INITIAL_SHADOW_CAP : old_cap * 2;
+        info->shadows = calloc(info->shadows_cap, sizeof(snd_source_shadow_t));
+        if(info->shadows == NULL) {
+            info->shadows = old_shadows;
+            info->shadows_cap = old_cap;
+            return NULL;
+        }
+        for(uint32_t i = 0; i < old_cap; i++) {
+            if(old_shadows[i].id != 0) {
+                slot = snd_source_shadow_slot(info->shadows_cap, old_shadows[i].id);
+                while(info->shadows[slot].id != 0) {
+                    slot = (slot + 1) & (info->shadows_cap - 1);
+                }
+                info->shadows[slot] = old_shadows[i];
+            }
+        }
+        free(old_shadows);
+    }
+
+    slot = snd_source_shadow_slot(info->shadows_cap, id);
+    while(info->shadows[slot].id != 0) {
+        slot = (slot + 1) & (info->shadows_cap - 1);
+    }
+    info->shadows[slot].id = id;
+    info->shadows[slot].valid_fields = 0;
+    info->nr_shadows++;
+
+    return &(info->shadows[slot]);
+}
+static void snd_source_shadow_invalidate(ALCcontext* handle, ALuint id) {
+    snd_context_info_t* info; snd_source_shadow_t* shadow;
+
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_get(handle);
+    shadow = info != NULL ? snd_source_shadow_get(info, id, false) : NULL;
+    if(shadow != NULL) {
+        shadow->valid_fields = 0;
+        shadow->last_state = AL_INITIAL;
+        shadow->stop_requested = false;
+        shadow->nr_underruns = 0;
+        shadow->scheduled_ns = 0;
+        shadow->lead_in_seconds = 0.0;
+    }
+    mtx_unlock(&g_al.contexts_lock);
+}
+/* handle has to be the current context */
+static void snd_source_shadow_stop_requested(ALCcontext* handle, uint32_t nr_sources, const snd_source_t* sources, bool stop_requested) {
+    snd_context_info_t* info; snd_source_shadow_t* shadow;
+
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_get(handle);
+    for(uint32_t i = 0; i < nr_sources && info != NULL; i++) {
+        shadow = snd_source_shadow_get(info, sources[i].id, true);
+        if(shadow != NULL) {
+            shadow->stop_requested = stop_requested;
+        }
+    }
+    mtx_unlock(&g_al.contexts_lock);
+}
+/* Lead-ins of snd_sources_play_at without AL_SOFT_source_start_delay. The silence is unqueued once it has played, and
+ * when the source is stopped it gets its static buffer back; entries of sources deleted or rebound meanwhile are
+ * dropped. handle has to be the current context. */
+static void snd_lead_in_collect(snd_context_info_t* info) {
+    ALint processed, type, state; ALuint b; bool done;
+
+    for(uint32_t i = 0; i < info->nr_lead_ins;) {
+        done = true;
+        if(g_al.IsSource(info->lead_ins[i].source) == AL_TRUE) {
+            processed = 0;
+            type = AL_UNDETERMINED;
+            state = AL_INITIAL;
+            g_al.GetSourcei(info->lead_ins[i].source, AL_SOURCE_TYPE, &type);
+            g_al.GetSourcei(info->lead_ins[i].source, AL_SOURCE_STATE, &state);
+            g_al.GetSourcei(info->lead_ins[i].source, AL_BUFFERS_PROCESSED, &processed);
+            if(type == AL_STREAMING && state != AL_PLAYING && state != AL_PAUSED) {
+                /* setting the buffer drops the queue, the source is static again */
+                g_al.Sourcei(info->lead_ins[i].source, AL_BUFFER, (ALint) info->lead_ins[i].content);
+            } else if(type == AL_STREAMING) {
+                done = false;
+                if(info->lead_ins[i].buffer != 0 && processed > 0) {
+                    /* the lead-in is always first in the queue */
+                    g_al.SourceUnqueueBuffers(info->lead_ins[i].source, 1, &b);
+                    g_al.DeleteBuffers(1, &(info->lead_ins[i].buffer));
+                    info->lead_ins[i].buffer = 0;
+                }
+            }
+        }
+        if(done) {
+            if(info->lead_ins[i].buffer != 0) {
+                g_al.DeleteBuffers(1, &(info->lead_ins[i].buffer));
+            }
+            info->lead_ins[i] = info->lead_ins[info->nr_lead_ins - 1];
+            info->nr_lead_ins--;
+        } else {
+            i++;
+        }
+    }
+    g_al.GetError();
+}
+/* detaches and deletes every lead-in, handle has to be the current context */
+static void snd_lead_in_release_all(snd_context_info_t* info) {
+    for(uint32_t i = 0; i < info->nr_lead_ins; i++) {
+        if(g_al.IsSource(info->lead_ins[i].source) == AL_TRUE) {
+            g_al.SourceStopv(1, &(info->lead_ins[i].source));
+            g_al.Sourcei(info->lead_ins[i].source, AL_BUFFER, 0);
+        }
+        if(info->lead_ins[i].buffer != 0) {
+            g_al.DeleteBuffers(1, &(info->lead_ins[i].buffer));
+        }
+    }
+    info->nr_lead_ins = 0;
+    g_al.GetError();
+}
+static int64_t snd_lead_in_find(const snd_context_info_t* info, ALuint source) {
+    for(uint32_t i = 0; i < info->nr_lead_ins; i++) {
+        if(info->lead_ins[i].source == source) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 snd_result_t snd_listener_context_create(uint32_t playback_device_id, uint32_t mixing_frequency_Hz, uint32_t refresh_interval_Hz, bool synchronous, uint32_t requested_min_nr_mono_sources, uint32_t requested_min_nr_stereo_sources, snd_listener_context_t* context) {
-    const ALCchar* str; ALCint attrlist[11]; ALCboolean b; ALCint iv[11];
+    snd_result_t r; const ALCchar* str; ALCint attrlist[11]; ALCboolean b; ALCint iv[11];
     ALCcontext* handle, old_con; ALCdevice* dev;
     
 #ifndef SND_NO_CHECKS
@@ -512,7 +1150,7 @@ snd_result_t snd_listener_context_create(uint32_t playback_device_id, uint32_t m
 #endif
 
     if(g_al.playback_device_handles[playback_device_id] == NULL) {
-        g_al.playback_device_handles[playback_device_id] = g_al.c.OpenDevice(g_al.devices.playback_devices[i]);
+        g_al.playback_device_handles[playback_device_id] = g_al.c.OpenDevice(g_al.devices.playback_devices[playback_device_id]);
 #ifndef SND_NO_CHECKS
         if(g_al.GetError() != AL_NO_ERROR) {
             return SND_ERROR_UNKNOWN;
@@ -523,12 +1161,21 @@ snd_result_t snd_listener_context_create(uint32_t playback_device_id, uint32_t m
         if(g_al.GetError() != AL_NO_ERROR) {
             return SND_ERROR_UNKNOWN;
         }
-        if(str == NULL || strcmp(str, g_al.devices.playback_devices[i]) != 0) {
+        if(str == NULL || strcmp(str, g_al.devices.playback_devices[playback_device_id]) != 0) {
             return SND_ERROR_UNKNOWN;
         }
 #endif
     }
     dev = g_al.playback_device_handles[playback_device_id];
+#ifndef SND_NO_CHECKS
+    if(dev == NULL) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    if(!g_al.formats_probed) {
+        snd_probe_formats(dev);
+        g_al.formats_probed = true;
+    }
 
     attrlist[0] = ALC_FREQUENCY;
     attrlist[1] = mixing_frequency_Hz;
@@ -601,9 +1248,93 @@ snd_result_t snd_listener_context_create(uint32_t playback_device_id, uint32_t m
     }
 #endif
     
+    /* the device is free to mix at another frequency than requested */
+    iv[0] = 0;
+    g_al.c.GetIntegerv(dev, ALC_FREQUENCY, 1, iv);
+    if(g_al.c.GetError(dev) != ALC_NO_ERROR || iv[0] <= 0) {
+        iv[0] = (ALCint) mixing_frequency_Hz;
+    }
+
+    r = snd_context_info_add(handle, (uint32_t) iv[0]);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
     context[0].handle = handle;
     return GFX_OK;
 }
+snd_result_t snd_listener_context_bind(snd_listener_context_t context) {
+    ALCcontext* previous; ALCboolean b;
+    
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    if(snd_bound.context != NULL) {
+        if(snd_bound.context != context.handle) {
+            return SND_ERROR_INVALID_PARAM;
+        }
+        snd_bound.depth++;
+        return SND_OK;
+    }
+    
+    /* with ALC_EXT_thread_local_context, the binding only affects the calling thread */
+    if(g_al.ext.thread_local_context) {
+        previous = g_al.GetThreadContext();
+        b = g_al.SetThreadContext(context.handle);
+    } else {
+        previous = g_al.c.GetCurrentContext();
+        b = g_al.c.MakeContextCurrent(context.handle);
+    }
+#ifndef SND_NO_CHECKS
+    if(g_al.c.GetError(NULL) != ALC_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+    if(b != ALC_TRUE) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    snd_bound.context = context.handle;
+    snd_bound.previous = previous;
+    snd_bound.depth = 1;
+    snd_bound.thread_bound = g_al.ext.thread_local_context;
+    return SND_OK;
+}
+snd_result_t snd_listener_context_unbind(void) {
+    ALCboolean b;
+    
+#ifndef SND_NO_CHECKS
+    if(snd_bound.context == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    if(--snd_bound.depth > 0) {
+        return SND_OK;
+    }
+    
+    /* the thread context may be restored to NULL, which falls back to the process wide one */
+    if(snd_bound.thread_bound) {
+        b = g_al.SetThreadContext(snd_bound.previous);
+    } else if(snd_bound.previous != NULL) {
+        b = g_al.c.MakeContextCurrent(snd_bound.previous);
+    } else {
+        b = ALC_TRUE;
+    }
+    snd_bound.context = NULL;
+    snd_bound.previous = NULL;
+    snd_bound.thread_bound = false;
+#ifndef SND_NO_CHECKS
+    if(g_al.c.GetError(NULL) != ALC_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+    if(b != ALC_TRUE) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    return SND_OK;
+}
 snd_result_t snd_listener_context_params_get(snd_listener_context_t context, snd_listener_context_params_t* out_params) {
     snd_result_t r; ALCcontext* old_con; snd_listener_context_params_t params;
     ALfloat fv[6]; ALint i;
@@ -866,12 +1597,38 @@ snd_result_t snd_listener_context_suspend(snd_listener_context_t context) {
     return SND_OK;
 }
 snd_result_t snd_listener_context_destroy(snd_listener_context_t context) {
-    ALCboolean b;
+    snd_result_t r; ALCboolean b; ALCcontext* old_con; snd_context_info_t* info;
 #ifndef SND_NO_CHECKS
     if(context.handle == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
+    if(snd_bound.context == context.handle) {
+        /* snd_context_set would keep using the destroyed context for this thread */
+        return SND_ERROR_INVALID_PARAM;
+    }
+
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_find(context.handle);
+    if(info != NULL && info->nr_lead_ins > 0) {
+        /* buffers belong to the device, the lead-ins would outlive the context */
+        r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+        if(r != SND_OK) {
+            mtx_unlock(&g_al.contexts_lock);
+            return r;
+        }
+#endif
+        snd_lead_in_release_all(info);
+        r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+        if(r != SND_OK) {
+            mtx_unlock(&g_al.contexts_lock);
+            return r;
+        }
+#endif
+    }
+    mtx_unlock(&g_al.contexts_lock);
 
     if(g_al.c.GetCurrentContext() == context.handle) {
         b = g_al.c.MakeContextCurrent(NULL);
@@ -891,98 +1648,4003 @@ snd_result_t snd_listener_context_destroy(snd_listener_context_t context) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
+    snd_context_info_remove(context.handle);
 
     return SND_OK;
 }
 
-snd_result_t snd_buffer_alloc(snd_listener_context_t context, snd_format_t format, uint32_t frequency_hz, void* data, size_t size, snd_buffer_t* buffer) {
-    ALuint id;
-    ALenum al_format;
-    ALint bits, channels, i;
-    snd_result_t r; ALCcontext* old_con;
+snd_result_t snd_listener_context_stats_get(snd_listener_context_t context, uint32_t nr_sources, const snd_source_t* sources, snd_source_stats_t* out_source_stats, snd_listener_context_stats_t* out_stats) {
+    snd_result_t r; ALCcontext* old_con; snd_context_info_t* info; ALCdevice* dev; snd_source_shadow_t* shadow;
+    ALCint64SOFT clock[2]; ALCint refresh; ALint queued, processed, state, type; ALdouble offset[2];
+    snd_source_stats_t s;
 
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL || buffer == NULL || data == NULL) {
+    if(context.handle == NULL || out_stats == NULL || (nr_sources > 0 && sources == NULL)) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    switch(format) {
-    case SND_FORMAT_PCM_UINT8_MONO:
-        al_format = AL_FORMAT_MOMO8;
-        bits = 8; channels = 1;
+
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    memset(out_stats, 0, sizeof(snd_listener_context_stats_t));
+    out_stats->device_latency_ns = -1;
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_get(context.handle);
+    dev = g_al.c.GetContextsDevice(context.handle);
+
+    if(info != NULL && info->GetInteger64vSOFT != NULL) {
+        info->GetInteger64vSOFT(dev, ALC_DEVICE_CLOCK_LATENCY_SOFT, 2, clock);
+        if(g_al.c.GetError(dev) == ALC_NO_ERROR) {
+            out_stats->device_clock_available = true;
+            out_stats->device_clock_ns = (uint64_t) clock[0];
+            out_stats->device_latency_ns = clock[1];
+        }
+    }
+    refresh = 0;
+    g_al.c.GetIntegerv(dev, ALC_REFRESH, 1, &refresh);
+    out_stats->refresh_interval_hz = g_al.c.GetError(dev) == ALC_NO_ERROR && refresh > 0 ? (uint32_t) refresh : 0;
+    out_stats->mixing_frequency_hz = info != NULL ? info->mixing_frequency_hz : 0;
+
+    for(uint32_t i = 0; i < nr_sources; i++) {
+        queued = processed = 0;
+        state = AL_INITIAL;
+        type = AL_UNDETERMINED;
+        g_al.GetSourcei(sources[i].id, AL_BUFFERS_QUEUED, &queued);
+        g_al.GetSourcei(sources[i].id, AL_BUFFERS_PROCESSED, &processed);
+        g_al.GetSourcei(sources[i].id, AL_SOURCE_STATE, &state);
+        g_al.GetSourcei(sources[i].id, AL_SOURCE_TYPE, &type);
+
+        memset(&s, 0, sizeof(snd_source_stats_t));
+        s.playing = state == AL_PLAYING;
+        s.nr_buffers_queued = (uint32_t) queued;
+        s.nr_buffers_processed = (uint32_t) processed;
+        s.latency_seconds = -1.0;
+        if(info != NULL && info->GetSourcedvSOFT != NULL) {
+            info->GetSourcedvSOFT(sources[i].id, AL_SEC_OFFSET_LATENCY_SOFT, offset);
+            s.latency_seconds = offset[1];
+        }
+
+        /* a streaming source that stopped by itself with everything played ran dry; this only sees what changed
+         * since the last call, so it has to be called at least once per queue length */
+        shadow = info != NULL ? snd_source_shadow_get(info, sources[i].id, true) : NULL;
+        if(shadow != NULL) {
+            if(shadow->last_state == AL_PLAYING && state == AL_STOPPED && type == AL_STREAMING && !shadow->stop_requested && processed == queued) {
+                shadow->nr_underruns++;
+            }
+            shadow->last_state = state;
+            s.nr_underruns = shadow->nr_underruns;
+        }
+
+        out_stats->nr_buffers_queued += s.nr_buffers_queued;
+        out_stats->nr_buffers_processed += s.nr_buffers_processed;
+        out_stats->nr_underruns += s.nr_underruns;
+        if(out_source_stats != NULL) {
+            out_source_stats[i] = s;
+        }
+    }
+    if(info != NULL) {
+        out_stats->api_seconds_last_frame = info->api_seconds_last_frame;
+        out_stats->api_seconds_max_frame = info->api_seconds_max_frame;
+        out_stats->nr_api_calls_last_frame = info->nr_api_calls_last_frame;
+    }
+    mtx_unlock(&g_al.contexts_lock);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    return SND_OK;
+}
+snd_result_t snd_listener_context_frame_end(snd_listener_context_t context) {
+    snd_context_info_t* info;
+
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_find(context.handle);
+    if(info == NULL) {
+        mtx_unlock(&g_al.contexts_lock);
+        return SND_ERROR_INVALID_PARAM;
+    }
+    info->api_seconds_last_frame = (double) atomic_exchange_explicit(&(info->api_ns), 0, memory_order_relaxed) * 1e-9;
+    info->nr_api_calls_last_frame = atomic_exchange_explicit(&(info->nr_api_calls), 0, memory_order_relaxed);
+    if(info->api_seconds_last_frame > info->api_seconds_max_frame) {
+        info->api_seconds_max_frame = info->api_seconds_last_frame;
+    }
+    mtx_unlock(&g_al.contexts_lock);
+    return SND_OK;
+}
+
+static const struct {
+    ALenum al_format;
+    uint32_t channels, bytes_per_sample;
+    /* what gets uploaded instead if al_format isn't supported */
+    snd_format_t fallback;
+} snd_formats[SND_FORMAT_COUNT] = {
+    [SND_FORMAT_PCM_UINT8_MONO]                      = { AL_FORMAT_MONO8,          1, 1, SND_FORMAT_PCM_UINT8_MONO },
+    [SND_FORMAT_PCM_INT16_MONO]                      = { AL_FORMAT_MONO16,         1, 2, SND_FORMAT_PCM_INT16_MONO },
+    [SND_FORMAT_PCM_UINT8_STEREO_INTERLEAVED_LR]     = { AL_FORMAT_STEREO8,        2, 1, SND_FORMAT_PCM_UINT8_STEREO_INTERLEAVED_LR },
+    [SND_FORMAT_PCM_INT16_STEREO_INTERLEAVED_LR]     = { AL_FORMAT_STEREO16,       2, 2, SND_FORMAT_PCM_INT16_STEREO_INTERLEAVED_LR },
+    [SND_FORMAT_PCM_FLOAT32_MONO]                    = { AL_FORMAT_MONO_FLOAT32,   1, 4, SND_FORMAT_PCM_INT16_MONO },
+    [SND_FORMAT_PCM_FLOAT32_STEREO_INTERLEAVED_LR]   = { AL_FORMAT_STEREO_FLOAT32, 2, 4, SND_FORMAT_PCM_INT16_STEREO_INTERLEAVED_LR },
+    [SND_FORMAT_PCM_INT16_QUAD_INTERLEAVED]          = { AL_FORMAT_QUAD16,         4, 2, SND_FORMAT_PCM_INT16_STEREO_INTERLEAVED_LR },
+    [SND_FORMAT_PCM_INT16_5_1_INTERLEAVED]           = { AL_FORMAT_51CHN16,        6, 2, SND_FORMAT_PCM_INT16_STEREO_INTERLEAVED_LR },
+    [SND_FORMAT_PCM_INT16_7_1_INTERLEAVED]           = { AL_FORMAT_71CHN16,        8, 2, SND_FORMAT_PCM_INT16_STEREO_INTERLEAVED_LR },
+    [SND_FORMAT_PCM_FLOAT32_QUAD_INTERLEAVED]        = { AL_FORMAT_QUAD32,         4, 4, SND_FORMAT_PCM_FLOAT32_STEREO_INTERLEAVED_LR },
+    [SND_FORMAT_PCM_FLOAT32_5_1_INTERLEAVED]         = { AL_FORMAT_51CHN32,        6, 4, SND_FORMAT_PCM_FLOAT32_STEREO_INTERLEAVED_LR },
+    [SND_FORMAT_PCM_FLOAT32_7_1_INTERLEAVED]         = { AL_FORMAT_71CHN32,        8, 4, SND_FORMAT_PCM_FLOAT32_STEREO_INTERLEAVED_LR },
+};
+/* stereo downmix weights per input channel (AL channel order: FL FR FC LFE BL BR SL SR, quad is FL FR BL BR),
+ * scaled so a full scale signal on every channel can't clip; the LFE is dropped */
+#define SND_DOWNMIX_C 0.70710678f
+static const float snd_downmix_quad[4][2] = {
+    { 1.0f/(1.0f+SND_DOWNMIX_C), 0.0f }, { 0.0f, 1.0f/(1.0f+SND_DOWNMIX_C) },
+    { SND_DOWNMIX_C/(1.0f+SND_DOWNMIX_C), 0.0f }, { 0.0f, SND_DOWNMIX_C/(1.0f+SND_DOWNMIX_C) },
+};
+static const float snd_downmix_5_1[6][2] = {
+    { 1.0f/(1.0f+2*SND_DOWNMIX_C), 0.0f }, { 0.0f, 1.0f/(1.0f+2*SND_DOWNMIX_C) },
+    { SND_DOWNMIX_C/(1.0f+2*SND_DOWNMIX_C), SND_DOWNMIX_C/(1.0f+2*SND_DOWNMIX_C) }, { 0.0f, 0.0f },
+    { SND_DOWNMIX_C/(1.0f+2*SND_DOWNMIX_C), 0.0f }, { 0.0f, SND_DOWNMIX_C/(1.0f+2*SND_DOWNMIX_C) },
+};
+static const float snd_downmix_7_1[8][2] = {
+    { 1.0f/(1.0f+3*SND_DOWNMIX_C), 0.0f }, { 0.0f, 1.0f/(1.0f+3*SND_DOWNMIX_C) },
+    { SND_DOWNMIX_C/(1.0f+3*SND_DOWNMIX_C), SND_DOWNMIX_C/(1.0f+3*SND_DOWNMIX_C) }, { 0.0f, 0.0f },
+    { SND_DOWNMIX_C/(1.0f+3*SND_DOWNMIX_C), 0.0f }, { 0.0f, SND_DOWNMIX_C/(1.0f+3*SND_DOWNMIX_C) },
+    { SND_DOWNMIX_C/(1.0f+3*SND_DOWNMIX_C), 0.0f }, { 0.0f, SND_DOWNMIX_C/(1.0f+3*SND_DOWNMIX_C) },
+};
+
+static snd_result_t snd_format_info(snd_format_t format, ALenum* al_format, uint32_t* frame_size) {
+    if((uint32_t) format >= SND_FORMAT_COUNT) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    al_format[0] = snd_formats[format].al_format;
+    frame_size[0] = snd_formats[format].channels * snd_formats[format].bytes_per_sample;
+    return SND_OK;
+}
+/* follows the fallback chain until a format the implementation takes (the U8/I16 mono/stereo ones always are) */
+static snd_format_t snd_format_upload_format(snd_format_t format) {
+    while(!g_al.formats_supported[format]) {
+        format = snd_formats[format].fallback;
+    }
+    return format;
+}
+/* Plain loops over restrict pointers without any calls or branches inside, so the compiler vectorizes them
+ * for whatever SIMD the target has. */
+static void snd_convert_float32_to_int16(size_t nr_samples, const float* restrict in, int16_t* restrict out) {
+    float f;
+    for(size_t i = 0; i < nr_samples; i++) {
+        f = in[i] * 32767.0f;
+        f = f < -32768.0f ? -32768.0f : (f > 32767.0f ? 32767.0f : f);
+        out[i] = (int16_t) f;
+    }
+}
+static void snd_convert_int16_to_float32(size_t nr_samples, const int16_t* restrict in, float* restrict out) {
+    for(size_t i = 0; i < nr_samples; i++) {
+        out[i] = (float) in[i] * (1.0f / 32768.0f);
+    }
+}
+static void snd_downmix_stereo(size_t nr_frames, uint32_t channels, const float (*weights)[2], const float* restrict in, float* restrict out) {
+    float l, r;
+    for(size_t i = 0; i < nr_frames; i++) {
+        l = 0.0f; r = 0.0f;
+        for(uint32_t c = 0; c < channels; c++) {
+            l += in[i*channels + c] * weights[c][0];
+            r += in[i*channels + c] * weights[c][1];
+        }
+        out[2*i] = l;
+        out[2*i + 1] = r;
+    }
+}
+/* uploads data to the buffer, converting it first if the format isn't supported by the implementation */
+static snd_result_t snd_buffer_data(ALuint id, snd_format_t format, const void* data, size_t size, uint32_t frequency_hz, snd_format_t* out_uploaded_format) {
+    snd_format_t upload; uint32_t channels; size_t nr_frames, nr_samples;
+    float* tmp = NULL; void* converted = NULL; const float* mixed;
+
+    upload = snd_format_upload_format(format);
+    out_uploaded_format[0] = upload;
+    if(upload == format) {
+        g_al.BufferData(id, snd_formats[format].al_format, data, size, frequency_hz);
+        return SND_OK;
+    }
+
+    channels = snd_formats[format].channels;
+    nr_frames = size / (channels * snd_formats[format].bytes_per_sample);
+    nr_samples = nr_frames * channels;
+
+    /* the multichannel fallbacks work in float, int16 input is widened first */
+    mixed = data;
+    if(channels != snd_formats[upload].channels) {
+        tmp = malloc(nr_samples * sizeof(float) + nr_frames * 2 * sizeof(float));
+        if(tmp == NULL) {
+            return SND_ERROR_OUT_OF_MEMORY;
+        }
+        if(snd_formats[format].bytes_per_sample == 2) {
+            snd_convert_int16_to_float32(nr_samples, data, tmp);
+            mixed = tmp;
+        }
+        snd_downmix_stereo(nr_frames, channels, channels == 4 ? snd_downmix_quad : (channels == 6 ? snd_downmix_5_1 : snd_downmix_7_1), mixed, tmp + nr_samples);
+        mixed = tmp + nr_samples;
+        nr_samples = nr_frames * 2;
+    }
+
+    if(snd_formats[upload].bytes_per_sample == 2) {
+        converted = malloc(nr_samples * sizeof(int16_t));
+        if(converted == NULL) {
+            free(tmp);
+            return SND_ERROR_OUT_OF_MEMORY;
+        }
+        snd_convert_float32_to_int16(nr_samples, mixed, converted);
+        g_al.BufferData(id, snd_formats[upload].al_format, converted, nr_samples * sizeof(int16_t), frequency_hz);
+    } else {
+        g_al.BufferData(id, snd_formats[upload].al_format, mixed, nr_samples * sizeof(float), frequency_hz);
+    }
+
+    free(converted);
+    free(tmp);
+    return SND_OK;
+}
+/* Windowed-sinc resampler for converting buffers to the mixing frequency on upload. The kernel is tabulated for
+ * phases+1 fractional positions and interpolated linearly in between, so any ratio works with one table. */
+static const struct {
+    uint32_t half_taps, phases;
+    /* Kaiser window shape, and where the passband ends relative to the lower Nyquist frequency */
+    float beta, rolloff;
+} snd_resample_tiers[] = {
+    [SND_RESAMPLE_QUALITY_FAST]   = {  4,   64,  5.0f, 0.85f },
+    [SND_RESAMPLE_QUALITY_MEDIUM] = {  8,  256,  7.0f, 0.90f },
+    [SND_RESAMPLE_QUALITY_BEST]   = { 24, 1024, 10.0f, 0.95f },
+};
+static double snd_bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for(int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+static void snd_convert_uint8_to_float32(size_t nr_samples, const uint8_t* restrict in, float* restrict out) {
+    for(size_t i = 0; i < nr_samples; i++) {
+        out[i] = ((float) in[i] - 128.0f) * (1.0f / 128.0f);
+    }
+}
+/* the float format with the same channel layout */
+static snd_format_t snd_format_float32_equivalent(snd_format_t format) {
+    switch(snd_formats[format].channels) {
+    case 1: return SND_FORMAT_PCM_FLOAT32_MONO;
+    case 2: return SND_FORMAT_PCM_FLOAT32_STEREO_INTERLEAVED_LR;
+    case 4: return SND_FORMAT_PCM_FLOAT32_QUAD_INTERLEAVED;
+    case 6: return SND_FORMAT_PCM_FLOAT32_5_1_INTERLEAVED;
+    default: return SND_FORMAT_PCM_FLOAT32_7_1_INTERLEAVED;
+    }
+}
+static void snd_resample_channel(size_t nr_out, const float* restrict padded, uint32_t in_hz, uint32_t out_hz, const float* restrict kernel, uint32_t taps, uint32_t phases, float* restrict out, uint32_t out_stride) {
+    const float* x; const float* a; const float* b; uint64_t num; size_t idx; float frac, f, acc; uint32_t p;
+
+    for(size_t k = 0; k < nr_out; k++) {
+        /* exact in integers, so long buffers don't drift */
+        num = (uint64_t) k * in_hz;
+        idx = (size_t)(num / out_hz);
+        frac = (float)(num % out_hz) / (float) out_hz * (float) phases;
+        p = (uint32_t) frac;
+        f = frac - (float) p;
+        a = kernel + (size_t) p * taps;
+        b = a + taps;
+        x = padded + idx + 1;
+        acc = 0.0f;
+        for(uint32_t j = 0; j < taps; j++) {
+            acc += x[j] * (a[j] + f * (b[j] - a[j]));
+        }
+        out[k * out_stride] = acc;
+    }
+}
+/* returns interleaved float samples at out_hz in *out_samples, to be freed by the caller */
+static snd_result_t snd_resample(snd_resample_quality_t quality, snd_format_t format, const void* data, size_t size, uint32_t in_hz, uint32_t out_hz, float** out_samples, size_t* out_nr_frames) {
+    uint32_t channels = snd_formats[format].channels, half = snd_resample_tiers[quality].half_taps, taps = 2 * half;
+    uint32_t phases = snd_resample_tiers[quality].phases;
+    size_t nr_frames = size / (channels * snd_formats[format].bytes_per_sample), nr_out;
+    float* samples; float* kernel; float* padded; float* out; double cutoff, t, w, s;
+
+    nr_out = (size_t)(((uint64_t) nr_frames * out_hz + in_hz - 1) / in_hz);
+    samples = malloc(nr_frames * channels * sizeof(float));
+    kernel = malloc((size_t)(phases + 1) * taps * sizeof(float));
+    padded = calloc(nr_frames + taps + 1, sizeof(float));
+    out = malloc((nr_out > 0 ? nr_out : 1) * channels * sizeof(float));
+    if(samples == NULL || kernel == NULL || padded == NULL || out == NULL) {
+        free(samples); free(kernel); free(padded); free(out);
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+
+    switch(snd_formats[format].bytes_per_sample) {
+    case 1:
+        snd_convert_uint8_to_float32(nr_frames * channels, data, samples);
         break;
-    case SND_FORMAT_PCM_INT16_MONO:
-        al_format = AL_FORMAT_MOMO16;
-        if(size%2 != 0) {
-            return SND_ERROR_INVALID_PARAM;
+    case 2:
+        snd_convert_int16_to_float32(nr_frames * channels, data, samples);
+        break;
+    default:
+        memcpy(samples, data, nr_frames * channels * sizeof(float));
+        break;
+    }
+
+    /* going down the cutoff has to follow the output's Nyquist frequency */
+    cutoff = snd_resample_tiers[quality].rolloff * (out_hz < in_hz ? (double) out_hz / in_hz : 1.0);
+    for(uint32_t p = 0; p <= phases; p++) {
+        for(uint32_t j = 0; j < taps; j++) {
+            /* distance of tap j from the output position, in input samples */
+            t = (double) j - (double)(half - 1) - (double) p / phases;
+            w = fabs(t) < half ? snd_bessel_i0(snd_resample_tiers[quality].beta * sqrt(1.0 - (t / half) * (t / half))) / snd_bessel_i0(snd_resample_tiers[quality].beta) : 0.0;
+            s = t == 0.0 ? 1.0 : sin(3.14159265358979 * cutoff * t) / (3.14159265358979 * cutoff * t);
+            kernel[(size_t) p * taps + j] = (float)(cutoff * s * w);
+        }
+    }
+
+    /* one channel at a time so the taps read contiguous memory */
+    for(uint32_t c = 0; c < channels; c++) {
+        for(size_t i = 0; i < nr_frames; i++) {
+            padded[half + i] = samples[i * channels + c];
+        }
+        snd_resample_channel(nr_out, padded, in_hz, out_hz, kernel, taps, phases, out + c, channels);
+    }
+
+    free(samples);
+    free(kernel);
+    free(padded);
+    out_samples[0] = out;
+    out_nr_frames[0] = nr_out;
+    return SND_OK;
+}
+/* AL extensions need a current context, so this runs once on a temporary context of the first device used */
+static snd_result_t snd_probe_formats(ALCdevice* dev) {
+    ALCcontext* handle; ALCcontext* old_con; bool float32, mcformats;
+
+    handle = g_al.c.CreateContext(dev, NULL);
+    if(handle == NULL) {
+        return SND_OK;
+    }
+    old_con = g_al.c.GetCurrentContext();
+    if(g_al.c.MakeContextCurrent(handle) != ALC_TRUE) {
+        g_al.c.DestroyContext(handle);
+        return SND_OK;
+    }
+
+    float32 = g_al.IsExtensionPresent("AL_EXT_float32") == AL_TRUE;
+    mcformats = g_al.IsExtensionPresent("AL_EXT_MCFORMATS") == AL_TRUE;
+    g_al.formats_supported[SND_FORMAT_PCM_FLOAT32_MONO] = float32;
+    g_al.formats_supported[SND_FORMAT_PCM_FLOAT32_STEREO_INTERLEAVED_LR] = float32;
+    g_al.formats_supported[SND_FORMAT_PCM_INT16_QUAD_INTERLEAVED] = mcformats;
+    g_al.formats_supported[SND_FORMAT_PCM_INT16_5_1_INTERLEAVED] = mcformats;
+    g_al.formats_supported[SND_FORMAT_PCM_INT16_7_1_INTERLEAVED] = mcformats;
+    /* the 32 bit multichannel formats are float and need both */
+    g_al.formats_supported[SND_FORMAT_PCM_FLOAT32_QUAD_INTERLEAVED] = float32 && mcformats;
+    g_al.formats_supported[SND_FORMAT_PCM_FLOAT32_5_1_INTERLEAVED] = float32 && mcformats;
+    g_al.formats_supported[SND_FORMAT_PCM_FLOAT32_7_1_INTERLEAVED] = float32 && mcformats;
+
+    g_al.c.MakeContextCurrent(old_con);
+    g_al.c.DestroyContext(handle);
+#ifndef SND_NO_CHECKS
+    if(g_al.c.GetError(dev) != ALC_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    return SND_OK;
+}
+snd_result_t snd_format_supported(snd_format_t format, bool* out_native) {
+#ifndef SND_NO_CHECKS
+    if(out_native == NULL || (uint32_t) format >= SND_FORMAT_COUNT) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    out_native[0] = g_al.formats_supported[format];
+    return SND_OK;
+}
+/* AL 1.1 spec, chapter 3.4 */
+static float snd_distance_gain(ALenum model, float distance, float ref, float max, float rolloff) {
+    float g;
+
+    switch(model) {
+    case AL_INVERSE_DISTANCE_CLAMPED:
+        distance = distance < ref ? ref : (distance > max ? max : distance);
+        /* fallthrough */
+    case AL_INVERSE_DISTANCE:
+        g = ref + rolloff * (distance - ref);
+        return g > 0.0f ? ref / g : 1.0f;
+    case AL_LINEAR_DISTANCE_CLAMPED:
+        distance = distance < ref ? ref : distance;
+        /* fallthrough */
+    case AL_LINEAR_DISTANCE:
+        distance = distance > max ? max : distance;
+        g = max > ref ? 1.0f - rolloff * (distance - ref) / (max - ref) : 1.0f;
+        return g < 0.0f ? 0.0f : g;
+    case AL_EXPONENT_DISTANCE_CLAMPED:
+        distance = distance < ref ? ref : (distance > max ? max : distance);
+        /* fallthrough */
+    case AL_EXPONENT_DISTANCE:
+        return distance > 0.0f && ref > 0.0f ? powf(distance / ref, -rolloff) : 1.0f;
+    default:
+        return 1.0f;
+    }
+}
+
+
+/* DSP nodes of the software backend. They work in place on blocks of SND_DSP_BLOCK_FRAMES interleaved stereo
+ * frames, the inner loops stay free of calls and branches over restrict pointers so the compiler vectorizes them. */
+#define SND_DSP_BLOCK_FRAMES 256
+#define SND_DSP_FFT_SIZE (2 * SND_DSP_BLOCK_FRAMES)
+#define SND_DSP_MAX_CHAIN 8
+/* a source's chain keeps running this long at most after the source stopped, for feedback close to 1 */
+#define SND_DSP_MAX_TAIL_SECONDS 10
+
+/* twiddles and bit reversal for the radix 2 FFT of SND_DSP_FFT_SIZE points */
+typedef struct snd_dsp_fft_t {
+    float cos_table[SND_DSP_FFT_SIZE / 2], sin_table[SND_DSP_FFT_SIZE / 2];
+    uint16_t bit_reverse[SND_DSP_FFT_SIZE];
+} snd_dsp_fft_t;
+typedef struct snd_dsp_node_state_t {
+    snd_dsp_node_params_t params;
+    /* sources and the master chain it's attached to */
+    uint32_t nr_users;
+    uint64_t nr_blocks;
+    double seconds_total;
+    union {
+        struct { float b0, b1, b2, a1, a2; float z1[2], z2[2]; } biquad;
+        struct { float* line; uint32_t capacity, length, pos; } delay;
+        struct {
+            /* uniformly partitioned overlap-save, the spectra of IR partitions and past input blocks are stored
+             * split into real and imaginary arrays; left and right are packed into one complex signal */
+            uint32_t nr_partitions, fdl_pos;
+            float* ir_re; float* ir_im;
+            float* fdl_re; float* fdl_im;
+            float input[2 * SND_DSP_BLOCK_FRAMES * 2];
+            snd_dsp_fft_t fft;
+        } convolution;
+        struct { float envelope, threshold, release; } limiter;
+    };
+} snd_dsp_node_state_t;
+
+static void snd_dsp_biquad_coefficients(snd_dsp_node_state_t* node, float frequency_hz) {
+    /* Robert Bristow-Johnson's audio EQ cookbook */
+    float w0, cw, alpha, a, b0, b1, b2, a0, a1, a2, sq;
+    const snd_dsp_node_params_t* p = &(node->params);
+
+    w0 = 2.0f * 3.14159265f * p->biquad.frequency_hz / frequency_hz;
+    cw = cosf(w0);
+    alpha = sinf(w0) / (2.0f * (p->biquad.q > 0.0f ? p->biquad.q : 0.70710678f));
+    a = powf(10.0f, p->biquad.gain_db / 40.0f);
+    sq = 2.0f * sqrtf(a) * alpha;
+
+    switch(p->biquad.type) {
+    case SND_BIQUAD_TYPE_HIGHPASS:
+        b0 = (1.0f + cw) / 2.0f; b1 = -(1.0f + cw); b2 = b0;
+        a0 = 1.0f + alpha; a1 = -2.0f * cw; a2 = 1.0f - alpha;
+        break;
+    case SND_BIQUAD_TYPE_BANDPASS:
+        b0 = alpha; b1 = 0.0f; b2 = -alpha;
+        a0 = 1.0f + alpha; a1 = -2.0f * cw; a2 = 1.0f - alpha;
+        break;
+    case SND_BIQUAD_TYPE_PEAKING:
+        b0 = 1.0f + alpha * a; b1 = -2.0f * cw; b2 = 1.0f - alpha * a;
+        a0 = 1.0f + alpha / a; a1 = -2.0f * cw; a2 = 1.0f - alpha / a;
+        break;
+    case SND_BIQUAD_TYPE_LOW_SHELF:
+        b0 = a * ((a + 1.0f) - (a - 1.0f) * cw + sq); b1 = 2.0f * a * ((a - 1.0f) - (a + 1.0f) * cw); b2 = a * ((a + 1.0f) - (a - 1.0f) * cw - sq);
+        a0 = (a + 1.0f) + (a - 1.0f) * cw + sq; a1 = -2.0f * ((a - 1.0f) + (a + 1.0f) * cw); a2 = (a + 1.0f) + (a - 1.0f) * cw - sq;
+        break;
+    case SND_BIQUAD_TYPE_HIGH_SHELF:
+        b0 = a * ((a + 1.0f) + (a - 1.0f) * cw + sq); b1 = -2.0f * a * ((a - 1.0f) + (a + 1.0f) * cw); b2 = a * ((a + 1.0f) + (a - 1.0f) * cw - sq);
+        a0 = (a + 1.0f) - (a - 1.0f) * cw + sq; a1 = 2.0f * ((a - 1.0f) - (a + 1.0f) * cw); a2 = (a + 1.0f) - (a - 1.0f) * cw - sq;
+        break;
+    case SND_BIQUAD_TYPE_LOWPASS:
+    default:
+        b0 = (1.0f - cw) / 2.0f; b1 = 1.0f - cw; b2 = b0;
+        a0 = 1.0f + alpha; a1 = -2.0f * cw; a2 = 1.0f - alpha;
+        break;
+    }
+    node->biquad.b0 = b0 / a0;
+    node->biquad.b1 = b1 / a0;
+    node->biquad.b2 = b2 / a0;
+    node->biquad.a1 = a1 / a0;
+    node->biquad.a2 = a2 / a0;
+}
+static void snd_dsp_biquad_process(snd_dsp_node_state_t* node, float* restrict block) {
+    /* transposed direct form II, both channels in one pass so the two recursions overlap */
+    float b0 = node->biquad.b0, b1 = node->biquad.b1, b2 = node->biquad.b2, a1 = node->biquad.a1, a2 = node->biquad.a2;
+    float z1l = node->biquad.z1[0], z2l = node->biquad.z2[0], z1r = node->biquad.z1[1], z2r = node->biquad.z2[1];
+    float xl, xr, yl, yr;
+
+    for(uint32_t i = 0; i < SND_DSP_BLOCK_FRAMES; i++) {
+        xl = block[2*i];
+        xr = block[2*i + 1];
+        yl = b0 * xl + z1l;
+        yr = b0 * xr + z1r;
+        z1l = b1 * xl - a1 * yl + z2l;
+        z1r = b1 * xr - a1 * yr + z2r;
+        z2l = b2 * xl - a2 * yl;
+        z2r = b2 * xr - a2 * yr;
+        block[2*i] = yl;
+        block[2*i + 1] = yr;
+    }
+    node->biquad.z1[0] = z1l; node->biquad.z2[0] = z2l;
+    node->biquad.z1[1] = z1r; node->biquad.z2[1] = z2r;
+}
+static void snd_dsp_delay_process(snd_dsp_node_state_t* node, float* restrict block) {
+    float* restrict line = node->delay.line; float d, fb = node->params.delay.feedback, wet = node->params.delay.wet, dry = node->params.delay.dry;
+    uint32_t pos = node->delay.pos, length = node->delay.length;
+
+    for(uint32_t i = 0; i < 2 * SND_DSP_BLOCK_FRAMES; i++) {
+        d = line[pos];
+        line[pos] = block[i] + fb * d;
+        block[i] = dry * block[i] + wet * d;
+        pos = pos + 1 == length ? 0 : pos + 1;
+    }
+    node->delay.pos = pos;
+}
+static void snd_dsp_fft_init(snd_dsp_fft_t* fft) {
+    uint32_t bits = 0, rev;
+
+    for(uint32_t n = SND_DSP_FFT_SIZE; n > 1; n /= 2) {
+        bits++;
+    }
+    for(uint32_t i = 0; i < SND_DSP_FFT_SIZE; i++) {
+        rev = 0;
+        for(uint32_t b = 0; b < bits; b++) {
+            rev |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        fft->bit_reverse[i] = (uint16_t) rev;
+    }
+    for(uint32_t k = 0; k < SND_DSP_FFT_SIZE / 2; k++) {
+        fft->cos_table[k] = cosf(2.0f * 3.14159265f * k / SND_DSP_FFT_SIZE);
+        fft->sin_table[k] = sinf(2.0f * 3.14159265f * k / SND_DSP_FFT_SIZE);
+    }
+}
+static void snd_dsp_fft(const snd_dsp_fft_t* fft, float* restrict re, float* restrict im, bool inverse) {
+    /* iterative radix 2, the inverse is left unscaled, the IR spectra carry the 1/N */
+    float tr, ti, wr, wi, sign = inverse ? 1.0f : -1.0f; uint32_t j;
+
+    for(uint32_t i = 0; i < SND_DSP_FFT_SIZE; i++) {
+        j = fft->bit_reverse[i];
+        if(i < j) {
+            tr = re[i]; re[i] = re[j]; re[j] = tr;
+            ti = im[i]; im[i] = im[j]; im[j] = ti;
+        }
+    }
+    for(uint32_t len = 2; len <= SND_DSP_FFT_SIZE; len *= 2) {
+        uint32_t half = len / 2, stride = SND_DSP_FFT_SIZE / len;
+        for(uint32_t start = 0; start < SND_DSP_FFT_SIZE; start += len) {
+            for(uint32_t k = 0; k < half; k++) {
+                wr = fft->cos_table[k * stride];
+                wi = sign * fft->sin_table[k * stride];
+                tr = re[start + k + half] * wr - im[start + k + half] * wi;
+                ti = re[start + k + half] * wi + im[start + k + half] * wr;
+                re[start + k + half] = re[start + k] - tr;
+                im[start + k + half] = im[start + k] - ti;
+                re[start + k] += tr;
+                im[start + k] += ti;
+            }
+        }
+    }
+}
+static void snd_dsp_complex_mac(uint32_t n, const float* restrict xr, const float* restrict xi, const float* restrict hr, const float* restrict hi, float* restrict yr, float* restrict yi) {
+    for(uint32_t k = 0; k < n; k++) {
+        yr[k] += xr[k] * hr[k] - xi[k] * hi[k];
+        yi[k] += xr[k] * hi[k] + xi[k] * hr[k];
+    }
+}
+static snd_result_t snd_dsp_convolution_init(snd_dsp_node_state_t* node) {
+    const snd_dsp_node_params_t* p = &(node->params); uint32_t n; float* re; float* im;
+
+    snd_dsp_fft_init(&(node->convolution.fft));
+
+    node->convolution.nr_partitions = (p->convolution.nr_frames + SND_DSP_BLOCK_FRAMES - 1) / SND_DSP_BLOCK_FRAMES;
+    n = node->convolution.nr_partitions * SND_DSP_FFT_SIZE;
+    node->convolution.ir_re = calloc(4 * (size_t) n, sizeof(float));
+    if(node->convolution.ir_re == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    node->convolution.ir_im = node->convolution.ir_re + n;
+    node->convolution.fdl_re = node->convolution.ir_re + 2 * n;
+    node->convolution.fdl_im = node->convolution.ir_re + 3 * n;
+
+    for(uint32_t part = 0; part < node->convolution.nr_partitions; part++) {
+        re = node->convolution.ir_re + part * SND_DSP_FFT_SIZE;
+        im = node->convolution.ir_im + part * SND_DSP_FFT_SIZE;
+        /* the partition in the first half, zero padded */
+        for(uint32_t i = 0; i < SND_DSP_BLOCK_FRAMES && part * SND_DSP_BLOCK_FRAMES + i < p->convolution.nr_frames; i++) {
+            re[i] = p->convolution.impulse_response[part * SND_DSP_BLOCK_FRAMES + i] * (1.0f / SND_DSP_FFT_SIZE);
         }
-        bits = 16; channels = 1;
+        snd_dsp_fft(&(node->convolution.fft), re, im, false);
+    }
+    return SND_OK;
+}
+static void snd_dsp_convolution_process(snd_dsp_node_state_t* node, float* restrict block) {
+    float re[SND_DSP_FFT_SIZE], im[SND_DSP_FFT_SIZE], yr[SND_DSP_FFT_SIZE], yi[SND_DSP_FFT_SIZE];
+    float wet = node->params.convolution.wet, dry = node->params.convolution.dry;
+    float* in = node->convolution.input; uint32_t np = node->convolution.nr_partitions, slot;
+
+    /* overlap-save input: the previous block followed by this one, left as real and right as imaginary part;
+     * since the IR is real, the result splits back into the two convolved channels the same way */
+    memmove(in, in + 2 * SND_DSP_BLOCK_FRAMES, 2 * SND_DSP_BLOCK_FRAMES * sizeof(float));
+    memcpy(in + 2 * SND_DSP_BLOCK_FRAMES, block, 2 * SND_DSP_BLOCK_FRAMES * sizeof(float));
+    for(uint32_t i = 0; i < SND_DSP_FFT_SIZE; i++) {
+        re[i] = in[2*i];
+        im[i] = in[2*i + 1];
+    }
+    snd_dsp_fft(&(node->convolution.fft), re, im, false);
+
+    slot = node->convolution.fdl_pos;
+    memcpy(node->convolution.fdl_re + slot * SND_DSP_FFT_SIZE, re, sizeof(re));
+    memcpy(node->convolution.fdl_im + slot * SND_DSP_FFT_SIZE, im, sizeof(im));
+
+    memset(yr, 0, sizeof(yr));
+    memset(yi, 0, sizeof(yi));
+    /* partition p of the IR meets the input from p blocks ago */
+    for(uint32_t part = 0; part < np; part++) {
+        slot = (node->convolution.fdl_pos + np - part) % np;
+        snd_dsp_complex_mac(SND_DSP_FFT_SIZE,
+            node->convolution.fdl_re + slot * SND_DSP_FFT_SIZE, node->convolution.fdl_im + slot * SND_DSP_FFT_SIZE,
+            node->convolution.ir_re + part * SND_DSP_FFT_SIZE, node->convolution.ir_im + part * SND_DSP_FFT_SIZE, yr, yi);
+    }
+    node->convolution.fdl_pos = (node->convolution.fdl_pos + 1) % np;
+
+    snd_dsp_fft(&(node->convolution.fft), yr, yi, true);
+    /* the first half is the circular wrap-around, the second half is valid */
+    for(uint32_t i = 0; i < SND_DSP_BLOCK_FRAMES; i++) {
+        block[2*i]     = dry * block[2*i]     + wet * yr[SND_DSP_BLOCK_FRAMES + i];
+        block[2*i + 1] = dry * block[2*i + 1] + wet * yi[SND_DSP_BLOCK_FRAMES + i];
+    }
+}
+static void snd_dsp_limiter_process(snd_dsp_node_state_t* node, float* restrict block) {
+    /* peak limiter with instant attack, the envelope falls off exponentially */
+    float env = node->limiter.envelope, thr = node->limiter.threshold, rel = node->limiter.release, g;
+
+    for(uint32_t i = 0; i < SND_DSP_BLOCK_FRAMES; i++) {
+        env = fmaxf(fmaxf(fabsf(block[2*i]), fabsf(block[2*i + 1])), env * rel);
+        g = fminf(1.0f, thr / fmaxf(env, 1e-9f));
+        block[2*i] *= g;
+        block[2*i + 1] *= g;
+    }
+    node->limiter.envelope = env;
+}
+/* sets up everything but the convolution tables and the delay line, which only change on create */
+static void snd_dsp_node_configure(snd_dsp_node_state_t* node, float frequency_hz) {
+    float samples;
+
+    switch(node->params.type) {
+    case SND_DSP_NODE_TYPE_BIQUAD:
+        snd_dsp_biquad_coefficients(node, frequency_hz);
         break;
-    case SND_FORMAT_PCM_UINT8_STEREO_INTERLEAVED_LR:
-        al_format = AL_FORMAT_STEREO8;
-        if(size%2 != 0) {
-            return SND_ERROR_INVALID_PARAM;
+    case SND_DSP_NODE_TYPE_DELAY:
+        /* in samples, two per frame */
+        samples = 2.0f * roundf(node->params.delay.delay_ms * 0.001f * frequency_hz);
+        node->delay.length = samples < 2.0f ? 2 : (samples > (float) node->delay.capacity ? node->delay.capacity : (uint32_t) samples);
+        node->delay.pos %= node->delay.length;
+        break;
+    case SND_DSP_NODE_TYPE_LIMITER:
+        node->limiter.threshold = powf(10.0f, node->params.limiter.threshold_db / 20.0f);
+        node->limiter.release = node->params.limiter.release_ms > 0.0f ? expf(-1.0f / (node->params.limiter.release_ms * 0.001f * frequency_hz)) : 0.0f;
+        break;
+    default:
+        break;
+    }
+}
+/* How long the chain keeps sounding after its input went silent, until it is 60 dB down: a delay repeats until its
+ * feedback got it there, a convolution lasts as long as its IR. */
+static uint32_t snd_dsp_chain_tail_frames(uint32_t nr_nodes, snd_dsp_node_state_t** nodes, uint32_t frequency_hz) {
+    uint64_t frames = 0, max_frames = (uint64_t) SND_DSP_MAX_TAIL_SECONDS * frequency_hz; float feedback;
+
+    for(uint32_t i = 0; i < nr_nodes; i++) {
+        switch(nodes[i]->params.type) {
+        case SND_DSP_NODE_TYPE_BIQUAD:
+            /* ringing of a narrow filter */
+            frames += SND_DSP_BLOCK_FRAMES;
+            break;
+        case SND_DSP_NODE_TYPE_DELAY:
+            feedback = fabsf(nodes[i]->params.delay.feedback);
+            if(feedback >= 1.0f) {
+                frames = max_frames;
+            } else if(feedback < 0.001f) {
+                frames += nodes[i]->delay.length / 2;
+            } else {
+                frames += (uint64_t)(1.0f + ceilf(logf(0.001f) / logf(feedback))) * (nodes[i]->delay.length / 2);
+            }
+            break;
+        case SND_DSP_NODE_TYPE_CONVOLUTION:
+            frames += (uint64_t) nodes[i]->convolution.nr_partitions * SND_DSP_BLOCK_FRAMES;
+            break;
+        default:
+            break;
+        }
+    }
+    return (uint32_t)(frames < max_frames ? frames : max_frames);
+}
+static void snd_dsp_chain_process(uint32_t nr_nodes, snd_dsp_node_state_t** nodes, float* block) {
+    double start, end;
+
+    for(uint32_t i = 0; i < nr_nodes; i++) {
+        start = snd_seconds_now();
+        switch(nodes[i]->params.type) {
+        case SND_DSP_NODE_TYPE_BIQUAD:
+            snd_dsp_biquad_process(nodes[i], block);
+            break;
+        case SND_DSP_NODE_TYPE_DELAY:
+            snd_dsp_delay_process(nodes[i], block);
+            break;
+        case SND_DSP_NODE_TYPE_CONVOLUTION:
+            snd_dsp_convolution_process(nodes[i], block);
+            break;
+        case SND_DSP_NODE_TYPE_LIMITER:
+            snd_dsp_limiter_process(nodes[i], block);
+            break;
+        default:
+            break;
         }
-        bits = 8; channels = 2;
+        end = snd_seconds_now();
+        nodes[i]->seconds_total += end - start;
+        nodes[i]->nr_blocks++;
+    }
+}
+
+/* HRTF data sets of the software backend, see snd_hrtf_create. The responses are kept like the convolution node's,
+ * as spectra of SND_DSP_BLOCK_FRAMES long partitions, but with the left ear as real and the right ear as imaginary
+ * part: a real mono input times that spectrum gives both ears with one inverse FFT. */
+#define SND_HRTF_BED_SPEAKERS 10
+#define SND_HRTF_NO_FILTER UINT32_MAX
+
+typedef struct snd_hrtf_state_t {
+    uint32_t nr_measurements, nr_partitions;
+    /* unit vectors in listener space, x to the right, y up and z to the front */
+    float* directions;
+    float* ir_re; float* ir_im;
+    snd_dsp_fft_t fft;
+    bool in_use;
+} snd_hrtf_state_t;
+/* one mono input going through a filter: its last two blocks, and the spectra of as many blocks as there are partitions */
+typedef struct snd_hrtf_channel_t {
+    float input[SND_DSP_FFT_SIZE];
+    float* fdl_re; float* fdl_im;
+    uint32_t fdl_pos, filter;
+} snd_hrtf_channel_t;
+
+static uint32_t snd_hrtf_nearest(const snd_hrtf_state_t* h, const float* direction) {
+    float best = -2.0f, d; uint32_t nearest = 0; const float* v;
+
+    for(uint32_t i = 0; i < h->nr_measurements; i++) {
+        v = h->directions + 3 * i;
+        d = v[0] * direction[0] + v[1] * direction[1] + v[2] * direction[2];
+        if(d > best) {
+            best = d;
+            nearest = i;
+        }
+    }
+    return nearest;
+}
+static void snd_hrtf_channel_feed(snd_hrtf_channel_t* ch, const float* block) {
+    memmove(ch->input, ch->input + SND_DSP_BLOCK_FRAMES, SND_DSP_BLOCK_FRAMES * sizeof(float));
+    memcpy(ch->input + SND_DSP_BLOCK_FRAMES, block, SND_DSP_BLOCK_FRAMES * sizeof(float));
+}
+/* the time domain output of filter for the channel's current input, valid in the second half */
+static void snd_hrtf_filter(const snd_hrtf_state_t* h, const snd_hrtf_channel_t* ch, uint32_t filter, float* restrict yr, float* restrict yi) {
+    uint32_t np = h->nr_partitions, slot; size_t base = (size_t) filter * np * SND_DSP_FFT_SIZE;
+
+    memset(yr, 0, SND_DSP_FFT_SIZE * sizeof(float));
+    memset(yi, 0, SND_DSP_FFT_SIZE * sizeof(float));
+    for(uint32_t part = 0; part < np; part++) {
+        slot = (ch->fdl_pos + np - part) % np;
+        snd_dsp_complex_mac(SND_DSP_FFT_SIZE, ch->fdl_re + slot * SND_DSP_FFT_SIZE, ch->fdl_im + slot * SND_DSP_FFT_SIZE,
+            h->ir_re + base + part * SND_DSP_FFT_SIZE, h->ir_im + base + part * SND_DSP_FFT_SIZE, yr, yi);
+    }
+    snd_dsp_fft(&(h->fft), yr, yi, true);
+}
+/* Pushes a block through the channel and adds both ears times gain to the interleaved out, weighted by a ramp from
+ * w0 to w1 over the block. A changed filter is crossfaded from the previous one, both see the same input spectra. */
+static void snd_hrtf_convolve(const snd_hrtf_state_t* h, snd_hrtf_channel_t* ch, const float* block, uint32_t filter, float gain, float w0, float w1, float* restrict out) {
+    float re[SND_DSP_FFT_SIZE], im[SND_DSP_FFT_SIZE], yr[SND_DSP_FFT_SIZE], yi[SND_DSP_FFT_SIZE], pr[SND_DSP_FFT_SIZE], pi[SND_DSP_FFT_SIZE];
+    float w, dw = (w1 - w0) / SND_DSP_BLOCK_FRAMES, f; uint32_t previous = ch->filter;
+
+    snd_hrtf_channel_feed(ch, block);
+    memcpy(re, ch->input, sizeof(re));
+    memset(im, 0, sizeof(im));
+    snd_dsp_fft(&(h->fft), re, im, false);
+    memcpy(ch->fdl_re + ch->fdl_pos * SND_DSP_FFT_SIZE, re, sizeof(re));
+    memcpy(ch->fdl_im + ch->fdl_pos * SND_DSP_FFT_SIZE, im, sizeof(im));
+
+    snd_hrtf_filter(h, ch, filter, yr, yi);
+    if(previous == filter || previous == SND_HRTF_NO_FILTER) {
+        for(uint32_t i = 0; i < SND_DSP_BLOCK_FRAMES; i++) {
+            w = gain * (w0 + dw * (float)(i + 1));
+            out[2*i]     += w * yr[SND_DSP_BLOCK_FRAMES + i];
+            out[2*i + 1] += w * yi[SND_DSP_BLOCK_FRAMES + i];
+        }
+    } else {
+        snd_hrtf_filter(h, ch, previous, pr, pi);
+        for(uint32_t i = 0; i < SND_DSP_BLOCK_FRAMES; i++) {
+            w = gain * (w0 + dw * (float)(i + 1));
+            f = (float)(i + 1) * (1.0f / SND_DSP_BLOCK_FRAMES);
+            out[2*i]     += w * (pr[SND_DSP_BLOCK_FRAMES + i] + f * (yr[SND_DSP_BLOCK_FRAMES + i] - pr[SND_DSP_BLOCK_FRAMES + i]));
+            out[2*i + 1] += w * (pi[SND_DSP_BLOCK_FRAMES + i] + f * (yi[SND_DSP_BLOCK_FRAMES + i] - pi[SND_DSP_BLOCK_FRAMES + i]));
+        }
+    }
+    ch->fdl_pos = (ch->fdl_pos + 1) % h->nr_partitions;
+    ch->filter = filter;
+}
+/* 8 virtual speakers on the horizon every 45 degrees clockwise from the front, one above and one below */
+static void snd_hrtf_bed_direction(uint32_t speaker, float* out_direction) {
+    out_direction[0] = speaker < 8 ? sinf((float) speaker * 0.78539816f) : 0.0f;
+    out_direction[1] = speaker < 8 ? 0.0f : (speaker == 8 ? 1.0f : -1.0f);
+    out_direction[2] = speaker < 8 ? cosf((float) speaker * 0.78539816f) : 0.0f;
+}
+/* equal power: pairwise between the horizon speakers, and between the horizon and the top or bottom */
+static void snd_hrtf_bed_gains(const float* direction, float* out_gains) {
+    float horizontal = sqrtf(direction[0] * direction[0] + direction[2] * direction[2]), az, sector, frac; uint32_t k;
+
+    memset(out_gains, 0, SND_HRTF_BED_SPEAKERS * sizeof(float));
+    az = atan2f(direction[0], direction[2]);
+    sector = (az < 0.0f ? az + 6.28318531f : az) * (4.0f / 3.14159265f);
+    k = (uint32_t) sector;
+    frac = sector - (float) k;
+    out_gains[k % 8] = horizontal * cosf(frac * 1.57079633f);
+    out_gains[(k + 1) % 8] = horizontal * sinf(frac * 1.57079633f);
+    out_gains[direction[1] > 0.0f ? 8 : 9] = fabsf(direction[1]);
+}
+
+/* Software implementation of the core AL/ALC functions snd uses, installed into g_al instead of a loaded OpenAL.
+ * It has one playback device and no recording devices, and it only mixes when snd_software_render is called,
+ * so offline rendering runs as fast as the CPU allows. One lock serializes it against snd_stream refill threads. */
+#define SND_SOFT_MAX_CONTEXTS 8
+#define SND_SOFT_MAX_QUEUE 64
+#define SND_SOFT_BLOCK_FRAMES SND_DSP_BLOCK_FRAMES
+#define SND_SOFT_ONE ((uint64_t) 1 << 32)
+
+typedef struct snd_soft_buffer_t {
+    bool used;
+    uint32_t channels, bits, frequency_hz, nr_frames, size;
+    /* converted to float on upload */
+    float* samples;
+    uint32_t nr_users;
+} snd_soft_buffer_t;
+typedef struct snd_soft_context_t {
+    bool used;
+    ALenum error;
+    ALenum distance_model;
+    float doppler_factor, speed_of_sound;
+    float listener_gain, listener_position[3], listener_velocity[3], listener_orientation[6];
+} snd_soft_context_t;
+typedef struct snd_soft_source_t {
+    /* NULL for a free slot */
+    snd_soft_context_t* context;
+    ALint state, type;
+    bool relative, looping, offset_pending;
+    float gain, min_gain, max_gain, cone_outer_gain, cone_inner_angle, cone_outer_angle;
+    float reference_distance, max_distance, rolloff_factor, pitch;
+    float position[3], velocity[3], direction[3];
+    ALuint queue[SND_SOFT_MAX_QUEUE];
+    /* queue entries before current are processed */
+    uint32_t nr_queued, current;
+    /* frame position in the current buffer, 32.32 fixed point */
+    uint64_t position_fixed;
+    snd_dsp_node_state_t* dsp[SND_DSP_MAX_CHAIN];
+    uint32_t nr_dsp;
+    /* frames the chain still runs on silence after the source stopped, panned with the gains of its last block */
+    uint32_t tail_frames;
+    float tail_gain[2];
+    /* with an HRTF output; the spectra are only allocated once the source gets a convolution of its own */
+    snd_hrtf_channel_t hrtf;
+    bool hrtf_direct, hrtf_was_direct, hrtf_fed;
+} snd_soft_source_t;
+typedef struct snd_soft_hrtf_rank_t {
+    float gain;
+    uint32_t source;
+} snd_soft_hrtf_rank_t;
+
+static struct {
+    mtx_t lock;
+    bool device_open;
+    ALCenum error;
+    snd_software_backend_params_t params;
+    ALCint attributes[16];
+    ALCint nr_attributes;
+    FILE* wav;
+    uint64_t wav_frames;
+    snd_soft_context_t contexts[SND_SOFT_MAX_CONTEXTS];
+    snd_soft_context_t* current;
+    snd_soft_buffer_t* buffers;
+    uint32_t buffers_cap;
+    snd_soft_source_t* sources;
+    uint32_t sources_cap;
+    float mix[SND_SOFT_BLOCK_FRAMES * 2], scratch[SND_SOFT_BLOCK_FRAMES * 2];
+    /* frames of mix already handed out, mixing happens in whole blocks so the DSP nodes always see full ones */
+    uint32_t block_pos;
+    snd_dsp_node_state_t* master[SND_DSP_MAX_CHAIN];
+    uint32_t nr_master;
+    snd_hrtf_state_t* hrtf;
+    uint32_t hrtf_max_direct, hrtf_nr_direct, hrtf_nr_bed;
+    snd_soft_hrtf_rank_t* hrtf_rank;
+    uint32_t hrtf_rank_cap;
+    /* the virtual speakers sources without a convolution of their own are panned onto */
+    snd_hrtf_channel_t bed[SND_HRTF_BED_SPEAKERS];
+    float bed_mix[SND_HRTF_BED_SPEAKERS][SND_SOFT_BLOCK_FRAMES];
+    bool bed_active[SND_HRTF_BED_SPEAKERS];
+    uint32_t bed_silent_blocks[SND_HRTF_BED_SPEAKERS];
+    float* bed_fdl;
+    uint64_t hrtf_blocks;
+    double hrtf_seconds;
+    /* frames handed out, the device clock */
+    uint64_t frames_rendered;
+    double render_seconds;
+    /* refilled by snd_software_render, guarded by streams_lock since that happens without the lock */
+    mtx_t streams_lock;
+    struct snd_stream_state_t** streams;
+    uint32_t nr_streams, streams_cap;
+} g_soft;
+
+static void snd_soft_error(ALenum error) {
+    /* like AL, only the first error is kept until it's read */
+    if(g_soft.current != NULL && g_soft.current->error == AL_NO_ERROR) {
+        g_soft.current->error = error;
+    }
+}
+static snd_soft_source_t* snd_soft_source(ALuint id) {
+    if(id == 0 || id > g_soft.sources_cap || g_soft.current == NULL || g_soft.sources[id-1].context != g_soft.current) {
+        return NULL;
+    }
+    return &(g_soft.sources[id-1]);
+}
+static snd_soft_buffer_t* snd_soft_buffer(ALuint id) {
+    if(id == 0 || id > g_soft.buffers_cap || !g_soft.buffers[id-1].used) {
+        return NULL;
+    }
+    return &(g_soft.buffers[id-1]);
+}
+static void snd_soft_source_release_queue(snd_soft_source_t* src) {
+    snd_soft_buffer_t* buf;
+    for(uint32_t i = 0; i < src->nr_queued; i++) {
+        buf = snd_soft_buffer(src->queue[i]);
+        if(buf != NULL) {
+            buf->nr_users--;
+        }
+    }
+    src->nr_queued = 0;
+    src->current = 0;
+    src->position_fixed = 0;
+}
+
+static ALCdevice* AL_APIENTRY snd_soft_OpenDevice(const ALCchar* name) {
+    ALCdevice* dev = NULL;
+    mtx_lock(&g_soft.lock);
+    if(g_soft.device_open) {
+        g_soft.error = ALC_INVALID_VALUE;
+    } else {
+        g_soft.device_open = true;
+        dev = (ALCdevice*) &g_soft;
+    }
+    mtx_unlock(&g_soft.lock);
+    return dev;
+}
+static ALCboolean AL_APIENTRY snd_soft_CloseDevice(ALCdevice* device) {
+    mtx_lock(&g_soft.lock);
+    g_soft.device_open = false;
+    mtx_unlock(&g_soft.lock);
+    return ALC_TRUE;
+}
+static ALCcontext* AL_APIENTRY snd_soft_CreateContext(ALCdevice* device, const ALCint* attrlist) {
+    snd_soft_context_t* ctx = NULL;
+
+    mtx_lock(&g_soft.lock);
+    for(int i = 0; i < SND_SOFT_MAX_CONTEXTS; i++) {
+        if(!g_soft.contexts[i].used) {
+            ctx = &(g_soft.contexts[i]);
+            break;
+        }
+    }
+    if(device != (ALCdevice*) &g_soft || ctx == NULL) {
+        g_soft.error = device != (ALCdevice*) &g_soft ? ALC_INVALID_DEVICE : ALC_INVALID_VALUE;
+        mtx_unlock(&g_soft.lock);
+        return NULL;
+    }
+    memset(ctx, 0, sizeof(snd_soft_context_t));
+    ctx->used = true;
+    ctx->error = AL_NO_ERROR;
+    ctx->distance_model = AL_INVERSE_DISTANCE_CLAMPED;
+    ctx->doppler_factor = 1.0f;
+    ctx->speed_of_sound = 343.3f;
+    ctx->listener_gain = 1.0f;
+    ctx->listener_orientation[2] = -1.0f;
+    ctx->listener_orientation[4] = 1.0f;
+
+    /* reported back as ALC_ALL_ATTRIBUTES, the mixing frequency is fixed by the backend params though */
+    g_soft.nr_attributes = 0;
+    while(attrlist != NULL && g_soft.nr_attributes < 15 && attrlist[g_soft.nr_attributes] != 0) {
+        g_soft.attributes[g_soft.nr_attributes] = attrlist[g_soft.nr_attributes];
+        g_soft.nr_attributes++;
+    }
+    g_soft.attributes[g_soft.nr_attributes++] = 0;
+    mtx_unlock(&g_soft.lock);
+    return (ALCcontext*) ctx;
+}
+static ALCboolean AL_APIENTRY snd_soft_MakeContextCurrent(ALCcontext* context) {
+    mtx_lock(&g_soft.lock);
+    g_soft.current = (snd_soft_context_t*) context;
+    mtx_unlock(&g_soft.lock);
+    return ALC_TRUE;
+}
+static void AL_APIENTRY snd_soft_ProcessContext(ALCcontext* context) {
+}
+static void AL_APIENTRY snd_soft_SuspendContext(ALCcontext* context) {
+}
+static void AL_APIENTRY snd_soft_DestroyContext(ALCcontext* context) {
+    snd_soft_context_t* ctx = (snd_soft_context_t*) context;
+
+    mtx_lock(&g_soft.lock);
+    for(uint32_t i = 0; i < g_soft.sources_cap; i++) {
+        if(g_soft.sources[i].context == ctx) {
+            snd_soft_source_release_queue(&(g_soft.sources[i]));
+            g_soft.sources[i].context = NULL;
+        }
+    }
+    ctx->used = false;
+    if(g_soft.current == ctx) {
+        g_soft.current = NULL;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static ALCcontext* AL_APIENTRY snd_soft_GetCurrentContext(void) {
+    return (ALCcontext*) g_soft.current;
+}
+static ALCdevice* AL_APIENTRY snd_soft_GetContextsDevice(ALCcontext* context) {
+    return (ALCdevice*) &g_soft;
+}
+static ALCenum AL_APIENTRY snd_soft_alcGetError(ALCdevice* device) {
+    ALCenum e;
+    mtx_lock(&g_soft.lock);
+    e = g_soft.error;
+    g_soft.error = ALC_NO_ERROR;
+    mtx_unlock(&g_soft.lock);
+    return e;
+}
+static const ALCchar* AL_APIENTRY snd_soft_alcGetString(ALCdevice* device, ALCenum param) {
+    switch(param) {
+    case ALC_DEVICE_SPECIFIER:
+    case ALC_DEFAULT_DEVICE_SPECIFIER:
+        /* device lists end with a double NUL, the literal adds the second one */
+        return "svalib software mixer\0";
+    case ALC_CAPTURE_DEVICE_SPECIFIER:
+        return "\0";
+    case ALC_CAPTURE_DEFAULT_DEVICE_SPECIFIER:
+    case ALC_EXTENSIONS:
+        return "";
+    default:
+        g_soft.error = ALC_INVALID_ENUM;
+        return NULL;
+    }
+}
+static void AL_APIENTRY snd_soft_alcGetIntegerv(ALCdevice* device, ALCenum param, ALCsizei size, ALCint* values) {
+    mtx_lock(&g_soft.lock);
+    if(values == NULL || size <= 0) {
+        g_soft.error = ALC_INVALID_VALUE;
+    } else switch(param) {
+    case ALC_MAJOR_VERSION:
+        values[0] = 1;
         break;
-    case SND_FORMAT_PCM_INT16_STEREO_INTERLEAVED_LR:
-        al_format = AL_FORMAT_STEREO16;
-        if(size%4 != 0) {
-            return SND_ERROR_INVALID_PARAM;
+    case ALC_MINOR_VERSION:
+        values[0] = 1;
+        break;
+    case ALC_FREQUENCY:
+        values[0] = (ALCint) g_soft.params.frequency_hz;
+        break;
+    case ALC_ATTRIBUTES_SIZE:
+        values[0] = g_soft.nr_attributes;
+        break;
+    case ALC_ALL_ATTRIBUTES:
+        if(size < g_soft.nr_attributes) {
+            g_soft.error = ALC_INVALID_VALUE;
+        } else {
+            memcpy(values, g_soft.attributes, g_soft.nr_attributes * sizeof(ALCint));
         }
-        bits = 16; channels = 2;
         break;
     default:
+        g_soft.error = ALC_INVALID_ENUM;
+        break;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static ALCdevice* AL_APIENTRY snd_soft_CaptureOpenDevice(const ALCchar* name, ALCuint frequency, ALCenum format, ALCsizei buffersize) {
+    g_soft.error = ALC_INVALID_VALUE;
+    return NULL;
+}
+static ALCboolean AL_APIENTRY snd_soft_CaptureCloseDevice(ALCdevice* device) {
+    g_soft.error = ALC_INVALID_DEVICE;
+    return ALC_FALSE;
+}
+static void AL_APIENTRY snd_soft_CaptureStart(ALCdevice* device) {
+    g_soft.error = ALC_INVALID_DEVICE;
+}
+static void AL_APIENTRY snd_soft_CaptureStop(ALCdevice* device) {
+    g_soft.error = ALC_INVALID_DEVICE;
+}
+static void AL_APIENTRY snd_soft_CaptureSamples(ALCdevice* device, ALCvoid* buffer, ALCsizei samples) {
+    g_soft.error = ALC_INVALID_DEVICE;
+}
+/* ALC_SOFT_device_clock, counting rendered frames so it only moves with snd_software_render */
+static void AL_APIENTRY snd_soft_GetInteger64vSOFT(ALCdevice* device, ALCenum param, ALsizei size, ALCint64SOFT* values) {
+    ALCint64SOFT clock; uint64_t frames, hz;
+
+    mtx_lock(&g_soft.lock);
+    frames = g_soft.frames_rendered;
+    hz = g_soft.params.frequency_hz;
+    clock = (ALCint64SOFT)((frames / hz) * 1000000000u + (frames % hz) * 1000000000u / hz);
+    if(values == NULL || size <= 0) {
+        g_soft.error = ALC_INVALID_VALUE;
+    } else switch(param) {
+    case ALC_DEVICE_CLOCK_SOFT:
+        values[0] = clock;
+        break;
+    case ALC_DEVICE_LATENCY_SOFT:
+        values[0] = 0;
+        break;
+    case ALC_DEVICE_CLOCK_LATENCY_SOFT:
+        if(size < 2) {
+            g_soft.error = ALC_INVALID_VALUE;
+        } else {
+            values[0] = clock;
+            values[1] = 0;
+        }
+        break;
+    default:
+        g_soft.error = ALC_INVALID_ENUM;
+        break;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static ALCboolean AL_APIENTRY snd_soft_alcIsExtensionPresent(ALCdevice* device, const ALCchar* name) {
+    return name != NULL && strcmp(name, "ALC_SOFT_device_clock") == 0 ? ALC_TRUE : ALC_FALSE;
+}
+static ALCvoid* AL_APIENTRY snd_soft_alcGetProcAddress(ALCdevice* device, const ALCchar* name) {
+    return name != NULL && strcmp(name, "alcGetInteger64vSOFT") == 0 ? (ALCvoid*) snd_soft_GetInteger64vSOFT : NULL;
+}
+
+static const ALchar* AL_APIENTRY snd_soft_GetString(ALenum param) {
+    switch(param) {
+    case AL_VENDOR:
+        return "svalib";
+    case AL_VERSION:
+        return "1.1";
+    case AL_RENDERER:
+        return "svalib software mixer";
+    case AL_EXTENSIONS:
+        return "AL_EXT_float32";
+    default:
+        snd_soft_error(AL_INVALID_ENUM);
+        return NULL;
+    }
+}
+static ALboolean AL_APIENTRY snd_soft_IsExtensionPresent(const ALchar* name) {
+    return strcmp(name, "AL_EXT_float32") == 0 ? AL_TRUE : AL_FALSE;
+}
+static void* AL_APIENTRY snd_soft_GetProcAddress(const ALchar* name) {
+    return NULL;
+}
+static ALenum AL_APIENTRY snd_soft_GetError(void) {
+    ALenum e = AL_NO_ERROR;
+    mtx_lock(&g_soft.lock);
+    if(g_soft.current != NULL) {
+        e = g_soft.current->error;
+        g_soft.current->error = AL_NO_ERROR;
+    }
+    mtx_unlock(&g_soft.lock);
+    return e;
+}
+static ALint AL_APIENTRY snd_soft_GetInteger(ALenum param) {
+    ALint v = 0;
+    mtx_lock(&g_soft.lock);
+    if(g_soft.current == NULL) {
+    } else if(param == AL_DISTANCE_MODEL) {
+        v = g_soft.current->distance_model;
+    } else {
+        snd_soft_error(AL_INVALID_ENUM);
+    }
+    mtx_unlock(&g_soft.lock);
+    return v;
+}
+static ALfloat AL_APIENTRY snd_soft_GetFloat(ALenum param) {
+    ALfloat v = 0.0f;
+    mtx_lock(&g_soft.lock);
+    if(g_soft.current == NULL) {
+    } else if(param == AL_DOPPLER_FACTOR) {
+        v = g_soft.current->doppler_factor;
+    } else if(param == AL_SPEED_OF_SOUND) {
+        v = g_soft.current->speed_of_sound;
+    } else {
+        snd_soft_error(AL_INVALID_ENUM);
+    }
+    mtx_unlock(&g_soft.lock);
+    return v;
+}
+static void AL_APIENTRY snd_soft_DopplerFactor(ALfloat value) {
+    mtx_lock(&g_soft.lock);
+    if(g_soft.current != NULL) {
+        if(!(value >= 0.0f)) {
+            snd_soft_error(AL_INVALID_VALUE);
+        } else {
+            g_soft.current->doppler_factor = value;
+        }
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_SpeedOfSound(ALfloat value) {
+    mtx_lock(&g_soft.lock);
+    if(g_soft.current != NULL) {
+        if(!(value > 0.0f)) {
+            snd_soft_error(AL_INVALID_VALUE);
+        } else {
+            g_soft.current->speed_of_sound = value;
+        }
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_DistanceModel(ALenum value) {
+    mtx_lock(&g_soft.lock);
+    if(g_soft.current != NULL) {
+        switch(value) {
+        case AL_NONE:
+        case AL_INVERSE_DISTANCE:
+        case AL_INVERSE_DISTANCE_CLAMPED:
+        case AL_LINEAR_DISTANCE:
+        case AL_LINEAR_DISTANCE_CLAMPED:
+        case AL_EXPONENT_DISTANCE:
+        case AL_EXPONENT_DISTANCE_CLAMPED:
+            g_soft.current->distance_model = value;
+            break;
+        default:
+            snd_soft_error(AL_INVALID_VALUE);
+            break;
+        }
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_Listenerfv(ALenum param, const ALfloat* values) {
+    mtx_lock(&g_soft.lock);
+    if(g_soft.current == NULL) {
+    } else if(values == NULL) {
+        snd_soft_error(AL_INVALID_VALUE);
+    } else switch(param) {
+    case AL_GAIN:
+        g_soft.current->listener_gain = values[0];
+        break;
+    case AL_POSITION:
+        memcpy(g_soft.current->listener_position, values, 3 * sizeof(float));
+        break;
+    case AL_VELOCITY:
+        memcpy(g_soft.current->listener_velocity, values, 3 * sizeof(float));
+        break;
+    case AL_ORIENTATION:
+        memcpy(g_soft.current->listener_orientation, values, 6 * sizeof(float));
+        break;
+    default:
+        snd_soft_error(AL_INVALID_ENUM);
+        break;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_Listenerf(ALenum param, ALfloat value) {
+    snd_soft_Listenerfv(param, &value);
+}
+static void AL_APIENTRY snd_soft_GetListenerfv(ALenum param, ALfloat* values) {
+    mtx_lock(&g_soft.lock);
+    if(g_soft.current == NULL) {
+    } else if(values == NULL) {
+        snd_soft_error(AL_INVALID_VALUE);
+    } else switch(param) {
+    case AL_GAIN:
+        values[0] = g_soft.current->listener_gain;
+        break;
+    case AL_POSITION:
+        memcpy(values, g_soft.current->listener_position, 3 * sizeof(float));
+        break;
+    case AL_VELOCITY:
+        memcpy(values, g_soft.current->listener_velocity, 3 * sizeof(float));
+        break;
+    case AL_ORIENTATION:
+        memcpy(values, g_soft.current->listener_orientation, 6 * sizeof(float));
+        break;
+    default:
+        snd_soft_error(AL_INVALID_ENUM);
+        break;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_GetListenerf(ALenum param, ALfloat* value) {
+    if(param != AL_GAIN) {
+        mtx_lock(&g_soft.lock);
+        snd_soft_error(AL_INVALID_ENUM);
+        mtx_unlock(&g_soft.lock);
+        return;
+    }
+    snd_soft_GetListenerfv(param, value);
+}
+
+static void AL_APIENTRY snd_soft_GenSources(ALsizei n, ALuint* ids) {
+    snd_soft_source_t* new_sources; snd_soft_source_t* src; uint32_t found = 0, old_cap;
+
+    mtx_lock(&g_soft.lock);
+    if(g_soft.current == NULL || n < 0) {
+        snd_soft_error(AL_INVALID_VALUE);
+        mtx_unlock(&g_soft.lock);
+        return;
+    }
+    for(uint32_t i = 0; i < g_soft.sources_cap && found < (uint32_t) n; i++) {
+        if(g_soft.sources[i].context == NULL) {
+            ids[found++] = i + 1;
+        }
+    }
+    if(found < (uint32_t) n) {
+        old_cap = g_soft.sources_cap;
+        new_sources = realloc(g_soft.sources, (old_cap + (n - found) + 64) * sizeof(snd_soft_source_t));
+        if(new_sources == NULL) {
+            snd_soft_error(AL_OUT_OF_MEMORY);
+            mtx_unlock(&g_soft.lock);
+            return;
+        }
+        g_soft.sources = new_sources;
+        g_soft.sources_cap = old_cap + (n - found) + 64;
+        memset(&(g_soft.sources[old_cap]), 0, (g_soft.sources_cap - old_cap) * sizeof(snd_soft_source_t));
+        for(uint32_t i = old_cap; found < (uint32_t) n; i++) {
+            ids[found++] = i + 1;
+        }
+    }
+    for(ALsizei i = 0; i < n; i++) {
+        src = &(g_soft.sources[ids[i]-1]);
+        free(src->hrtf.fdl_re);
+        memset(src, 0, sizeof(snd_soft_source_t));
+        src->context = g_soft.current;
+        src->state = AL_INITIAL;
+        src->type = AL_UNDETERMINED;
+        src->gain = 1.0f;
+        src->max_gain = 1.0f;
+        src->cone_inner_angle = 360.0f;
+        src->cone_outer_angle = 360.0f;
+        src->reference_distance = 1.0f;
+        src->max_distance = FLT_MAX;
+        src->rolloff_factor = 1.0f;
+        src->pitch = 1.0f;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_DeleteSources(ALsizei n, const ALuint* ids) {
+    mtx_lock(&g_soft.lock);
+    for(ALsizei i = 0; i < n; i++) {
+        if(snd_soft_source(ids[i]) == NULL) {
+            snd_soft_error(AL_INVALID_NAME);
+            mtx_unlock(&g_soft.lock);
+            return;
+        }
+    }
+    for(ALsizei i = 0; i < n; i++) {
+        snd_soft_source_release_queue(&(g_soft.sources[ids[i]-1]));
+        for(uint32_t j = 0; j < g_soft.sources[ids[i]-1].nr_dsp; j++) {
+            g_soft.sources[ids[i]-1].dsp[j]->nr_users--;
+        }
+        g_soft.sources[ids[i]-1].nr_dsp = 0;
+        g_soft.sources[ids[i]-1].tail_frames = 0;
+        g_soft.sources[ids[i]-1].context = NULL;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static ALboolean AL_APIENTRY snd_soft_IsSource(ALuint id) {
+    ALboolean b;
+    mtx_lock(&g_soft.lock);
+    b = snd_soft_source(id) != NULL ? AL_TRUE : AL_FALSE;
+    mtx_unlock(&g_soft.lock);
+    return b;
+}
+/* offset of the source in frames from the start of its queue */
+static uint64_t snd_soft_source_offset(snd_soft_source_t* src) {
+    uint64_t frames = 0; snd_soft_buffer_t* buf;
+    for(uint32_t i = 0; i < src->current && i < src->nr_queued; i++) {
+        buf = snd_soft_buffer(src->queue[i]);
+        frames += buf != NULL ? buf->nr_frames : 0;
+    }
+    return src->current < src->nr_queued ? frames + (src->position_fixed >> 32) : 0;
+}
+static void snd_soft_source_seek(snd_soft_source_t* src, ALenum param, double value) {
+    snd_soft_buffer_t* buf; double frames;
+
+    if(src->nr_queued == 0 || value < 0.0) {
+        snd_soft_error(AL_INVALID_VALUE);
+        return;
+    }
+    buf = snd_soft_buffer(src->queue[0]);
+    switch(param) {
+    case AL_SEC_OFFSET:
+        frames = value * buf->frequency_hz;
+        break;
+    case AL_BYTE_OFFSET:
+        frames = value / (buf->channels * buf->bits / 8);
+        break;
+    default:
+        frames = value;
+        break;
+    }
+    for(uint32_t i = 0; i < src->nr_queued; i++) {
+        buf = snd_soft_buffer(src->queue[i]);
+        if(frames < buf->nr_frames) {
+            src->current = i;
+            src->position_fixed = (uint64_t)(frames * (double) SND_SOFT_ONE);
+            /* on a stopped source the offset is used by the next play */
+            src->offset_pending = src->state != AL_PLAYING && src->state != AL_PAUSED;
+            return;
+        }
+        frames -= buf->nr_frames;
+    }
+    snd_soft_error(AL_INVALID_VALUE);
+}
+static void AL_APIENTRY snd_soft_Sourcefv(ALuint id, ALenum param, const ALfloat* values) {
+    snd_soft_source_t* src;
+
+    mtx_lock(&g_soft.lock);
+    src = snd_soft_source(id);
+    if(src == NULL) {
+        snd_soft_error(AL_INVALID_NAME);
+    } else if(values == NULL) {
+        snd_soft_error(AL_INVALID_VALUE);
+    } else switch(param) {
+    case AL_GAIN:               src->gain = values[0]; break;
+    case AL_MIN_GAIN:           src->min_gain = values[0]; break;
+    case AL_MAX_GAIN:           src->max_gain = values[0]; break;
+    case AL_CONE_OUTER_GAIN:    src->cone_outer_gain = values[0]; break;
+    case AL_CONE_INNER_ANGLE:   src->cone_inner_angle = values[0]; break;
+    case AL_CONE_OUTER_ANGLE:   src->cone_outer_angle = values[0]; break;
+    case AL_REFERENCE_DISTANCE: src->reference_distance = values[0]; break;
+    case AL_MAX_DISTANCE:       src->max_distance = values[0]; break;
+    case AL_ROLLOFF_FACTOR:     src->rolloff_factor = values[0]; break;
+    case AL_PITCH:
+        if(!(values[0] > 0.0f)) {
+            snd_soft_error(AL_INVALID_VALUE);
+        } else {
+            src->pitch = values[0];
+        }
+        break;
+    case AL_POSITION:  memcpy(src->position, values, 3 * sizeof(float)); break;
+    case AL_VELOCITY:  memcpy(src->velocity, values, 3 * sizeof(float)); break;
+    case AL_DIRECTION: memcpy(src->direction, values, 3 * sizeof(float)); break;
+    case AL_SEC_OFFSET:
+    case AL_SAMPLE_OFFSET:
+    case AL_BYTE_OFFSET:
+        snd_soft_source_seek(src, param, values[0]);
+        break;
+    default:
+        snd_soft_error(AL_INVALID_ENUM);
+        break;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_Sourcef(ALuint id, ALenum param, ALfloat value) {
+    snd_soft_Sourcefv(id, param, &value);
+}
+static void AL_APIENTRY snd_soft_Sourcei(ALuint id, ALenum param, ALint value) {
+    snd_soft_source_t* src; snd_soft_buffer_t* buf;
+
+    mtx_lock(&g_soft.lock);
+    src = snd_soft_source(id);
+    if(src == NULL) {
+        snd_soft_error(AL_INVALID_NAME);
+    } else switch(param) {
+    case AL_SOURCE_RELATIVE:
+        src->relative = value != AL_FALSE;
+        break;
+    case AL_LOOPING:
+        src->looping = value != AL_FALSE;
+        break;
+    case AL_BUFFER:
+        buf = snd_soft_buffer((ALuint) value);
+        if(src->state == AL_PLAYING || src->state == AL_PAUSED) {
+            snd_soft_error(AL_INVALID_OPERATION);
+        } else if(value != 0 && buf == NULL) {
+            snd_soft_error(AL_INVALID_VALUE);
+        } else {
+            snd_soft_source_release_queue(src);
+            if(buf != NULL) {
+                src->queue[0] = (ALuint) value;
+                src->nr_queued = 1;
+                src->type = AL_STATIC;
+                buf->nr_users++;
+            } else {
+                src->type = AL_UNDETERMINED;
+            }
+        }
+        break;
+    case AL_SEC_OFFSET:
+    case AL_SAMPLE_OFFSET:
+    case AL_BYTE_OFFSET:
+        snd_soft_source_seek(src, param, value);
+        break;
+    default:
+        mtx_unlock(&g_soft.lock);
+        snd_soft_Sourcef(id, param, (ALfloat) value);
+        return;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_GetSourcefv(ALuint id, ALenum param, ALfloat* values) {
+    snd_soft_source_t* src; snd_soft_buffer_t* buf; uint64_t offset;
+
+    mtx_lock(&g_soft.lock);
+    src = snd_soft_source(id);
+    if(src == NULL) {
+        snd_soft_error(AL_INVALID_NAME);
+    } else if(values == NULL) {
+        snd_soft_error(AL_INVALID_VALUE);
+    } else switch(param) {
+    case AL_GAIN:               values[0] = src->gain; break;
+    case AL_MIN_GAIN:           values[0] = src->min_gain; break;
+    case AL_MAX_GAIN:           values[0] = src->max_gain; break;
+    case AL_CONE_OUTER_GAIN:    values[0] = src->cone_outer_gain; break;
+    case AL_CONE_INNER_ANGLE:   values[0] = src->cone_inner_angle; break;
+    case AL_CONE_OUTER_ANGLE:   values[0] = src->cone_outer_angle; break;
+    case AL_REFERENCE_DISTANCE: values[0] = src->reference_distance; break;
+    case AL_MAX_DISTANCE:       values[0] = src->max_distance; break;
+    case AL_ROLLOFF_FACTOR:     values[0] = src->rolloff_factor; break;
+    case AL_PITCH:              values[0] = src->pitch; break;
+    case AL_POSITION:  memcpy(values, src->position, 3 * sizeof(float)); break;
+    case AL_VELOCITY:  memcpy(values, src->velocity, 3 * sizeof(float)); break;
+    case AL_DIRECTION: memcpy(values, src->direction, 3 * sizeof(float)); break;
+    case AL_SEC_OFFSET:
+    case AL_SAMPLE_OFFSET:
+    case AL_BYTE_OFFSET:
+        offset = snd_soft_source_offset(src);
+        buf = src->nr_queued > 0 ? snd_soft_buffer(src->queue[0]) : NULL;
+        if(buf == NULL) {
+            values[0] = 0.0f;
+        } else if(param == AL_SEC_OFFSET) {
+            values[0] = (float)((double) offset / buf->frequency_hz);
+        } else if(param == AL_BYTE_OFFSET) {
+            values[0] = (float)(offset * buf->channels * buf->bits / 8);
+        } else {
+            values[0] = (float) offset;
+        }
+        break;
+    default:
+        snd_soft_error(AL_INVALID_ENUM);
+        break;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_GetSourcef(ALuint id, ALenum param, ALfloat* value) {
+    snd_soft_GetSourcefv(id, param, value);
+}
+static void AL_APIENTRY snd_soft_GetSourcei(ALuint id, ALenum param, ALint* value) {
+    snd_soft_source_t* src; ALfloat f;
+
+    mtx_lock(&g_soft.lock);
+    src = snd_soft_source(id);
+    if(src == NULL) {
+        snd_soft_error(AL_INVALID_NAME);
+    } else if(value == NULL) {
+        snd_soft_error(AL_INVALID_VALUE);
+    } else switch(param) {
+    case AL_SOURCE_RELATIVE:   value[0] = src->relative; break;
+    case AL_LOOPING:           value[0] = src->looping; break;
+    case AL_SOURCE_STATE:      value[0] = src->state; break;
+    case AL_SOURCE_TYPE:       value[0] = src->type; break;
+    case AL_BUFFER:            value[0] = src->nr_queued > 0 ? (ALint) src->queue[src->current < src->nr_queued ? src->current : src->nr_queued-1] : 0; break;
+    case AL_BUFFERS_QUEUED:    value[0] = (ALint) src->nr_queued; break;
+    case AL_BUFFERS_PROCESSED: value[0] = src->type == AL_STREAMING ? (ALint) src->current : 0; break;
+    default:
+        mtx_unlock(&g_soft.lock);
+        snd_soft_GetSourcefv(id, param, &f);
+        value[0] = (ALint) f;
+        return;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_SourcePlayv(ALsizei n, const ALuint* ids) {
+    snd_soft_source_t* src;
+
+    mtx_lock(&g_soft.lock);
+    for(ALsizei i = 0; i < n; i++) {
+        src = snd_soft_source(ids[i]);
+        if(src == NULL) {
+            snd_soft_error(AL_INVALID_NAME);
+            continue;
+        }
+        /* playing a playing or stopped source starts over, unless an offset was set while it was stopped */
+        if(src->state == AL_PLAYING || (src->state == AL_STOPPED && !src->offset_pending)) {
+            src->current = 0;
+            src->position_fixed = 0;
+        }
+        src->offset_pending = false;
+        src->state = src->nr_queued > 0 ? AL_PLAYING : AL_STOPPED;
+        src->tail_frames = 0;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_SourceStopv(ALsizei n, const ALuint* ids) {
+    snd_soft_source_t* src;
+
+    mtx_lock(&g_soft.lock);
+    for(ALsizei i = 0; i < n; i++) {
+        src = snd_soft_source(ids[i]);
+        if(src == NULL) {
+            snd_soft_error(AL_INVALID_NAME);
+            continue;
+        }
+        if(src->state == AL_PLAYING) {
+            src->tail_frames = snd_dsp_chain_tail_frames(src->nr_dsp, src->dsp, g_soft.params.frequency_hz);
+        }
+        if(src->state != AL_INITIAL) {
+            src->state = AL_STOPPED;
+            src->current = src->nr_queued;
+            src->position_fixed = 0;
+        }
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_SourceRewindv(ALsizei n, const ALuint* ids) {
+    snd_soft_source_t* src;
+
+    mtx_lock(&g_soft.lock);
+    for(ALsizei i = 0; i < n; i++) {
+        src = snd_soft_source(ids[i]);
+        if(src == NULL) {
+            snd_soft_error(AL_INVALID_NAME);
+            continue;
+        }
+        src->state = AL_INITIAL;
+        src->current = 0;
+        src->position_fixed = 0;
+        src->offset_pending = false;
+        src->tail_frames = 0;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_SourcePausev(ALsizei n, const ALuint* ids) {
+    snd_soft_source_t* src;
+
+    mtx_lock(&g_soft.lock);
+    for(ALsizei i = 0; i < n; i++) {
+        src = snd_soft_source(ids[i]);
+        if(src == NULL) {
+            snd_soft_error(AL_INVALID_NAME);
+            continue;
+        }
+        if(src->state == AL_PLAYING) {
+            src->state = AL_PAUSED;
+        }
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_SourceQueueBuffers(ALuint id, ALsizei n, const ALuint* ids) {
+    snd_soft_source_t* src; snd_soft_buffer_t* buf; snd_soft_buffer_t* first;
+
+    mtx_lock(&g_soft.lock);
+    src = snd_soft_source(id);
+    if(src == NULL) {
+        snd_soft_error(AL_INVALID_NAME);
+        mtx_unlock(&g_soft.lock);
+        return;
+    }
+    if(src->type == AL_STATIC || n < 0 || src->nr_queued + (uint32_t) n > SND_SOFT_MAX_QUEUE) {
+        snd_soft_error(src->type == AL_STATIC ? AL_INVALID_OPERATION : AL_INVALID_VALUE);
+        mtx_unlock(&g_soft.lock);
+        return;
+    }
+    first = src->nr_queued > 0 ? snd_soft_buffer(src->queue[0]) : NULL;
+    for(ALsizei i = 0; i < n; i++) {
+        buf = snd_soft_buffer(ids[i]);
+        /* all buffers in a queue need the same layout */
+        if(buf == NULL || (first != NULL && (buf->channels != first->channels || buf->bits != first->bits))) {
+            snd_soft_error(buf == NULL ? AL_INVALID_NAME : AL_INVALID_OPERATION);
+            mtx_unlock(&g_soft.lock);
+            return;
+        }
+        if(first == NULL) {
+            first = buf;
+        }
+    }
+    for(ALsizei i = 0; i < n; i++) {
+        src->queue[src->nr_queued++] = ids[i];
+        g_soft.buffers[ids[i]-1].nr_users++;
+    }
+    src->type = AL_STREAMING;
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_SourceUnqueueBuffers(ALuint id, ALsizei n, ALuint* ids) {
+    snd_soft_source_t* src; snd_soft_buffer_t* buf;
+
+    mtx_lock(&g_soft.lock);
+    src = snd_soft_source(id);
+    if(src == NULL) {
+        snd_soft_error(AL_INVALID_NAME);
+    } else if(n < 0 || src->type != AL_STREAMING || (uint32_t) n > src->current) {
+        snd_soft_error(AL_INVALID_VALUE);
+    } else {
+        for(ALsizei i = 0; i < n; i++) {
+            ids[i] = src->queue[i];
+            buf = snd_soft_buffer(ids[i]);
+            if(buf != NULL) {
+                buf->nr_users--;
+            }
+        }
+        memmove(src->queue, src->queue + n, (src->nr_queued - n) * sizeof(ALuint));
+        src->nr_queued -= n;
+        src->current -= n;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+
+static void AL_APIENTRY snd_soft_GenBuffers(ALsizei n, ALuint* ids) {
+    snd_soft_buffer_t* new_buffers; uint32_t found = 0, old_cap;
+
+    mtx_lock(&g_soft.lock);
+    if(n < 0) {
+        snd_soft_error(AL_INVALID_VALUE);
+        mtx_unlock(&g_soft.lock);
+        return;
+    }
+    for(uint32_t i = 0; i < g_soft.buffers_cap && found < (uint32_t) n; i++) {
+        if(!g_soft.buffers[i].used) {
+            ids[found++] = i + 1;
+        }
+    }
+    if(found < (uint32_t) n) {
+        old_cap = g_soft.buffers_cap;
+        new_buffers = realloc(g_soft.buffers, (old_cap + (n - found) + 64) * sizeof(snd_soft_buffer_t));
+        if(new_buffers == NULL) {
+            snd_soft_error(AL_OUT_OF_MEMORY);
+            mtx_unlock(&g_soft.lock);
+            return;
+        }
+        g_soft.buffers = new_buffers;
+        g_soft.buffers_cap = old_cap + (n - found) + 64;
+        memset(&(g_soft.buffers[old_cap]), 0, (g_soft.buffers_cap - old_cap) * sizeof(snd_soft_buffer_t));
+        for(uint32_t i = old_cap; found < (uint32_t) n; i++) {
+            ids[found++] = i + 1;
+        }
+    }
+    for(ALsizei i = 0; i < n; i++) {
+        memset(&(g_soft.buffers[ids[i]-1]), 0, sizeof(snd_soft_buffer_t));
+        g_soft.buffers[ids[i]-1].used = true;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_DeleteBuffers(ALsizei n, const ALuint* ids) {
+    snd_soft_buffer_t* buf;
+
+    mtx_lock(&g_soft.lock);
+    for(ALsizei i = 0; i < n; i++) {
+        buf = snd_soft_buffer(ids[i]);
+        if(ids[i] != 0 && (buf == NULL || buf->nr_users > 0)) {
+            snd_soft_error(buf == NULL ? AL_INVALID_NAME : AL_INVALID_OPERATION);
+            mtx_unlock(&g_soft.lock);
+            return;
+        }
+    }
+    for(ALsizei i = 0; i < n; i++) {
+        buf = snd_soft_buffer(ids[i]);
+        if(buf != NULL) {
+            free(buf->samples);
+            memset(buf, 0, sizeof(snd_soft_buffer_t));
+        }
+    }
+    mtx_unlock(&g_soft.lock);
+}
+static ALboolean AL_APIENTRY snd_soft_IsBuffer(ALuint id) {
+    ALboolean b;
+    mtx_lock(&g_soft.lock);
+    b = id == 0 || snd_soft_buffer(id) != NULL ? AL_TRUE : AL_FALSE;
+    mtx_unlock(&g_soft.lock);
+    return b;
+}
+static void AL_APIENTRY snd_soft_BufferData(ALuint id, ALenum format, const ALvoid* data, ALsizei size, ALsizei frequency) {
+    snd_soft_buffer_t* buf; uint32_t channels, bits, nr_samples; float* samples;
+
+    switch(format) {
+    case AL_FORMAT_MONO8:          channels = 1; bits = 8;  break;
+    case AL_FORMAT_MONO16:         channels = 1; bits = 16; break;
+    case AL_FORMAT_STEREO8:        channels = 2; bits = 8;  break;
+    case AL_FORMAT_STEREO16:       channels = 2; bits = 16; break;
+    case AL_FORMAT_MONO_FLOAT32:   channels = 1; bits = 32; break;
+    case AL_FORMAT_STEREO_FLOAT32: channels = 2; bits = 32; break;
+    default:
+        mtx_lock(&g_soft.lock);
+        snd_soft_error(AL_INVALID_ENUM);
+        mtx_unlock(&g_soft.lock);
+        return;
+    }
+
+    mtx_lock(&g_soft.lock);
+    buf = snd_soft_buffer(id);
+    if(buf == NULL || buf->nr_users > 0 || size < 0 || frequency <= 0 || (data == NULL && size > 0) || size % (channels * bits / 8) != 0) {
+        snd_soft_error(buf == NULL ? AL_INVALID_NAME : (buf->nr_users > 0 ? AL_INVALID_OPERATION : AL_INVALID_VALUE));
+        mtx_unlock(&g_soft.lock);
+        return;
+    }
+    nr_samples = (uint32_t) size / (bits / 8);
+    samples = malloc((size_t) nr_samples * sizeof(float) + sizeof(float));
+    if(samples == NULL) {
+        snd_soft_error(AL_OUT_OF_MEMORY);
+        mtx_unlock(&g_soft.lock);
+        return;
+    }
+    if(bits == 8) {
+        for(uint32_t i = 0; i < nr_samples; i++) {
+            samples[i] = ((float)((const uint8_t*) data)[i] - 128.0f) * (1.0f / 128.0f);
+        }
+    } else if(bits == 16) {
+        snd_convert_int16_to_float32(nr_samples, data, samples);
+    } else {
+        memcpy(samples, data, (size_t) nr_samples * sizeof(float));
+    }
+
+    free(buf->samples);
+    buf->samples = samples;
+    buf->channels = channels;
+    buf->bits = bits;
+    buf->frequency_hz = (uint32_t) frequency;
+    buf->nr_frames = nr_samples / channels;
+    buf->size = (uint32_t) size;
+    mtx_unlock(&g_soft.lock);
+}
+static void AL_APIENTRY snd_soft_GetBufferi(ALuint id, ALenum param, ALint* value) {
+    snd_soft_buffer_t* buf;
+
+    mtx_lock(&g_soft.lock);
+    buf = snd_soft_buffer(id);
+    if(buf == NULL) {
+        snd_soft_error(AL_INVALID_NAME);
+    } else if(value == NULL) {
+        snd_soft_error(AL_INVALID_VALUE);
+    } else switch(param) {
+    case AL_FREQUENCY: value[0] = (ALint) buf->frequency_hz; break;
+    case AL_BITS:      value[0] = (ALint) buf->bits; break;
+    case AL_CHANNELS:  value[0] = (ALint) buf->channels; break;
+    case AL_SIZE:      value[0] = (ALint) buf->size; break;
+    default:
+        snd_soft_error(AL_INVALID_ENUM);
+        break;
+    }
+    mtx_unlock(&g_soft.lock);
+}
+
+static void snd_soft_load_al(void) {
+    g_al.c.CreateContext      = snd_soft_CreateContext;
+    g_al.c.MakeContextCurrent = snd_soft_MakeContextCurrent;
+    g_al.c.ProcessContext     = snd_soft_ProcessContext;
+    g_al.c.SuspendContext     = snd_soft_SuspendContext;
+    g_al.c.DestroyContext     = snd_soft_DestroyContext;
+    g_al.c.GetCurrentContext  = snd_soft_GetCurrentContext;
+    g_al.c.GetContextsDevice  = snd_soft_GetContextsDevice;
+    g_al.c.OpenDevice         = snd_soft_OpenDevice;
+    g_al.c.CloseDevice        = snd_soft_CloseDevice;
+    g_al.c.GetError           = snd_soft_alcGetError;
+    g_al.c.GetString          = snd_soft_alcGetString;
+    g_al.c.GetIntegerv        = snd_soft_alcGetIntegerv;
+    g_al.c.CaptureOpenDevice  = snd_soft_CaptureOpenDevice;
+    g_al.c.CaptureCloseDevice = snd_soft_CaptureCloseDevice;
+    g_al.c.CaptureStart       = snd_soft_CaptureStart;
+    g_al.c.CaptureStop        = snd_soft_CaptureStop;
+    g_al.c.CaptureSamples     = snd_soft_CaptureSamples;
+    g_al.c.IsExtensionPresent = snd_soft_alcIsExtensionPresent;
+    g_al.c.GetProcAddress     = snd_soft_alcGetProcAddress;
+    g_al.GetString            = snd_soft_GetString;
+    g_al.GetInteger           = snd_soft_GetInteger;
+    g_al.GetFloat             = snd_soft_GetFloat;
+    g_al.GetError             = snd_soft_GetError;
+    g_al.IsExtensionPresent   = snd_soft_IsExtensionPresent;
+    g_al.GetProcAddress       = snd_soft_GetProcAddress;
+    g_al.DopplerFactor        = snd_soft_DopplerFactor;
+    g_al.SpeedOfSound         = snd_soft_SpeedOfSound;
+    g_al.DistanceModel        = snd_soft_DistanceModel;
+    g_al.Listenerf            = snd_soft_Listenerf;
+    g_al.Listenerfv           = snd_soft_Listenerfv;
+    g_al.GetListenerf         = snd_soft_GetListenerf;
+    g_al.GetListenerfv        = snd_soft_GetListenerfv;
+    g_al.GenSources           = snd_soft_GenSources;
+    g_al.DeleteSources        = snd_soft_DeleteSources;
+    g_al.IsSource             = snd_soft_IsSource;
+    g_al.Sourcef              = snd_soft_Sourcef;
+    g_al.Sourcefv             = snd_soft_Sourcefv;
+    g_al.Sourcei              = snd_soft_Sourcei;
+    g_al.GetSourcef           = snd_soft_GetSourcef;
+    g_al.GetSourcefv          = snd_soft_GetSourcefv;
+    g_al.GetSourcei           = snd_soft_GetSourcei;
+    g_al.SourcePlayv          = snd_soft_SourcePlayv;
+    g_al.SourceStopv          = snd_soft_SourceStopv;
+    g_al.SourceRewindv        = snd_soft_SourceRewindv;
+    g_al.SourcePausev         = snd_soft_SourcePausev;
+    g_al.SourceQueueBuffers   = snd_soft_SourceQueueBuffers;
+    g_al.SourceUnqueueBuffers = snd_soft_SourceUnqueueBuffers;
+    g_al.GenBuffers           = snd_soft_GenBuffers;
+    g_al.DeleteBuffers        = snd_soft_DeleteBuffers;
+    g_al.IsBuffer             = snd_soft_IsBuffer;
+    g_al.BufferData           = snd_soft_BufferData;
+    g_al.GetBufferi           = snd_soft_GetBufferi;
+}
+
+static float snd_soft_dot(const float* a, const float* b) {
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+static float snd_soft_distance_gain(const snd_soft_context_t* ctx, const snd_soft_source_t* src, float distance) {
+    return snd_distance_gain(ctx->distance_model, distance, src->reference_distance, src->max_distance, src->rolloff_factor);
+}
+/* gain, direction as a unit vector in listener space (x to the right, y up, z to the front) and doppler shifted
+ * pitch of a source */
+static void snd_soft_source_spatialize(const snd_soft_context_t* ctx, const snd_soft_source_t* src, const snd_soft_buffer_t* buf, float* out_gain, float* out_direction, float* out_pitch) {
+    float rel[3], sl[3], right[3], up[3], dir[3], distance, g, angle, vls, vss, limit, cone, len;
+    const float* f = ctx->listener_orientation; const float* u = ctx->listener_orientation + 3;
+
+    g = src->gain;
+    out_pitch[0] = src->pitch;
+    out_direction[0] = 0.0f;
+    out_direction[1] = 0.0f;
+    out_direction[2] = 1.0f;
+    /* like AL, only mono buffers are positioned, stereo is played as is */
+    if(buf->channels != 1) {
+        g = g < src->min_gain ? src->min_gain : (g > src->max_gain ? src->max_gain : g);
+        out_gain[0] = g * ctx->listener_gain;
+        return;
+    }
+
+    for(int i = 0; i < 3; i++) {
+        rel[i] = src->relative ? src->position[i] : src->position[i] - ctx->listener_position[i];
+    }
+    distance = sqrtf(snd_soft_dot(rel, rel));
+    g *= snd_soft_distance_gain(ctx, src, distance);
+
+    if(distance > 0.0f && (src->cone_inner_angle < 360.0f || src->cone_outer_angle < 360.0f) && snd_soft_dot(src->direction, src->direction) > 0.0f) {
+        for(int i = 0; i < 3; i++) {
+            dir[i] = src->direction[i] / sqrtf(snd_soft_dot(src->direction, src->direction));
+        }
+        /* angle between the source direction and the way from the source to the listener */
+        angle = acosf(-snd_soft_dot(dir, rel) / distance) * (360.0f / 3.14159265f);
+        if(angle <= src->cone_inner_angle) {
+            cone = 1.0f;
+        } else if(angle >= src->cone_outer_angle) {
+            cone = src->cone_outer_gain;
+        } else {
+            cone = 1.0f + (src->cone_outer_gain - 1.0f) * (angle - src->cone_inner_angle) / (src->cone_outer_angle - src->cone_inner_angle);
+        }
+        g *= cone;
+    }
+    g = g < src->min_gain ? src->min_gain : (g > src->max_gain ? src->max_gain : g);
+    out_gain[0] = g * ctx->listener_gain;
+
+    /* relative sources are already in listener space, where AL looks down -z */
+    if(distance > 0.0f) {
+        if(src->relative) {
+            out_direction[0] = rel[0] / distance;
+            out_direction[1] = rel[1] / distance;
+            out_direction[2] = -rel[2] / distance;
+        } else {
+            right[0] = f[1]*u[2] - f[2]*u[1];
+            right[1] = f[2]*u[0] - f[0]*u[2];
+            right[2] = f[0]*u[1] - f[1]*u[0];
+            up[0] = right[1]*f[2] - right[2]*f[1];
+            up[1] = right[2]*f[0] - right[0]*f[2];
+            up[2] = right[0]*f[1] - right[1]*f[0];
+            len = sqrtf(snd_soft_dot(right, right));
+            if(len > 0.0f) {
+                out_direction[0] = snd_soft_dot(rel, right) / (distance * len);
+                out_direction[1] = snd_soft_dot(rel, up) / (distance * sqrtf(snd_soft_dot(up, up)));
+                out_direction[2] = snd_soft_dot(rel, f) / (distance * sqrtf(snd_soft_dot(f, f)));
+            }
+        }
+    }
+
+    if(ctx->doppler_factor > 0.0f && distance > 0.0f) {
+        /* AL projects the velocities on the way from the source to the listener, so approaching raises the pitch */
+        for(int i = 0; i < 3; i++) {
+            sl[i] = -rel[i];
+        }
+        limit = ctx->speed_of_sound / ctx->doppler_factor;
+        vls = snd_soft_dot(ctx->listener_velocity, sl) / distance;
+        vss = snd_soft_dot(src->velocity, sl) / distance;
+        vls = vls < limit ? vls : limit;
+        vss = vss < limit ? vss : limit;
+        out_pitch[0] *= (ctx->speed_of_sound - ctx->doppler_factor * vls) / (ctx->speed_of_sound - ctx->doppler_factor * vss);
+    }
+}
+/* kept free of branches and calls so it vectorizes */
+static void snd_soft_accumulate(uint32_t nr_frames, const float* restrict in, float gain_l, float gain_r, float* restrict out) {
+    for(uint32_t i = 0; i < nr_frames; i++) {
+        out[2*i]     += in[2*i]     * gain_l;
+        out[2*i + 1] += in[2*i + 1] * gain_r;
+    }
+}
+static int snd_soft_hrtf_rank_compare(const void* a, const void* b) {
+    const snd_soft_hrtf_rank_t* ra = a; const snd_soft_hrtf_rank_t* rb = b;
+    /* ties go by source, qsort isn't stable and the choice has to be the same on every run */
+    if(ra->gain != rb->gain) {
+        return ra->gain < rb->gain ? 1 : -1;
+    }
+    return ra->source < rb->source ? -1 : (ra->source > rb->source ? 1 : 0);
+}
+/* picks the loudest playing mono sources for a convolution of their own in the next block */
+static void snd_soft_hrtf_rank(void) {
+    snd_soft_source_t* src; snd_soft_buffer_t* buf; snd_soft_hrtf_rank_t* rank; float gain, direction[3], pitch;
+    uint32_t n = 0, nr_direct = 0; size_t fdl_size = (size_t) g_soft.hrtf->nr_partitions * SND_DSP_FFT_SIZE;
+
+    if(g_soft.hrtf_rank_cap < g_soft.sources_cap) {
+        rank = realloc(g_soft.hrtf_rank, g_soft.sources_cap * sizeof(snd_soft_hrtf_rank_t));
+        if(rank != NULL) {
+            g_soft.hrtf_rank = rank;
+            g_soft.hrtf_rank_cap = g_soft.sources_cap;
+        }
+    }
+    for(uint32_t i = 0; i < g_soft.sources_cap; i++) {
+        src = &(g_soft.sources[i]);
+        buf = src->context != NULL && src->state == AL_PLAYING && src->current < src->nr_queued ? snd_soft_buffer(src->queue[src->current]) : NULL;
+        src->hrtf_direct = false;
+        if(buf == NULL || buf->channels != 1) {
+            if(src->hrtf_fed) {
+                memset(src->hrtf.input, 0, sizeof(src->hrtf.input));
+                src->hrtf_fed = false;
+            }
+            src->hrtf_was_direct = false;
+            continue;
+        }
+        src->hrtf_fed = true;
+        if(n < g_soft.hrtf_rank_cap) {
+            snd_soft_source_spatialize(src->context, src, buf, &gain, direction, &pitch);
+            /* a bit of hysteresis, so sources of about the same loudness don't keep trading places */
+            g_soft.hrtf_rank[n].gain = src->hrtf_was_direct ? 1.25f * gain : gain;
+            g_soft.hrtf_rank[n].source = i;
+            n++;
+        }
+    }
+    if(n > g_soft.hrtf_max_direct) {
+        qsort(g_soft.hrtf_rank, n, sizeof(snd_soft_hrtf_rank_t), snd_soft_hrtf_rank_compare);
+    }
+
+    for(uint32_t i = 0; i < n && i < g_soft.hrtf_max_direct; i++) {
+        src = &(g_soft.sources[g_soft.hrtf_rank[i].source]);
+        if(!src->hrtf_was_direct) {
+            if(src->hrtf.fdl_re == NULL) {
+                src->hrtf.fdl_re = malloc(2 * fdl_size * sizeof(float));
+                if(src->hrtf.fdl_re == NULL) {
+                    continue;
+                }
+                src->hrtf.fdl_im = src->hrtf.fdl_re + fdl_size;
+            }
+            /* the input of the last block is there, only older spectra are missing and fade in with the crossfade */
+            memset(src->hrtf.fdl_re, 0, 2 * fdl_size * sizeof(float));
+            src->hrtf.fdl_pos = 0;
+            src->hrtf.filter = SND_HRTF_NO_FILTER;
+        }
+        src->hrtf_direct = true;
+        nr_direct++;
+    }
+    g_soft.hrtf_nr_direct = nr_direct;
+    g_soft.hrtf_nr_bed = n - nr_direct;
+}
+/* a source's block in g_soft.scratch goes through its own convolution or onto the bed, and crossfades between the
+ * two when it was moved from one to the other */
+static void snd_soft_hrtf_mix(snd_soft_source_t* src, float gain, const float* direction, float* out) {
+    float mono[SND_SOFT_BLOCK_FRAMES], gains[SND_HRTF_BED_SPEAKERS], w0, w1, dw, g;
+
+    for(uint32_t i = 0; i < SND_SOFT_BLOCK_FRAMES; i++) {
+        mono[i] = 0.5f * (g_soft.scratch[2*i] + g_soft.scratch[2*i + 1]);
+    }
+    w0 = src->hrtf_was_direct ? 1.0f : 0.0f;
+    w1 = src->hrtf_direct ? 1.0f : 0.0f;
+    if(src->hrtf_direct || src->hrtf_was_direct) {
+        snd_hrtf_convolve(g_soft.hrtf, &(src->hrtf), mono, snd_hrtf_nearest(g_soft.hrtf, direction), gain, w0, w1, out);
+    } else {
+        snd_hrtf_channel_feed(&(src->hrtf), mono);
+    }
+    if(w0 < 1.0f || w1 < 1.0f) {
+        snd_hrtf_bed_gains(direction, gains);
+        dw = (w1 - w0) / SND_SOFT_BLOCK_FRAMES;
+        for(uint32_t s = 0; s < SND_HRTF_BED_SPEAKERS; s++) {
+            if(gains[s] <= 0.0f) {
+                continue;
+            }
+            g = gain * gains[s];
+            for(uint32_t i = 0; i < SND_SOFT_BLOCK_FRAMES; i++) {
+                g_soft.bed_mix[s][i] += mono[i] * g * (1.0f - w0 - dw * (float)(i + 1));
+            }
+            g_soft.bed_active[s] = true;
+        }
+    }
+    src->hrtf_was_direct = src->hrtf_direct;
+}
+/* convolves the virtual speakers, a silent one keeps going until its tail has played out */
+static void snd_soft_hrtf_bed_process(float* out) {
+    for(uint32_t s = 0; s < SND_HRTF_BED_SPEAKERS; s++) {
+        if(!g_soft.bed_active[s] && g_soft.bed_silent_blocks[s] > g_soft.hrtf->nr_partitions + 1) {
+            continue;
+        }
+        g_soft.bed_silent_blocks[s] = g_soft.bed_active[s] ? 0 : g_soft.bed_silent_blocks[s] + 1;
+        snd_hrtf_convolve(g_soft.hrtf, &(g_soft.bed[s]), g_soft.bed_mix[s], g_soft.bed[s].filter, 1.0f, 1.0f, 1.0f, out);
+        memset(g_soft.bed_mix[s], 0, sizeof(g_soft.bed_mix[s]));
+        g_soft.bed_active[s] = false;
+    }
+}
+/* a stopped source's chain running out on silence, so delays and reverbs aren't cut off */
+static void snd_soft_mix_tail(snd_soft_source_t* src, uint32_t nr_frames, float* out) {
+    memset(g_soft.scratch, 0, 2 * nr_frames * sizeof(float));
+    snd_dsp_chain_process(src->nr_dsp, src->dsp, g_soft.scratch);
+    snd_soft_accumulate(nr_frames, g_soft.scratch, src->tail_gain[0], src->tail_gain[1], out);
+    src->tail_frames = src->tail_frames > nr_frames ? src->tail_frames - nr_frames : 0;
+}
+static void snd_soft_mix_source(snd_soft_source_t* src, uint32_t nr_frames, float* out) {
+    snd_soft_buffer_t* buf; float gain, direction[3], gain_l, gain_r, pan, pitch, s0, s1, frac; bool hrtf;
+    uint64_t step, end, idx; uint32_t done = 0, nr_empty = 0; double start;
+
+    if(src->state != AL_PLAYING) {
+        snd_soft_mix_tail(src, nr_frames, out);
+        return;
+    }
+    buf = src->current < src->nr_queued ? snd_soft_buffer(src->queue[src->current]) : NULL;
+    if(buf == NULL) {
+        src->state = AL_STOPPED;
+        return;
+    }
+    snd_soft_source_spatialize(src->context, src, buf, &gain, direction, &pitch);
+    /* the HRTF path always works on whole blocks, which render hands over */
+    hrtf = g_soft.hrtf != NULL && buf->channels == 1 && nr_frames == SND_SOFT_BLOCK_FRAMES;
+    if(buf->channels != 1) {
+        gain_l = gain_r = gain;
+    } else {
+        /* equal power panning on the listener's right axis */
+        pan = direction[0] < -1.0f ? -1.0f : (direction[0] > 1.0f ? 1.0f : direction[0]);
+        gain_l = gain * cosf((pan + 1.0f) * 0.78539816f);
+        gain_r = gain * sinf((pan + 1.0f) * 0.78539816f);
+    }
+
+    while(done < nr_frames && src->state == AL_PLAYING) {
+        buf = snd_soft_buffer(src->queue[src->current]);
+        step = (uint64_t)((double) buf->frequency_hz / g_soft.params.frequency_hz * pitch * (double) SND_SOFT_ONE);
+        step = step == 0 ? 1 : step;
+        end = (uint64_t) buf->nr_frames << 32;
+
+        /* linear interpolation, the last frame of a buffer is held instead of reading into the next one */
+        while(done < nr_frames && src->position_fixed < end) {
+            idx = src->position_fixed >> 32;
+            frac = (float)(src->position_fixed & 0xffffffffu) * (1.0f / 4294967296.0f);
+            for(uint32_t c = 0; c < 2; c++) {
+                s0 = buf->samples[idx * buf->channels + (c % buf->channels)];
+                s1 = idx + 1 < buf->nr_frames ? buf->samples[(idx + 1) * buf->channels + (c % buf->channels)] : s0;
+                g_soft.scratch[2*done + c] = s0 + (s1 - s0) * frac;
+            }
+            src->position_fixed += step;
+            done++;
+        }
+        if(src->position_fixed >= end) {
+            /* a queue of only empty buffers would loop forever */
+            nr_empty = buf->nr_frames == 0 ? nr_empty + 1 : 0;
+            src->position_fixed -= end;
+            if(src->current + 1 < src->nr_queued) {
+                src->current++;
+            } else if(src->looping && nr_empty <= src->nr_queued) {
+                src->current = 0;
+            } else {
+                src->state = AL_STOPPED;
+                src->current = src->nr_queued;
+                src->position_fixed = 0;
+                src->tail_frames = snd_dsp_chain_tail_frames(src->nr_dsp, src->dsp, g_soft.params.frequency_hz);
+            }
+        }
+    }
+    src->tail_gain[0] = gain_l;
+    src->tail_gain[1] = gain_r;
+
+    if(src->nr_dsp > 0 || hrtf) {
+        /* a source stopping inside the block still gets a whole one, filled up with silence */
+        memset(g_soft.scratch + 2 * done, 0, 2 * (nr_frames - done) * sizeof(float));
+        done = nr_frames;
+    }
+    if(src->nr_dsp > 0) {
+        snd_dsp_chain_process(src->nr_dsp, src->dsp, g_soft.scratch);
+    }
+    if(hrtf) {
+        start = snd_seconds_now();
+        snd_soft_hrtf_mix(src, gain, direction, out);
+        g_soft.hrtf_seconds += snd_seconds_now() - start;
+    } else {
+        snd_soft_accumulate(done, g_soft.scratch, gain_l, gain_r, out);
+    }
+}
+static void snd_soft_wav_header(FILE* f, uint64_t nr_frames) {
+    uint8_t h[44]; uint32_t data_size = (uint32_t)(nr_frames * 8);
+    uint32_t fields[] = { 36 + data_size, 16, 3 | (2 << 16), g_soft.params.frequency_hz, g_soft.params.frequency_hz * 8, 8 | (32 << 16), data_size };
+    uint32_t offsets[] = { 4, 16, 20, 24, 28, 32, 40 };
+
+    memset(h, 0, 44);
+    memcpy(h, "RIFF", 4);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    memcpy(h + 36, "data", 4);
+    for(int i = 0; i < 7; i++) {
+        for(int b = 0; b < 4; b++) {
+            h[offsets[i] + b] = (uint8_t)(fields[i] >> (8 * b));
+        }
+    }
+    fseek(f, 0, SEEK_SET);
+    fwrite(h, 1, 44, f);
+    fseek(f, 0, SEEK_END);
+}
+
+static void snd_soft_streams_update(void);
+
+/* Mixes block by block; between blocks the streams are refilled, without the lock since that goes through AL.
+ * Nothing depends on the time it takes, so the same calls give the same output on every run. */
+static snd_result_t snd_soft_render(uint32_t nr_frames, float* out_frames) {
+    uint32_t n; double start, render_start;
+
+#ifndef SND_NO_CHECKS
+    /* only set up by snd_init_backend with SND_BACKEND_TYPE_SOFTWARE */
+    if(g_soft.params.frequency_hz == 0) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    render_start = snd_seconds_now();
+    while(nr_frames > 0) {
+        if(g_soft.block_pos == SND_SOFT_BLOCK_FRAMES) {
+            snd_soft_streams_update();
+        }
+        mtx_lock(&g_soft.lock);
+        if(g_soft.block_pos == SND_SOFT_BLOCK_FRAMES) {
+            memset(g_soft.mix, 0, sizeof(g_soft.mix));
+            if(g_soft.hrtf != NULL) {
+                start = snd_seconds_now();
+                snd_soft_hrtf_rank();
+                g_soft.hrtf_seconds += snd_seconds_now() - start;
+            }
+            for(uint32_t i = 0; i < g_soft.sources_cap; i++) {
+                if(g_soft.sources[i].context != NULL && (g_soft.sources[i].state == AL_PLAYING || g_soft.sources[i].tail_frames > 0)) {
+                    snd_soft_mix_source(&(g_soft.sources[i]), SND_SOFT_BLOCK_FRAMES, g_soft.mix);
+                }
+            }
+            if(g_soft.hrtf != NULL) {
+                start = snd_seconds_now();
+                snd_soft_hrtf_bed_process(g_soft.mix);
+                g_soft.hrtf_seconds += snd_seconds_now() - start;
+                g_soft.hrtf_blocks++;
+            }
+            snd_dsp_chain_process(g_soft.nr_master, g_soft.master, g_soft.mix);
+            g_soft.block_pos = 0;
+        }
+        n = SND_SOFT_BLOCK_FRAMES - g_soft.block_pos;
+        n = nr_frames < n ? nr_frames : n;
+        if(g_soft.params.sink != NULL) {
+            g_soft.params.sink(g_soft.params.user_data, g_soft.mix + 2 * g_soft.block_pos, n);
+        }
+        if(g_soft.wav != NULL) {
+            fwrite(g_soft.mix + 2 * g_soft.block_pos, sizeof(float) * 2, n, g_soft.wav);
+            g_soft.wav_frames += n;
+        }
+        if(out_frames != NULL) {
+            memcpy(out_frames, g_soft.mix + 2 * g_soft.block_pos, 2 * n * sizeof(float));
+            out_frames += 2 * n;
+        }
+        g_soft.block_pos += n;
+        g_soft.frames_rendered += n;
+        nr_frames -= n;
+        mtx_unlock(&g_soft.lock);
+    }
+    mtx_lock(&g_soft.lock);
+    g_soft.render_seconds += snd_seconds_now() - render_start;
+    mtx_unlock(&g_soft.lock);
+
+    return SND_OK;
+}
+snd_result_t snd_software_render(uint32_t nr_frames) {
+    return snd_soft_render(nr_frames, NULL);
+}
+snd_result_t snd_software_render_to_memory(uint32_t nr_frames, float* out_frames) {
+#ifndef SND_NO_CHECKS
+    if(out_frames == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    return snd_soft_render(nr_frames, out_frames);
+}
+snd_result_t snd_software_render_stats_get(snd_software_render_stats_t* out_stats) {
+#ifndef SND_NO_CHECKS
+    if(out_stats == NULL || g_soft.params.frequency_hz == 0) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    mtx_lock(&g_soft.lock);
+    out_stats->nr_frames = g_soft.frames_rendered;
+    out_stats->seconds_total = g_soft.render_seconds;
+    out_stats->realtime_factor = g_soft.render_seconds > 0.0 ? (double) g_soft.frames_rendered / g_soft.params.frequency_hz / g_soft.render_seconds : 0.0;
+    mtx_unlock(&g_soft.lock);
+    return SND_OK;
+}
+static snd_result_t snd_soft_init(const snd_software_backend_params_t* params) {
+    memset(&g_soft, 0, sizeof(g_soft));
+    g_soft.params = params[0];
+    if(g_soft.params.frequency_hz == 0) {
+        g_soft.params.frequency_hz = 48000;
+    }
+    g_soft.block_pos = SND_SOFT_BLOCK_FRAMES;
+    if(mtx_init(&g_soft.lock, mtx_plain) != thrd_success) {
+        return SND_ERROR_UNKNOWN;
+    }
+    if(mtx_init(&g_soft.streams_lock, mtx_plain) != thrd_success) {
+        mtx_destroy(&g_soft.lock);
+        return SND_ERROR_UNKNOWN;
+    }
+    if(params->wav_path != NULL) {
+        g_soft.wav = fopen(params->wav_path, "wb");
+        if(g_soft.wav == NULL) {
+            mtx_destroy(&g_soft.streams_lock);
+            mtx_destroy(&g_soft.lock);
+            return SND_ERROR_FILE_IO;
+        }
+        snd_soft_wav_header(g_soft.wav, 0);
+    }
+    snd_soft_load_al();
+    return SND_OK;
+}
+static void snd_soft_exit(void) {
+    if(g_soft.wav != NULL) {
+        snd_soft_wav_header(g_soft.wav, g_soft.wav_frames);
+        fclose(g_soft.wav);
+    }
+    for(uint32_t i = 0; i < g_soft.buffers_cap; i++) {
+        free(g_soft.buffers[i].samples);
+    }
+    for(uint32_t i = 0; i < g_soft.sources_cap; i++) {
+        free(g_soft.sources[i].hrtf.fdl_re);
+    }
+    if(g_soft.hrtf != NULL) {
+        g_soft.hrtf->in_use = false;
+    }
+    free(g_soft.buffers);
+    free(g_soft.sources);
+    free(g_soft.hrtf_rank);
+    free(g_soft.bed_fdl);
+    free(g_soft.streams);
+    mtx_destroy(&g_soft.streams_lock);
+    mtx_destroy(&g_soft.lock);
+    memset(&g_soft, 0, sizeof(g_soft));
+}
+snd_result_t snd_dsp_node_create(const snd_dsp_node_params_t* params, snd_dsp_node_t* out_node) {
+    snd_result_t r; snd_dsp_node_state_t* node; float max_ms;
+
+#ifndef SND_NO_CHECKS
+    if(params == NULL || out_node == NULL || params->type < 0 || params->type > SND_DSP_NODE_TYPE_LIMITER) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    if(params->type == SND_DSP_NODE_TYPE_CONVOLUTION && (params->convolution.impulse_response == NULL || params->convolution.nr_frames == 0)) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    /* written this way round so NaN fails too; the line's length in samples has to fit a uint32_t */
+    if(params->type == SND_DSP_NODE_TYPE_DELAY && !(params->delay.delay_ms >= 0.0f && params->delay.max_delay_ms >= 0.0f
+    && fmaxf(params->delay.delay_ms, params->delay.max_delay_ms) * 0.001f * g_soft.params.frequency_hz < (float)(UINT32_MAX / 4))) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    if(g_al.backend != SND_BACKEND_TYPE_SOFTWARE) {
+        return SND_ERROR_BACKEND_NOT_SUPPORTED;
+    }
+
+    node = calloc(1, sizeof(snd_dsp_node_state_t));
+    if(node == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    node->params = params[0];
+    if(params->type == SND_DSP_NODE_TYPE_DELAY) {
+        max_ms = params->delay.max_delay_ms > params->delay.delay_ms ? params->delay.max_delay_ms : params->delay.delay_ms;
+        node->delay.capacity = 2 * (uint32_t) ceilf(max_ms * 0.001f * g_soft.params.frequency_hz);
+        node->delay.capacity = node->delay.capacity < 2 ? 2 : node->delay.capacity;
+        node->delay.line = calloc(node->delay.capacity, sizeof(float));
+        if(node->delay.line == NULL) {
+            free(node);
+            return SND_ERROR_OUT_OF_MEMORY;
+        }
+    } else if(params->type == SND_DSP_NODE_TYPE_CONVOLUTION) {
+        r = snd_dsp_convolution_init(node);
+        if(r != SND_OK) {
+            free(node);
+            return r;
+        }
+        /* the IR belongs to the caller, only its spectra are kept */
+        node->params.convolution.impulse_response = NULL;
+    }
+    snd_dsp_node_configure(node, (float) g_soft.params.frequency_hz);
+
+    out_node[0].handle = node;
+    return SND_OK;
+}
+snd_result_t snd_dsp_node_params_set(snd_dsp_node_t node, const snd_dsp_node_params_t* params) {
+    snd_dsp_node_state_t* n = node.handle;
+
+#ifndef SND_NO_CHECKS
+    if(n == NULL || params == NULL || params->type != n->params.type) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    /* the delay line was sized on create */
+    if(params->type == SND_DSP_NODE_TYPE_DELAY && !(params->delay.delay_ms >= 0.0f && 2.0f * roundf(params->delay.delay_ms * 0.001f * g_soft.params.frequency_hz) <= (float) n->delay.capacity)) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    mtx_lock(&g_soft.lock);
+    if(n->params.type == SND_DSP_NODE_TYPE_CONVOLUTION) {
+        /* changing the IR means a new node */
+        n->params.convolution.wet = params->convolution.wet;
+        n->params.convolution.dry = params->convolution.dry;
+    } else {
+        n->params = params[0];
+    }
+    snd_dsp_node_configure(n, (float) g_soft.params.frequency_hz);
+    mtx_unlock(&g_soft.lock);
+    return SND_OK;
+}
+snd_result_t snd_dsp_node_stats_get(snd_dsp_node_t node, snd_dsp_node_stats_t* out_stats) {
+    snd_dsp_node_state_t* n = node.handle;
+
+#ifndef SND_NO_CHECKS
+    if(n == NULL || out_stats == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    mtx_lock(&g_soft.lock);
+    out_stats->nr_blocks = n->nr_blocks;
+    out_stats->seconds_total = n->seconds_total;
+    out_stats->seconds_per_block = n->nr_blocks > 0 ? n->seconds_total / (double) n->nr_blocks : 0.0;
+    out_stats->load = out_stats->seconds_per_block * (double) g_soft.params.frequency_hz / SND_DSP_BLOCK_FRAMES;
+    mtx_unlock(&g_soft.lock);
+    return SND_OK;
+}
+/* Replaces *chain with nodes. A node keeps filter state, so it can only be in one chain at a time.
+ * Has to be called with the lock held; on failure the old chain stays. */
+static snd_result_t snd_dsp_chain_set(snd_dsp_node_state_t** chain, uint32_t* nr_chain, uint32_t nr_nodes, const snd_dsp_node_t* nodes) {
+    snd_dsp_node_state_t* n;
+
+    for(uint32_t i = 0; i < nr_chain[0]; i++) {
+        chain[i]->nr_users--;
+    }
+    for(uint32_t i = 0; i < nr_nodes; i++) {
+        n = nodes[i].handle;
+        if(n == NULL || n->nr_users > 0) {
+            for(uint32_t j = 0; j < i; j++) {
+                ((snd_dsp_node_state_t*) nodes[j].handle)->nr_users--;
+            }
+            for(uint32_t j = 0; j < nr_chain[0]; j++) {
+                chain[j]->nr_users++;
+            }
+            return n == NULL ? SND_ERROR_INVALID_PARAM : SND_ERROR_DSP_NODE_STILL_IN_USE;
+        }
+        n->nr_users++;
+    }
+    for(uint32_t i = 0; i < nr_nodes; i++) {
+        chain[i] = nodes[i].handle;
+    }
+    nr_chain[0] = nr_nodes;
+    return SND_OK;
+}
+snd_result_t snd_dsp_source_chain_set(snd_listener_context_t context, snd_source_t source, uint32_t nr_nodes, const snd_dsp_node_t* nodes) {
+    snd_result_t r; snd_soft_source_t* src;
+
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || nr_nodes > SND_DSP_MAX_CHAIN || (nr_nodes > 0 && nodes == NULL)) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    if(g_al.backend != SND_BACKEND_TYPE_SOFTWARE) {
+        return SND_ERROR_BACKEND_NOT_SUPPORTED;
+    }
+
+    mtx_lock(&g_soft.lock);
+    if(source.id == 0 || source.id > g_soft.sources_cap || g_soft.sources[source.id-1].context != (snd_soft_context_t*) context.handle) {
+        mtx_unlock(&g_soft.lock);
+        return SND_ERROR_INVALID_PARAM;
+    }
+    src = &(g_soft.sources[source.id-1]);
+    r = snd_dsp_chain_set(src->dsp, &(src->nr_dsp), nr_nodes, nodes);
+    if(r == SND_OK) {
+        /* the old chain's tail goes with it */
+        src->tail_frames = 0;
+    }
+    mtx_unlock(&g_soft.lock);
+    return r;
+}
+snd_result_t snd_dsp_master_chain_set(uint32_t nr_nodes, const snd_dsp_node_t* nodes) {
+    snd_result_t r;
+
+#ifndef SND_NO_CHECKS
+    if(nr_nodes > SND_DSP_MAX_CHAIN || (nr_nodes > 0 && nodes == NULL)) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    if(g_al.backend != SND_BACKEND_TYPE_SOFTWARE) {
+        return SND_ERROR_BACKEND_NOT_SUPPORTED;
+    }
+
+    mtx_lock(&g_soft.lock);
+    r = snd_dsp_chain_set(g_soft.master, &(g_soft.nr_master), nr_nodes, nodes);
+    mtx_unlock(&g_soft.lock);
+    return r;
+}
+snd_result_t snd_dsp_node_destroy(snd_dsp_node_t node) {
+    snd_dsp_node_state_t* n = node.handle;
+
+#ifndef SND_NO_CHECKS
+    if(n == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    mtx_lock(&g_soft.lock);
+    if(n->nr_users > 0) {
+        mtx_unlock(&g_soft.lock);
+        return SND_ERROR_DSP_NODE_STILL_IN_USE;
+    }
+    mtx_unlock(&g_soft.lock);
+
+    if(n->params.type == SND_DSP_NODE_TYPE_DELAY) {
+        free(n->delay.line);
+    } else if(n->params.type == SND_DSP_NODE_TYPE_CONVOLUTION) {
+        free(n->convolution.ir_re);
+    }
+    free(n);
+    return SND_OK;
+}
+snd_result_t snd_hrtf_create(const snd_hrtf_data_t* data, snd_hrtf_t* out_hrtf) {
+    snd_result_t r; snd_hrtf_state_t* h; float* pair; float* resampled = NULL; float* shifts; float* re; float* im;
+    float az, el, scale, min_delay = FLT_MAX, max_shift = 0.0f, d; size_t nr_frames, nr_resampled, part_size, t;
+    uint32_t out_hz = g_soft.params.frequency_hz, shift[2]; const float* ir; const float* ear;
+
+#ifndef SND_NO_CHECKS
+    if(data == NULL || out_hrtf == NULL || data->frequency_hz == 0 || data->nr_measurements == 0 || data->nr_frames == 0) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    if(data->directions == NULL || data->impulse_responses == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    if(g_al.backend != SND_BACKEND_TYPE_SOFTWARE) {
+        return SND_ERROR_BACKEND_NOT_SUPPORTED;
+    }
+
+    /* the delays in samples of the mixing frequency, less the smallest one so there's no common latency */
+    shifts = calloc(2 * (size_t) data->nr_measurements, sizeof(float));
+    if(shifts == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    if(data->delays != NULL) {
+        for(uint32_t i = 0; i < 2 * data->nr_measurements; i++) {
+            shifts[i] = data->delays[i] * (float) out_hz / (float) data->frequency_hz;
+            min_delay = shifts[i] < min_delay ? shifts[i] : min_delay;
+        }
+        for(uint32_t i = 0; i < 2 * data->nr_measurements; i++) {
+            shifts[i] = roundf(shifts[i] - min_delay);
+            max_shift = shifts[i] > max_shift ? shifts[i] : max_shift;
+        }
+    }
+    nr_frames = data->frequency_hz == out_hz ? data->nr_frames : (size_t)(((uint64_t) data->nr_frames * out_hz + data->frequency_hz - 1) / data->frequency_hz);
+    nr_frames += (size_t) max_shift;
+
+    h = calloc(1, sizeof(snd_hrtf_state_t));
+    pair = malloc(2 * (size_t) data->nr_frames * sizeof(float));
+    if(h == NULL || pair == NULL) {
+        free(h); free(pair); free(shifts);
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    h->nr_measurements = data->nr_measurements;
+    h->nr_partitions = (uint32_t)((nr_frames + SND_DSP_BLOCK_FRAMES - 1) / SND_DSP_BLOCK_FRAMES);
+    part_size = (size_t) h->nr_partitions * SND_DSP_FFT_SIZE;
+    h->directions = malloc(3 * (size_t) h->nr_measurements * sizeof(float));
+    h->ir_re = calloc(2 * part_size * h->nr_measurements, sizeof(float));
+    if(h->directions == NULL || h->ir_re == NULL) {
+        free(h->directions); free(h->ir_re); free(h); free(pair); free(shifts);
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    h->ir_im = h->ir_re + part_size * h->nr_measurements;
+    snd_dsp_fft_init(&(h->fft));
+
+    for(uint32_t m = 0; m < h->nr_measurements; m++) {
+        az = data->directions[2*m] * (3.14159265f / 180.0f);
+        el = data->directions[2*m + 1] * (3.14159265f / 180.0f);
+        h->directions[3*m]     = -sinf(az) * cosf(el);
+        h->directions[3*m + 1] = sinf(el);
+        h->directions[3*m + 2] = cosf(az) * cosf(el);
+
+        ir = data->impulse_responses + 2 * (size_t) m * data->nr_frames;
+        nr_resampled = data->nr_frames;
+        scale = 1.0f / SND_DSP_FFT_SIZE;
+        if(data->frequency_hz != out_hz) {
+            for(uint32_t i = 0; i < data->nr_frames; i++) {
+                pair[2*i] = ir[i];
+                pair[2*i + 1] = ir[data->nr_frames + i];
+            }
+            r = snd_resample(SND_RESAMPLE_QUALITY_MEDIUM, SND_FORMAT_PCM_FLOAT32_STEREO_INTERLEAVED_LR, pair, 2 * (size_t) data->nr_frames * sizeof(float), data->frequency_hz, out_hz, &resampled, &nr_resampled);
+            if(r != SND_OK) {
+                snd_hrtf_destroy((snd_hrtf_t){ h });
+                free(pair); free(shifts);
+                return r;
+            }
+            /* an impulse response has to keep its sum, not its peak */
+            scale *= (float) data->frequency_hz / (float) out_hz;
+        }
+        shift[0] = (uint32_t) shifts[2*m];
+        shift[1] = (uint32_t) shifts[2*m + 1];
+
+        for(uint32_t part = 0; part < h->nr_partitions; part++) {
+            re = h->ir_re + (size_t) m * part_size + part * SND_DSP_FFT_SIZE;
+            im = h->ir_im + (size_t) m * part_size + part * SND_DSP_FFT_SIZE;
+            /* the partition in the first half, zero padded; the left ear is the real part and the right one imaginary */
+            for(uint32_t i = 0; i < SND_DSP_BLOCK_FRAMES; i++) {
+                for(uint32_t c = 0; c < 2; c++) {
+                    t = (size_t) part * SND_DSP_BLOCK_FRAMES + i;
+                    d = 0.0f;
+                    if(t >= shift[c] && t - shift[c] < nr_resampled) {
+                        ear = resampled != NULL ? resampled + c : ir + c * (size_t) data->nr_frames;
+                        d = ear[(t - shift[c]) * (resampled != NULL ? 2 : 1)];
+                    }
+                    (c == 0 ? re : im)[i] = d * scale;
+                }
+            }
+            snd_dsp_fft(&(h->fft), re, im, false);
+        }
+        free(resampled);
+        resampled = NULL;
+    }
+
+    free(pair);
+    free(shifts);
+    out_hrtf[0].handle = h;
+    return SND_OK;
+}
+/* Little endian reads from an .mhr file; the versions differ in the header layout, the sample and delay formats and in
+ * whether they know more than one field. */
+typedef struct snd_mhr_reader_t {
+    const uint8_t* p;
+    size_t left;
+    bool ok;
+} snd_mhr_reader_t;
+static uint32_t snd_mhr_read(snd_mhr_reader_t* rd, uint32_t nr_bytes) {
+    uint32_t v = 0;
+
+    if(rd->left < nr_bytes) {
+        rd->ok = false;
+        return 0;
+    }
+    for(uint32_t b = 0; b < nr_bytes; b++) {
+        v |= (uint32_t) rd->p[b] << (8 * b);
+    }
+    rd->p += nr_bytes;
+    rd->left -= nr_bytes;
+    return v;
+}
+/* The measurements of an .mhr file as snd_hrtf_create takes them, the arrays in set are allocated here and freed by
+ * the caller on success. */
+static snd_result_t snd_mhr_parse(const void* data, size_t size, snd_hrtf_data_t* out_set) {
+    snd_mhr_reader_t rd = { data, size, true }; snd_hrtf_data_t set;
+    uint32_t version, channels = 1, sample_bytes = 2, ir_size, nr_fields = 1, nr_elevations, nr_irs = 0, distance, best_distance = 0;
+    uint32_t field_first = 0, field_elevations = 0, first, mirror, m, from, ch, v; float delay_scale = 1.0f;
+    uint16_t elevation_first[256]; uint8_t azimuths[256], field_azimuths[256];
+    const uint8_t* coefficients; const uint8_t* delays; float* directions; float* irs; float* set_delays; size_t c;
+
+    if(size < 8 || memcmp(data, "MinPHR0", 7) != 0 || ((const char*) data)[7] < '0' || ((const char*) data)[7] > '3') {
+        return SND_ERROR_UNSUPPORTED_FORMAT;
+    }
+    version = (uint32_t)(((const char*) data)[7] - '0');
+    rd.p += 8;
+    rd.left -= 8;
+
+    set.frequency_hz = snd_mhr_read(&rd, 4);
+    if(version == 0) {
+        /* the IR count and size, then where each elevation starts */
+        nr_irs = snd_mhr_read(&rd, 2);
+        ir_size = snd_mhr_read(&rd, 2);
+        nr_elevations = snd_mhr_read(&rd, 1);
+        for(uint32_t e = 0; e < nr_elevations; e++) {
+            elevation_first[e] = (uint16_t) snd_mhr_read(&rd, 2);
+        }
+        if(!rd.ok || nr_elevations == 0 || elevation_first[0] != 0) {
+            return SND_ERROR_UNSUPPORTED_FORMAT;
+        }
+        for(uint32_t e = 0; e < nr_elevations; e++) {
+            v = e + 1 < nr_elevations ? elevation_first[e+1] : nr_irs;
+            if(v <= elevation_first[e] || v - elevation_first[e] > 255) {
+                return SND_ERROR_UNSUPPORTED_FORMAT;
+            }
+            field_azimuths[e] = (uint8_t)(v - elevation_first[e]);
+        }
+        field_elevations = nr_elevations;
+    } else if(version == 1) {
+        /* the IR size, then the number of azimuths of each elevation */
+        ir_size = snd_mhr_read(&rd, 1);
+        nr_elevations = snd_mhr_read(&rd, 1);
+        for(uint32_t e = 0; e < nr_elevations; e++) {
+            field_azimuths[e] = (uint8_t) snd_mhr_read(&rd, 1);
+            if(field_azimuths[e] == 0) {
+                return SND_ERROR_UNSUPPORTED_FORMAT;
+            }
+            nr_irs += field_azimuths[e];
+        }
+        field_elevations = nr_elevations;
+    } else {
+        if(version == 2) {
+            sample_bytes = snd_mhr_read(&rd, 1) == 0 ? 2 : 3;
+        } else {
+            sample_bytes = 3;
+            /* quarter samples */
+            delay_scale = 0.25f;
+        }
+        channels = snd_mhr_read(&rd, 1) == 0 ? 1 : 2;
+        ir_size = snd_mhr_read(&rd, 1);
+        nr_fields = snd_mhr_read(&rd, 1);
+        for(uint32_t f = 0; f < nr_fields && rd.ok; f++) {
+            distance = snd_mhr_read(&rd, 2);
+            nr_elevations = snd_mhr_read(&rd, 1);
+            v = 0;
+            for(uint32_t e = 0; e < nr_elevations; e++) {
+                azimuths[e] = (uint8_t) snd_mhr_read(&rd, 1);
+                if(azimuths[e] == 0) {
+                    return SND_ERROR_UNSUPPORTED_FORMAT;
+                }
+                v += azimuths[e];
+            }
+            if(distance >= best_distance) {
+                best_distance = distance;
+                field_first = nr_irs;
+                field_elevations = nr_elevations;
+                memcpy(field_azimuths, azimuths, nr_elevations);
+            }
+            nr_irs += v;
+        }
+    }
+    if(!rd.ok || set.frequency_hz == 0 || ir_size == 0 || nr_fields == 0 || field_elevations == 0) {
+        return SND_ERROR_UNSUPPORTED_FORMAT;
+    }
+    if(rd.left < (size_t) nr_irs * channels * (ir_size * sample_bytes + 1)) {
+        return SND_ERROR_UNSUPPORTED_FORMAT;
+    }
+    coefficients = rd.p;
+    delays = rd.p + (size_t) nr_irs * channels * ir_size * sample_bytes;
+
+    set.nr_measurements = 0;
+    for(uint32_t e = 0; e < field_elevations; e++) {
+        elevation_first[e] = (uint16_t) set.nr_measurements;
+        set.nr_measurements += field_azimuths[e];
+    }
+    set.nr_frames = ir_size;
+    directions = malloc(2 * (size_t) set.nr_measurements * sizeof(float));
+    irs = malloc(2 * (size_t) set.nr_measurements * ir_size * sizeof(float));
+    set_delays = malloc(2 * (size_t) set.nr_measurements * sizeof(float));
+    if(directions == NULL || irs == NULL || set_delays == NULL) {
+        free(directions); free(irs); free(set_delays);
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+
+    for(uint32_t e = 0; e < field_elevations; e++) {
+        for(uint32_t a = 0; a < field_azimuths[e]; a++) {
+            m = elevation_first[e] + a;
+            /* clockwise here, counterclockwise in SOFA */
+            directions[2*m] = -360.0f * (float) a / (float) field_azimuths[e];
+            directions[2*m + 1] = field_elevations > 1 ? -90.0f + 180.0f * (float) e / (float)(field_elevations - 1) : 0.0f;
+            first = field_first + elevation_first[e] + a;
+            mirror = field_first + elevation_first[e] + (field_azimuths[e] - a) % field_azimuths[e];
+            for(uint32_t ear = 0; ear < 2; ear++) {
+                /* mono files only have the left ear, the right one is the left one of the mirrored direction */
+                from = channels == 2 || ear == 0 ? first : mirror;
+                ch = channels == 2 ? ear : 0;
+                for(uint32_t i = 0; i < ir_size; i++) {
+                    c = (((size_t) from * ir_size + i) * channels + ch) * sample_bytes;
+                    if(sample_bytes == 2) {
+                        v = (uint32_t) coefficients[c] | ((uint32_t) coefficients[c+1] << 8);
+                        irs[((size_t) 2 * m + ear) * ir_size + i] = (float)(int16_t) v * (1.0f / 32768.0f);
+                    } else {
+                        v = (uint32_t) coefficients[c] | ((uint32_t) coefficients[c+1] << 8) | ((uint32_t) coefficients[c+2] << 16);
+                        irs[((size_t) 2 * m + ear) * ir_size + i] = (float)((int32_t)(v << 8) >> 8) * (1.0f / 8388608.0f);
+                    }
+                }
+                set_delays[2*m + ear] = (float) delays[(size_t) from * channels + ch] * delay_scale;
+            }
+        }
+    }
+
+    set.directions = directions;
+    set.impulse_responses = irs;
+    set.delays = set_delays;
+    out_set[0] = set;
+    return SND_OK;
+}
+snd_result_t snd_hrtf_create_mhr(const void* data, size_t size, snd_hrtf_t* out_hrtf) {
+    snd_result_t r; snd_hrtf_data_t set;
+
+#ifndef SND_NO_CHECKS
+    if(data == NULL || out_hrtf == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    r = snd_mhr_parse(data, size, &set);
+    if(r != SND_OK) {
+        return r;
+    }
+    r = snd_hrtf_create(&set, out_hrtf);
+    free((float*) set.directions);
+    free((float*) set.impulse_responses);
+    free((float*) set.delays);
+    return r;
+}
+snd_result_t snd_hrtf_output_set(snd_hrtf_t hrtf, const snd_hrtf_params_t* params) {
+    snd_hrtf_state_t* h = hrtf.handle; float* bed_fdl = NULL; float direction[3]; size_t n = 0;
+
+#ifndef SND_NO_CHECKS
+    if(h != NULL && params == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    if(g_al.backend != SND_BACKEND_TYPE_SOFTWARE) {
+        return SND_ERROR_BACKEND_NOT_SUPPORTED;
+    }
+
+    if(h != NULL) {
+        n = (size_t) h->nr_partitions * SND_DSP_FFT_SIZE;
+        bed_fdl = calloc(2 * SND_HRTF_BED_SPEAKERS * n, sizeof(float));
+        if(bed_fdl == NULL) {
+            return SND_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+    mtx_lock(&g_soft.lock);
+    if(g_soft.hrtf != NULL) {
+        g_soft.hrtf->in_use = false;
+    }
+    /* the partition count can differ, so every convolution starts over */
+    for(uint32_t i = 0; i < g_soft.sources_cap; i++) {
+        free(g_soft.sources[i].hrtf.fdl_re);
+        memset(&(g_soft.sources[i].hrtf), 0, sizeof(snd_hrtf_channel_t));
+        g_soft.sources[i].hrtf_direct = false;
+        g_soft.sources[i].hrtf_was_direct = false;
+        g_soft.sources[i].hrtf_fed = false;
+    }
+    free(g_soft.bed_fdl);
+    memset(g_soft.bed, 0, sizeof(g_soft.bed));
+    memset(g_soft.bed_mix, 0, sizeof(g_soft.bed_mix));
+    memset(g_soft.bed_active, 0, sizeof(g_soft.bed_active));
+    g_soft.bed_fdl = bed_fdl;
+    g_soft.hrtf = h;
+    g_soft.hrtf_nr_direct = 0;
+    g_soft.hrtf_nr_bed = 0;
+    g_soft.hrtf_blocks = 0;
+    g_soft.hrtf_seconds = 0.0;
+    if(h != NULL) {
+        h->in_use = true;
+        g_soft.hrtf_max_direct = params->max_direct_sources;
+        for(uint32_t s = 0; s < SND_HRTF_BED_SPEAKERS; s++) {
+            g_soft.bed[s].fdl_re = bed_fdl + 2 * s * n;
+            g_soft.bed[s].fdl_im = bed_fdl + (2 * s + 1) * n;
+            snd_hrtf_bed_direction(s, direction);
+            g_soft.bed[s].filter = snd_hrtf_nearest(h, direction);
+            /* nothing to play out yet */
+            g_soft.bed_silent_blocks[s] = h->nr_partitions + 2;
+        }
+    }
+    mtx_unlock(&g_soft.lock);
+    return SND_OK;
+}
+snd_result_t snd_hrtf_stats_get(snd_hrtf_stats_t* out_stats) {
+#ifndef SND_NO_CHECKS
+    if(out_stats == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    if(g_al.backend != SND_BACKEND_TYPE_SOFTWARE) {
+        return SND_ERROR_BACKEND_NOT_SUPPORTED;
+    }
+
+    mtx_lock(&g_soft.lock);
+    out_stats->nr_direct_sources = g_soft.hrtf_nr_direct;
+    out_stats->nr_bed_sources = g_soft.hrtf_nr_bed;
+    out_stats->nr_blocks = g_soft.hrtf_blocks;
+    out_stats->seconds_total = g_soft.hrtf_seconds;
+    out_stats->seconds_per_block = g_soft.hrtf_blocks > 0 ? g_soft.hrtf_seconds / (double) g_soft.hrtf_blocks : 0.0;
+    out_stats->load = out_stats->seconds_per_block * (double) g_soft.params.frequency_hz / SND_SOFT_BLOCK_FRAMES;
+    mtx_unlock(&g_soft.lock);
+    return SND_OK;
+}
+snd_result_t snd_hrtf_destroy(snd_hrtf_t hrtf) {
+    snd_hrtf_state_t* h = hrtf.handle;
+
+#ifndef SND_NO_CHECKS
+    if(h == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    mtx_lock(&g_soft.lock);
+    if(h->in_use) {
+        mtx_unlock(&g_soft.lock);
+        return SND_ERROR_HRTF_STILL_IN_USE;
+    }
+    mtx_unlock(&g_soft.lock);
+
+    free(h->directions);
+    free(h->ir_re);
+    free(h);
+    return SND_OK;
+}
+
+/* snd_buffer_alloc that also tells how many bytes the buffer holds after resampling and conversion */
+static snd_result_t snd_buffer_alloc_sized(snd_listener_context_t context, snd_format_t format, uint32_t frequency_hz, void* data, size_t size, snd_buffer_t* buffer, size_t* out_uploaded_size) {
+    ALuint id;
+    ALenum al_format;
+    ALint i;
+    uint32_t frame_size;
+    snd_format_t uploaded;
+    snd_result_t r; ALCcontext* old_con;
+    snd_context_info_t* info; float* resampled = NULL; size_t nr_resampled;
+    snd_resample_quality_t quality = SND_RESAMPLE_QUALITY_NONE; uint32_t mixing_frequency_hz = 0;
+
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || buffer == NULL || data == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    if(snd_format_info(format, &al_format, &frame_size) != SND_OK) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    if(size%frame_size != 0) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    g_al.GenBuffers(&id);
+#ifndef SND_NO_CHECKS
+    switch(g_al.GetError()) {
+    case AL_NO_ERROR:
+        break;
+    case AL_OUT_OF_MEMORY:
+        return SND_ERROR_OUT_OF_MEMORY;
+    default:
+        return SND_ERROR_UNKNOWN;
+    }
+    if(g_al.IsBuffer(id) != AL_TRUE) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    /* once here instead of on every mix in the driver */
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_get(context.handle);
+    if(info != NULL) {
+        quality = info->resample_quality;
+        mixing_frequency_hz = info->mixing_frequency_hz;
+    }
+    mtx_unlock(&g_al.contexts_lock);
+    if(quality != SND_RESAMPLE_QUALITY_NONE && mixing_frequency_hz != 0 && frequency_hz != mixing_frequency_hz) {
+        r = snd_resample(quality, format, data, size, frequency_hz, mixing_frequency_hz, &resampled, &nr_resampled);
+        if(r != SND_OK) {
+            return r;
+        }
+        format = snd_format_float32_equivalent(format);
+        frame_size = snd_formats[format].channels * sizeof(float);
+        data = resampled;
+        size = nr_resampled * frame_size;
+        frequency_hz = mixing_frequency_hz;
+    }
+
+    r = snd_buffer_data(id, format, data, size, frequency_hz, &uploaded);
+    free(resampled);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+#ifndef SND_NO_CHECKS
+    switch(g_al.GetError()) {
+    case AL_NO_ERROR:
+        break;
+    case AL_OUT_OF_MEMORY:
+        return SND_ERROR_OUT_OF_MEMORY;
+    default:
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+#ifdef SND_DEBUG
+    g_al.GetBufferi(id, AL_FREQUENCY, &i)
+    if(i != frequency_hz) {
+        return SND_ERROR_UNKNOWN;
+    }
+    g_al.GetBufferi(id, AL_BITS, &i)
+    if(i != snd_formats[uploaded].bytes_per_sample * 8) {
+        return SND_ERROR_UNKNOWN;
+    }
+    g_al.GetBufferi(id, AL_CHANNELS, &i)
+    if(i != snd_formats[uploaded].channels) {
+        return SND_ERROR_UNKNOWN;
+    }
+    g_al.GetBufferi(id, AL_SIZE, &i)
+    if(i != size / frame_size * snd_formats[uploaded].channels * snd_formats[uploaded].bytes_per_sample) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    buffer[0].id = id;
+    out_uploaded_size[0] = size / frame_size * snd_formats[uploaded].channels * snd_formats[uploaded].bytes_per_sample;
+    return SND_OK;
+}
+snd_result_t snd_buffer_alloc(snd_listener_context_t context, snd_format_t format, uint32_t frequency_hz, void* data, size_t size, snd_buffer_t* buffer) {
+    size_t uploaded_size;
+    return snd_buffer_alloc_sized(context, format, frequency_hz, data, size, buffer, &uploaded_size);
+}
+snd_result_t snd_listener_context_resample_quality_set(snd_listener_context_t context, snd_resample_quality_t quality) {
+    snd_context_info_t* info;
+
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || quality < SND_RESAMPLE_QUALITY_NONE || quality > SND_RESAMPLE_QUALITY_BEST) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_find(context.handle);
+    if(info == NULL) {
+        mtx_unlock(&g_al.contexts_lock);
+        return SND_ERROR_INVALID_PARAM;
+    }
+    info->resample_quality = quality;
+    mtx_unlock(&g_al.contexts_lock);
+    return SND_OK;
+}
+snd_result_t snd_buffer_free(snd_listener_context_t context, snd_buffer_t buffer) {
+    snd_result_t r; ALCcontext* old_con;
+    
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+#ifndef SND_NO_CHECKS
+    if(g_al.IsBuffer(buffer.id) != AL_TRUE) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    g_al.DeleteBuffers(1, &(buffer.id));
+#ifndef SND_NO_CHECKS
+    switch(g_al.GetError()) {
+    case AL_NO_ERROR:
+        break;
+    case AL_INVALID_OPERATION:
+        return SND_ERROR_BUFFER_STILL_IN_USE;
+    default:
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    return SND_OK;
+}
+
+snd_result_t snd_source_create(snd_listener_context_t context, snd_source_t* source) {
+    snd_result_t r; ALCcontext* old_con; ALuint id;
+    
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || source == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    g_al.GenSources(1, &id);
+#ifndef SND_NO_CHECKS
+    switch(g_al.GetError()) {
+    case AL_NO_ERROR:
+        break;
+    case AL_OUT_OF_MEMORY:
+        return SND_ERROR_OUT_OF_MEMORY;
+    case AL_INVALID_VALUE:
+        return SND_ERROR_LISTENING_CONTEXT_OUT_OF_SOURCES;
+    default:
+        return SND_ERROR_UNKNOWN;
+    }
+    if(g_al.IsSource(source.id) != AL_TRUE) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    source[0].id = id;
+
+    return SND_OK;
+}
+snd_result_t snd_source_delete(snd_listener_context_t context, snd_source_t source) {
+    snd_result_t r; ALCcontext* old_con; snd_context_info_t* info;
+    
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+#ifndef SND_NO_CHECKS
+    if(g_al.IsSource(source.id) != AL_TRUE) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    g_al.DeleteSources(1, &(source.id));
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    snd_source_shadow_invalidate(context.handle, source.id);
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_get(context.handle);
+    if(info != NULL && info->nr_lead_ins > 0) {
+        /* frees a lead-in it still had, before the id is handed out again */
+        snd_lead_in_collect(info);
+    }
+    mtx_unlock(&g_al.contexts_lock);
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    return SND_OK;
+}
+snd_result_t snd_source_params_get(snd_listener_context_t context, snd_source_t source, const snd_source_params_t* out_params) {
+    snd_result_t r; ALCcontext* old_con; snd_source_params_t params;
+    ALint i; ALfloat fv[3];
+    
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || out_params == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+#ifndef SND_NO_CHECKS
+    if(g_al.IsSource(source.id) != AL_TRUE) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    g_al.GetSourcei(source.id, AL_SOURCE_RELATIVE, &i);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.position_relative_to_listener = i;
+    
+    g_al.GetSourcei(source.id, AL_LOOPING, &i);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.looping = i;
+    
+    g_al.GetSourcefv(source.id, AL_GAIN, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.gain.multiplier = fv[0];
+    
+    g_al.GetSourcefv(source.id, AL_MIN_GAIN, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.gain.min = fv[0];
+    
+    g_al.GetSourcefv(source.id, AL_MAX_GAIN, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.gain.max = fv[0];
+    
+    g_al.GetSourcefv(source.id, AL_CONE_OUTER_GAIN, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.gain.outer_angle_secondary_multiplier = fv[0];
+    
+    g_al.GetSourcefv(source.id, AL_CONE_INNER_ANGLE, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.cone.inner_angle = fv[0];
+    
+    g_al.GetSourcefv(source.id, AL_CONE_OUTER_ANGLE, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.cone.outer_angle = fv[0];
+    
+    g_al.GetSourcefv(source.id, AL_REFERENCE_DISTANCE, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.distance.reference = fv[0];
+    
+    g_al.GetSourcefv(source.id, AL_MAX_DISTANCE, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.distance.max = fv[0];
+    
+    g_al.GetSourcefv(source.id, AL_ROLLOFF_FACTOR, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.distance.rolloff_factor = fv[0];
+    
+    g_al.GetSourcefv(source.id, AL_PITCH, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.pitch_shift_multiplier = fv[0];
+    
+    g_al.GetSourcefv(source.id, AL_POSITION, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.position.x = fv[0];
+    params.position.y = fv[1];
+    params.position.z = fv[2];
+    
+    g_al.GetSourcefv(source.id, AL_VELOCITY, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.velocity.x = fv[0];
+    params.velocity.y = fv[1];
+    params.velocity.z = fv[2];
+    
+    g_al.GetSourcefv(source.id, AL_DIRECTION, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    params.direction.x = fv[0];
+    params.direction.y = fv[1];
+    params.direction.z = fv[2];
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    out_params[0] = params;
+
+    return SND_OK;
+}
+/* the ranges AL accepts, only for the fields set in fields */
+static bool snd_source_params_valid(const snd_source_params_t* params, uint32_t fields) {
+    if((fields & SND_SOURCE_PARAMS_FIELD_GAIN_BIT) != 0 && !(params->gain.multiplier >= 0.0f)) {
+        return false;
+    }
+    if((fields & SND_SOURCE_PARAMS_FIELD_GAIN_MIN_BIT) != 0 && !(params->gain.min >= 0.0f && params->gain.min <= 1.0f)) {
+        return false;
+    }
+    if((fields & SND_SOURCE_PARAMS_FIELD_GAIN_MAX_BIT) != 0 && !(params->gain.max >= 0.0f && params->gain.max <= 1.0f)) {
+        return false;
+    }
+    if((fields & SND_SOURCE_PARAMS_FIELD_GAIN_OUTER_ANGLE_BIT) != 0
+    && !(params->gain.outer_angle_secondary_multiplier >= 0.0f && params->gain.outer_angle_secondary_multiplier <= 1.0f)) {
+        return false;
+    }
+    if((fields & SND_SOURCE_PARAMS_FIELD_CONE_INNER_ANGLE_BIT) != 0 && !(params->cone.inner_angle >= 0.0f && params->cone.inner_angle <= 360.0f)) {
+        return false;
+    }
+    if((fields & SND_SOURCE_PARAMS_FIELD_CONE_OUTER_ANGLE_BIT) != 0 && !(params->cone.outer_angle >= 0.0f && params->cone.outer_angle <= 360.0f)) {
+        return false;
+    }
+    if((fields & SND_SOURCE_PARAMS_FIELD_DISTANCE_REFERENCE_BIT) != 0 && !(params->distance.reference >= 0.0f)) {
+        return false;
+    }
+    if((fields & SND_SOURCE_PARAMS_FIELD_DISTANCE_MAX_BIT) != 0 && !(params->distance.max >= 0.0f)) {
+        return false;
+    }
+    if((fields & SND_SOURCE_PARAMS_FIELD_ROLLOFF_FACTOR_BIT) != 0 && !(params->distance.rolloff_factor >= 0.0f)) {
+        return false;
+    }
+    if((fields & SND_SOURCE_PARAMS_FIELD_PITCH_BIT) != 0 && !(params->pitch_shift_multiplier > 0.0f)) {
+        return false;
+    }
+    return true;
+}
+snd_result_t snd_source_params_set(snd_listener_context_t context, snd_source_t source, const snd_source_params_t params) {
+    snd_result_t r; ALCcontext* old_con; ALfloat fv[3];
+    snd_context_info_t* info; snd_source_shadow_t* shadow;
+    snd_source_params_t test_params;
+    
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    if(!snd_source_params_valid(&params, SND_SOURCE_PARAMS_FIELD_ALL_BITS)) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+#ifndef SND_NO_CHECKS
+    if(g_al.IsSource(source.id) != AL_TRUE) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    g_al.Sourcei(source.id, AL_SOURCE_RELATIVE, params.position_relative_to_listener);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    g_al.Sourcei(source.id, AL_LOOPING, params.looping);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.gain.multiplier;
+    g_al.Sourcefv(source.id, AL_GAIN, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.gain.min;
+    g_al.Sourcefv(source.id, AL_MIN_GAIN, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.gain.max;
+    g_al.Sourcefv(source.id, AL_MAX_GAIN, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.gain.outer_angle_secondary_multiplier;
+    g_al.Sourcefv(source.id, AL_CONE_OUTER_GAIN, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.cone.inner_angle;
+    g_al.Sourcefv(source.id, AL_CONE_INNER_ANGLE, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.cone.outer_angle;
+    g_al.Sourcefv(source.id, AL_CONE_OUTER_ANGLE, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.distance.reference;
+    g_al.Sourcefv(source.id, AL_REFERENCE_DISTANCE, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.distance.max;
+    g_al.Sourcefv(source.id, AL_MAX_DISTANCE, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.distance.rolloff_factor;
+    g_al.Sourcefv(source.id, AL_ROLLOFF_FACTOR, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.pitch_shift_multiplier;
+    g_al.Sourcefv(source.id, AL_PITCH, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.position.x;
+    fv[1] = params.position.y;
+    fv[2] = params.position.z;
+    g_al.Sourcefv(source.id, AL_POSITION, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.velocity.x;
+    fv[1] = params.velocity.y;
+    fv[2] = params.velocity.z;
+    g_al.Sourcefv(source.id, AL_VELOCITY, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+    
+    fv[0] = params.direction.x;
+    fv[1] = params.direction.y;
+    fv[2] = params.direction.z;
+    g_al.Sourcefv(source.id, AL_DIRECTION, fv);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_get(context.handle);
+    shadow = info != NULL ? snd_source_shadow_get(info, source.id, true) : NULL;
+    if(shadow != NULL) {
+        shadow->params = params;
+        shadow->valid_fields = SND_SOURCE_PARAMS_FIELD_ALL_BITS;
+    }
+    mtx_unlock(&g_al.contexts_lock);
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+
+#ifdef SND_DEBUG
+    r = snd_source_params_get(context, source, &test_params);
+    if(r != SND_OK) { return r; }
+
+    if(test_params != params) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    return SND_OK;
+}
+
+static const struct {
+    uint32_t bit;
+    ALenum param;
+    size_t offset;
+    uint32_t nr_floats; /* 0 for the bool fields */
+} snd_source_fields[] = {
+    { SND_SOURCE_PARAMS_FIELD_POSITION_RELATIVE_BIT, AL_SOURCE_RELATIVE,    offsetof(snd_source_params_t, position_relative_to_listener),      0 },
+    { SND_SOURCE_PARAMS_FIELD_LOOPING_BIT,           AL_LOOPING,            offsetof(snd_source_params_t, looping),                            0 },
+    { SND_SOURCE_PARAMS_FIELD_GAIN_BIT,              AL_GAIN,               offsetof(snd_source_params_t, gain.multiplier),                    1 },
+    { SND_SOURCE_PARAMS_FIELD_GAIN_MIN_BIT,          AL_MIN_GAIN,           offsetof(snd_source_params_t, gain.min),                           1 },
+    { SND_SOURCE_PARAMS_FIELD_GAIN_MAX_BIT,          AL_MAX_GAIN,           offsetof(snd_source_params_t, gain.max),                           1 },
+    { SND_SOURCE_PARAMS_FIELD_GAIN_OUTER_ANGLE_BIT,  AL_CONE_OUTER_GAIN,    offsetof(snd_source_params_t, gain.outer_angle_secondary_multiplier), 1 },
+    { SND_SOURCE_PARAMS_FIELD_CONE_INNER_ANGLE_BIT,  AL_CONE_INNER_ANGLE,   offsetof(snd_source_params_t, cone.inner_angle),                   1 },
+    { SND_SOURCE_PARAMS_FIELD_CONE_OUTER_ANGLE_BIT,  AL_CONE_OUTER_ANGLE,   offsetof(snd_source_params_t, cone.outer_angle),                   1 },
+    { SND_SOURCE_PARAMS_FIELD_DISTANCE_REFERENCE_BIT,AL_REFERENCE_DISTANCE, offsetof(snd_source_params_t, distance.reference),                 1 },
+    { SND_SOURCE_PARAMS_FIELD_DISTANCE_MAX_BIT,      AL_MAX_DISTANCE,       offsetof(snd_source_params_t, distance.max),                       1 },
+    { SND_SOURCE_PARAMS_FIELD_ROLLOFF_FACTOR_BIT,    AL_ROLLOFF_FACTOR,     offsetof(snd_source_params_t, distance.rolloff_factor),            1 },
+    { SND_SOURCE_PARAMS_FIELD_PITCH_BIT,             AL_PITCH,              offsetof(snd_source_params_t, pitch_shift_multiplier),             1 },
+    { SND_SOURCE_PARAMS_FIELD_POSITION_BIT,          AL_POSITION,           offsetof(snd_source_params_t, position),                           3 },
+    { SND_SOURCE_PARAMS_FIELD_VELOCITY_BIT,          AL_VELOCITY,           offsetof(snd_source_params_t, velocity),                           3 },
+    { SND_SOURCE_PARAMS_FIELD_DIRECTION_BIT,         AL_DIRECTION,          offsetof(snd_source_params_t, direction),                          3 },
+};
+snd_result_t snd_sources_params_set_batch(snd_listener_context_t context, uint32_t nr_sources, const snd_source_t* sources, const snd_source_params_t* params, uint32_t dirty_mask) {
+    snd_result_t r, batch_r; ALCcontext* old_con; ALfloat fv[3];
+    snd_context_info_t* info; snd_source_shadow_t* shadow;
+    const char* value; const char* shadow_value; size_t value_size;
+
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || (nr_sources > 0 && (sources == NULL || params == NULL))) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    if((dirty_mask & ~SND_SOURCE_PARAMS_FIELD_ALL_BITS) != 0) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    /* the same as snd_source_params_set, and before anything is written */
+    for(uint32_t i = 0; i < nr_sources; i++) {
+        if(!snd_source_params_valid(&(params[i]), dirty_mask)) {
+            return SND_ERROR_INVALID_PARAM;
+        }
+    }
+#endif
+    if(nr_sources == 0 || dirty_mask == 0) {
+        return SND_OK;
+    }
+
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    batch_r = SND_OK;
+#ifdef SND_DEBUG
+    /* nothing is written then, but the context is still restored below */
+    for(uint32_t i = 0; i < nr_sources; i++) {
+        if(g_al.IsSource(sources[i].id) != AL_TRUE) {
+            batch_r = SND_ERROR_INVALID_PARAM;
+        }
+    }
+#endif
+
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_get(context.handle);
+    if(info != NULL && info->deferred_updates) {
+        /* the mixer sees the whole batch in one update instead of a half moved scene */
+        info->DeferUpdatesSOFT();
+    }
+
+    for(uint32_t i = 0; i < nr_sources && batch_r == SND_OK; i++) {
+        /* without a shadow slot every dirty field is written, which is always correct */
+        shadow = info != NULL ? snd_source_shadow_get(info, sources[i].id, true) : NULL;
+
+        for(size_t f = 0; f < sizeof(snd_source_fields)/sizeof(snd_source_fields[0]); f++) {
+            if((dirty_mask & snd_source_fields[f].bit) == 0) {
+                continue;
+            }
+            value = ((const char*) &(params[i])) + snd_source_fields[f].offset;
+            value_size = snd_source_fields[f].nr_floats == 0 ? sizeof(bool) : snd_source_fields[f].nr_floats * sizeof(float);
+            if(shadow != NULL) {
+                shadow_value = ((const char*) &(shadow->params)) + snd_source_fields[f].offset;
+                if((shadow->valid_fields & snd_source_fields[f].bit) != 0 && memcmp(value, shadow_value, value_size) == 0) {
+                    continue;
+                }
+            }
+
+            if(snd_source_fields[f].nr_floats == 0) {
+                g_al.Sourcei(sources[i].id, snd_source_fields[f].param, ((const bool*) value)[0]);
+            } else {
+                memcpy(fv, value, value_size);
+                g_al.Sourcefv(sources[i].id, snd_source_fields[f].param, fv);
+            }
+
+            if(shadow != NULL) {
+                memcpy(((char*) &(shadow->params)) + snd_source_fields[f].offset, value, value_size);
+                shadow->valid_fields |= snd_source_fields[f].bit;
+            }
+        }
+    }
+
+    /* AL keeps the first error until it's read, so one check covers the whole batch */
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        batch_r = SND_ERROR_UNKNOWN;
+        /* we don't know which write failed, so nothing in this batch can be trusted anymore */
+        for(uint32_t i = 0; i < nr_sources && info != NULL; i++) {
+            shadow = snd_source_shadow_get(info, sources[i].id, false);
+            if(shadow != NULL) {
+                shadow->valid_fields = 0;
+            }
+        }
+    }
+#endif
+
+    if(info != NULL && info->deferred_updates) {
+        info->ProcessUpdatesSOFT();
+    }
+    mtx_unlock(&g_al.contexts_lock);
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    return batch_r;
+}
+
+snd_result_t snd_source_play_position_set(snd_listener_context_t context, snd_source_t source, snd_source_position_format_t format, float value) {
+    snd_result_t r; ALCcontext* old_con; ALenum al_param_name;
+    ALfloat f;
+    
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    switch(format) {
+    case SND_SOURCE_POSITION_FORMAT_SECONDS:
+        al_param_name = AL_SEC_OFFSET;
+        break;
+    case SND_SOURCE_POSITION_FORMAT_SAMPLES:
+        al_param_name = AL_SAMPLE_OFFSET;
+        break;
+    case SND_SOURCE_POSITION_FORMAT_BYTES:
+        al_param_name = AL_BYTE_OFFSET;
+        break;
+    default:
+        return SND_ERROR_INVALID_PARAM;
+    }
+    
+    f = value;
+    
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+#ifndef SND_NO_CHECKS
+    if(g_al.IsSource(source.id) != AL_TRUE) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    g_al.Sourcefv(source.id, al_param_name, &f);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+#ifdef SND_DEBUG
+    g_al.GetSourcefv(source.id, al_param_name, &f);
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+    if(f != value) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    return SND_OK;
+}
+snd_result_t snd_source_play_position_get(snd_listener_context_t context, snd_source_t source, snd_source_position_format_t format, float* out_value) {
+    snd_result_t r; ALCcontext* old_con; ALenum al_param_name;
+    ALfloat f;
+    
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || out_value == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    switch(format) {
+    case SND_SOURCE_POSITION_FORMAT_SECONDS:
+        al_param_name = AL_SEC_OFFSET;
+        break;
+    case SND_SOURCE_POSITION_FORMAT_SAMPLES:
+        al_param_name = AL_SAMPLE_OFFSET;
+        break;
+    case SND_SOURCE_POSITION_FORMAT_BYTES:
+        al_param_name = AL_BYTE_OFFSET;
+        break;
+    default:
+        return SND_ERROR_INVALID_PARAM;
+    }
+    
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+#ifndef SND_NO_CHECKS
+    if(g_al.IsSource(source.id) != AL_TRUE) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    g_al.GetSourcefv(source.id, al_param_name, &f);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    out_value[0] = f;
+
+    return SND_OK;
+}
+snd_result_t snd_source_queue_position_get(snd_listener_context_t context, snd_source_t source, uint32_t* nr_buffers_in_queue, uint32_t* currently_playing_index) {
+    snd_result_t r; ALCcontext* old_con;
+    ALint i1, i2;
+    
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || nr_buffers_in_queue == NULL || currently_playing_index == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+#ifndef SND_NO_CHECKS
+    if(g_al.IsSource(source.id) != AL_TRUE) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    g_al.GetSourcei(source.id, AL_BUFFERS_QUEUED, &i1);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    g_al.GetSourcei(source.id, AL_BUFFERS_PROCESSED, &i2);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    nr_buffers_in_queue[0] = i1;
+    currently_playing_index[0] = i2;
+
+    return SND_OK;
+}
+
+snd_result_t snd_source_static_buffer(snd_listener_context_t context, snd_source_t source, snd_buffer_t buffer) {
+    snd_result_t r; ALCcontext* old_con; ALint id, i;
+    
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    id = buffer.id;
+    
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+#ifndef SND_NO_CHECKS
+    if(g_al.IsSource(source.id) != AL_TRUE) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    if(g_al.IsBuffer(buffer.id) != AL_TRUE) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    g_al.Sourcei(source.id, AL_BUFFER, &id);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+#ifdef SND_DEBUG
+    g_al.GetSourcei(source.id, AL_BUFFER, &i);
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+    if(i != id) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+#ifdef SND_DEBUG
+    g_al.GetSourcei(source.id, AL_SOURCE_TYPE, &i);
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+    if(i != AL_STATIC) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    return SND_OK;
+}
+snd_result_t snd_source_queue_buffers(snd_listener_context_t context, snd_source_t source, uint32_t nr_buffers, snd_buffer_t* buffers) {
+    snd_result_t r; ALCcontext* old_con;
+    
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || nr_buffers <= 0 || buffers == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+    
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+#ifndef SND_NO_CHECKS
+    if(g_al.IsSource(source.id) != AL_TRUE) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+#ifndef SND_NO_CHECKS
+    g_al.GetSourcei(source.id, AL_SOURCE_TYPE, &i);
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+    if(i != AL_STREAMING || i != AL_UNDETERMINED) {
+        return SND_ERROR_SOURCE_STATICALLY_BOUND;
+    }
+#endif
+
+    /* Since the only field of snd_buffer_t is the id, the arrays will line up.
+     * NOTE: if anything is added to the snd_buffer_t struct, rewrite this! */
+    g_al.SourceQueueBuffers(source.id, nr_buffers, (ALuint*) buffers);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+#ifdef SND_DEBUG
+    g_al.GetSourcei(source.id, AL_SOURCE_TYPE, &i);
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+    if(i != AL_STREAMING) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    return SND_OK;
+}
+snd_result_t snd_source_unqueue_buffers(snd_listener_context_t context, snd_source_t source, uint32_t nr_buffers, snd_buffer_t* out_buffers) {
+    snd_result_t r; ALCcontext* old_con;
+    
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || nr_buffers <= 0 || out_buffers == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
+#endif
     
     r = snd_context_set(context.handle, &old_con);
 #ifndef SND_NO_CHECKS
     if(r != SND_OK) { return r; }
 #endif
 
-    g_al.GenBuffers(&id);
 #ifndef SND_NO_CHECKS
-    switch(g_al.GetError()) {
-    case AL_NO_ERROR:
-        break;
-    case AL_OUT_OF_MEMORY:
-        return SND_ERROR_OUT_OF_MEMORY;
-    default:
-        return SND_ERROR_UNKNOWN;
+    if(g_al.IsSource(source.id) != AL_TRUE) {
+        return SND_ERROR_INVALID_PARAM;
     }
-    if(g_al.IsBuffer(id) != AL_TRUE) {
+#endif
+
+#ifndef SND_NO_CHECKS
+    g_al.GetSourcei(source.id, AL_SOURCE_TYPE, &i);
+    if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
     }
+    if(i != AL_STREAMING) {
+        return SND_ERROR_SOURCE_NO_BUFFERS_QUEUED;
+    }
 #endif
 
-    g_al.BufferData(id, al_format, data, size, frequency_hz);
+    /* Since the only field of snd_buffer_t is the id, the arrays will line up.
+     * NOTE: if anything is added to the snd_buffer_t struct, rewrite this! */
+    g_al.SourceUnqueueBuffers(source.id, nr_buffers, (ALuint*) out_buffers);
 #ifndef SND_NO_CHECKS
     switch(g_al.GetError()) {
     case AL_NO_ERROR:
         break;
-    case AL_OUT_OF_MEMORY:
-        return SND_ERROR_OUT_OF_MEMORY;
+    case AL_INVALID_VALUE:
+        return SND_ERROR_SOURCE_NOT_ENOUGH_QUEUED_BUFFERS_FINISHED;
     default:
         return SND_ERROR_UNKNOWN;
     }
 #endif
 
 #ifdef SND_DEBUG
-    g_al.GetBufferi(id, AL_FREQUENCY, &i)
-    if(i != frequency_hz) {
-        return SND_ERROR_UNKNOWN;
-    }
-    g_al.GetBufferi(id, AL_BITS, &i)
-    if(i != bits) {
-        return SND_ERROR_UNKNOWN;
-    }
-    g_al.GetBufferi(id, AL_CHANNELS, &i)
-    if(i != channels) {
+    g_al.GetSourcei(source.id, AL_SOURCE_TYPE, &i);
+    if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
     }
-    g_al.GetBufferi(id, AL_SIZE, &i)
-    if(i != size) {
+    if(i != AL_STREAMING) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
@@ -992,10 +5654,9 @@ snd_result_t snd_buffer_alloc(snd_listener_context_t context, snd_format_t forma
     if(r != SND_OK) { return r; }
 #endif
 
-    buffer[0].id = id;
     return SND_OK;
 }
-snd_result_t snd_buffer_free(snd_listener_context_t context, snd_buffer_t buffer) {
+snd_result_t snd_source_reset_buffer_state(snd_listener_context_t context, snd_source_t source) {
     snd_result_t r; ALCcontext* old_con;
     
 #ifndef SND_NO_CHECKS
@@ -1010,19 +5671,23 @@ snd_result_t snd_buffer_free(snd_listener_context_t context, snd_buffer_t buffer
 #endif
 
 #ifndef SND_NO_CHECKS
-    if(g_al.IsBuffer(buffer.id) != AL_TRUE) {
+    if(g_al.IsSource(source.id) != AL_TRUE) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
-    g_al.DeleteBuffers(1, &(buffer.id));
+    g_al.Sourcei(source.id, AL_BUFFER, NULL);
 #ifndef SND_NO_CHECKS
-    switch(g_al.GetError()) {
-    case AL_NO_ERROR:
-        break;
-    case AL_INVALID_OPERATION:
-        return SND_ERROR_BUFFER_STILL_IN_USE;
-    default:
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+#ifdef SND_DEBUG
+    g_al.GetSourcei(source.id, AL_SOURCE_TYPE, &i);
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+    if(i != AL_UNDETERMINED) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
@@ -1035,11 +5700,11 @@ snd_result_t snd_buffer_free(snd_listener_context_t context, snd_buffer_t buffer
     return SND_OK;
 }
 
-snd_result_t snd_source_create(snd_listener_context_t context, snd_source_t* source) {
-    snd_result_t r; ALCcontext* old_con; ALuint id;
+snd_result_t snd_sources_play  (snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources) {
+    snd_result_t r; ALCcontext* old_con; ALint i; snd_context_info_t* info;
     
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL || source == NULL) {
+    if(context.handle == NULL || sources == NULL || nr_sources <= 0) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
@@ -1049,19 +5714,37 @@ snd_result_t snd_source_create(snd_listener_context_t context, snd_source_t* sou
     if(r != SND_OK) { return r; }
 #endif
 
-    g_al.GenSources(1, &id);
 #ifndef SND_NO_CHECKS
-    switch(g_al.GetError()) {
-    case AL_NO_ERROR:
-        break;
-    case AL_OUT_OF_MEMORY:
-        return SND_ERROR_OUT_OF_MEMORY;
-    case AL_INVALID_VALUE:
-        return SND_ERROR_LISTENING_CONTEXT_OUT_OF_SOURCES;
-    default:
+    for(int i = 0; i < nr_sources; i++) {
+        if(g_al.IsSource(sources[i].id) != AL_TRUE) {
+            return SND_ERROR_INVALID_PARAM;
+        }
+    }
+#endif
+
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_get(context.handle);
+    if(info != NULL && info->nr_lead_ins > 0) {
+        /* a stopped source of snd_sources_play_at replays its buffer, not the lead-in in front */
+        snd_lead_in_collect(info);
+    }
+    mtx_unlock(&g_al.contexts_lock);
+
+    /* Since the only field of snd_source_t is the id, the arrays will line up.
+     * NOTE: if anything is added to the snd_source_t struct, rewrite this! */
+    g_al.SourcePlayv(nr_sources, sources);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
     }
-    if(g_al.IsSource(source.id) != AL_TRUE) {
+#endif
+    snd_source_shadow_stop_requested(context.handle, nr_sources, sources, false);
+#ifdef SND_DEBUG
+    g_al.GetSourcei(source.id, AL_SOURCE_STATE, &i);
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+    if(i != AL_PLAYING) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
@@ -1071,15 +5754,13 @@ snd_result_t snd_source_create(snd_listener_context_t context, snd_source_t* sou
     if(r != SND_OK) { return r; }
 #endif
 
-    source[0].id = id;
-
     return SND_OK;
 }
-snd_result_t snd_source_delete(snd_listener_context_t context, snd_source_t source) {
+snd_result_t snd_sources_pause (snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources) {
     snd_result_t r; ALCcontext* old_con;
     
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL) {
+    if(context.handle == NULL || sources == NULL || nr_sources <= 0) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
@@ -1090,17 +5771,40 @@ snd_result_t snd_source_delete(snd_listener_context_t context, snd_source_t sour
 #endif
 
 #ifndef SND_NO_CHECKS
-    if(g_al.IsSource(source.id) != AL_TRUE) {
-        return SND_ERROR_INVALID_PARAM;
+    for(int i = 0; i < nr_sources; i++) {
+        if(g_al.IsSource(sources[i].id) != AL_TRUE) {
+            return SND_ERROR_INVALID_PARAM;
+        }
     }
 #endif
 
-    g_al.DeleteSources(1, &(source.id));
+#ifdef SND_DEBUG
+    g_al.GetSourcei(source.id, AL_SOURCE_STATE, &i);
+    if(g_al.GetError() != AL_NO_ERROR) {
+        return SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    /* Since the only field of snd_source_t is the id, the arrays will line up.
+     * NOTE: if anything is added to the snd_source_t struct, rewrite this! */
+    g_al.SourcePausev(nr_sources, sources);
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
+#ifdef SND_DEBUG
+    /* Only for AL_PLAYING sources does the spec guarentee state change */
+    if(i == AL_PLAYING) {
+        g_al.GetSourcei(source.id, AL_SOURCE_STATE, &i);
+        if(g_al.GetError() != AL_NO_ERROR) {
+            return SND_ERROR_UNKNOWN;
+        }
+        if(i != AL_PAUSED) {
+            return SND_ERROR_UNKNOWN;
+        }
+    }
+#endif
 
     r = snd_context_set(old_con, NULL);
 #ifndef SND_NO_CHECKS
@@ -1109,12 +5813,11 @@ snd_result_t snd_source_delete(snd_listener_context_t context, snd_source_t sour
 
     return SND_OK;
 }
-snd_result_t snd_source_params_get(snd_listener_context_t context, snd_source_t source, const snd_source_params_t* out_params) {
-    snd_result_t r; ALCcontext* old_con; snd_source_params_t params;
-    ALint i; ALfloat fv[3];
+snd_result_t snd_sources_stop  (snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources) {
+    snd_result_t r; ALCcontext* old_con;
     
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL || out_params == NULL) {
+    if(context.handle == NULL || sources == NULL || nr_sources <= 0) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
@@ -1125,285 +5828,778 @@ snd_result_t snd_source_params_get(snd_listener_context_t context, snd_source_t
 #endif
 
 #ifndef SND_NO_CHECKS
-    if(g_al.IsSource(source.id) != AL_TRUE) {
-        return SND_ERROR_INVALID_PARAM;
+    for(int i = 0; i < nr_sources; i++) {
+        if(g_al.IsSource(sources[i].id) != AL_TRUE) {
+            return SND_ERROR_INVALID_PARAM;
+        }
     }
 #endif
 
-    g_al.GetSourcei(source.id, AL_SOURCE_RELATIVE, &i);
-#ifndef SND_NO_CHECKS
+#ifdef SND_DEBUG
+    g_al.GetSourcei(source.id, AL_SOURCE_STATE, &i);
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    params.position_relative_to_listener = i;
-    
-    g_al.GetSourcei(source.id, AL_LOOPING, &i);
+
+    /* Since the only field of snd_source_t is the id, the arrays will line up.
+     * NOTE: if anything is added to the snd_source_t struct, rewrite this! */
+    g_al.SourceStopv(nr_sources, sources);
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    params.looping = i;
-    
-    g_al.GetSourcefv(source.id, AL_GAIN, fv);
+    snd_source_shadow_stop_requested(context.handle, nr_sources, sources, true);
+#ifdef SND_DEBUG
+    /* Only for AL_PLAYING and AL_PAUSED sources does the spec guarentee state change */
+    if(i == AL_PLAYING || i == AL_PAUSED) {
+        g_al.GetSourcei(source.id, AL_SOURCE_STATE, &i);
+        if(g_al.GetError() != AL_NO_ERROR) {
+            return SND_ERROR_UNKNOWN;
+        }
+        if(i != AL_PAUSED) {
+            return SND_ERROR_UNKNOWN;
+        }
+    }
+#endif
+
+    r = snd_context_set(old_con, NULL);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(r != SND_OK) { return r; }
+#endif
+
+    return SND_OK;
+}
+/* device clock if the device has one, the host clock otherwise; handle has to be the current context */
+static uint64_t snd_clock_now_ns(snd_context_info_t* info, ALCdevice* dev) {
+    ALCint64SOFT clock;
+
+    if(info != NULL && info->GetInteger64vSOFT != NULL) {
+        info->GetInteger64vSOFT(dev, ALC_DEVICE_CLOCK_SOFT, 1, &clock);
+        if(g_al.c.GetError(dev) == ALC_NO_ERROR) {
+            return (uint64_t) clock;
+        }
+    }
+    return (uint64_t)(snd_seconds_now() * 1e9);
+}
+snd_result_t snd_listener_context_clock_get(snd_listener_context_t context, uint64_t* out_clock_ns) {
+    snd_result_t r; ALCcontext* old_con;
+
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || out_clock_ns == NULL) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    params.gain.multiplier = fv[0];
-    
-    g_al.GetSourcefv(source.id, AL_MIN_GAIN, fv);
+
+    r = snd_context_set(context.handle, &old_con);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
+    if(r != SND_OK) { return r; }
+#endif
+
+    mtx_lock(&g_al.contexts_lock);
+    out_clock_ns[0] = snd_clock_now_ns(snd_context_info_get(context.handle), g_al.c.GetContextsDevice(context.handle));
+    mtx_unlock(&g_al.contexts_lock);
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    return SND_OK;
+}
+snd_result_t snd_sources_play_at(snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources, uint64_t device_clock_ns) {
+    snd_result_t r; ALCcontext* old_con; snd_context_info_t* info; ALCdevice* dev; snd_source_shadow_t* shadow;
+    uint64_t now, lead_in_ns; ALint type, looping, buffer, frequency, channels, bits; ALuint queue[2];
+    size_t size, silence_size; void* silence; int64_t lead_in; void* new_lead_ins;
+    struct { ALuint content; int format; size_t nr_frames; ALint frequency; double lead_in_seconds; }* plan;
+
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || sources == NULL || nr_sources == 0) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    r = snd_context_set(context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_get(context.handle);
+    if(info == NULL) {
+        mtx_unlock(&g_al.contexts_lock);
         return SND_ERROR_UNKNOWN;
     }
+    dev = g_al.c.GetContextsDevice(context.handle);
+    snd_lead_in_collect(info);
+    plan = calloc(nr_sources, sizeof(plan[0]));
+    if(plan == NULL) {
+        mtx_unlock(&g_al.contexts_lock);
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+
+    if(info->SourcePlayAtTimevSOFT != NULL) {
+        /* the mixer starts them on the exact sample */
+        info->SourcePlayAtTimevSOFT(nr_sources, (const ALuint*) sources, (ALint64SOFT) device_clock_ns);
+    } else {
+        /* Fallback: a buffer of silence as long as the time left in front of each static buffer, and all of them
+         * started in one call, so they line up on the sample even though the start is only as exact as the clock.
+         * Everything that can fail is checked and allocated first, so an error leaves the sources as they were. */
+        now = snd_clock_now_ns(info, dev);
+        lead_in_ns = device_clock_ns > now ? device_clock_ns - now : 0;
+        silence_size = 0;
+        for(uint32_t i = 0; i < nr_sources; i++) {
+            type = AL_UNDETERMINED;
+            looping = AL_FALSE;
+            buffer = 0;
+            g_al.GetSourcei(sources[i].id, AL_SOURCE_TYPE, &type);
+            g_al.GetSourcei(sources[i].id, AL_LOOPING, &looping);
+            g_al.GetSourcei(sources[i].id, AL_BUFFER, &buffer);
+            /* a queue made by an earlier call here goes back to its static buffer */
+            lead_in = type == AL_STREAMING ? snd_lead_in_find(info, sources[i].id) : -1;
+            if(lead_in >= 0) {
+                buffer = (ALint) info->lead_ins[lead_in].content;
+            } else if(type != AL_STATIC || looping == AL_TRUE) {
+                free(plan);
+                mtx_unlock(&g_al.contexts_lock);
+                return type == AL_UNDETERMINED ? SND_ERROR_SOURCE_NO_BUFFERS_QUEUED : SND_ERROR_INVALID_PARAM;
+            }
+            plan[i].content = (ALuint) buffer;
+            frequency = channels = bits = 0;
+            g_al.GetBufferi((ALuint) buffer, AL_FREQUENCY, &frequency);
+            g_al.GetBufferi((ALuint) buffer, AL_CHANNELS, &channels);
+            g_al.GetBufferi((ALuint) buffer, AL_BITS, &bits);
+            for(plan[i].format = 0; plan[i].format < SND_FORMAT_COUNT; plan[i].format++) {
+                if(snd_formats[plan[i].format].channels == (uint32_t) channels && snd_formats[plan[i].format].bytes_per_sample * 8 == (uint32_t) bits) {
+                    break;
+                }
+            }
+            plan[i].frequency = frequency;
+            plan[i].nr_frames = (size_t)(((double) lead_in_ns * frequency + 5e8) / 1e9);
+            if(plan[i].format == SND_FORMAT_COUNT) {
+                plan[i].nr_frames = 0;
+            }
+            size = plan[i].nr_frames * channels * (bits / 8);
+            silence_size = size > silence_size ? size : silence_size;
+        }
+#ifndef SND_NO_CHECKS
+        if(g_al.GetError() != AL_NO_ERROR) {
+            free(plan);
+            mtx_unlock(&g_al.contexts_lock);
+            return SND_ERROR_INVALID_PARAM;
+        }
 #endif
-    params.gain.min = fv[0];
-    
-    g_al.GetSourcefv(source.id, AL_MAX_GAIN, fv);
+        if(info->nr_lead_ins + nr_sources > info->lead_ins_cap) {
+            new_lead_ins = realloc(info->lead_ins, (info->nr_lead_ins + nr_sources + 16) * sizeof(info->lead_ins[0]));
+            if(new_lead_ins == NULL) {
+                free(plan);
+                mtx_unlock(&g_al.contexts_lock);
+                return SND_ERROR_OUT_OF_MEMORY;
+            }
+            info->lead_ins = new_lead_ins;
+            info->lead_ins_cap = info->nr_lead_ins + nr_sources + 16;
+        }
+        silence = silence_size > 0 ? malloc(silence_size) : NULL;
+        if(silence_size > 0 && silence == NULL) {
+            free(plan);
+            mtx_unlock(&g_al.contexts_lock);
+            return SND_ERROR_OUT_OF_MEMORY;
+        }
+
+        for(uint32_t i = 0; i < nr_sources; i++) {
+            lead_in = snd_lead_in_find(info, sources[i].id);
+            if(lead_in >= 0) {
+                /* stopped, the whole queue counts as processed and setting the buffer drops it */
+                g_al.SourceStopv(1, &(sources[i].id));
+                g_al.Sourcei(sources[i].id, AL_BUFFER, (ALint) plan[i].content);
+                if(info->lead_ins[lead_in].buffer != 0) {
+                    g_al.DeleteBuffers(1, &(info->lead_ins[lead_in].buffer));
+                }
+                info->lead_ins[lead_in] = info->lead_ins[info->nr_lead_ins - 1];
+                info->nr_lead_ins--;
+            }
+            if(plan[i].nr_frames == 0) {
+                continue;
+            }
+            bits = (ALint) snd_formats[plan[i].format].bytes_per_sample * 8;
+            size = plan[i].nr_frames * snd_formats[plan[i].format].channels * (bits / 8);
+            /* unsigned 8 bit is centered on 128 */
+            memset(silence, bits == 8 ? 0x80 : 0, size);
+            g_al.GenBuffers(1, &(queue[0]));
+            g_al.BufferData(queue[0], snd_formats[plan[i].format].al_format, silence, (ALsizei) size, plan[i].frequency);
+            queue[1] = plan[i].content;
+            g_al.Sourcei(sources[i].id, AL_BUFFER, 0);
+            g_al.SourceQueueBuffers(sources[i].id, 2, queue);
+            info->lead_ins[info->nr_lead_ins].source = sources[i].id;
+            info->lead_ins[info->nr_lead_ins].buffer = queue[0];
+            info->lead_ins[info->nr_lead_ins].content = plan[i].content;
+            info->nr_lead_ins++;
+            plan[i].lead_in_seconds = (double) plan[i].nr_frames / plan[i].frequency;
+        }
+        free(silence);
+        g_al.SourcePlayv(nr_sources, (const ALuint*) sources);
+    }
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
+        free(plan);
+        mtx_unlock(&g_al.contexts_lock);
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    params.gain.max = fv[0];
-    
-    g_al.GetSourcefv(source.id, AL_CONE_OUTER_GAIN, fv);
+
+    for(uint32_t i = 0; i < nr_sources; i++) {
+        shadow = snd_source_shadow_get(info, sources[i].id, true);
+        if(shadow != NULL) {
+            shadow->stop_requested = false;
+            shadow->scheduled_ns = device_clock_ns;
+            shadow->lead_in_seconds = plan[i].lead_in_seconds;
+        }
+    }
+    free(plan);
+    mtx_unlock(&g_al.contexts_lock);
+
+    r = snd_context_set(old_con, NULL);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    return SND_OK;
+}
+snd_result_t snd_source_start_error_get(snd_listener_context_t context, snd_source_t source, int64_t* out_error_ns) {
+    snd_result_t r; ALCcontext* old_con; snd_context_info_t* info; snd_source_shadow_t* shadow;
+    ALdouble offset_clock[2]; ALfloat offset; double start_s;
+
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || out_error_ns == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    r = snd_context_set(context.handle, &old_con);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
-    }
+    if(r != SND_OK) { return r; }
 #endif
-    params.gain.outer_angle_secondary_multiplier = fv[0];
-    
-    g_al.GetSourcefv(source.id, AL_CONE_INNER_ANGLE, fv);
+
+    mtx_lock(&g_al.contexts_lock);
+    info = snd_context_info_get(context.handle);
+    shadow = info != NULL ? snd_source_shadow_get(info, source.id, false) : NULL;
+    if(shadow == NULL || shadow->scheduled_ns == 0) {
+        mtx_unlock(&g_al.contexts_lock);
+        return SND_ERROR_INVALID_PARAM;
+    }
+
+    /* when the first sample after the lead-in was heard: now minus how far the source got past it;
+     * AL_SEC_OFFSET_CLOCK_SOFT gives the offset and the device clock of the same moment, both in seconds */
+    if(info->GetSourcedvSOFT != NULL && info->GetInteger64vSOFT != NULL) {
+        info->GetSourcedvSOFT(source.id, AL_SEC_OFFSET_CLOCK_SOFT, offset_clock);
+        start_s = offset_clock[1] - (offset_clock[0] - shadow->lead_in_seconds);
+    } else {
+        /* only as exact as one mixer update */
+        g_al.GetSourcef(source.id, AL_SEC_OFFSET, &offset);
+        start_s = (double) snd_clock_now_ns(info, g_al.c.GetContextsDevice(context.handle)) * 1e-9 - ((double) offset - shadow->lead_in_seconds);
+    }
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
+        mtx_unlock(&g_al.contexts_lock);
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    params.cone.inner_angle = fv[0];
-    
-    g_al.GetSourcefv(source.id, AL_CONE_OUTER_ANGLE, fv);
+    out_error_ns[0] = (int64_t)(start_s * 1e9) - (int64_t) shadow->scheduled_ns;
+    mtx_unlock(&g_al.contexts_lock);
+
+    r = snd_context_set(old_con, NULL);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
-    }
+    if(r != SND_OK) { return r; }
 #endif
-    params.cone.outer_angle = fv[0];
+
+    return SND_OK;
+}
+snd_result_t snd_sources_rewind(snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources) {
+    snd_result_t r; ALCcontext* old_con;
     
-    g_al.GetSourcefv(source.id, AL_REFERENCE_DISTANCE, fv);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(context.handle == NULL || sources == NULL || nr_sources <= 0) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    params.distance.reference = fv[0];
     
-    g_al.GetSourcefv(source.id, AL_MAX_DISTANCE, fv);
+    r = snd_context_set(context.handle, &old_con);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
-    }
+    if(r != SND_OK) { return r; }
 #endif
-    params.distance.max = fv[0];
-    
-    g_al.GetSourcefv(source.id, AL_ROLLOFF_FACTOR, fv);
+
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    for(int i = 0; i < nr_sources; i++) {
+        if(g_al.IsSource(sources[i].id) != AL_TRUE) {
+            return SND_ERROR_INVALID_PARAM;
+        }
     }
 #endif
-    params.distance.rolloff_factor = fv[0];
-    
-    g_al.GetSourcefv(source.id, AL_PITCH, fv);
+
+    /* Since the only field of snd_source_t is the id, the arrays will line up.
+     * NOTE: if anything is added to the snd_source_t struct, rewrite this! */
+    g_al.SourceRewindv(nr_sources, sources);
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    params.pitch_shift_multiplier = fv[0];
-    
-    g_al.GetSourcefv(source.id, AL_POSITION, fv);
-#ifndef SND_NO_CHECKS
+#ifdef SND_DEBUG
+    g_al.GetSourcei(source.id, AL_SOURCE_STATE, &i);
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
     }
+    if(i != AL_INITIAL) {
+        return SND_ERROR_UNKNOWN;
+    }
 #endif
-    params.position.x = fv[0];
-    params.position.y = fv[1];
-    params.position.z = fv[2];
-    
-    g_al.GetSourcefv(source.id, AL_VELOCITY, fv);
+
+    r = snd_context_set(old_con, NULL);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(r != SND_OK) { return r; }
+#endif
+
+    return SND_OK;
+}
+
+
+typedef struct snd_stream_state_t {
+    ALCcontext* context;
+    ALuint source;
+    snd_stream_params_t params;
+    ALenum al_format;
+    uint32_t frame_size;
+    ALuint buffers[SND_STREAM_MAX_BUFFERS];
+    void* staging;
+    thrd_t thread;
+    /* guards everything below and the AL source state against the refill thread */
+    mtx_t lock;
+    bool thread_running, playing, end_of_stream;
+    /* buffers a fill failed on, queued again before the processed ones; staging still holds their frames */
+    ALuint spare[SND_STREAM_MAX_BUFFERS];
+    uint32_t nr_spare, staged_frames;
+    snd_stream_stats_t stats;
+    snd_result_t error;
+} snd_stream_state_t;
+
+/* pulls one buffer worth of frames and queues it, returns false at the end of the stream or on an error,
+ * which is kept in stream->error while the buffer and the pulled frames wait in spare for the next try */
+static bool snd_stream_fill(snd_stream_state_t* stream, ALuint buffer) {
+    snd_result_t r; uint32_t nr_frames; snd_format_t uploaded;
+
+    if(stream->staged_frames == 0) {
+        if(stream->end_of_stream) {
+            return false;
+        }
+        nr_frames = stream->params.pull(stream->params.user_data, stream->staging, stream->params.frames_per_buffer);
+        if(nr_frames > stream->params.frames_per_buffer) {
+            nr_frames = stream->params.frames_per_buffer;
+        }
+        if(nr_frames == 0) {
+            stream->end_of_stream = true;
+            return false;
+        }
+        stream->staged_frames = nr_frames;
     }
+
+    r = snd_buffer_data(buffer, stream->params.format, stream->staging, stream->staged_frames * stream->frame_size, stream->params.frequency_hz, &uploaded);
+    if(r == SND_OK) {
+        g_al.SourceQueueBuffers(stream->source, 1, &buffer);
+#ifndef SND_NO_CHECKS
+        if(g_al.GetError() != AL_NO_ERROR) {
+            r = SND_ERROR_UNKNOWN;
+        }
 #endif
-    params.velocity.x = fv[0];
-    params.velocity.y = fv[1];
-    params.velocity.z = fv[2];
-    
-    g_al.GetSourcefv(source.id, AL_DIRECTION, fv);
+    }
+    if(r != SND_OK) {
+        stream->spare[stream->nr_spare++] = buffer;
+        if(stream->error == SND_OK) {
+            stream->error = r;
+        }
+        return false;
+    }
+    stream->stats.frames_streamed += stream->staged_frames;
+    stream->staged_frames = 0;
+    return true;
+}
+/* called with the lock held and the stream's context current */
+static snd_result_t snd_stream_update(snd_stream_state_t* stream) {
+    ALint processed, queued, state; ALuint buffer; uint32_t nr_spare;
+
+    /* a failed fill puts its buffer back at an index already taken out */
+    nr_spare = stream->nr_spare;
+    stream->nr_spare = 0;
+    for(uint32_t i = 0; i < nr_spare; i++) {
+        snd_stream_fill(stream, stream->spare[i]);
+    }
+    g_al.GetSourcei(stream->source, AL_BUFFERS_PROCESSED, &processed);
+    while(processed > 0) {
+        g_al.SourceUnqueueBuffers(stream->source, 1, &buffer);
+        snd_stream_fill(stream, buffer);
+        processed--;
+    }
+
+    g_al.GetSourcei(stream->source, AL_BUFFERS_QUEUED, &queued);
+    g_al.GetSourcei(stream->source, AL_SOURCE_STATE, &state);
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    params.direction.x = fv[0];
-    params.direction.y = fv[1];
-    params.direction.z = fv[2];
 
-    r = snd_context_set(old_con, NULL);
+    stream->stats.buffers_queued = (uint32_t) queued;
+    if(stream->playing && state != AL_PLAYING && state != AL_PAUSED) {
+        if(queued > 0) {
+            /* AL stopped the source because it ran dry before we refilled, restart with what we have now */
+            stream->stats.underruns++;
+            g_al.SourcePlayv(1, &(stream->source));
 #ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
+            if(g_al.GetError() != AL_NO_ERROR) {
+                return SND_ERROR_UNKNOWN;
+            }
 #endif
+        } else if(stream->end_of_stream) {
+            stream->playing = false;
+            stream->stats.finished = true;
+        }
+    }
 
-    out_params[0] = params;
-
+    /* SND_OK unless a fill failed, which stops the refills until snd_stream_stop */
+    return stream->error;
+}
+/* The software backend renders faster than real time, so its streams are refilled by snd_software_render before
+ * every block instead of on a thread that would fall behind. */
+static void snd_soft_streams_update(void) {
+    snd_stream_state_t* stream; ALCcontext* old_con;
+
+    mtx_lock(&g_soft.streams_lock);
+    for(uint32_t i = 0; i < g_soft.nr_streams; i++) {
+        stream = g_soft.streams[i];
+        mtx_lock(&(stream->lock));
+        if(stream->playing && stream->error == SND_OK) {
+            stream->error = snd_context_set(stream->context, &old_con);
+            if(stream->error == SND_OK) {
+                stream->error = snd_stream_update(stream);
+                snd_context_set(old_con, NULL);
+            }
+        }
+        mtx_unlock(&(stream->lock));
+    }
+    mtx_unlock(&g_soft.streams_lock);
+}
+static snd_result_t snd_soft_stream_register(snd_stream_state_t* stream) {
+    snd_stream_state_t** streams;
+
+    mtx_lock(&g_soft.streams_lock);
+    if(g_soft.nr_streams == g_soft.streams_cap) {
+        streams = realloc(g_soft.streams, (g_soft.streams_cap + 16) * sizeof(snd_stream_state_t*));
+        if(streams == NULL) {
+            mtx_unlock(&g_soft.streams_lock);
+            return SND_ERROR_OUT_OF_MEMORY;
+        }
+        g_soft.streams = streams;
+        g_soft.streams_cap += 16;
+    }
+    g_soft.streams[g_soft.nr_streams++] = stream;
+    mtx_unlock(&g_soft.streams_lock);
     return SND_OK;
 }
-snd_result_t snd_source_params_set(snd_listener_context_t context, snd_source_t source, const snd_source_params_t params) {
-    snd_result_t r; ALCcontext* old_con; ALfloat fv[3];
-    snd_source_params_t test_params;
-    
+/* once this returns, snd_software_render doesn't touch the stream anymore */
+static void snd_soft_stream_unregister(snd_stream_state_t* stream) {
+    mtx_lock(&g_soft.streams_lock);
+    for(uint32_t i = 0; i < g_soft.nr_streams; i++) {
+        if(g_soft.streams[i] == stream) {
+            g_soft.streams[i] = g_soft.streams[--g_soft.nr_streams];
+            break;
+        }
+    }
+    mtx_unlock(&g_soft.streams_lock);
+}
+static int snd_stream_thread(void* arg) {
+    snd_stream_state_t* stream = arg; snd_result_t r; bool running;
+    struct timespec interval;
+    snd_listener_context_t context;
+
+    /* snd_stream_create made sure of ALC_EXT_thread_local_context, so this only changes the context of the refill thread */
+    context.handle = stream->context;
+    r = snd_listener_context_bind(context);
+    if(r != SND_OK) {
+        mtx_lock(&(stream->lock));
+        stream->error = r;
+        stream->thread_running = false;
+        mtx_unlock(&(stream->lock));
+        return 0;
+    }
+
+    interval.tv_sec = stream->params.refill_interval_ms / 1000;
+    interval.tv_nsec = (long)(stream->params.refill_interval_ms % 1000) * 1000000L;
+    do {
+        mtx_lock(&(stream->lock));
+        running = stream->thread_running;
+        if(running && stream->playing && stream->error == SND_OK) {
+            stream->error = snd_stream_update(stream);
+        }
+        mtx_unlock(&(stream->lock));
+        if(running) {
+            thrd_sleep(&interval, NULL);
+        }
+    } while(running);
+
+    snd_listener_context_unbind();
+    return 0;
+}
+
+/* undoes a snd_stream_create that failed after the lock was initialized, old_con is NULL if the context wasn't switched yet */
+static void snd_stream_create_undo(snd_stream_state_t* stream, ALCcontext* old_con, bool buffers_generated) {
+    if(buffers_generated) {
+        g_al.DeleteBuffers(stream->params.nr_buffers, stream->buffers);
+    }
+    if(old_con != NULL) {
+        snd_context_set(old_con, NULL);
+    }
+    mtx_destroy(&(stream->lock));
+    free(stream->staging);
+    free(stream);
+}
+snd_result_t snd_stream_create(snd_listener_context_t context, snd_source_t source, const snd_stream_params_t params, snd_stream_t* out_stream) {
+    snd_result_t r; ALCcontext* old_con; snd_stream_state_t* stream;
+
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL) {
+    if(context.handle == NULL || out_stream == NULL || params.pull == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    if(params.nr_buffers < 2 || params.nr_buffers > SND_STREAM_MAX_BUFFERS || params.frames_per_buffer == 0 || params.frequency_hz == 0) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    
+    /* without thread local contexts the refill thread would switch the process wide context under the other threads */
+    if(g_al.backend != SND_BACKEND_TYPE_SOFTWARE && !g_al.ext.thread_local_context) {
+        return SND_ERROR_THREAD_LOCAL_CONTEXT_NOT_PRESENT;
+    }
+
+    stream = calloc(1, sizeof(snd_stream_state_t));
+    if(stream == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    stream->context = context.handle;
+    stream->source = source.id;
+    stream->params = params;
+    if(stream->params.refill_interval_ms == 0) {
+        /* a quarter of one buffer's playtime keeps the refill well ahead of the mixer */
+        stream->params.refill_interval_ms = (uint32_t)((uint64_t) params.frames_per_buffer * 250 / params.frequency_hz);
+        if(stream->params.refill_interval_ms == 0) {
+            stream->params.refill_interval_ms = 1;
+        }
+    }
+    r = snd_format_info(params.format, &(stream->al_format), &(stream->frame_size));
+    if(r != SND_OK) {
+        free(stream);
+        return r;
+    }
+    stream->staging = malloc((size_t) params.frames_per_buffer * stream->frame_size);
+    if(stream->staging == NULL) {
+        free(stream);
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    if(mtx_init(&(stream->lock), mtx_plain) != thrd_success) {
+        free(stream->staging);
+        free(stream);
+        return SND_ERROR_UNKNOWN;
+    }
+
     r = snd_context_set(context.handle, &old_con);
 #ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
+    if(r != SND_OK) {
+        snd_stream_create_undo(stream, NULL, false);
+        return r;
+    }
 #endif
 
 #ifndef SND_NO_CHECKS
     if(g_al.IsSource(source.id) != AL_TRUE) {
+        snd_stream_create_undo(stream, old_con, false);
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
-    g_al.Sourcei(source.id, AL_SOURCE_RELATIVE, params.position_relative_to_listener);
+    g_al.GenBuffers(params.nr_buffers, stream->buffers);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
+    switch(g_al.GetError()) {
+    case AL_NO_ERROR:
+        break;
+    case AL_OUT_OF_MEMORY:
+        snd_stream_create_undo(stream, old_con, false);
+        return SND_ERROR_OUT_OF_MEMORY;
+    default:
+        snd_stream_create_undo(stream, old_con, false);
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    
-    g_al.Sourcei(source.id, AL_LOOPING, params.looping);
+
+    /* streaming sources must not loop, the end of the stream is decided by the pull callback */
+    g_al.Sourcei(source.id, AL_LOOPING, AL_FALSE);
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
+        snd_stream_create_undo(stream, old_con, true);
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    
-    fv[0] = params.gain.multiplier;
-    g_al.Sourcefv(source.id, AL_GAIN, fv);
+
+    r = snd_context_set(old_con, NULL);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(r != SND_OK) {
+        snd_stream_destroy((snd_stream_t){ stream });
+        return r;
     }
 #endif
-    
-    fv[0] = params.gain.min;
-    g_al.Sourcefv(source.id, AL_MIN_GAIN, fv);
-#ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+
+    if(g_al.backend == SND_BACKEND_TYPE_SOFTWARE) {
+        r = snd_soft_stream_register(stream);
+        if(r != SND_OK) {
+            snd_stream_destroy((snd_stream_t){ stream });
+            return r;
+        }
+        out_stream[0].handle = stream;
+        return SND_OK;
     }
-#endif
-    
-    fv[0] = params.gain.max;
-    g_al.Sourcefv(source.id, AL_MAX_GAIN, fv);
-#ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    stream->thread_running = true;
+    if(thrd_create(&(stream->thread), snd_stream_thread, stream) != thrd_success) {
+        stream->thread_running = false;
+        snd_stream_destroy((snd_stream_t){ stream });
+        return SND_ERROR_THREAD_CREATION_FAILED;
     }
-#endif
-    
-    fv[0] = params.gain.outer_angle_secondary_multiplier;
-    g_al.Sourcefv(source.id, AL_CONE_OUTER_GAIN, fv);
+
+    out_stream[0].handle = stream;
+    return SND_OK;
+}
+snd_result_t snd_stream_play(snd_stream_t stream) {
+    snd_result_t r; ALCcontext* old_con; snd_stream_state_t* s = stream.handle;
+    ALint queued;
+
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(s == NULL) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    
-    fv[0] = params.cone.inner_angle;
-    g_al.Sourcefv(source.id, AL_CONE_INNER_ANGLE, fv);
+
+    r = snd_context_set(s->context, &old_con);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
-    }
+    if(r != SND_OK) { return r; }
 #endif
-    
-    fv[0] = params.cone.outer_angle;
-    g_al.Sourcefv(source.id, AL_CONE_OUTER_ANGLE, fv);
+
+    mtx_lock(&(s->lock));
+    if(!s->playing) {
+        /* prime the whole ring before starting, so playback begins with the full latency headroom */
+        g_al.GetSourcei(s->source, AL_BUFFERS_QUEUED, &queued);
+        if(queued == 0) {
+            /* no break on a failed fill, the buffers after it have to go to spare as well */
+            s->nr_spare = 0;
+            for(uint32_t i = 0; i < s->params.nr_buffers; i++) {
+                snd_stream_fill(s, s->buffers[i]);
+            }
+        }
+        g_al.SourcePlayv(1, &(s->source));
+        s->playing = true;
+        s->stats.finished = false;
+    }
+    mtx_unlock(&(s->lock));
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    
-    fv[0] = params.distance.reference;
-    g_al.Sourcefv(source.id, AL_REFERENCE_DISTANCE, fv);
+
+    r = snd_context_set(old_con, NULL);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
-    }
+    if(r != SND_OK) { return r; }
 #endif
-    
-    fv[0] = params.distance.max;
-    g_al.Sourcefv(source.id, AL_MAX_DISTANCE, fv);
+
+    return SND_OK;
+}
+snd_result_t snd_stream_stop(snd_stream_t stream) {
+    snd_result_t r; ALCcontext* old_con; snd_stream_state_t* s = stream.handle;
+
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(s == NULL) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    
-    fv[0] = params.distance.rolloff_factor;
-    g_al.Sourcefv(source.id, AL_ROLLOFF_FACTOR, fv);
+
+    r = snd_context_set(s->context, &old_con);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
-    }
+    if(r != SND_OK) { return r; }
 #endif
-    
-    fv[0] = params.pitch_shift_multiplier;
-    g_al.Sourcefv(source.id, AL_PITCH, fv);
+
+    mtx_lock(&(s->lock));
+    s->playing = false;
+    s->end_of_stream = false;
+    /* a fill error is cleared so play can try again, the refill thread failing to start is not */
+    if(s->thread_running || g_al.backend == SND_BACKEND_TYPE_SOFTWARE) {
+        s->error = SND_OK;
+    }
+    /* stopping marks every queued buffer as processed, detaching the buffer drops the queue */
+    g_al.SourceStopv(1, &(s->source));
+    g_al.Sourcei(s->source, AL_BUFFER, 0);
+    mtx_unlock(&(s->lock));
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
     }
 #endif
-    
-    fv[0] = params.position.x;
-    fv[1] = params.position.y;
-    fv[2] = params.position.z;
-    g_al.Sourcefv(source.id, AL_POSITION, fv);
+
+    r = snd_context_set(old_con, NULL);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(r != SND_OK) { return r; }
+#endif
+
+    return SND_OK;
+}
+snd_result_t snd_stream_stats_get(snd_stream_t stream, snd_stream_stats_t* out_stats) {
+    snd_result_t r; snd_stream_state_t* s = stream.handle;
+
+#ifndef SND_NO_CHECKS
+    if(s == NULL || out_stats == NULL) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    
-    fv[0] = params.velocity.x;
-    fv[1] = params.velocity.y;
-    fv[2] = params.velocity.z;
-    g_al.Sourcefv(source.id, AL_VELOCITY, fv);
+
+    mtx_lock(&(s->lock));
+    out_stats[0] = s->stats;
+    r = s->error;
+    mtx_unlock(&(s->lock));
+
+    return r;
+}
+snd_result_t snd_stream_destroy(snd_stream_t stream) {
+    snd_result_t r; ALCcontext* old_con; snd_stream_state_t* s = stream.handle;
+    bool joinable;
+
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(s == NULL) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    
-    fv[0] = params.direction.x;
-    fv[1] = params.direction.y;
-    fv[2] = params.direction.z;
-    g_al.Sourcefv(source.id, AL_DIRECTION, fv);
+
+    if(g_al.backend == SND_BACKEND_TYPE_SOFTWARE) {
+        snd_soft_stream_unregister(s);
+    }
+    mtx_lock(&(s->lock));
+    joinable = s->thread_running;
+    s->thread_running = false;
+    mtx_unlock(&(s->lock));
+    if(joinable) {
+        thrd_join(s->thread, NULL);
+    }
+
+    r = snd_context_set(s->context, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    g_al.SourceStopv(1, &(s->source));
+    g_al.Sourcei(s->source, AL_BUFFER, 0);
+    g_al.DeleteBuffers(s->params.nr_buffers, s->buffers);
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
@@ -1415,602 +6611,1775 @@ snd_result_t snd_source_params_set(snd_listener_context_t context, snd_source_t
     if(r != SND_OK) { return r; }
 #endif
 
+    mtx_destroy(&(s->lock));
+    free(s->staging);
+    free(s);
 
-#ifdef SND_DEBUG
-    r = snd_source_params_get(context, source, &test_params);
-    if(r != SND_OK) { return r; }
+    return SND_OK;
+}
 
-    if(test_params != params) {
-        return SND_ERROR_UNKNOWN;
+typedef struct snd_voice_state_t {
+    bool used, playing, restart;
+    snd_buffer_t buffer;
+    snd_source_params_t params;
+    float priority, audibility;
+    /* the playback position, advanced by the update while the voice is virtual */
+    double time_s, duration_s;
+    /* index into the pool's sources, -1 while virtual */
+    int32_t real;
+} snd_voice_state_t;
+typedef struct snd_voice_rank_t {
+    float audibility;
+    uint32_t index;
+} snd_voice_rank_t;
+typedef struct snd_voice_pool_state_t {
+    snd_listener_context_t context;
+    uint32_t nr_sources;
+    snd_source_t* sources;
+    /* voice index + 1 of the voice on each source, 0 if free */
+    uint32_t* source_voices;
+    snd_voice_state_t* voices;
+    uint32_t nr_voices, voices_cap;
+    /* scratch for the update, voices_cap entries */
+    snd_voice_rank_t* order;
+    snd_source_params_t* batch_params;
+    snd_source_t* batch_sources;
+} snd_voice_pool_state_t;
+
+snd_result_t snd_voice_pool_create(snd_listener_context_t context, uint32_t nr_real_sources, snd_voice_pool_t* out_pool) {
+    snd_result_t r; snd_voice_pool_state_t* pool;
+
+#ifndef SND_NO_CHECKS
+    if(context.handle == NULL || nr_real_sources == 0 || out_pool == NULL) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
+    pool = calloc(1, sizeof(snd_voice_pool_state_t));
+    if(pool == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    pool->context = context;
+    pool->sources = calloc(nr_real_sources, sizeof(snd_source_t));
+    pool->source_voices = calloc(nr_real_sources, sizeof(uint32_t));
+    pool->batch_params = calloc(nr_real_sources, sizeof(snd_source_params_t));
+    pool->batch_sources = calloc(nr_real_sources, sizeof(snd_source_t));
+    if(pool->sources == NULL || pool->source_voices == NULL || pool->batch_params == NULL || pool->batch_sources == NULL) {
+        snd_voice_pool_destroy((snd_voice_pool_t){ pool });
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* as many as the context gives us, the pool just maps fewer voices if it runs out */
+    for(uint32_t i = 0; i < nr_real_sources; i++) {
+        r = snd_source_create(context, &(pool->sources[i]));
+        if(r == SND_ERROR_LISTENING_CONTEXT_OUT_OF_SOURCES && i > 0) {
+            break;
+        }
+        if(r != SND_OK) {
+            snd_voice_pool_destroy((snd_voice_pool_t){ pool });
+            return r;
+        }
+        pool->nr_sources++;
+    }
+
+    out_pool[0].handle = pool;
     return SND_OK;
 }
+snd_result_t snd_voice_create(snd_voice_pool_t pool, snd_buffer_t buffer, const snd_source_params_t params, float priority, snd_voice_t* out_voice) {
+    snd_result_t r; ALCcontext* old_con; snd_voice_pool_state_t* p = pool.handle;
+    snd_voice_state_t* voice; snd_voice_state_t* new_voices; snd_voice_rank_t* new_order; uint32_t index;
+    ALint size, channels, bits, frequency;
 
-snd_result_t snd_source_play_position_set(snd_listener_context_t context, snd_source_t source, snd_source_position_format_t format, float value) {
-    snd_result_t r; ALCcontext* old_con; ALenum al_param_name;
-    ALfloat f;
-    
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL) {
+    if(p == NULL || out_voice == NULL || !(priority >= 0.0f)) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
-    switch(format) {
-    case SND_SOURCE_POSITION_FORMAT_SECONDS:
-        al_param_name = AL_SEC_OFFSET;
-        break;
-    case SND_SOURCE_POSITION_FORMAT_SAMPLES:
-        al_param_name = AL_SAMPLE_OFFSET;
-        break;
-    case SND_SOURCE_POSITION_FORMAT_BYTES:
-        al_param_name = AL_BYTE_OFFSET;
-        break;
-    default:
+    for(index = 0; index < p->voices_cap; index++) {
+        if(!p->voices[index].used) {
+            break;
+        }
+    }
+    if(index == p->voices_cap) {
+        new_voices = realloc(p->voices, (p->voices_cap + SND_INITIAL_ARRAY_CAP) * sizeof(snd_voice_state_t));
+        if(new_voices == NULL) {
+            return SND_ERROR_OUT_OF_MEMORY;
+        }
+        p->voices = new_voices;
+        memset(&(p->voices[p->voices_cap]), 0, SND_INITIAL_ARRAY_CAP * sizeof(snd_voice_state_t));
+        new_order = realloc(p->order, (p->voices_cap + SND_INITIAL_ARRAY_CAP) * sizeof(snd_voice_rank_t));
+        if(new_order == NULL) {
+            return SND_ERROR_OUT_OF_MEMORY;
+        }
+        p->order = new_order;
+        p->voices_cap += SND_INITIAL_ARRAY_CAP;
+    }
+
+    /* the duration is needed to advance virtual voices without asking AL */
+    r = snd_context_set(p->context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
+#endif
+
+    g_al.GetBufferi(buffer.id, AL_SIZE, &size);
+    g_al.GetBufferi(buffer.id, AL_CHANNELS, &channels);
+    g_al.GetBufferi(buffer.id, AL_BITS, &bits);
+    g_al.GetBufferi(buffer.id, AL_FREQUENCY, &frequency);
+#ifndef SND_NO_CHECKS
+    if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_INVALID_PARAM;
     }
-    
-    f = value;
-    
-    r = snd_context_set(context.handle, &old_con);
+#endif
+
+    r = snd_context_set(old_con, NULL);
 #ifndef SND_NO_CHECKS
     if(r != SND_OK) { return r; }
 #endif
 
+    voice = &(p->voices[index]);
+    memset(voice, 0, sizeof(snd_voice_state_t));
+    voice->used = true;
+    voice->buffer = buffer;
+    voice->params = params;
+    voice->priority = priority;
+    voice->real = -1;
+    voice->duration_s = channels > 0 && bits > 0 && frequency > 0 ? (double) size / (channels * bits / 8) / frequency : 0.0;
+    p->nr_voices++;
+
+    out_voice[0].id = index + 1;
+    return SND_OK;
+}
+static snd_voice_state_t* snd_voice_get(snd_voice_pool_state_t* p, snd_voice_t voice) {
+    if(p == NULL || voice.id == 0 || voice.id > p->voices_cap || !p->voices[voice.id-1].used) {
+        return NULL;
+    }
+    return &(p->voices[voice.id-1]);
+}
+snd_result_t snd_voice_params_set(snd_voice_pool_t pool, snd_voice_t voice, const snd_source_params_t params, float priority) {
+    snd_voice_state_t* v = snd_voice_get(pool.handle, voice);
+
 #ifndef SND_NO_CHECKS
-    if(g_al.IsSource(source.id) != AL_TRUE) {
+    if(v == NULL || !(priority >= 0.0f)) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
-    g_al.Sourcefv(source.id, al_param_name, &f);
+    /* applied to the real source by the next update */
+    v->params = params;
+    v->priority = priority;
+    return SND_OK;
+}
+snd_result_t snd_voice_play(snd_voice_pool_t pool, snd_voice_t voice) {
+    snd_voice_state_t* v = snd_voice_get(pool.handle, voice);
+
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(v == NULL) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
-#ifdef SND_DEBUG
-    g_al.GetSourcefv(source.id, al_param_name, &f);
+
+    v->playing = true;
+    v->restart = v->real >= 0;
+    v->time_s = 0.0;
+    return SND_OK;
+}
+/* takes the voice off its real source, if it has one */
+static snd_result_t snd_voice_release_source(snd_voice_pool_state_t* p, snd_voice_state_t* v) {
+    snd_source_t source;
+
+    if(v->real < 0) {
+        return SND_OK;
+    }
+    source = p->sources[v->real];
+    g_al.SourceStopv(1, &(source.id));
+    g_al.Sourcei(source.id, AL_BUFFER, 0);
+    p->source_voices[v->real] = 0;
+    v->real = -1;
+#ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
         return SND_ERROR_UNKNOWN;
     }
-    if(f != value) {
-        return SND_ERROR_UNKNOWN;
+#endif
+    return SND_OK;
+}
+snd_result_t snd_voice_stop(snd_voice_pool_t pool, snd_voice_t voice) {
+    snd_result_t r, release_r; ALCcontext* old_con; snd_voice_pool_state_t* p = pool.handle;
+    snd_voice_state_t* v = snd_voice_get(p, voice);
+
+#ifndef SND_NO_CHECKS
+    if(v == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    v->playing = false;
+    if(v->real < 0) {
+        return SND_OK;
     }
+
+    r = snd_context_set(p->context.handle, &old_con);
+#ifndef SND_NO_CHECKS
+    if(r != SND_OK) { return r; }
 #endif
 
+    release_r = snd_voice_release_source(p, v);
+
     r = snd_context_set(old_con, NULL);
 #ifndef SND_NO_CHECKS
     if(r != SND_OK) { return r; }
 #endif
 
-    return SND_OK;
+    return release_r;
 }
-snd_result_t snd_source_play_position_get(snd_listener_context_t context, snd_source_t source, snd_source_position_format_t format, float* out_value) {
-    snd_result_t r; ALCcontext* old_con; ALenum al_param_name;
-    ALfloat f;
-    
+snd_result_t snd_voice_destroy(snd_voice_pool_t pool, snd_voice_t voice) {
+    snd_result_t r; snd_voice_pool_state_t* p = pool.handle;
+    snd_voice_state_t* v = snd_voice_get(p, voice);
+
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL || out_value == NULL) {
+    if(v == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
-    switch(format) {
-    case SND_SOURCE_POSITION_FORMAT_SECONDS:
-        al_param_name = AL_SEC_OFFSET;
-        break;
-    case SND_SOURCE_POSITION_FORMAT_SAMPLES:
-        al_param_name = AL_SAMPLE_OFFSET;
-        break;
-    case SND_SOURCE_POSITION_FORMAT_BYTES:
-        al_param_name = AL_BYTE_OFFSET;
-        break;
-    default:
+    r = snd_voice_stop(pool, voice);
+    v->used = false;
+    p->nr_voices--;
+    return r;
+}
+static int snd_voice_rank_compare(const void* a, const void* b) {
+    float x = ((const snd_voice_rank_t*) a)->audibility, y = ((const snd_voice_rank_t*) b)->audibility;
+    return x < y ? 1 : (x > y ? -1 : 0);
+}
+snd_result_t snd_voice_pool_update(snd_voice_pool_t pool, float elapsed_s) {
+    snd_result_t r, update_r = SND_OK; ALCcontext* old_con; snd_voice_pool_state_t* p = pool.handle;
+    snd_voice_state_t* v; ALint state, distance_model; ALfloat listener[3], f, rel[3], distance;
+    uint32_t nr_playing = 0, nr_real, nr_batch = 0, free_source = 0;
+#ifdef SND_PROFILE
+    uint32_t profile_depth;
+#endif
+
+#ifndef SND_NO_CHECKS
+    if(p == NULL || !(elapsed_s >= 0.0f)) {
         return SND_ERROR_INVALID_PARAM;
     }
-    
-    r = snd_context_set(context.handle, &old_con);
+#endif
+
+    r = snd_context_set(p->context.handle, &old_con);
 #ifndef SND_NO_CHECKS
     if(r != SND_OK) { return r; }
 #endif
 
-#ifndef SND_NO_CHECKS
-    if(g_al.IsSource(source.id) != AL_TRUE) {
-        return SND_ERROR_INVALID_PARAM;
+    g_al.GetListenerfv(AL_POSITION, listener);
+    distance_model = g_al.GetInteger(AL_DISTANCE_MODEL);
+
+    for(uint32_t i = 0; i < p->voices_cap; i++) {
+        v = &(p->voices[i]);
+        if(!v->used || !v->playing) {
+            continue;
+        }
+        if(v->real >= 0 && v->restart) {
+            /* played from the start once its params are set below */
+        } else if(v->real >= 0) {
+            g_al.GetSourcei(p->sources[v->real].id, AL_SOURCE_STATE, &state);
+            g_al.GetSourcef(p->sources[v->real].id, AL_SEC_OFFSET, &f);
+            if(state == AL_STOPPED) {
+                v->playing = false;
+                snd_voice_release_source(p, v);
+                continue;
+            }
+            v->time_s = f;
+        } else {
+            v->time_s += elapsed_s * v->params.pitch_shift_multiplier;
+            if(v->time_s >= v->duration_s) {
+                if(!v->params.looping || v->duration_s <= 0.0) {
+                    v->playing = false;
+                    continue;
+                }
+                v->time_s = fmod(v->time_s, v->duration_s);
+            }
+        }
+
+        /* what AL would do with the gain, only cheaper: no cone, just distance and the priority on top */
+        for(int c = 0; c < 3; c++) {
+            rel[c] = v->params.position_relative_to_listener ? (&v->params.position.x)[c] : (&v->params.position.x)[c] - listener[c];
+        }
+        distance = sqrtf(rel[0]*rel[0] + rel[1]*rel[1] + rel[2]*rel[2]);
+        v->audibility = v->params.gain.multiplier * v->priority * snd_distance_gain(distance_model, distance, v->params.distance.reference, v->params.distance.max, v->params.distance.rolloff_factor);
+        p->order[nr_playing].audibility = v->audibility;
+        p->order[nr_playing].index = i;
+        nr_playing++;
     }
-#endif
 
-    g_al.GetSourcefv(source.id, al_param_name, &f);
+    qsort(p->order, nr_playing, sizeof(snd_voice_rank_t), snd_voice_rank_compare);
+    nr_real = 0;
+    while(nr_real < nr_playing && nr_real < p->nr_sources && p->order[nr_real].audibility > 0.0f) {
+        nr_real++;
+    }
+
+    /* first free the sources of voices that fell out of the top, so the new ones can take them */
+    for(uint32_t i = nr_real; i < nr_playing; i++) {
+        r = snd_voice_release_source(p, &(p->voices[p->order[i].index]));
+        if(r != SND_OK) { update_r = r; }
+    }
+    for(uint32_t i = 0; i < nr_real; i++) {
+        v = &(p->voices[p->order[i].index]);
+        if(v->real < 0) {
+            while(p->source_voices[free_source] != 0) {
+                free_source++;
+            }
+            v->real = (int32_t) free_source;
+            p->source_voices[free_source] = p->order[i].index + 1;
+            g_al.Sourcei(p->sources[free_source].id, AL_BUFFER, (ALint) v->buffer.id);
+            g_al.Sourcef(p->sources[free_source].id, AL_SEC_OFFSET, (ALfloat) v->time_s);
+            v->restart = true;
+        }
+        p->batch_sources[nr_batch] = p->sources[v->real];
+        p->batch_params[nr_batch] = v->params;
+        nr_batch++;
+    }
 #ifndef SND_NO_CHECKS
     if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+        update_r = SND_ERROR_UNKNOWN;
+    }
+#endif
+
+    /* everything, the shadow copy drops what didn't change */
+    if(nr_batch > 0) {
+#ifdef SND_PROFILE
+        /* counted as part of this call; a batch failing before it leaves mustn't leave the depth raised */
+        profile_depth = snd_profile.depth;
+        snd_profile.nested = true;
+#endif
+        r = snd_sources_params_set_batch(p->context, nr_batch, p->batch_sources, p->batch_params, SND_SOURCE_PARAMS_FIELD_ALL_BITS);
+#ifdef SND_PROFILE
+        snd_profile.nested = false;
+        snd_profile.depth = profile_depth;
+#endif
+        if(r != SND_OK) { update_r = r; }
+    }
+
+    /* only now, so the first block they mix already has their own params and not those of the source's last voice */
+    nr_batch = 0;
+    for(uint32_t i = 0; i < nr_real; i++) {
+        v = &(p->voices[p->order[i].index]);
+        if(v->restart) {
+            p->batch_sources[nr_batch++] = p->sources[v->real];
+            v->restart = false;
+        }
     }
+    if(nr_batch > 0) {
+        g_al.SourcePlayv(nr_batch, (const ALuint*) p->batch_sources);
+#ifndef SND_NO_CHECKS
+        if(g_al.GetError() != AL_NO_ERROR) {
+            update_r = SND_ERROR_UNKNOWN;
+        }
 #endif
+    }
 
     r = snd_context_set(old_con, NULL);
 #ifndef SND_NO_CHECKS
     if(r != SND_OK) { return r; }
 #endif
 
-    out_value[0] = f;
-
-    return SND_OK;
+    return update_r;
 }
-snd_result_t snd_source_queue_position_get(snd_listener_context_t context, snd_source_t source, uint32_t* nr_buffers_in_queue, uint32_t* currently_playing_index) {
-    snd_result_t r; ALCcontext* old_con;
-    ALint i1, i2;
-    
+snd_result_t snd_voice_pool_stats_get(snd_voice_pool_t pool, snd_voice_pool_stats_t* out_stats) {
+    snd_voice_pool_state_t* p = pool.handle;
+
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL || nr_buffers_in_queue == NULL || currently_playing_index == NULL) {
+    if(p == NULL || out_stats == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    
-    r = snd_context_set(context.handle, &old_con);
+
+    memset(out_stats, 0, sizeof(snd_voice_pool_stats_t));
+    out_stats->nr_voices = p->nr_voices;
+    out_stats->nr_real_sources = p->nr_sources;
+    for(uint32_t i = 0; i < p->voices_cap; i++) {
+        if(p->voices[i].used && p->voices[i].playing) {
+            if(p->voices[i].real >= 0) {
+                out_stats->nr_playing_real++;
+            } else {
+                out_stats->nr_playing_virtual++;
+            }
+        }
+    }
+    return SND_OK;
+}
+snd_result_t snd_voice_pool_destroy(snd_voice_pool_t pool) {
+    snd_result_t r = SND_OK, delete_r; snd_voice_pool_state_t* p = pool.handle;
+
 #ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
+    if(p == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
 #endif
 
+    for(uint32_t i = 0; i < p->nr_sources; i++) {
+        delete_r = snd_source_delete(p->context, p->sources[i]);
+        if(delete_r != SND_OK) {
+            r = delete_r;
+        }
+    }
+    free(p->sources);
+    free(p->source_voices);
+    free(p->batch_params);
+    free(p->batch_sources);
+    free(p->voices);
+    free(p->order);
+    free(p);
+    return r;
+}
+
+typedef struct snd_buffer_cache_entry_t {
+    uint64_t hash;
+    snd_format_t format;
+    uint32_t frequency_hz;
+    /* size is the key, uploaded_size what the buffer holds after resampling and conversion */
+    size_t size, uploaded_size;
+    snd_buffer_t buffer;
+    uint32_t nr_refs;
+    /* chains in the two bucket arrays, and the LRU list of unreferenced entries; UINT32_MAX ends them */
+    uint32_t hash_next, id_next, lru_prev, lru_next;
+    bool used;
+} snd_buffer_cache_entry_t;
+typedef struct snd_buffer_cache_state_t {
+    snd_listener_context_t context;
+    size_t budget_bytes, resident_bytes;
+    snd_buffer_cache_entry_t* entries;
+    uint32_t nr_entries, entries_cap, free_head;
+    /* power of two, grown with the entries */
+    uint32_t* hash_buckets;
+    uint32_t* id_buckets;
+    uint32_t buckets_cap;
+    uint32_t lru_head, lru_tail;
+    uint64_t nr_hits, nr_misses, nr_evictions;
+} snd_buffer_cache_state_t;
+
+#define SND_CACHE_NONE UINT32_MAX
+
+/* 8 bytes per step, the content only has to be told apart, not protected against anyone */
+static uint64_t snd_buffer_cache_hash(const void* data, size_t size, snd_format_t format, uint32_t frequency_hz) {
+    const uint8_t* p = data; uint64_t h, w;
+
+    h = 0x9e3779b97f4a7c15ull ^ ((uint64_t) format << 32 | frequency_hz) ^ ((uint64_t) size * 0xff51afd7ed558ccdull);
+    for(size_t i = 0; i + 8 <= size; i += 8) {
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0x100000001b3ull;
+        h ^= h >> 29;
+    }
+    w = 0;
+    memcpy(&w, p + (size & ~(size_t) 7), size & 7);
+    h = (h ^ w) * 0xc4ceb9fe1a85ec53ull;
+    return h ^ (h >> 32);
+}
+static void snd_buffer_cache_lru_unlink(snd_buffer_cache_state_t* c, uint32_t i) {
+    snd_buffer_cache_entry_t* e = &(c->entries[i]);
+
+    if(e->lru_prev != SND_CACHE_NONE) {
+        c->entries[e->lru_prev].lru_next = e->lru_next;
+    } else {
+        c->lru_head = e->lru_next;
+    }
+    if(e->lru_next != SND_CACHE_NONE) {
+        c->entries[e->lru_next].lru_prev = e->lru_prev;
+    } else {
+        c->lru_tail = e->lru_prev;
+    }
+    e->lru_prev = e->lru_next = SND_CACHE_NONE;
+}
+/* most recently released at the tail, eviction starts at the head */
+static void snd_buffer_cache_lru_append(snd_buffer_cache_state_t* c, uint32_t i) {
+    c->entries[i].lru_prev = c->lru_tail;
+    c->entries[i].lru_next = SND_CACHE_NONE;
+    if(c->lru_tail != SND_CACHE_NONE) {
+        c->entries[c->lru_tail].lru_next = i;
+    } else {
+        c->lru_head = i;
+    }
+    c->lru_tail = i;
+}
+static void snd_buffer_cache_unchain(uint32_t* bucket, snd_buffer_cache_entry_t* entries, uint32_t i, bool by_hash) {
+    uint32_t* link = bucket;
+
+    while(*link != i) {
+        link = by_hash ? &(entries[*link].hash_next) : &(entries[*link].id_next);
+    }
+    *link = by_hash ? entries[i].hash_next : entries[i].id_next;
+}
+static void snd_buffer_cache_chain(snd_buffer_cache_state_t* c, uint32_t i) {
+    uint32_t hb = (uint32_t) c->entries[i].hash & (c->buckets_cap - 1);
+    uint32_t ib = (uint32_t)(c->entries[i].buffer.id * 2654435769u) & (c->buckets_cap - 1);
+
+    c->entries[i].hash_next = c->hash_buckets[hb];
+    c->hash_buckets[hb] = i;
+    c->entries[i].id_next = c->id_buckets[ib];
+    c->id_buckets[ib] = i;
+}
+static uint32_t snd_buffer_cache_find_id(snd_buffer_cache_state_t* c, uint32_t id) {
+    uint32_t i;
+
+    if(c->buckets_cap == 0) {
+        return SND_CACHE_NONE;
+    }
+    i = c->id_buckets[(uint32_t)(id * 2654435769u) & (c->buckets_cap - 1)];
+    while(i != SND_CACHE_NONE && c->entries[i].buffer.id != id) {
+        i = c->entries[i].id_next;
+    }
+    return i;
+}
+static snd_result_t snd_buffer_cache_evict(snd_buffer_cache_state_t* c, uint32_t i) {
+    snd_result_t r; snd_buffer_cache_entry_t* e = &(c->entries[i]);
+
+    /* can still fail if a source holds the buffer without a reference from the cache */
+    r = snd_buffer_free(c->context, e->buffer);
+    if(r != SND_OK) {
+        return r;
+    }
+    snd_buffer_cache_lru_unlink(c, i);
+    snd_buffer_cache_unchain(&(c->hash_buckets[(uint32_t) e->hash & (c->buckets_cap - 1)]), c->entries, i, true);
+    snd_buffer_cache_unchain(&(c->id_buckets[(uint32_t)(e->buffer.id * 2654435769u) & (c->buckets_cap - 1)]), c->entries, i, false);
+    c->resident_bytes -= e->uploaded_size;
+    c->nr_evictions++;
+    c->nr_entries--;
+    e->used = false;
+    e->hash_next = c->free_head;
+    c->free_head = i;
+    return SND_OK;
+}
+static void snd_buffer_cache_trim(snd_buffer_cache_state_t* c) {
+    uint32_t i = c->lru_head, next;
+
+    while(i != SND_CACHE_NONE && c->resident_bytes > c->budget_bytes) {
+        next = c->entries[i].lru_next;
+        snd_buffer_cache_evict(c, i);
+        i = next;
+    }
+}
+static snd_result_t snd_buffer_cache_grow(snd_buffer_cache_state_t* c) {
+    snd_buffer_cache_entry_t* new_entries; uint32_t* new_buckets; uint32_t new_cap;
+
+    new_cap = c->entries_cap == 0 ? 64 : c->entries_cap * 2;
+    new_entries = realloc(c->entries, new_cap * sizeof(snd_buffer_cache_entry_t));
+    if(new_entries == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    c->entries = new_entries;
+    new_buckets = malloc(2 * (size_t) new_cap * sizeof(uint32_t));
+    if(new_buckets == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    for(uint32_t i = c->entries_cap; i < new_cap; i++) {
+        c->entries[i].used = false;
+        c->entries[i].hash_next = i + 1 < new_cap ? i + 1 : c->free_head;
+    }
+    c->free_head = c->entries_cap;
+    c->entries_cap = new_cap;
+
+    /* one bucket per entry, rebuilt from scratch */
+    free(c->hash_buckets);
+    c->hash_buckets = new_buckets;
+    c->id_buckets = new_buckets + new_cap;
+    c->buckets_cap = new_cap;
+    for(uint32_t i = 0; i < 2 * new_cap; i++) {
+        new_buckets[i] = SND_CACHE_NONE;
+    }
+    for(uint32_t i = 0; i < new_cap; i++) {
+        if(c->entries[i].used) {
+            snd_buffer_cache_chain(c, i);
+        }
+    }
+    return SND_OK;
+}
+
+snd_result_t snd_buffer_cache_create(snd_listener_context_t context, size_t budget_bytes, snd_buffer_cache_t* out_cache) {
+    snd_buffer_cache_state_t* c;
+
 #ifndef SND_NO_CHECKS
-    if(g_al.IsSource(source.id) != AL_TRUE) {
+    if(context.handle == NULL || out_cache == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
-    g_al.GetSourcei(source.id, AL_BUFFERS_QUEUED, &i1);
-#ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    c = calloc(1, sizeof(snd_buffer_cache_state_t));
+    if(c == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
     }
-#endif
+    c->context = context;
+    c->budget_bytes = budget_bytes;
+    c->free_head = c->lru_head = c->lru_tail = SND_CACHE_NONE;
 
-    g_al.GetSourcei(source.id, AL_BUFFERS_PROCESSED, &i2);
-#ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
-    }
-#endif
+    out_cache[0].handle = c;
+    return SND_OK;
+}
+snd_result_t snd_buffer_cache_acquire(snd_buffer_cache_t cache, snd_format_t format, uint32_t frequency_hz, void* data, size_t size, snd_buffer_t* out_buffer) {
+    snd_result_t r; snd_buffer_cache_state_t* c = cache.handle; snd_buffer_cache_entry_t* e;
+    uint64_t hash; uint32_t i; snd_buffer_t buffer; size_t uploaded_size;
 
-    r = snd_context_set(old_con, NULL);
 #ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
+    if(c == NULL || data == NULL || out_buffer == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
 #endif
 
-    nr_buffers_in_queue[0] = i1;
-    currently_playing_index[0] = i2;
+    hash = snd_buffer_cache_hash(data, size, format, frequency_hz);
+    i = c->buckets_cap > 0 ? c->hash_buckets[(uint32_t) hash & (c->buckets_cap - 1)] : SND_CACHE_NONE;
+    while(i != SND_CACHE_NONE) {
+        e = &(c->entries[i]);
+        if(e->hash == hash && e->size == size && e->format == format && e->frequency_hz == frequency_hz) {
+            if(e->nr_refs == 0) {
+                snd_buffer_cache_lru_unlink(c, i);
+            }
+            e->nr_refs++;
+            c->nr_hits++;
+            out_buffer[0] = e->buffer;
+            return SND_OK;
+        }
+        i = e->hash_next;
+    }
 
+    c->nr_misses++;
+    r = snd_buffer_alloc_sized(c->context, format, frequency_hz, data, size, &buffer, &uploaded_size);
+    if(r != SND_OK) {
+        return r;
+    }
+    if(c->free_head == SND_CACHE_NONE) {
+        r = snd_buffer_cache_grow(c);
+        if(r != SND_OK) {
+            snd_buffer_free(c->context, buffer);
+            return r;
+        }
+    }
+    i = c->free_head;
+    c->free_head = c->entries[i].hash_next;
+    e = &(c->entries[i]);
+    e->used = true;
+    e->hash = hash;
+    e->format = format;
+    e->frequency_hz = frequency_hz;
+    e->size = size;
+    e->uploaded_size = uploaded_size;
+    e->buffer = buffer;
+    e->nr_refs = 1;
+    e->lru_prev = e->lru_next = SND_CACHE_NONE;
+    snd_buffer_cache_chain(c, i);
+    c->nr_entries++;
+    c->resident_bytes += uploaded_size;
+
+    /* only unreferenced buffers go, so the budget can be exceeded while everything is in use */
+    snd_buffer_cache_trim(c);
+
+    out_buffer[0] = buffer;
     return SND_OK;
 }
+snd_result_t snd_buffer_cache_release(snd_buffer_cache_t cache, snd_buffer_t buffer) {
+    snd_buffer_cache_state_t* c = cache.handle; uint32_t i;
 
-snd_result_t snd_source_static_buffer(snd_listener_context_t context, snd_source_t source, snd_buffer_t buffer) {
-    snd_result_t r; ALCcontext* old_con; ALint id, i;
-    
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL) {
+    if(c == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
-    id = buffer.id;
-    
-    r = snd_context_set(context.handle, &old_con);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
-
-#ifndef SND_NO_CHECKS
-    if(g_al.IsSource(source.id) != AL_TRUE) {
+    i = snd_buffer_cache_find_id(c, buffer.id);
+    if(i == SND_CACHE_NONE || c->entries[i].nr_refs == 0) {
         return SND_ERROR_INVALID_PARAM;
     }
-    if(g_al.IsBuffer(buffer.id) != AL_TRUE) {
+    c->entries[i].nr_refs--;
+    if(c->entries[i].nr_refs == 0) {
+        /* stays resident for the next acquire until the budget needs the space */
+        snd_buffer_cache_lru_append(c, i);
+        snd_buffer_cache_trim(c);
+    }
+    return SND_OK;
+}
+snd_result_t snd_buffer_cache_stats_get(snd_buffer_cache_t cache, snd_buffer_cache_stats_t* out_stats) {
+    snd_buffer_cache_state_t* c = cache.handle;
+
+#ifndef SND_NO_CHECKS
+    if(c == NULL || out_stats == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
-    g_al.Sourcei(source.id, AL_BUFFER, &id);
+    out_stats->nr_hits = c->nr_hits;
+    out_stats->nr_misses = c->nr_misses;
+    out_stats->nr_evictions = c->nr_evictions;
+    out_stats->nr_resident = c->nr_entries;
+    out_stats->resident_bytes = c->resident_bytes;
+    return SND_OK;
+}
+snd_result_t snd_buffer_cache_destroy(snd_buffer_cache_t cache) {
+    snd_result_t r = SND_OK, free_r; snd_buffer_cache_state_t* c = cache.handle;
+
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(c == NULL) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
-#ifdef SND_DEBUG
-    g_al.GetSourcei(source.id, AL_BUFFER, &i);
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
-    }
-    if(i != id) {
-        return SND_ERROR_UNKNOWN;
+
+    for(uint32_t i = 0; i < c->entries_cap; i++) {
+        if(c->entries[i].used) {
+            free_r = snd_buffer_free(c->context, c->entries[i].buffer);
+            if(free_r != SND_OK) {
+                r = free_r;
+            }
+        }
     }
-#endif
+    free(c->entries);
+    free(c->hash_buckets);
+    free(c);
+    return r;
+}
 
-#ifdef SND_DEBUG
-    g_al.GetSourcei(source.id, AL_SOURCE_TYPE, &i);
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+/* Bounded lock-free ring after Dmitry Vyukov's MPMC queue: every cell has a sequence number telling producers and
+ * consumers whose turn it is, so the only shared writes are one CAS on the position per push or pop. */
+#define SND_RING_PAYLOAD_OFFSET (alignof(max_align_t) > sizeof(atomic_size_t) ? alignof(max_align_t) : sizeof(atomic_size_t))
+#define SND_CACHE_LINE 64
+
+typedef struct snd_ring_t {
+    uint8_t* cells;
+    size_t mask, stride, elem_size;
+    alignas(SND_CACHE_LINE) atomic_size_t enqueue_pos;
+    alignas(SND_CACHE_LINE) atomic_size_t dequeue_pos;
+} snd_ring_t;
+
+/* capacity has to be a power of two */
+static snd_result_t snd_ring_init(snd_ring_t* ring, size_t capacity, size_t elem_size) {
+    ring->elem_size = elem_size;
+    ring->stride = (SND_RING_PAYLOAD_OFFSET + elem_size + SND_RING_PAYLOAD_OFFSET - 1) / SND_RING_PAYLOAD_OFFSET * SND_RING_PAYLOAD_OFFSET;
+    ring->mask = capacity - 1;
+    ring->cells = calloc(capacity, ring->stride);
+    if(ring->cells == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
     }
-    if(i != AL_STATIC) {
-        return SND_ERROR_UNKNOWN;
+    for(size_t i = 0; i < capacity; i++) {
+        atomic_init((atomic_size_t*)(ring->cells + i * ring->stride), i);
     }
-#endif
-
-    r = snd_context_set(old_con, NULL);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
-
+    atomic_init(&(ring->enqueue_pos), 0);
+    atomic_init(&(ring->dequeue_pos), 0);
     return SND_OK;
 }
-snd_result_t snd_source_queue_buffers(snd_listener_context_t context, snd_source_t source, uint32_t nr_buffers, snd_buffer_t* buffers) {
-    snd_result_t r; ALCcontext* old_con;
-    
-#ifndef SND_NO_CHECKS
-    if(context.handle == NULL || nr_buffers <= 0 || buffers == NULL) {
-        return SND_ERROR_INVALID_PARAM;
+static void snd_ring_free(snd_ring_t* ring) {
+    free(ring->cells);
+    ring->cells = NULL;
+}
+static bool snd_ring_push(snd_ring_t* ring, const void* elem) {
+    uint8_t* cell; size_t pos, seq; intptr_t diff;
+
+    pos = atomic_load_explicit(&(ring->enqueue_pos), memory_order_relaxed);
+    for(;;) {
+        cell = ring->cells + (pos & ring->mask) * ring->stride;
+        seq = atomic_load_explicit((atomic_size_t*) cell, memory_order_acquire);
+        diff = (intptr_t) seq - (intptr_t) pos;
+        if(diff == 0) {
+            if(atomic_compare_exchange_weak_explicit(&(ring->enqueue_pos), &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if(diff < 0) {
+            /* full */
+            return false;
+        } else {
+            pos = atomic_load_explicit(&(ring->enqueue_pos), memory_order_relaxed);
+        }
     }
-#endif
-    
-    r = snd_context_set(context.handle, &old_con);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
+    memcpy(cell + SND_RING_PAYLOAD_OFFSET, elem, ring->elem_size);
+    atomic_store_explicit((atomic_size_t*) cell, pos + 1, memory_order_release);
+    return true;
+}
+static bool snd_ring_pop(snd_ring_t* ring, void* elem) {
+    uint8_t* cell; size_t pos, seq; intptr_t diff;
+
+    pos = atomic_load_explicit(&(ring->dequeue_pos), memory_order_relaxed);
+    for(;;) {
+        cell = ring->cells + (pos & ring->mask) * ring->stride;
+        seq = atomic_load_explicit((atomic_size_t*) cell, memory_order_acquire);
+        diff = (intptr_t) seq - (intptr_t)(pos + 1);
+        if(diff == 0) {
+            if(atomic_compare_exchange_weak_explicit(&(ring->dequeue_pos), &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if(diff < 0) {
+            /* empty */
+            return false;
+        } else {
+            pos = atomic_load_explicit(&(ring->dequeue_pos), memory_order_relaxed);
+        }
+    }
+    memcpy(elem, cell + SND_RING_PAYLOAD_OFFSET, ring->elem_size);
+    atomic_store_explicit((atomic_size_t*) cell, pos + ring->mask + 1, memory_order_release);
+    return true;
+}
+static size_t snd_ring_round_capacity(size_t n) {
+    size_t cap = 2;
+    while(cap < n) {
+        cap *= 2;
+    }
+    return cap;
+}
+
+#define SND_COMMAND_BATCH_SIZE 256
+
+typedef struct snd_command_queue_state_t {
+    snd_listener_context_t context;
+    snd_ring_t commands;
+    /* sources handed out by snd_command_queue_source_acquire, created up front so producers never call AL */
+    snd_ring_t free_sources;
+    snd_source_t* sources;
+    uint32_t nr_sources;
+    uint32_t drain_interval_ms;
+    thrd_t thread;
+    atomic_bool running;
+    atomic_uint_fast64_t nr_pushed, nr_rejected, nr_executed, nr_failed;
+    _Atomic snd_result_t last_error;
+    /* consecutive param commands are applied as one batch */
+    uint32_t nr_batch;
+    snd_source_t batch_sources[SND_COMMAND_BATCH_SIZE];
+    snd_source_params_t batch_params[SND_COMMAND_BATCH_SIZE];
+    uint32_t batch_masks[SND_COMMAND_BATCH_SIZE];
+} snd_command_queue_state_t;
+
+static void snd_command_result(snd_command_queue_state_t* q, snd_result_t r) {
+    atomic_fetch_add_explicit(&(q->nr_executed), 1, memory_order_relaxed);
+    if(r != SND_OK) {
+        atomic_fetch_add_explicit(&(q->nr_failed), 1, memory_order_relaxed);
+        atomic_store_explicit(&(q->last_error), r, memory_order_relaxed);
+    }
+}
+static void snd_command_flush_params(snd_command_queue_state_t* q) {
+    uint32_t start = 0, end;
+
+    /* the batch call takes one dirty mask, so split it where the mask changes */
+    while(start < q->nr_batch) {
+        end = start + 1;
+        while(end < q->nr_batch && q->batch_masks[end] == q->batch_masks[start]) {
+            end++;
+        }
+        snd_command_result(q, snd_sources_params_set_batch(q->context, end - start, q->batch_sources + start, q->batch_params + start, q->batch_masks[start]));
+        for(uint32_t i = start + 1; i < end; i++) {
+            atomic_fetch_add_explicit(&(q->nr_executed), 1, memory_order_relaxed);
+        }
+        start = end;
+    }
+    q->nr_batch = 0;
+}
+static void snd_command_execute(snd_command_queue_state_t* q, snd_command_t* cmd) {
+    if(cmd->type == SND_COMMAND_TYPE_PARAMS_SET) {
+        if(q->nr_batch == SND_COMMAND_BATCH_SIZE) {
+            snd_command_flush_params(q);
+        }
+        q->batch_sources[q->nr_batch] = cmd->source;
+        q->batch_params[q->nr_batch] = cmd->params.params;
+        q->batch_masks[q->nr_batch] = cmd->params.dirty_mask;
+        q->nr_batch++;
+        return;
+    }
+    /* everything else has to see the params posted before it */
+    snd_command_flush_params(q);
+
+    switch(cmd->type) {
+    case SND_COMMAND_TYPE_PLAY:
+        snd_command_result(q, snd_sources_play(q->context, 1, &(cmd->source)));
+        break;
+    case SND_COMMAND_TYPE_PAUSE:
+        snd_command_result(q, snd_sources_pause(q->context, 1, &(cmd->source)));
+        break;
+    case SND_COMMAND_TYPE_STOP:
+        snd_command_result(q, snd_sources_stop(q->context, 1, &(cmd->source)));
+        break;
+    case SND_COMMAND_TYPE_STATIC_BUFFER:
+        snd_command_result(q, snd_source_static_buffer(q->context, cmd->source, cmd->buffers.buffers[0]));
+        break;
+    case SND_COMMAND_TYPE_QUEUE_BUFFERS:
+        snd_command_result(q, snd_source_queue_buffers(q->context, cmd->source, cmd->buffers.nr_buffers, cmd->buffers.buffers));
+        break;
+    case SND_COMMAND_TYPE_RELEASE_SOURCE:
+        snd_command_result(q, snd_source_reset_buffer_state(q->context, cmd->source));
+        /* only after the reset, so the next owner gets a clean source; can't fail, the ring holds every source */
+        snd_ring_push(&(q->free_sources), &(cmd->source));
+        break;
+    default:
+        snd_command_result(q, SND_ERROR_INVALID_PARAM);
+        break;
+    }
+}
+static int snd_command_queue_thread(void* arg) {
+    snd_command_queue_state_t* q = arg; snd_command_t cmd; struct timespec interval; bool running;
+
+    /* snd_command_queue_create made sure of ALC_EXT_thread_local_context, so the producers' contexts are untouched */
+    snd_command_result(q, snd_listener_context_bind(q->context));
+    interval.tv_sec = q->drain_interval_ms / 1000;
+    interval.tv_nsec = (long)(q->drain_interval_ms % 1000) * 1000000L;
+
+    do {
+        running = atomic_load(&(q->running));
+        /* drains everything after a stop too, so nothing posted before destroy is lost */
+        while(snd_ring_pop(&(q->commands), &cmd)) {
+            snd_command_execute(q, &cmd);
+        }
+        snd_command_flush_params(q);
+        if(running) {
+            thrd_sleep(&interval, NULL);
+        }
+    } while(running);
+
+    snd_listener_context_unbind();
+    return 0;
+}
+
+snd_result_t snd_command_queue_create(snd_listener_context_t context, uint32_t capacity, uint32_t nr_sources, uint32_t drain_interval_ms, snd_command_queue_t* out_queue) {
+    snd_result_t r; snd_command_queue_state_t* q; size_t source_cap;
 
 #ifndef SND_NO_CHECKS
-    if(g_al.IsSource(source.id) != AL_TRUE) {
+    if(context.handle == NULL || capacity == 0 || out_queue == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
+    /* the queue's thread stays bound to the context, without thread local contexts that would be the whole process */
+    if(!g_al.ext.thread_local_context) {
+        return SND_ERROR_THREAD_LOCAL_CONTEXT_NOT_PRESENT;
+    }
 
-#ifndef SND_NO_CHECKS
-    g_al.GetSourcei(source.id, AL_SOURCE_TYPE, &i);
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    q = calloc(1, sizeof(snd_command_queue_state_t));
+    if(q == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
     }
-    if(i != AL_STREAMING || i != AL_UNDETERMINED) {
-        return SND_ERROR_SOURCE_STATICALLY_BOUND;
+    q->context = context;
+    q->drain_interval_ms = drain_interval_ms == 0 ? 1 : drain_interval_ms;
+    source_cap = snd_ring_round_capacity(nr_sources);
+    q->sources = calloc(nr_sources > 0 ? nr_sources : 1, sizeof(snd_source_t));
+    if(q->sources == NULL || snd_ring_init(&(q->commands), snd_ring_round_capacity(capacity), sizeof(snd_command_t)) != SND_OK
+    || snd_ring_init(&(q->free_sources), source_cap, sizeof(snd_source_t)) != SND_OK) {
+        snd_ring_free(&(q->commands));
+        free(q->sources);
+        free(q);
+        return SND_ERROR_OUT_OF_MEMORY;
     }
-#endif
+    for(uint32_t i = 0; i < nr_sources; i++) {
+        r = snd_source_create(context, &(q->sources[i]));
+        if(r != SND_OK) {
+            for(uint32_t j = 0; j < i; j++) {
+                snd_source_delete(context, q->sources[j]);
+            }
+            snd_ring_free(&(q->commands));
+            snd_ring_free(&(q->free_sources));
+            free(q->sources);
+            free(q);
+            return r;
+        }
+        snd_ring_push(&(q->free_sources), &(q->sources[i]));
+    }
+    q->nr_sources = nr_sources;
+
+    atomic_init(&(q->running), true);
+    if(thrd_create(&(q->thread), snd_command_queue_thread, q) != thrd_success) {
+        atomic_store(&(q->running), false);
+        snd_command_queue_destroy((snd_command_queue_t){ q });
+        return SND_ERROR_THREAD_CREATION_FAILED;
+    }
+
+    out_queue[0].handle = q;
+    return SND_OK;
+}
+snd_result_t snd_command_queue_source_acquire(snd_command_queue_t queue, snd_source_t* out_source) {
+    snd_command_queue_state_t* q = queue.handle;
 
-    /* Since the only field of snd_buffer_t is the id, the arrays will line up.
-     * NOTE: if anything is added to the snd_buffer_t struct, rewrite this! */
-    g_al.SourceQueueBuffers(source.id, nr_buffers, (ALuint*) buffers);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(q == NULL || out_source == NULL) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
-#ifdef SND_DEBUG
-    g_al.GetSourcei(source.id, AL_SOURCE_TYPE, &i);
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
-    }
-    if(i != AL_STREAMING) {
-        return SND_ERROR_UNKNOWN;
+    if(!snd_ring_pop(&(q->free_sources), out_source)) {
+        return SND_ERROR_LISTENING_CONTEXT_OUT_OF_SOURCES;
     }
-#endif
+    return SND_OK;
+}
+snd_result_t snd_command_queue_push(snd_command_queue_t queue, const snd_command_t* command) {
+    snd_command_queue_state_t* q = queue.handle;
 
-    r = snd_context_set(old_con, NULL);
 #ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
+    if(q == NULL || command == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    if(command->type == SND_COMMAND_TYPE_QUEUE_BUFFERS && (command->buffers.nr_buffers == 0 || command->buffers.nr_buffers > SND_COMMAND_MAX_BUFFERS)) {
+        return SND_ERROR_INVALID_PARAM;
+    }
 #endif
 
+    if(!snd_ring_push(&(q->commands), command)) {
+        atomic_fetch_add_explicit(&(q->nr_rejected), 1, memory_order_relaxed);
+        return SND_ERROR_QUEUE_FULL;
+    }
+    atomic_fetch_add_explicit(&(q->nr_pushed), 1, memory_order_relaxed);
     return SND_OK;
 }
-snd_result_t snd_source_unqueue_buffers(snd_listener_context_t context, snd_source_t source, uint32_t nr_buffers, snd_buffer_t* out_buffers) {
-    snd_result_t r; ALCcontext* old_con;
-    
+snd_result_t snd_command_queue_stats_get(snd_command_queue_t queue, snd_command_queue_stats_t* out_stats) {
+    snd_command_queue_state_t* q = queue.handle;
+
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL || nr_buffers <= 0 || out_buffers == NULL) {
+    if(q == NULL || out_stats == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    
-    r = snd_context_set(context.handle, &old_con);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
+
+    out_stats->nr_pushed = atomic_load_explicit(&(q->nr_pushed), memory_order_relaxed);
+    out_stats->nr_rejected = atomic_load_explicit(&(q->nr_rejected), memory_order_relaxed);
+    out_stats->nr_executed = atomic_load_explicit(&(q->nr_executed), memory_order_relaxed);
+    out_stats->nr_failed = atomic_load_explicit(&(q->nr_failed), memory_order_relaxed);
+    out_stats->last_error = atomic_load_explicit(&(q->last_error), memory_order_relaxed);
+    return SND_OK;
+}
+snd_result_t snd_command_queue_destroy(snd_command_queue_t queue) {
+    snd_result_t r = SND_OK, delete_r; snd_command_queue_state_t* q = queue.handle;
 
 #ifndef SND_NO_CHECKS
-    if(g_al.IsSource(source.id) != AL_TRUE) {
+    if(q == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
-#ifndef SND_NO_CHECKS
-    g_al.GetSourcei(source.id, AL_SOURCE_TYPE, &i);
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(atomic_exchange(&(q->running), false)) {
+        thrd_join(q->thread, NULL);
     }
-    if(i != AL_STREAMING) {
-        return SND_ERROR_SOURCE_NO_BUFFERS_QUEUED;
+    for(uint32_t i = 0; i < q->nr_sources; i++) {
+        delete_r = snd_source_delete(q->context, q->sources[i]);
+        if(delete_r != SND_OK) {
+            r = delete_r;
+        }
     }
-#endif
+    snd_ring_free(&(q->commands));
+    snd_ring_free(&(q->free_sources));
+    free(q->sources);
+    free(q);
+    return r;
+}
 
-    /* Since the only field of snd_buffer_t is the id, the arrays will line up.
-     * NOTE: if anything is added to the snd_buffer_t struct, rewrite this! */
-    g_al.SourceUnqueueBuffers(source.id, nr_buffers, (ALuint*) out_buffers);
-#ifndef SND_NO_CHECKS
-    switch(g_al.GetError()) {
-    case AL_NO_ERROR:
-        break;
-    case AL_INVALID_VALUE:
-        return SND_ERROR_SOURCE_NOT_ENOUGH_QUEUED_BUFFERS_FINISHED;
-    default:
-        return SND_ERROR_UNKNOWN;
+typedef struct snd_capture_state_t {
+    snd_recording_device_t device;
+    snd_capture_params_t params;
+    uint32_t frame_size;
+    size_t block_size;
+    /* blocks waiting for snd_capture_wait, unused with a callback */
+    snd_ring_t blocks;
+    uint8_t* scratch;
+    thrd_t thread;
+    atomic_bool running;
+    mtx_t wait_mutex;
+    cnd_t wait_cond;
+    atomic_uint waiters;
+    atomic_uint_fast64_t nr_frames_captured, nr_blocks_delivered, nr_blocks_dropped, max_backlog_frames;
+} snd_capture_state_t;
+
+static void snd_capture_deliver(snd_capture_state_t* c) {
+    if(c->params.callback != NULL) {
+        c->params.callback(c->params.user_data, c->scratch, c->params.frames_per_block);
+        atomic_fetch_add_explicit(&(c->nr_blocks_delivered), 1, memory_order_relaxed);
+        return;
+    }
+    /* overrun: the reader fell behind, so the oldest block goes and the newest stays - the ring is multi consumer,
+     * so popping here is safe even while a reader is inside snd_capture_wait */
+    while(!snd_ring_push(&(c->blocks), c->scratch)) {
+        if(snd_ring_pop(&(c->blocks), c->scratch + c->block_size)) {
+            atomic_fetch_add_explicit(&(c->nr_blocks_dropped), 1, memory_order_relaxed);
+        }
     }
-#endif
-
-#ifdef SND_DEBUG
-    g_al.GetSourcei(source.id, AL_SOURCE_TYPE, &i);
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    /* pairs with the fence in snd_capture_wait: either it sees the block or we see it waiting, never neither */
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load(&(c->waiters)) > 0) {
+        mtx_lock(&(c->wait_mutex));
+        cnd_broadcast(&(c->wait_cond));
+        mtx_unlock(&(c->wait_mutex));
     }
-    if(i != AL_STREAMING) {
-        return SND_ERROR_UNKNOWN;
+}
+static int snd_capture_thread(void* arg) {
+    snd_capture_state_t* c = arg; ALCint available; struct timespec interval; uint_fast64_t max;
+
+    interval.tv_sec = c->params.poll_interval_ms / 1000;
+    interval.tv_nsec = (long)(c->params.poll_interval_ms % 1000) * 1000000L;
+
+    while(atomic_load(&(c->running))) {
+        available = 0;
+        g_al.c.GetIntegerv((ALCdevice*) c->device.handle, ALC_CAPTURE_SAMPLES, 1, &available);
+        max = atomic_load_explicit(&(c->max_backlog_frames), memory_order_relaxed);
+        if((uint_fast64_t) available > max) {
+            atomic_store_explicit(&(c->max_backlog_frames), (uint_fast64_t) available, memory_order_relaxed);
+        }
+        /* only whole blocks are taken, the rest stays in the device until the next poll */
+        while(available >= (ALCint) c->params.frames_per_block) {
+            g_al.c.CaptureSamples((ALCdevice*) c->device.handle, c->scratch, c->params.frames_per_block);
+            available -= c->params.frames_per_block;
+            atomic_fetch_add_explicit(&(c->nr_frames_captured), c->params.frames_per_block, memory_order_relaxed);
+            snd_capture_deliver(c);
+        }
+        thrd_sleep(&interval, NULL);
     }
-#endif
+    return 0;
+}
 
-    r = snd_context_set(old_con, NULL);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
+snd_result_t snd_capture_start(snd_recording_device_t device, const snd_capture_params_t* params, snd_capture_t* out_capture) {
+    snd_result_t r; snd_capture_state_t* c; ALenum al_format; uint32_t i;
 
-    return SND_OK;
-}
-snd_result_t snd_source_reset_buffer_state(snd_listener_context_t context, snd_source_t source) {
-    snd_result_t r; ALCcontext* old_con;
-    
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL) {
+    if(device.handle == NULL || params == NULL || out_capture == NULL || params->frames_per_block == 0) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    if(params->callback == NULL && params->nr_blocks == 0) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    
-    r = snd_context_set(context.handle, &old_con);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
+    /* blocks are sized for params->format, the device writes them in its own */
+    for(i = 0; i < g_al.nr_recording_formats; i++) {
+        if(g_al.recording_formats[i].handle == (ALCdevice*) device.handle) {
+            break;
+        }
+    }
+    if(i == g_al.nr_recording_formats || g_al.recording_formats[i].format != params->format) {
+        return SND_ERROR_UNSUPPORTED_FORMAT;
+    }
+
+    c = calloc(1, sizeof(snd_capture_state_t));
+    if(c == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    c->device = device;
+    c->params = params[0];
+    if(c->params.poll_interval_ms == 0) {
+        c->params.poll_interval_ms = 1;
+    }
+    r = snd_format_info(params->format, &al_format, &(c->frame_size));
+    if(r != SND_OK) {
+        free(c);
+        return r;
+    }
+    c->block_size = (size_t) c->frame_size * params->frames_per_block;
+    /* second half is where an overrun puts the dropped block */
+    c->scratch = malloc(2 * c->block_size);
+    if(c->scratch == NULL) {
+        free(c);
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    if(params->callback == NULL) {
+        r = snd_ring_init(&(c->blocks), snd_ring_round_capacity(params->nr_blocks), c->block_size);
+        if(r != SND_OK) {
+            free(c->scratch);
+            free(c);
+            return r;
+        }
+    }
+    if(mtx_init(&(c->wait_mutex), mtx_plain) != thrd_success || cnd_init(&(c->wait_cond)) != thrd_success) {
+        snd_ring_free(&(c->blocks));
+        free(c->scratch);
+        free(c);
+        return SND_ERROR_THREAD_CREATION_FAILED;
+    }
+
+    r = snd_recording_start(device);
+    if(r != SND_OK) {
+        cnd_destroy(&(c->wait_cond));
+        mtx_destroy(&(c->wait_mutex));
+        snd_ring_free(&(c->blocks));
+        free(c->scratch);
+        free(c);
+        return r;
+    }
+    atomic_init(&(c->running), true);
+    if(thrd_create(&(c->thread), snd_capture_thread, c) != thrd_success) {
+        snd_recording_stop(device);
+        cnd_destroy(&(c->wait_cond));
+        mtx_destroy(&(c->wait_mutex));
+        snd_ring_free(&(c->blocks));
+        free(c->scratch);
+        free(c);
+        return SND_ERROR_THREAD_CREATION_FAILED;
+    }
+
+    out_capture[0].handle = c;
+    return SND_OK;
+}
+static bool snd_capture_pop(snd_capture_state_t* c, void* block) {
+    if(!snd_ring_pop(&(c->blocks), block)) {
+        return false;
+    }
+    atomic_fetch_add_explicit(&(c->nr_blocks_delivered), 1, memory_order_relaxed);
+    return true;
+}
+snd_result_t snd_capture_wait(snd_capture_t capture, void* block, uint32_t timeout_ms) {
+    snd_capture_state_t* c = capture.handle; struct timespec deadline;
 
 #ifndef SND_NO_CHECKS
-    if(g_al.IsSource(source.id) != AL_TRUE) {
+    if(c == NULL || block == NULL || c->params.callback != NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
-    g_al.Sourcei(source.id, AL_BUFFER, NULL);
-#ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(snd_capture_pop(c, block)) {
+        return SND_OK;
     }
-#endif
-#ifdef SND_DEBUG
-    g_al.GetSourcei(source.id, AL_SOURCE_TYPE, &i);
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(timeout_ms == 0) {
+        return SND_ERROR_TIMEOUT;
     }
-    if(i != AL_UNDETERMINED) {
-        return SND_ERROR_UNKNOWN;
+
+    timespec_get(&deadline, TIME_UTC);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
     }
-#endif
 
-    r = snd_context_set(old_con, NULL);
+    atomic_fetch_add(&(c->waiters), 1);
+    /* the ring's release store alone doesn't order the push before the thread's load of waiters */
+    atomic_thread_fence(memory_order_seq_cst);
+    mtx_lock(&(c->wait_mutex));
+    /* checked again under the lock, the capture thread only signals while holding it */
+    while(!snd_capture_pop(c, block)) {
+        if(cnd_timedwait(&(c->wait_cond), &(c->wait_mutex), &deadline) == thrd_timedout) {
+            mtx_unlock(&(c->wait_mutex));
+            atomic_fetch_sub(&(c->waiters), 1);
+            return snd_capture_pop(c, block) ? SND_OK : SND_ERROR_TIMEOUT;
+        }
+    }
+    mtx_unlock(&(c->wait_mutex));
+    atomic_fetch_sub(&(c->waiters), 1);
+    return SND_OK;
+}
+snd_result_t snd_capture_stats_get(snd_capture_t capture, snd_capture_stats_t* out_stats) {
+    snd_capture_state_t* c = capture.handle;
+
 #ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
+    if(c == NULL || out_stats == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
 #endif
 
+    out_stats->nr_frames_captured = atomic_load_explicit(&(c->nr_frames_captured), memory_order_relaxed);
+    out_stats->nr_blocks_delivered = atomic_load_explicit(&(c->nr_blocks_delivered), memory_order_relaxed);
+    out_stats->nr_blocks_dropped = atomic_load_explicit(&(c->nr_blocks_dropped), memory_order_relaxed);
+    out_stats->max_backlog_frames = atomic_load_explicit(&(c->max_backlog_frames), memory_order_relaxed);
     return SND_OK;
 }
+snd_result_t snd_capture_stop(snd_capture_t capture) {
+    snd_result_t r; snd_capture_state_t* c = capture.handle;
 
-snd_result_t snd_sources_play  (snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources) {
-    snd_result_t r; ALCcontext* old_con; ALint i;
-    
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL || sources == NULL || nr_sources <= 0) {
+    if(c == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    
-    r = snd_context_set(context.handle, &old_con);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
 
-#ifndef SND_NO_CHECKS
-    for(int i = 0; i < nr_sources; i++) {
-        if(g_al.IsSource(sources[i].id) != AL_TRUE) {
-            return SND_ERROR_INVALID_PARAM;
+    atomic_store(&(c->running), false);
+    thrd_join(c->thread, NULL);
+    r = snd_recording_stop(c->device);
+    cnd_destroy(&(c->wait_cond));
+    mtx_destroy(&(c->wait_mutex));
+    snd_ring_free(&(c->blocks));
+    free(c->scratch);
+    free(c);
+    return r;
+}
+
+#define SND_DECODE_CHUNK_FRAMES 4096
+/* snd_decode_all trusts the length in a header only up to this many decoded bytes per encoded byte, low bitrate
+ * Vorbis gets near it; anything longer is grown into as it decodes */
+#define SND_DECODE_MAX_RATIO 32
+#define SND_QOA_SLICE_LEN 20
+#define SND_QOA_MAX_FRAME_FRAMES (256 * SND_QOA_SLICE_LEN)
+
+typedef struct snd_decoder_state_t {
+    snd_decoder_info_t info;
+    uint32_t frame_size;
+    /* the encoded data is not copied, it has to outlive the decoder */
+    const uint8_t* data;
+    size_t size, pos;
+    uint64_t frames_left;
+    struct {
+        /* QOA allows up to 8 channels */
+        int32_t history[8][4], weights[8][4];
+        int16_t* frame;
+        uint32_t nr_frame_frames, frame_pos;
+    } qoa;
+    const snd_decoder_interface_t* external_interface;
+    void* external;
+} snd_decoder_state_t;
+
+static struct {
+    const snd_decoder_interface_t* external[SND_DECODER_TYPE_VORBIS + 1];
+    bool qoa_tab_built;
+    int32_t qoa_dequant_tab[16][8];
+} g_decoders;
+
+static uint32_t snd_read_le32(const uint8_t* p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+static uint16_t snd_read_le16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+static uint64_t snd_read_be64(const uint8_t* p) {
+    uint64_t v = 0;
+    for(int i = 0; i < 8; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+static snd_result_t snd_format_from_layout(uint32_t channels, uint32_t bits, bool is_float, snd_format_t* out_format) {
+    if(is_float) {
+        if(bits != 32) {
+            return SND_ERROR_UNSUPPORTED_FORMAT;
         }
+        switch(channels) {
+        case 1: out_format[0] = SND_FORMAT_PCM_FLOAT32_MONO; break;
+        case 2: out_format[0] = SND_FORMAT_PCM_FLOAT32_STEREO_INTERLEAVED_LR; break;
+        case 4: out_format[0] = SND_FORMAT_PCM_FLOAT32_QUAD_INTERLEAVED; break;
+        case 6: out_format[0] = SND_FORMAT_PCM_FLOAT32_5_1_INTERLEAVED; break;
+        case 8: out_format[0] = SND_FORMAT_PCM_FLOAT32_7_1_INTERLEAVED; break;
+        default: return SND_ERROR_UNSUPPORTED_FORMAT;
+        }
+    } else if(bits == 16 && channels == 4) {
+        out_format[0] = SND_FORMAT_PCM_INT16_QUAD_INTERLEAVED;
+    } else if(bits == 16 && channels == 6) {
+        out_format[0] = SND_FORMAT_PCM_INT16_5_1_INTERLEAVED;
+    } else if(bits == 16 && channels == 8) {
+        out_format[0] = SND_FORMAT_PCM_INT16_7_1_INTERLEAVED;
+    } else if(channels == 1 && bits == 8) {
+        out_format[0] = SND_FORMAT_PCM_UINT8_MONO;
+    } else if(channels == 1 && bits == 16) {
+        out_format[0] = SND_FORMAT_PCM_INT16_MONO;
+    } else if(channels == 2 && bits == 8) {
+        out_format[0] = SND_FORMAT_PCM_UINT8_STEREO_INTERLEAVED_LR;
+    } else if(channels == 2 && bits == 16) {
+        out_format[0] = SND_FORMAT_PCM_INT16_STEREO_INTERLEAVED_LR;
+    } else {
+        return SND_ERROR_UNSUPPORTED_FORMAT;
     }
-#endif
+    return SND_OK;
+}
 
-    /* Since the only field of snd_source_t is the id, the arrays will line up.
-     * NOTE: if anything is added to the snd_source_t struct, rewrite this! */
-    g_al.SourcePlayv(nr_sources, sources);
-#ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+static snd_result_t snd_wav_open(snd_decoder_state_t* dec) {
+    const uint8_t* chunk; uint32_t chunk_size, channels = 0, bits = 0, format_tag = 0;
+    size_t pos = 12; bool have_fmt = false;
+
+    while(pos + 8 <= dec->size) {
+        chunk = dec->data + pos;
+        chunk_size = snd_read_le32(chunk + 4);
+        if(memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 && pos + 8 + 16 <= dec->size) {
+            format_tag = snd_read_le16(chunk + 8);
+            channels = snd_read_le16(chunk + 10);
+            dec->info.frequency_hz = snd_read_le32(chunk + 12);
+            bits = snd_read_le16(chunk + 22);
+            /* WAVE_FORMAT_EXTENSIBLE, the real tag is the start of the subformat GUID */
+            if(format_tag == 0xfffe && chunk_size >= 40 && pos + 8 + 40 <= dec->size) {
+                format_tag = snd_read_le16(chunk + 32);
+            }
+            have_fmt = true;
+        } else if(memcmp(chunk, "data", 4) == 0) {
+            /* 1 is integer PCM, 3 IEEE float */
+            if(!have_fmt || (format_tag != 1 && format_tag != 3)) {
+                return SND_ERROR_UNSUPPORTED_FORMAT;
+            }
+            if(snd_format_from_layout(channels, bits, format_tag == 3, &(dec->info.format)) != SND_OK) {
+                return SND_ERROR_UNSUPPORTED_FORMAT;
+            }
+            dec->frame_size = channels * bits / 8;
+            dec->pos = pos + 8;
+            /* truncated files are common, play what is there */
+            if(chunk_size > dec->size - dec->pos) {
+                chunk_size = (uint32_t)(dec->size - dec->pos);
+            }
+            dec->info.nr_frames = chunk_size / dec->frame_size;
+            dec->frames_left = dec->info.nr_frames;
+            return SND_OK;
+        }
+        /* chunks are padded to an even size */
+        pos += 8 + (size_t) chunk_size + (chunk_size & 1);
     }
-#endif
-#ifdef SND_DEBUG
-    g_al.GetSourcei(source.id, AL_SOURCE_STATE, &i);
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    return SND_ERROR_INVALID_PARAM;
+}
+static uint32_t snd_wav_read(snd_decoder_state_t* dec, void* out, uint32_t max_frames) {
+    uint32_t nr_frames = max_frames < dec->frames_left ? max_frames : (uint32_t) dec->frames_left;
+
+    memcpy(out, dec->data + dec->pos, (size_t) nr_frames * dec->frame_size);
+    dec->pos += (size_t) nr_frames * dec->frame_size;
+    dec->frames_left -= nr_frames;
+    return nr_frames;
+}
+
+static void snd_qoa_build_tab(void) {
+    /* QOA spec: scalefactor (s+1)^2.75 rounded, times the dequantization steps, rounded half away from zero.
+     * The steps are kept times 4 so everything stays in integers. */
+    static const int32_t scalefactors[16] = { 1, 7, 21, 45, 84, 138, 211, 304, 421, 562, 731, 928, 1157, 1419, 1715, 2048 };
+    static const int32_t steps_x4[8] = { 3, -3, 10, -10, 18, -18, 28, -28 };
+    int32_t v;
+
+    for(int s = 0; s < 16; s++) {
+        for(int q = 0; q < 8; q++) {
+            v = scalefactors[s] * steps_x4[q];
+            g_decoders.qoa_dequant_tab[s][q] = v < 0 ? -((-v + 2) / 4) : (v + 2) / 4;
+        }
     }
-    if(i != AL_PLAYING) {
-        return SND_ERROR_UNKNOWN;
+    g_decoders.qoa_tab_built = true;
+}
+static snd_result_t snd_qoa_open(snd_decoder_state_t* dec) {
+    uint32_t channels;
+
+    if(dec->size < 16) {
+        return SND_ERROR_INVALID_PARAM;
     }
-#endif
+    /* static table, building it twice from two threads writes the same values */
+    if(!g_decoders.qoa_tab_built) {
+        snd_qoa_build_tab();
+    }
+    dec->info.nr_frames = ((uint32_t) dec->data[4] << 24) | ((uint32_t) dec->data[5] << 16) | ((uint32_t) dec->data[6] << 8) | dec->data[7];
+    dec->frames_left = dec->info.nr_frames;
+    dec->pos = 8;
 
-    r = snd_context_set(old_con, NULL);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
+    /* the first frame header has the layout, QOA doesn't allow it to change within a file we can play */
+    channels = dec->data[8];
+    dec->info.frequency_hz = ((uint32_t) dec->data[9] << 16) | ((uint32_t) dec->data[10] << 8) | dec->data[11];
+    if(snd_format_from_layout(channels, 16, false, &(dec->info.format)) != SND_OK) {
+        return SND_ERROR_UNSUPPORTED_FORMAT;
+    }
+    dec->frame_size = channels * 2;
+    /* every slice of 8 bytes per channel holds SND_QOA_SLICE_LEN frames, the header can't claim more than the file has */
+    if(dec->info.nr_frames > (dec->size - 8) / (8 * channels) * SND_QOA_SLICE_LEN) {
+        dec->info.nr_frames = (uint32_t)((dec->size - 8) / (8 * channels) * SND_QOA_SLICE_LEN);
+        dec->frames_left = dec->info.nr_frames;
+    }
 
+    dec->qoa.frame = malloc(SND_QOA_MAX_FRAME_FRAMES * dec->frame_size);
+    if(dec->qoa.frame == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
     return SND_OK;
 }
-snd_result_t snd_sources_pause (snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources) {
-    snd_result_t r; ALCcontext* old_con;
-    
-#ifndef SND_NO_CHECKS
-    if(context.handle == NULL || sources == NULL || nr_sources <= 0) {
-        return SND_ERROR_INVALID_PARAM;
+static bool snd_qoa_decode_frame(snd_decoder_state_t* dec) {
+    const uint8_t* p; uint32_t channels, nr_frames, frame_bytes, slice_end;
+    int32_t predicted, quantized, dequantized, reconstructed, delta, scalefactor;
+    uint64_t slice, history, weights;
+
+    if(dec->pos + 8 > dec->size) {
+        return false;
+    }
+    p = dec->data + dec->pos;
+    channels = p[0];
+    nr_frames = ((uint32_t) p[4] << 8) | p[5];
+    frame_bytes = ((uint32_t) p[6] << 8) | p[7];
+    if(channels * 2 != dec->frame_size || nr_frames > SND_QOA_MAX_FRAME_FRAMES || dec->pos + frame_bytes > dec->size
+    || frame_bytes < 8 + channels * 16 + ((nr_frames + SND_QOA_SLICE_LEN - 1) / SND_QOA_SLICE_LEN) * channels * 8) {
+        return false;
+    }
+    p += 8;
+
+    for(uint32_t c = 0; c < channels; c++) {
+        history = snd_read_be64(p);
+        weights = snd_read_be64(p + 8);
+        for(int i = 0; i < 4; i++) {
+            dec->qoa.history[c][i] = (int16_t)(history >> 48);
+            dec->qoa.weights[c][i] = (int16_t)(weights >> 48);
+            history <<= 16;
+            weights <<= 16;
+        }
+        p += 16;
+    }
+
+    for(uint32_t sample = 0; sample < nr_frames; sample += SND_QOA_SLICE_LEN) {
+        for(uint32_t c = 0; c < channels; c++) {
+            slice = snd_read_be64(p);
+            p += 8;
+            scalefactor = (int32_t)((slice >> 60) & 0xf);
+            slice <<= 4;
+            slice_end = sample + SND_QOA_SLICE_LEN < nr_frames ? sample + SND_QOA_SLICE_LEN : nr_frames;
+            for(uint32_t s = sample; s < slice_end; s++) {
+                int32_t* h = dec->qoa.history[c]; int32_t* w = dec->qoa.weights[c];
+                predicted = (w[0]*h[0] + w[1]*h[1] + w[2]*h[2] + w[3]*h[3]) >> 13;
+                quantized = (int32_t)((slice >> 61) & 0x7);
+                dequantized = g_decoders.qoa_dequant_tab[scalefactor][quantized];
+                reconstructed = predicted + dequantized;
+                reconstructed = reconstructed < -32768 ? -32768 : (reconstructed > 32767 ? 32767 : reconstructed);
+                dec->qoa.frame[s * channels + c] = (int16_t) reconstructed;
+                slice <<= 3;
+
+                delta = dequantized >> 4;
+                for(int i = 0; i < 4; i++) {
+                    w[i] += h[i] < 0 ? -delta : delta;
+                }
+                h[0] = h[1]; h[1] = h[2]; h[2] = h[3]; h[3] = reconstructed;
+            }
+        }
     }
-#endif
-    
-    r = snd_context_set(context.handle, &old_con);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
 
-#ifndef SND_NO_CHECKS
-    for(int i = 0; i < nr_sources; i++) {
-        if(g_al.IsSource(sources[i].id) != AL_TRUE) {
-            return SND_ERROR_INVALID_PARAM;
+    dec->pos += frame_bytes;
+    dec->qoa.nr_frame_frames = nr_frames;
+    dec->qoa.frame_pos = 0;
+    return true;
+}
+static uint32_t snd_qoa_read(snd_decoder_state_t* dec, void* out, uint32_t max_frames) {
+    uint32_t written = 0, n;
+
+    while(written < max_frames && dec->frames_left > 0) {
+        if(dec->qoa.frame_pos == dec->qoa.nr_frame_frames && !snd_qoa_decode_frame(dec)) {
+            /* truncated or corrupt, end the stream early */
+            dec->frames_left = 0;
+            break;
+        }
+        n = dec->qoa.nr_frame_frames - dec->qoa.frame_pos;
+        if(n > max_frames - written) {
+            n = max_frames - written;
         }
+        if(n > dec->frames_left) {
+            n = (uint32_t) dec->frames_left;
+        }
+        memcpy(((uint8_t*) out) + (size_t) written * dec->frame_size, dec->qoa.frame + (size_t) dec->qoa.frame_pos * dec->frame_size / 2, (size_t) n * dec->frame_size);
+        dec->qoa.frame_pos += n;
+        dec->frames_left -= n;
+        written += n;
     }
-#endif
+    return written;
+}
 
-#ifdef SND_DEBUG
-    g_al.GetSourcei(source.id, AL_SOURCE_STATE, &i);
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+snd_result_t snd_decoder_register(snd_decoder_type_t type, const snd_decoder_interface_t* decoder_interface) {
+#ifndef SND_NO_CHECKS
+    if(type != SND_DECODER_TYPE_VORBIS) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+    if(decoder_interface != NULL && (decoder_interface->open == NULL || decoder_interface->read == NULL || decoder_interface->close == NULL)) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
 
-    /* Since the only field of snd_source_t is the id, the arrays will line up.
-     * NOTE: if anything is added to the snd_source_t struct, rewrite this! */
-    g_al.SourcePausev(nr_sources, sources);
+    g_decoders.external[type] = decoder_interface;
+    return SND_OK;
+}
+snd_result_t snd_decoder_open(const void* data, size_t size, snd_decoder_t* out_decoder, snd_decoder_info_t* out_info) {
+    snd_result_t r; snd_decoder_state_t* dec; const uint8_t* bytes = data;
+
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(data == NULL || out_decoder == NULL) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
-#ifdef SND_DEBUG
-    /* Only for AL_PLAYING sources does the spec guarentee state change */
-    if(i == AL_PLAYING) {
-        g_al.GetSourcei(source.id, AL_SOURCE_STATE, &i);
-        if(g_al.GetError() != AL_NO_ERROR) {
-            return SND_ERROR_UNKNOWN;
-        }
-        if(i != AL_PAUSED) {
-            return SND_ERROR_UNKNOWN;
+    if(size < 12) {
+        return SND_ERROR_INVALID_PARAM;
+    }
+
+    dec = calloc(1, sizeof(snd_decoder_state_t));
+    if(dec == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+    dec->data = bytes;
+    dec->size = size;
+
+    if(memcmp(bytes, "RIFF", 4) == 0 && memcmp(bytes + 8, "WAVE", 4) == 0) {
+        dec->info.type = SND_DECODER_TYPE_WAV;
+        r = snd_wav_open(dec);
+    } else if(memcmp(bytes, "qoaf", 4) == 0) {
+        dec->info.type = SND_DECODER_TYPE_QOA;
+        r = snd_qoa_open(dec);
+    } else if(memcmp(bytes, "OggS", 4) == 0) {
+        dec->info.type = SND_DECODER_TYPE_VORBIS;
+        dec->external_interface = g_decoders.external[SND_DECODER_TYPE_VORBIS];
+        if(dec->external_interface == NULL) {
+            r = SND_ERROR_DECODER_NOT_AVAILABLE;
+        } else {
+            dec->external = dec->external_interface->open(data, size, &(dec->info.format), &(dec->info.frequency_hz), &(dec->info.nr_frames));
+            r = dec->external == NULL ? SND_ERROR_UNSUPPORTED_FORMAT : snd_format_info(dec->info.format, &(ALenum){0}, &(dec->frame_size));
+            dec->frames_left = dec->info.nr_frames;
         }
+    } else {
+        r = SND_ERROR_UNSUPPORTED_FORMAT;
     }
-#endif
 
-    r = snd_context_set(old_con, NULL);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
+    if(r != SND_OK) {
+        snd_decoder_close((snd_decoder_t){ dec });
+        return r;
+    }
 
+    out_decoder[0].handle = dec;
+    if(out_info != NULL) {
+        out_info[0] = dec->info;
+    }
     return SND_OK;
 }
-snd_result_t snd_sources_stop  (snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources) {
-    snd_result_t r; ALCcontext* old_con;
-    
+snd_result_t snd_decoder_read(snd_decoder_t decoder, void* out_data, uint32_t max_frames, uint32_t* out_nr_frames) {
+    snd_decoder_state_t* dec = decoder.handle;
+
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL || sources == NULL || nr_sources <= 0) {
+    if(dec == NULL || out_data == NULL || out_nr_frames == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    
-    r = snd_context_set(context.handle, &old_con);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
 
-#ifndef SND_NO_CHECKS
-    for(int i = 0; i < nr_sources; i++) {
-        if(g_al.IsSource(sources[i].id) != AL_TRUE) {
-            return SND_ERROR_INVALID_PARAM;
-        }
+    switch(dec->info.type) {
+    case SND_DECODER_TYPE_WAV:
+        out_nr_frames[0] = snd_wav_read(dec, out_data, max_frames);
+        break;
+    case SND_DECODER_TYPE_QOA:
+        out_nr_frames[0] = snd_qoa_read(dec, out_data, max_frames);
+        break;
+    default:
+        out_nr_frames[0] = dec->external_interface->read(dec->external, out_data, max_frames);
+        break;
     }
-#endif
+    return SND_OK;
+}
+uint32_t snd_decoder_stream_pull(void* user_data, void* data, uint32_t max_frames) {
+    snd_decoder_t decoder; uint32_t nr_frames;
 
-#ifdef SND_DEBUG
-    g_al.GetSourcei(source.id, AL_SOURCE_STATE, &i);
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    decoder.handle = user_data;
+    if(snd_decoder_read(decoder, data, max_frames, &nr_frames) != SND_OK) {
+        return 0;
     }
-#endif
+    return nr_frames;
+}
+snd_result_t snd_decoder_close(snd_decoder_t decoder) {
+    snd_decoder_state_t* dec = decoder.handle;
 
-    /* Since the only field of snd_source_t is the id, the arrays will line up.
-     * NOTE: if anything is added to the snd_source_t struct, rewrite this! */
-    g_al.SourceStopv(nr_sources, sources);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(dec == NULL) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
-#ifdef SND_DEBUG
-    /* Only for AL_PLAYING and AL_PAUSED sources does the spec guarentee state change */
-    if(i == AL_PLAYING || i == AL_PAUSED) {
-        g_al.GetSourcei(source.id, AL_SOURCE_STATE, &i);
-        if(g_al.GetError() != AL_NO_ERROR) {
-            return SND_ERROR_UNKNOWN;
-        }
-        if(i != AL_PAUSED) {
-            return SND_ERROR_UNKNOWN;
-        }
+
+    if(dec->external != NULL) {
+        dec->external_interface->close(dec->external);
     }
-#endif
+    free(dec->qoa.frame);
+    free(dec);
+    return SND_OK;
+}
 
-    r = snd_context_set(old_con, NULL);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
+typedef struct snd_decode_job_state_t {
+    const void* data;
+    size_t size;
+    thrd_t thread;
+    snd_result_t result;
+    snd_decoder_info_t info;
+    void* pcm;
+    size_t pcm_size;
+    snd_decode_stats_t stats;
+} snd_decode_job_state_t;
+
+/* decodes everything in chunks into one growing allocation, so the file's length doesn't have to be trusted */
+static snd_result_t snd_decode_all(const void* data, size_t size, snd_decoder_info_t* out_info, void** out_pcm, size_t* out_pcm_size) {
+    snd_result_t r; snd_decoder_t decoder; snd_decoder_state_t* dec;
+    uint8_t* pcm; uint8_t* new_pcm; size_t used = 0, cap, chunk_size; uint32_t nr_frames;
+
+    r = snd_decoder_open(data, size, &decoder, out_info);
+    if(r != SND_OK) {
+        return r;
+    }
+    dec = decoder.handle;
+    chunk_size = (size_t) SND_DECODE_CHUNK_FRAMES * dec->frame_size;
+    /* one chunk of slack, so a correct length in the header never needs a realloc; a header claiming more than the
+     * data could decode to only gets what it could, the loop grows the buffer if it really is that long */
+    cap = (size_t) dec->info.nr_frames * dec->frame_size;
+    if(cap / SND_DECODE_MAX_RATIO > size) {
+        cap = size * SND_DECODE_MAX_RATIO;
+    }
+    cap += chunk_size;
+    pcm = malloc(cap);
+    if(pcm == NULL) {
+        snd_decoder_close(decoder);
+        return SND_ERROR_OUT_OF_MEMORY;
+    }
+
+    do {
+        if(cap - used < chunk_size) {
+            cap *= 2;
+            new_pcm = realloc(pcm, cap);
+            if(new_pcm == NULL) {
+                free(pcm);
+                snd_decoder_close(decoder);
+                return SND_ERROR_OUT_OF_MEMORY;
+            }
+            pcm = new_pcm;
+        }
+        snd_decoder_read(decoder, pcm + used, SND_DECODE_CHUNK_FRAMES, &nr_frames);
+        used += (size_t) nr_frames * dec->frame_size;
+    } while(nr_frames > 0);
 
+    snd_decoder_close(decoder);
+    out_pcm[0] = pcm;
+    out_pcm_size[0] = used;
     return SND_OK;
 }
-snd_result_t snd_sources_rewind(snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources) {
-    snd_result_t r; ALCcontext* old_con;
-    
+static int snd_decode_job_thread(void* arg) {
+    snd_decode_job_state_t* job = arg; double start; uint32_t frame_size; ALenum al_format;
+
+    start = snd_seconds_now();
+    job->result = snd_decode_all(job->data, job->size, &(job->info), &(job->pcm), &(job->pcm_size));
+    job->stats.decode_seconds = snd_seconds_now() - start;
+    if(job->result == SND_OK && snd_format_info(job->info.format, &al_format, &frame_size) == SND_OK) {
+        job->stats.nr_frames = job->pcm_size / frame_size;
+        if(job->stats.decode_seconds > 0.0 && job->info.frequency_hz > 0) {
+            job->stats.x_realtime = ((double) job->stats.nr_frames / job->info.frequency_hz) / job->stats.decode_seconds;
+        }
+    }
+    return 0;
+}
+
+snd_result_t snd_buffer_alloc_decoded(snd_listener_context_t context, const void* data, size_t size, snd_buffer_t* buffer) {
+    snd_result_t r; snd_decoder_info_t info; void* pcm; size_t pcm_size;
+
 #ifndef SND_NO_CHECKS
-    if(context.handle == NULL || sources == NULL || nr_sources <= 0) {
+    if(context.handle == NULL || data == NULL || buffer == NULL) {
         return SND_ERROR_INVALID_PARAM;
     }
 #endif
-    
-    r = snd_context_set(context.handle, &old_con);
-#ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
-#endif
 
-#ifndef SND_NO_CHECKS
-    for(int i = 0; i < nr_sources; i++) {
-        if(g_al.IsSource(sources[i].id) != AL_TRUE) {
-            return SND_ERROR_INVALID_PARAM;
-        }
+    r = snd_decode_all(data, size, &info, &pcm, &pcm_size);
+    if(r != SND_OK) {
+        return r;
     }
-#endif
+    r = snd_buffer_alloc(context, info.format, info.frequency_hz, pcm, pcm_size, buffer);
+    free(pcm);
+    return r;
+}
+snd_result_t snd_decode_job_start(const void* data, size_t size, snd_decode_job_t* out_job) {
+    snd_decode_job_state_t* job;
 
-    /* Since the only field of snd_source_t is the id, the arrays will line up.
-     * NOTE: if anything is added to the snd_source_t struct, rewrite this! */
-    g_al.SourceRewindv(nr_sources, sources);
 #ifndef SND_NO_CHECKS
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+    if(data == NULL || out_job == NULL) {
+        return SND_ERROR_INVALID_PARAM;
     }
 #endif
-#ifdef SND_DEBUG
-    g_al.GetSourcei(source.id, AL_SOURCE_STATE, &i);
-    if(g_al.GetError() != AL_NO_ERROR) {
-        return SND_ERROR_UNKNOWN;
+
+    job = calloc(1, sizeof(snd_decode_job_state_t));
+    if(job == NULL) {
+        return SND_ERROR_OUT_OF_MEMORY;
     }
-    if(i != AL_INITIAL) {
-        return SND_ERROR_UNKNOWN;
+    job->data = data;
+    job->size = size;
+    if(thrd_create(&(job->thread), snd_decode_job_thread, job) != thrd_success) {
+        free(job);
+        return SND_ERROR_THREAD_CREATION_FAILED;
     }
-#endif
 
-    r = snd_context_set(old_con, NULL);
+    out_job[0].handle = job;
+    return SND_OK;
+}
+snd_result_t snd_decode_job_finish(snd_decode_job_t job, snd_listener_context_t context, snd_buffer_t* buffer, snd_decode_stats_t* out_stats) {
+    snd_result_t r; snd_decode_job_state_t* j = job.handle;
+
 #ifndef SND_NO_CHECKS
-    if(r != SND_OK) { return r; }
+    if(j == NULL || context.handle == NULL || buffer == NULL) {
+        return SND_ERROR_INVALID_PARAM;
+    }
 #endif
 
-    return SND_OK;
+    thrd_join(j->thread, NULL);
+    r = j->result;
+    /* the upload has to happen here, the worker thread has no context */
+    if(r == SND_OK) {
+        r = snd_buffer_alloc(context, j->info.format, j->info.frequency_hz, j->pcm, j->pcm_size, buffer);
+    }
+    if(out_stats != NULL) {
+        out_stats[0] = j->stats;
+    }
+    free(j->pcm);
+    free(j);
+    return r;
 }
 
 
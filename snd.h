@@ -33,6 +33,16 @@ typedef enum snd_result_t {
     SND_ERROR_SOURCE_STATICALLY_BOUND = -10,
     SND_ERROR_SOURCE_NO_BUFFERS_QUEUED = -11,
     SND_ERROR_SOURCE_NOT_ENOUGH_QUEUED_BUFFERS_FINISHED = -12,
+    SND_ERROR_THREAD_CREATION_FAILED = -13,
+    SND_ERROR_UNSUPPORTED_FORMAT = -14,
+    SND_ERROR_DECODER_NOT_AVAILABLE = -15,
+    SND_ERROR_FILE_IO = -16,
+    SND_ERROR_QUEUE_FULL = -17,
+    SND_ERROR_TIMEOUT = -18,
+    SND_ERROR_BACKEND_NOT_SUPPORTED = -19,
+    SND_ERROR_DSP_NODE_STILL_IN_USE = -20,
+    SND_ERROR_HRTF_STILL_IN_USE = -21,
+    SND_ERROR_THREAD_LOCAL_CONTEXT_NOT_PRESENT = -22,
     SND_RESULT_MAX_ENUM = 0x7fffffff
 } snd_result_t;
 typedef enum snd_format_t {
@@ -40,6 +50,18 @@ typedef enum snd_format_t {
     SND_FORMAT_PCM_INT16_MONO = 1,
     SND_FORMAT_PCM_UINT8_STEREO_INTERLEAVED_LR = 2,
     SND_FORMAT_PCM_INT16_STEREO_INTERLEAVED_LR = 3,
+    /* the formats below need AL_EXT_float32 / AL_EXT_MCFORMATS, without them they are converted to int16 and mixed down to stereo */
+    SND_FORMAT_PCM_FLOAT32_MONO = 4,
+    SND_FORMAT_PCM_FLOAT32_STEREO_INTERLEAVED_LR = 5,
+    /* channel order FL FR BL BR */
+    SND_FORMAT_PCM_INT16_QUAD_INTERLEAVED = 6,
+    /* channel order FL FR FC LFE BL BR */
+    SND_FORMAT_PCM_INT16_5_1_INTERLEAVED = 7,
+    /* channel order FL FR FC LFE BL BR SL SR */
+    SND_FORMAT_PCM_INT16_7_1_INTERLEAVED = 8,
+    SND_FORMAT_PCM_FLOAT32_QUAD_INTERLEAVED = 9,
+    SND_FORMAT_PCM_FLOAT32_5_1_INTERLEAVED = 10,
+    SND_FORMAT_PCM_FLOAT32_7_1_INTERLEAVED = 11,
     SND_FORMAT_MAX_ENUM = 0x7f
 } snd_format_t;
 typedef enum snd_distance_model_type_t {
@@ -58,6 +80,31 @@ typedef enum snd_source_position_format_t {
     SND_SOURCE_POSITION_FORMAT_BYTES = 2,
     SND_SOURCE_POSITION_FORMAT_MAX_ENUM = 0x7f
 } snd_source_position_format_t;
+typedef enum snd_source_params_field_bits_t {
+    SND_SOURCE_PARAMS_FIELD_POSITION_RELATIVE_BIT = 0x0001,
+    SND_SOURCE_PARAMS_FIELD_LOOPING_BIT = 0x0002,
+    SND_SOURCE_PARAMS_FIELD_GAIN_BIT = 0x0004,
+    SND_SOURCE_PARAMS_FIELD_GAIN_MIN_BIT = 0x0008,
+    SND_SOURCE_PARAMS_FIELD_GAIN_MAX_BIT = 0x0010,
+    SND_SOURCE_PARAMS_FIELD_GAIN_OUTER_ANGLE_BIT = 0x0020,
+    SND_SOURCE_PARAMS_FIELD_CONE_INNER_ANGLE_BIT = 0x0040,
+    SND_SOURCE_PARAMS_FIELD_CONE_OUTER_ANGLE_BIT = 0x0080,
+    SND_SOURCE_PARAMS_FIELD_DISTANCE_REFERENCE_BIT = 0x0100,
+    SND_SOURCE_PARAMS_FIELD_DISTANCE_MAX_BIT = 0x0200,
+    SND_SOURCE_PARAMS_FIELD_ROLLOFF_FACTOR_BIT = 0x0400,
+    SND_SOURCE_PARAMS_FIELD_PITCH_BIT = 0x0800,
+    SND_SOURCE_PARAMS_FIELD_POSITION_BIT = 0x1000,
+    SND_SOURCE_PARAMS_FIELD_VELOCITY_BIT = 0x2000,
+    SND_SOURCE_PARAMS_FIELD_DIRECTION_BIT = 0x4000,
+    SND_SOURCE_PARAMS_FIELD_ALL_BITS = 0x7fff,
+    SND_SOURCE_PARAMS_FIELD_BITS_MAX_ENUM = 0x7fffffff
+} snd_source_params_field_bits_t;
+
+typedef enum snd_backend_type_t {
+    SND_BACKEND_TYPE_OPENAL = 0,
+    SND_BACKEND_TYPE_SOFTWARE = 1,
+    SND_BACKEND_TYPE_MAX_ENUM = 0x7f
+} snd_backend_type_t;
 
 typedef struct snd_device_list_t {
     int                              nr_playback_devices;
@@ -67,9 +114,26 @@ typedef struct snd_device_list_t {
     int                              recording_devices_default_id;
     const char**                     recording_devices;
 } snd_device_list_t;
+typedef enum snd_device_event_bits_t {
+    /* an open playback device lost its output, see snd_playback_device_reopen; reported on every poll until then */
+    SND_DEVICE_EVENT_DISCONNECTED_BIT = 0x1,
+    /* only with ALC_SOFT_system_events; call snd_devices_refresh to see the change */
+    SND_DEVICE_EVENT_DEVICE_ADDED_BIT = 0x2,
+    SND_DEVICE_EVENT_DEVICE_REMOVED_BIT = 0x4,
+    SND_DEVICE_EVENT_DEFAULT_CHANGED_BIT = 0x8,
+    SND_DEVICE_EVENT_MAX_ENUM = 0x7fffffff
+} snd_device_event_bits_t;
 typedef struct snd_recording_device_t {
     void* handle;
 } snd_recording_device_t;
+/* Converting buffers to the mixing frequency on upload, NONE leaves it to the driver on every mix. */
+typedef enum snd_resample_quality_t {
+    SND_RESAMPLE_QUALITY_NONE = 0,
+    SND_RESAMPLE_QUALITY_FAST = 1,
+    SND_RESAMPLE_QUALITY_MEDIUM = 2,
+    SND_RESAMPLE_QUALITY_BEST = 3,
+    SND_RESAMPLE_QUALITY_MAX_ENUM = 0x7f
+} snd_resample_quality_t;
 typedef struct snd_listener_context_t {
     void* handle;
 } snd_listener_context_t;
@@ -99,30 +163,318 @@ typedef struct snd_source_params_t {
     float pitch_shift_multiplier;
     float32_vec3_t position, velocity, direction;
 } snd_source_params_t;
+/* The software backend mixes only when snd_software_render is called, with one playback device and no recording.
+ * Its output only depends on the calls made, not on timing: there's nothing random in the mix, snd_stream refills
+ * happen between blocks of the render instead of on a thread, and the device clock counts rendered frames. So the
+ * same program renders bit identical output on every run of the same build, for golden files and benchmarks; only
+ * snd_command_queue stays asynchronous. */
+typedef struct snd_software_backend_params_t {
+    /* 0 means 48000 */
+    uint32_t frequency_hz;
+    /* gets the mix as interleaved stereo float, may be NULL */
+    void (*sink)(void* user_data, const float* frames, uint32_t nr_frames);
+    void* user_data;
+    /* if not NULL, the mix is also written to this file as a float WAV */
+    const char* wav_path;
+} snd_software_backend_params_t;
+typedef struct snd_software_render_stats_t {
+    uint64_t nr_frames;
+    double seconds_total;
+    /* seconds of audio rendered per second spent, above 1 is faster than real time */
+    double realtime_factor;
+} snd_software_render_stats_t;
+/* DSP nodes run in the software backend, in blocks of 256 frames, on a source before it is panned or on the mix.
+ * A source's chain keeps running on silence after the source stopped, until its delays and convolutions have decayed. */
+typedef enum snd_dsp_node_type_t {
+    SND_DSP_NODE_TYPE_BIQUAD = 0,
+    SND_DSP_NODE_TYPE_DELAY = 1,
+    SND_DSP_NODE_TYPE_CONVOLUTION = 2,
+    SND_DSP_NODE_TYPE_LIMITER = 3,
+    SND_DSP_NODE_TYPE_MAX_ENUM = 0x7f
+} snd_dsp_node_type_t;
+typedef enum snd_biquad_type_t {
+    SND_BIQUAD_TYPE_LOWPASS = 0,
+    SND_BIQUAD_TYPE_HIGHPASS = 1,
+    SND_BIQUAD_TYPE_BANDPASS = 2,
+    SND_BIQUAD_TYPE_PEAKING = 3,
+    SND_BIQUAD_TYPE_LOW_SHELF = 4,
+    SND_BIQUAD_TYPE_HIGH_SHELF = 5,
+    SND_BIQUAD_TYPE_MAX_ENUM = 0x7f
+} snd_biquad_type_t;
+typedef struct snd_dsp_node_params_t {
+    snd_dsp_node_type_t type;
+    union {
+        /* gain_db only for peaking and shelves */
+        struct { snd_biquad_type_t type; float frequency_hz, q, gain_db; } biquad;
+        /* max_delay_ms sizes the delay line on create, later delays can't go beyond it */
+        struct { float delay_ms, max_delay_ms, feedback, wet, dry; } delay;
+        /* a mono IR applied to both channels, it is copied on create and can't be changed afterwards */
+        struct { const float* impulse_response; uint32_t nr_frames; float wet, dry; } convolution;
+        struct { float threshold_db, release_ms; } limiter;
+    };
+} snd_dsp_node_params_t;
+typedef struct snd_dsp_node_t {
+    void* handle;
+} snd_dsp_node_t;
+typedef struct snd_dsp_node_stats_t {
+    uint64_t nr_blocks;
+    double seconds_total, seconds_per_block;
+    /* share of real time spent in the node, 1.0 would use a whole core */
+    double load;
+} snd_dsp_node_stats_t;
+/* HRTF rendering for headphones in the software backend: mono sources are convolved with the measured head related
+ * impulse responses of the nearest direction instead of being panned, stereo sources are played as is. */
+typedef struct snd_hrtf_t {
+    void* handle;
+} snd_hrtf_t;
+/* One set of measurements as in a SOFA SimpleFreeFieldHRIR file; reading the file itself is up to the caller. */
+typedef struct snd_hrtf_data_t {
+    uint32_t frequency_hz, nr_measurements, nr_frames;
+    /* SourcePosition: azimuth counterclockwise from the front and elevation, in degrees, two floats per measurement */
+    const float* directions;
+    /* Data.IR: nr_frames of the left ear, then nr_frames of the right ear, for every measurement */
+    const float* impulse_responses;
+    /* Data.Delay in samples, left and right per measurement, or NULL if the IRs already contain the delays */
+    const float* delays;
+} snd_hrtf_data_t;
+typedef struct snd_hrtf_params_t {
+    /* the loudest sources get a convolution of their own, all others are panned onto 10 virtual speakers that are
+     * convolved once per block; so the load depends on this and not on the number of sources */
+    uint32_t max_direct_sources;
+} snd_hrtf_params_t;
+typedef struct snd_hrtf_stats_t {
+    /* in the last block */
+    uint32_t nr_direct_sources, nr_bed_sources;
+    uint64_t nr_blocks;
+    double seconds_total, seconds_per_block;
+    /* share of real time, as in snd_dsp_node_stats_t */
+    double load;
+} snd_hrtf_stats_t;
+#define SND_STREAM_MAX_BUFFERS 16
+/* Writes up to max_frames frames in the stream's format to data and returns how many were written, 0 ends the stream.
+ * Called on the stream's refill thread. */
+typedef uint32_t (*snd_stream_pull_callback_t)(void* user_data, void* data, uint32_t max_frames);
+typedef struct snd_stream_params_t {
+    snd_format_t format;
+    uint32_t frequency_hz;
+    /* latency is about nr_buffers * frames_per_buffer / frequency_hz, memory nr_buffers + 1 buffers */
+    uint32_t nr_buffers, frames_per_buffer;
+    /* 0 picks a quarter of one buffer's playtime */
+    uint32_t refill_interval_ms;
+    snd_stream_pull_callback_t pull;
+    void* user_data;
+} snd_stream_params_t;
+typedef struct snd_stream_stats_t {
+    uint64_t frames_streamed;
+    uint32_t underruns, buffers_queued;
+    bool finished;
+} snd_stream_stats_t;
+typedef struct snd_stream_t {
+    void* handle;
+} snd_stream_t;
+typedef struct snd_voice_pool_t {
+    void* handle;
+} snd_voice_pool_t;
+typedef struct snd_voice_t {
+    uint32_t id;
+} snd_voice_t;
+typedef struct snd_voice_pool_stats_t {
+    uint32_t nr_voices, nr_real_sources, nr_playing_real, nr_playing_virtual;
+} snd_voice_pool_stats_t;
+typedef struct snd_buffer_cache_t {
+    void* handle;
+} snd_buffer_cache_t;
+typedef struct snd_buffer_cache_stats_t {
+    uint64_t nr_hits, nr_misses, nr_evictions;
+    uint32_t nr_resident;
+    /* size of the PCM as passed to acquire */
+    size_t resident_bytes;
+} snd_buffer_cache_stats_t;
+typedef struct snd_source_stats_t {
+    bool playing;
+    uint32_t nr_buffers_queued, nr_buffers_processed;
+    /* streaming sources found stopped with their whole queue played without snd_sources_stop */
+    uint32_t nr_underruns;
+    /* from AL_SOFT_source_latency, -1 without it */
+    double latency_seconds;
+} snd_source_stats_t;
+typedef struct snd_listener_context_stats_t {
+    /* from ALC_SOFT_device_clock, device_latency_ns is -1 without it */
+    bool device_clock_available;
+    uint64_t device_clock_ns;
+    int64_t device_latency_ns;
+    uint32_t mixing_frequency_hz, refresh_interval_hz;
+    /* sums over the sources passed in */
+    uint32_t nr_buffers_queued, nr_buffers_processed, nr_underruns;
+    /* time inside snd calls on this context in the last frame ended by snd_listener_context_frame_end,
+     * and the most of any frame; only measured when built with SND_PROFILE, 0 otherwise */
+    double api_seconds_last_frame, api_seconds_max_frame;
+    uint32_t nr_api_calls_last_frame;
+} snd_listener_context_stats_t;
+#define SND_COMMAND_MAX_BUFFERS 4
+typedef enum snd_command_type_t {
+    SND_COMMAND_TYPE_PLAY = 0,
+    SND_COMMAND_TYPE_PAUSE = 1,
+    SND_COMMAND_TYPE_STOP = 2,
+    SND_COMMAND_TYPE_PARAMS_SET = 3,
+    SND_COMMAND_TYPE_STATIC_BUFFER = 4,
+    SND_COMMAND_TYPE_QUEUE_BUFFERS = 5,
+    /* resets the source and gives it back to the queue's pool */
+    SND_COMMAND_TYPE_RELEASE_SOURCE = 6,
+    SND_COMMAND_TYPE_MAX_ENUM = 0x7f
+} snd_command_type_t;
+typedef struct snd_command_t {
+    snd_command_type_t type;
+    snd_source_t source;
+    union {
+        /* SND_COMMAND_TYPE_PARAMS_SET, dirty_mask as in snd_sources_params_set_batch */
+        struct { snd_source_params_t params; uint32_t dirty_mask; } params;
+        /* SND_COMMAND_TYPE_STATIC_BUFFER uses buffers[0] */
+        struct { uint32_t nr_buffers; snd_buffer_t buffers[SND_COMMAND_MAX_BUFFERS]; } buffers;
+    };
+} snd_command_t;
+typedef struct snd_command_queue_t {
+    void* handle;
+} snd_command_queue_t;
+typedef struct snd_command_queue_stats_t {
+    uint64_t nr_pushed, nr_rejected, nr_executed, nr_failed;
+    snd_result_t last_error;
+} snd_command_queue_stats_t;
+/* called on the capture thread with exactly frames_per_block frames */
+typedef void (*snd_capture_callback_t)(void* user_data, const void* frames, uint32_t nr_frames);
+typedef struct snd_capture_params_t {
+    /* has to be the format the recording device was opened with, SND_ERROR_UNSUPPORTED_FORMAT otherwise */
+    snd_format_t format;
+    uint32_t frames_per_block;
+    /* blocks kept for snd_capture_wait before the oldest is dropped, unused with a callback */
+    uint32_t nr_blocks;
+    uint32_t poll_interval_ms;
+    /* NULL to collect the blocks with snd_capture_wait instead */
+    snd_capture_callback_t callback;
+    void* user_data;
+} snd_capture_params_t;
+typedef struct snd_capture_t {
+    void* handle;
+} snd_capture_t;
+typedef struct snd_capture_stats_t {
+    uint64_t nr_frames_captured, nr_blocks_delivered;
+    /* overruns: blocks thrown away because snd_capture_wait wasn't called fast enough */
+    uint64_t nr_blocks_dropped;
+    /* largest ALC_CAPTURE_SAMPLES seen; close to the device buffer size means the poll interval is too long */
+    uint64_t max_backlog_frames;
+} snd_capture_stats_t;
+typedef enum snd_decoder_type_t {
+    SND_DECODER_TYPE_WAV = 0,
+    SND_DECODER_TYPE_QOA = 1,
+    SND_DECODER_TYPE_VORBIS = 2,
+    SND_DECODER_TYPE_MAX_ENUM = 0x7f
+} snd_decoder_type_t;
+typedef struct snd_decoder_info_t {
+    snd_decoder_type_t type;
+    snd_format_t format;
+    uint32_t frequency_hz;
+    /* from the file header, 0 if unknown */
+    uint64_t nr_frames;
+} snd_decoder_info_t;
+/* For decoders that aren't built in (Ogg Vorbis, e.g. wrapping stb_vorbis). open returns NULL on failure,
+ * read works like snd_stream_pull_callback_t. */
+typedef struct snd_decoder_interface_t {
+    void* (*open)(const void* data, size_t size, snd_format_t* out_format, uint32_t* out_frequency_hz, uint64_t* out_nr_frames);
+    uint32_t (*read)(void* decoder, void* out_data, uint32_t max_frames);
+    void (*close)(void* decoder);
+} snd_decoder_interface_t;
+typedef struct snd_decoder_t {
+    void* handle;
+} snd_decoder_t;
+typedef struct snd_decode_job_t {
+    void* handle;
+} snd_decode_job_t;
+typedef struct snd_decode_stats_t {
+    uint64_t nr_frames;
+    double decode_seconds, x_realtime;
+} snd_decode_stats_t;
 
 snd_result_t snd_init(snd_device_list_t* out_device_list);
+/* snd_init is this with SND_BACKEND_TYPE_OPENAL; software_params is only used (and required) for SND_BACKEND_TYPE_SOFTWARE */
+snd_result_t snd_init_backend(snd_backend_type_t backend, const snd_software_backend_params_t* software_params, snd_device_list_t* out_device_list);
 snd_result_t snd_exit(void);
+/* Enumerates the devices again. Ids can change, devices already in use are remapped to their new id and the
+ * previous list's strings are freed. A device that is gone stays open for the contexts using it until snd_exit. */
+snd_result_t snd_devices_refresh(snd_device_list_t* out_device_list);
+/* Doesn't block: returns the snd_device_event_bits_t seen since the last call, and the ids of open playback devices
+ * that are disconnected; out_disconnected_ids can be NULL if max_disconnected is 0. */
+snd_result_t snd_devices_poll(uint32_t* out_event_bits, uint32_t max_disconnected, uint32_t* out_disconnected_ids, uint32_t* out_nr_disconnected);
+/* Moves an open playback device with all its contexts to another output (ALC_SOFT_reopen_device), so playback
+ * goes on without recreating anything. The device is then known under new_playback_device_id. */
+snd_result_t snd_playback_device_reopen(uint32_t playback_device_id, uint32_t new_playback_device_id);
+/* Software backend only: mixes nr_frames of all playing sources and hands them to the sink and/or WAV file. */
+snd_result_t snd_software_render(uint32_t nr_frames);
+/* the same, also writing the mix to out_frames as nr_frames interleaved stereo floats */
+snd_result_t snd_software_render_to_memory(uint32_t nr_frames, float* out_frames);
+snd_result_t snd_software_render_stats_get(snd_software_render_stats_t* out_stats);
+snd_result_t snd_dsp_node_create(const snd_dsp_node_params_t* params, snd_dsp_node_t* out_node);
+snd_result_t snd_dsp_node_params_set(snd_dsp_node_t node, const snd_dsp_node_params_t* params);
+snd_result_t snd_dsp_node_stats_get(snd_dsp_node_t node, snd_dsp_node_stats_t* out_stats);
+/* Up to 8 nodes processed in order; 0 nodes removes the chain. A node can only be in one chain at a time. */
+snd_result_t snd_dsp_source_chain_set(snd_listener_context_t context, snd_source_t source, uint32_t nr_nodes, const snd_dsp_node_t* nodes);
+snd_result_t snd_dsp_master_chain_set(uint32_t nr_nodes, const snd_dsp_node_t* nodes);
+/* fails while the node is in a chain */
+snd_result_t snd_dsp_node_destroy(snd_dsp_node_t node);
+/* The data is resampled to the mixing frequency and copied. */
+snd_result_t snd_hrtf_create(const snd_hrtf_data_t* data, snd_hrtf_t* out_hrtf);
+/* OpenAL Soft's .mhr files, versions 0 to 3; of several fields the farthest is used. */
+snd_result_t snd_hrtf_create_mhr(const void* data, size_t size, snd_hrtf_t* out_hrtf);
+/* Renders the mix through hrtf from the next block on; a NULL handle goes back to panning and params is ignored. */
+snd_result_t snd_hrtf_output_set(snd_hrtf_t hrtf, const snd_hrtf_params_t* params);
+snd_result_t snd_hrtf_stats_get(snd_hrtf_stats_t* out_stats);
+/* fails while it is the output */
+snd_result_t snd_hrtf_destroy(snd_hrtf_t hrtf);
 
 snd_result_t snd_recording_device_open(uint32_t recording_device_id, snd_format_t format, uint32_t frequency_hz, size_t internal_buffer_size, snd_recording_device_t* device);
 snd_result_t snd_recording_device_close(snd_recording_device_t device);
 snd_result_t snd_recording_start(snd_recording_device_t device);
 snd_result_t snd_recording_stop(snd_recording_device_t device);
 snd_result_t snd_recording_retrieve_samples_nonblocking(snd_recording_device_t device, void* buffer, size_t nr_samples);
+/* Starts recording and a thread that polls the device every poll_interval_ms, handing out fixed size blocks. */
+snd_result_t snd_capture_start(snd_recording_device_t device, const snd_capture_params_t* params, snd_capture_t* out_capture);
+/* copies the oldest block (frames_per_block frames) into block, SND_ERROR_TIMEOUT if none arrived in time */
+snd_result_t snd_capture_wait(snd_capture_t capture, void* block, uint32_t timeout_ms);
+snd_result_t snd_capture_stats_get(snd_capture_t capture, snd_capture_stats_t* out_stats);
+/* stops the thread and the recording, the device stays open */
+snd_result_t snd_capture_stop(snd_capture_t capture);
 
 snd_result_t snd_listener_context_create(uint32_t playback_device_id, uint32_t mixing_frequency_Hz, uint32_t refresh_interval_Hz, bool synchronous, uint32_t requested_min_nr_mono_sources, uint32_t requested_min_nr_stereo_sources, snd_listener_context_t* context);
+/* Makes the context current once for a scope of snd calls on this thread, instead of switching to it and back on every call.
+ * Uses ALC_EXT_thread_local_context if present, so other threads are not affected; otherwise the process wide current context
+ * is changed. Scopes of the same context can nest, a different one can't be bound before the outer scope is unbound.
+ * A context can't be destroyed while this thread has it bound. */
+snd_result_t snd_listener_context_bind(snd_listener_context_t context);
+snd_result_t snd_listener_context_unbind(void);
+/* out_source_stats can be NULL, otherwise it gets one entry per source */
+snd_result_t snd_listener_context_stats_get(snd_listener_context_t context, uint32_t nr_sources, const snd_source_t* sources, snd_source_stats_t* out_source_stats, snd_listener_context_stats_t* out_stats);
+/* call once per game frame, the API time collected since the last call becomes the last frame's */
+snd_result_t snd_listener_context_frame_end(snd_listener_context_t context);
 snd_result_t snd_listener_context_params_get(snd_listener_context_t context, const snd_listener_context_params_t* params);
 snd_result_t snd_listener_context_params_set(snd_listener_context_t context, const snd_listener_context_params_t params);
 snd_result_t snd_listener_context_process(snd_listener_context_t context);
 snd_result_t snd_listener_context_suspend(snd_listener_context_t context);
 snd_result_t snd_listener_context_destroy(snd_listener_context_t context);
 
+/* out_native is false if buffers in this format are converted before upload */
+snd_result_t snd_format_supported(snd_format_t format, bool* out_native);
 snd_result_t snd_buffer_alloc(snd_listener_context_t context, snd_format_t format, uint32_t frequency_hz, void* data, size_t size, snd_buffer_t* buffer);
+/* applies to buffers allocated afterwards, these are uploaded as float at the device's mixing frequency */
+snd_result_t snd_listener_context_resample_quality_set(snd_listener_context_t context, snd_resample_quality_t quality);
 snd_result_t snd_buffer_free(snd_listener_context_t context, snd_buffer_t buffer);
 
 snd_result_t snd_source_create(snd_listener_context_t context, snd_source_t* source);
 snd_result_t snd_source_delete(snd_listener_context_t context, snd_source_t source);
 snd_result_t snd_source_params_get(snd_listener_context_t context, snd_source_t source, const snd_source_params_t* params);
 snd_result_t snd_source_params_set(snd_listener_context_t context, snd_source_t source, const snd_source_params_t params);
+/* Sets the fields in dirty_mask (snd_source_params_field_bits_t) of params[i] on sources[i]. Values that are the same as the
+ * last ones set through snd are skipped. With AL_SOFT_deferred_updates the whole batch is applied in one mixer update.
+ * Values out of the ranges snd_source_params_set accepts fail the whole batch before any source is changed. */
+snd_result_t snd_sources_params_set_batch(snd_listener_context_t context, uint32_t nr_sources, const snd_source_t* sources, const snd_source_params_t* params, uint32_t dirty_mask);
 
 snd_result_t snd_source_play_position_set(snd_listener_context_t context, snd_source_t source, snd_source_position_format_t format, float value);
 snd_result_t snd_source_play_position_get(snd_listener_context_t context, snd_source_t source, snd_source_position_format_t format, float* out_value);
@@ -136,7 +488,78 @@ snd_result_t snd_source_reset_buffer_state(snd_listener_context_t context, snd_s
 snd_result_t snd_sources_play  (snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources);
 snd_result_t snd_sources_pause (snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources);
 snd_result_t snd_sources_stop  (snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources);
+/* Starts the sources together at device_clock_ns, in the time base of snd_listener_context_clock_get (the device clock
+ * with ALC_SOFT_device_clock, the host clock otherwise). Sample exact with AL_SOFT_source_start_delay; without it,
+ * silence is queued in front of each source, which needs a non looping source with a static buffer. The source then
+ * holds the buffer as a queue until it is stopped and the next snd_sources_play(_at) gives it its static buffer back,
+ * so it can be scheduled again right away. */
+snd_result_t snd_sources_play_at(snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources, uint64_t device_clock_ns);
+snd_result_t snd_listener_context_clock_get(snd_listener_context_t context, uint64_t* out_clock_ns);
+/* how late (positive) or early the last snd_sources_play_at of a playing source really started */
+snd_result_t snd_source_start_error_get(snd_listener_context_t context, snd_source_t source, int64_t* out_error_ns);
 snd_result_t snd_sources_rewind(snd_listener_context_t context, uint32_t nr_sources, snd_source_t* sources);
 
+/* The stream owns the source's buffer queue until destroyed; don't queue buffers on it or play/stop it directly.
+ * Its refill thread needs ALC_EXT_thread_local_context, without it SND_ERROR_THREAD_LOCAL_CONTEXT_NOT_PRESENT is returned
+ * (except on the software backend, which refills its streams while rendering). */
+snd_result_t snd_stream_create(snd_listener_context_t context, snd_source_t source, const snd_stream_params_t params, snd_stream_t* out_stream);
+snd_result_t snd_stream_play(snd_stream_t stream);
+snd_result_t snd_stream_stop(snd_stream_t stream);
+/* also returns an error the refill thread ran into; after an error filling or queueing a buffer the stream isn't
+ * refilled until snd_stream_stop, the buffer and its frames are kept for the next snd_stream_play */
+snd_result_t snd_stream_stats_get(snd_stream_t stream, snd_stream_stats_t* out_stats);
+snd_result_t snd_stream_destroy(snd_stream_t stream);
+
+/* Voices are logical sources without a limit. Each update the playing voices with the highest
+ * gain * distance attenuation * priority get the pool's real sources, the rest only advance their play position.
+ * Parameter changes and play/stop take effect on the real source at the next update. */
+snd_result_t snd_voice_pool_create(snd_listener_context_t context, uint32_t nr_real_sources, snd_voice_pool_t* out_pool);
+snd_result_t snd_voice_create(snd_voice_pool_t pool, snd_buffer_t buffer, const snd_source_params_t params, float priority, snd_voice_t* out_voice);
+snd_result_t snd_voice_params_set(snd_voice_pool_t pool, snd_voice_t voice, const snd_source_params_t params, float priority);
+snd_result_t snd_voice_play(snd_voice_pool_t pool, snd_voice_t voice);
+snd_result_t snd_voice_stop(snd_voice_pool_t pool, snd_voice_t voice);
+snd_result_t snd_voice_destroy(snd_voice_pool_t pool, snd_voice_t voice);
+snd_result_t snd_voice_pool_update(snd_voice_pool_t pool, float elapsed_s);
+snd_result_t snd_voice_pool_stats_get(snd_voice_pool_t pool, snd_voice_pool_stats_t* out_stats);
+snd_result_t snd_voice_pool_destroy(snd_voice_pool_t pool);
+
+/* Buffers keyed by a hash of their PCM, format and frequency, so loading the same asset twice shares one buffer.
+ * Released buffers stay resident until budget_bytes is exceeded, then the least recently released go first.
+ * The PCM isn't kept to compare against, a hit only checks the 64 bit hash, size, format and frequency; two different
+ * assets agreeing on all of them share a buffer. That's unlikely by accident but not safe against crafted input.
+ * The budget and resident_bytes count what was uploaded, after any resampling and format conversion. */
+snd_result_t snd_buffer_cache_create(snd_listener_context_t context, size_t budget_bytes, snd_buffer_cache_t* out_cache);
+snd_result_t snd_buffer_cache_acquire(snd_buffer_cache_t cache, snd_format_t format, uint32_t frequency_hz, void* data, size_t size, snd_buffer_t* out_buffer);
+/* every acquire needs a release; the buffer mustn't be attached to a source anymore when the last one happens */
+snd_result_t snd_buffer_cache_release(snd_buffer_cache_t cache, snd_buffer_t buffer);
+snd_result_t snd_buffer_cache_stats_get(snd_buffer_cache_t cache, snd_buffer_cache_stats_t* out_stats);
+/* frees every buffer, referenced or not */
+snd_result_t snd_buffer_cache_destroy(snd_buffer_cache_t cache);
+
+/* Commands can be pushed from any number of threads without locking; a full queue rejects the push instead of waiting.
+ * They are executed in order on the queue's own thread every drain_interval_ms. nr_sources sources are created up front
+ * and handed out by acquire without touching AL. Needs ALC_EXT_thread_local_context, otherwise
+ * SND_ERROR_THREAD_LOCAL_CONTEXT_NOT_PRESENT is returned. */
+snd_result_t snd_command_queue_create(snd_listener_context_t context, uint32_t capacity, uint32_t nr_sources, uint32_t drain_interval_ms, snd_command_queue_t* out_queue);
+snd_result_t snd_command_queue_source_acquire(snd_command_queue_t queue, snd_source_t* out_source);
+snd_result_t snd_command_queue_push(snd_command_queue_t queue, const snd_command_t* command);
+snd_result_t snd_command_queue_stats_get(snd_command_queue_t queue, snd_command_queue_stats_t* out_stats);
+/* executes what is still queued, then deletes the sources */
+snd_result_t snd_command_queue_destroy(snd_command_queue_t queue);
+
+/* WAV (PCM) and QOA are built in, Ogg Vorbis needs a decoder registered. The encoded data is not copied and has to
+ * stay valid until the decoder is closed or the job is finished. */
+snd_result_t snd_decoder_register(snd_decoder_type_t type, const snd_decoder_interface_t* decoder_interface);
+snd_result_t snd_decoder_open(const void* data, size_t size, snd_decoder_t* out_decoder, snd_decoder_info_t* out_info);
+/* out_nr_frames is 0 at the end of the data */
+snd_result_t snd_decoder_read(snd_decoder_t decoder, void* out_data, uint32_t max_frames, uint32_t* out_nr_frames);
+/* snd_stream_pull_callback_t with the decoder's handle as user_data */
+uint32_t snd_decoder_stream_pull(void* user_data, void* data, uint32_t max_frames);
+snd_result_t snd_decoder_close(snd_decoder_t decoder);
+snd_result_t snd_buffer_alloc_decoded(snd_listener_context_t context, const void* data, size_t size, snd_buffer_t* buffer);
+/* Decodes on a worker thread; finish waits for it and uploads the result on the calling thread. */
+snd_result_t snd_decode_job_start(const void* data, size_t size, snd_decode_job_t* out_job);
+snd_result_t snd_decode_job_finish(snd_decode_job_t job, snd_listener_context_t context, snd_buffer_t* buffer, snd_decode_stats_t* out_stats);
+
 
 
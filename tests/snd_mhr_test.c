@@ -0,0 +1,93 @@
+/* Checks the .mhr header parsing against files laid out like OpenAL Soft's makemhr writes them:
+ *   MinPHR00: rate u32, irCount u16, irSize u16, evCount u8, evOffset u16[evCount]
+ *   MinPHR01: rate u32, irSize u8, evCount u8, azCount u8[evCount]
+ * both followed by irCount * irSize s16 coefficients and irCount u8 delays.
+ * Build with the flags of snd.c, e.g. cc -std=c11 -I.. snd_mhr_test.c -lm, and run without arguments. */
+#include "../snd.c"
+
+#include <stdio.h>
+
+#define NR_ELEVATIONS 5
+#define NR_IRS 16
+#define IR_SIZE 8
+static const uint8_t azimuth_counts[NR_ELEVATIONS] = { 1, 4, 6, 4, 1 };
+static const uint16_t elevation_offsets[NR_ELEVATIONS] = { 0, 1, 5, 11, 15 };
+
+static size_t put(uint8_t* p, size_t at, uint32_t v, uint32_t nr_bytes) {
+    for(uint32_t b = 0; b < nr_bytes; b++) {
+        p[at + b] = (uint8_t)(v >> (8 * b));
+    }
+    return at + nr_bytes;
+}
+static size_t put_payload(uint8_t* p, size_t at) {
+    for(uint32_t ir = 0; ir < NR_IRS; ir++) {
+        for(uint32_t i = 0; i < IR_SIZE; i++) {
+            at = put(p, at, ir * 100 + i, 2);
+        }
+    }
+    for(uint32_t ir = 0; ir < NR_IRS; ir++) {
+        at = put(p, at, ir, 1);
+    }
+    return at;
+}
+static size_t make_v00(uint8_t* p) {
+    size_t at = 0;
+    memcpy(p, "MinPHR00", 8);
+    at = put(p, 8, 44100, 4);
+    at = put(p, at, NR_IRS, 2);
+    at = put(p, at, IR_SIZE, 2);
+    at = put(p, at, NR_ELEVATIONS, 1);
+    for(uint32_t e = 0; e < NR_ELEVATIONS; e++) {
+        at = put(p, at, elevation_offsets[e], 2);
+    }
+    return put_payload(p, at);
+}
+static size_t make_v01(uint8_t* p) {
+    size_t at = 0;
+    memcpy(p, "MinPHR01", 8);
+    at = put(p, 8, 44100, 4);
+    at = put(p, at, IR_SIZE, 1);
+    at = put(p, at, NR_ELEVATIONS, 1);
+    for(uint32_t e = 0; e < NR_ELEVATIONS; e++) {
+        at = put(p, at, azimuth_counts[e], 1);
+    }
+    return put_payload(p, at);
+}
+static int check(const char* name, const uint8_t* file, size_t size) {
+    snd_hrtf_data_t set; int failed = 0; uint32_t m;
+
+    if(snd_mhr_parse(file, size, &set) != SND_OK) {
+        printf("%s: not parsed\n", name);
+        return 1;
+    }
+    failed |= set.frequency_hz != 44100 || set.nr_measurements != NR_IRS || set.nr_frames != IR_SIZE;
+    /* the third azimuth of the horizontal elevation is IR 7, its mirror for the right ear IR 9 */
+    m = 7;
+    failed |= set.directions[2*m] != -120.0f || set.directions[2*m + 1] != 0.0f;
+    failed |= set.impulse_responses[(2 * m) * IR_SIZE + 3] != (float)(7 * 100 + 3) / 32768.0f;
+    failed |= set.impulse_responses[(2 * m + 1) * IR_SIZE + 3] != (float)(9 * 100 + 3) / 32768.0f;
+    failed |= set.delays[2*m] != 7.0f || set.delays[2*m + 1] != 9.0f;
+    /* the top elevation has a single direction */
+    failed |= set.directions[2 * (NR_IRS - 1) + 1] != 90.0f;
+    free((float*) set.directions);
+    free((float*) set.impulse_responses);
+    free((float*) set.delays);
+
+    /* a file cut short in the payload is refused */
+    if(snd_mhr_parse(file, size - 1, &set) == SND_OK) {
+        free((float*) set.directions);
+        free((float*) set.impulse_responses);
+        free((float*) set.delays);
+        failed = 1;
+    }
+    printf("%s: %s\n", name, failed ? "FAILED" : "ok");
+    return failed;
+}
+int main(void) {
+    static uint8_t file[1024];
+    int failed = 0;
+
+    failed |= check("MinPHR00", file, make_v00(file));
+    failed |= check("MinPHR01", file, make_v01(file));
+    return failed;
+}
@@ -0,0 +1,792 @@
+/* tmpl: build-time expansion of the <?c ... ?> templates in lib.h and lib.c
+
+    usage: tmpl [options] <template> <output>
+        -cc <compiler>  compiler for the generator program and -measure (default: $CC, or cc)
+        -prune <file>   only keep the generated declarations reachable from the identifiers used in <file>;
+                        can be given more than once. Expand lib.c first and pass its output when expanding lib.h,
+                        so the prototypes of everything the kept definitions call stay in.
+        -split          write every template region to <output stem>_<n><output extension> and #include it there
+        -measure        time a syntax-only compile of the full and of the pruned expansion and report both
+        -force          expand even if <output>.stamp says nothing changed
+        -keep           keep the generator (<output>.gen.c and <output>.gen) and the unpruned expansion
+        -v              print statistics
+
+    Everything between <?c and ?> is C code run at build time, everything else is text copied to the output with
+    @name@ replaced by the value of the char* variable name in scope. All code blocks of one template end up in the
+    same generator program, so later blocks can use the arrays declared in earlier ones. A template region starts
+    with a code block at brace depth 0 and ends with the code block that closes its last brace.
+
+    The stamp file holds a hash of the template, the options and the -prune files; if it still matches and the
+    output exists, the template isn't expanded again, so a build only pays for the templates that changed.
+*/
+/* popen and pclose are POSIX, not C11 */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32) || defined(__MINGW32__)
+#define popen _popen
+#define pclose _pclose
+#endif
+
+#define TMPL_VERSION "1"
+
+/* written by the generator around every template region; neither byte can occur in C source text */
+#define TMPL_REGION_BEGIN 0x03
+#define TMPL_REGION_END 0x04
+
+typedef struct tmpl_buf_t {
+    char* data;
+    size_t len, cap;
+} tmpl_buf_t;
+
+static void* tmpl_realloc(void* ptr, size_t size) {
+    ptr = realloc(ptr, size);
+    if(ptr == NULL) {
+        fprintf(stderr, "tmpl: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+static void tmpl_buf_append(tmpl_buf_t* buf, const char* data, size_t len) {
+    if(buf->len + len + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 4096;
+        while(cap < buf->len + len + 1) cap *= 2;
+        buf->data = tmpl_realloc(buf->data, cap);
+        buf->cap = cap;
+    }
+    memcpy(&buf->data[buf->len], data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+static void tmpl_buf_append_str(tmpl_buf_t* buf, const char* str) {
+    tmpl_buf_append(buf, str, strlen(str));
+}
+static void tmpl_buf_free(tmpl_buf_t* buf) {
+    free(buf->data);
+    buf[0] = (tmpl_buf_t){0};
+}
+
+static bool tmpl_read_file(const char* path, tmpl_buf_t* out) {
+    char chunk[65536]; size_t n;
+    FILE* f = fopen(path, "rb");
+    if(f == NULL) return false;
+    tmpl_buf_append(out, "", 0);
+    while((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        tmpl_buf_append(out, chunk, n);
+    }
+    fclose(f);
+    return true;
+}
+static bool tmpl_write_file(const char* path, const char* data, size_t len) {
+    FILE* f = fopen(path, "wb");
+    if(f == NULL) {
+        fprintf(stderr, "tmpl: could not write %s\n", path);
+        return false;
+    }
+    if(fwrite(data, 1, len, f) != len) {
+        fclose(f);
+        fprintf(stderr, "tmpl: could not write %s\n", path);
+        return false;
+    }
+    return fclose(f) == 0;
+}
+
+static uint64_t tmpl_hash(uint64_t h, const char* data, size_t len) {
+    /* FNV-1a */
+    for(size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t) data[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+#define TMPL_HASH_INIT 0xcbf29ce484222325ull
+
+static double tmpl_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static bool tmpl_is_ident_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+static bool tmpl_is_ident_char(char c) {
+    return tmpl_is_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+/* index after the comment or literal starting at i, or i if there is none */
+static size_t tmpl_skip_comment_or_literal(const char* s, size_t i, size_t end) {
+    if(s[i] == '/' && i + 1 < end && s[i + 1] == '/') {
+        while(i < end && s[i] != '\n') i++;
+        return i;
+    }
+    if(s[i] == '/' && i + 1 < end && s[i + 1] == '*') {
+        i += 2;
+        while(i + 1 < end && !(s[i] == '*' && s[i + 1] == '/')) i++;
+        return (i + 2 < end) ? i + 2 : end;
+    }
+    if(s[i] == '"' || s[i] == '\'') {
+        char quote = s[i++];
+        while(i < end && s[i] != quote && s[i] != '\n') {
+            if(s[i] == '\\') i++;
+            i++;
+        }
+        return (i + 1 < end) ? i + 1 : end;
+    }
+    return i;
+}
+
+
+
+
+/* generator program: */
+
+static void tmpl_emit_literal(tmpl_buf_t* gen, const char* text, size_t len) {
+    char esc[8];
+    if(len == 0) return;
+    tmpl_buf_append_str(gen, "fputs(\"");
+    for(size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) text[i];
+        switch(c) {
+        case '\\': tmpl_buf_append_str(gen, "\\\\"); break;
+        case '"': tmpl_buf_append_str(gen, "\\\""); break;
+        /* no trigraphs in the generator */
+        case '?': tmpl_buf_append_str(gen, "\\?"); break;
+        case '\t': tmpl_buf_append_str(gen, "\\t"); break;
+        case '\r': tmpl_buf_append_str(gen, "\\r"); break;
+        case '\n': tmpl_buf_append_str(gen, "\\n\"\n\""); break;
+        default:
+            if(c < 0x20 || c >= 0x7f) {
+                snprintf(esc, sizeof(esc), "\\%03o", c);
+                tmpl_buf_append_str(gen, esc);
+            } else {
+                tmpl_buf_append(gen, &text[i], 1);
+            }
+        }
+    }
+    tmpl_buf_append_str(gen, "\", stdout); ");
+}
+
+/* text between code blocks: literals, and the value of the variable for every @name@. Only the line breaks of the
+   text end up as line breaks in the generator, so its lines stay in step with the template. */
+static void tmpl_emit_text(tmpl_buf_t* gen, const char* template_path, size_t line, const char* text, size_t len) {
+    size_t start = 0, i = 0;
+    char line_directive[32];
+    if(len == 0) return;
+    snprintf(line_directive, sizeof(line_directive), "#line %zu \"", line);
+    tmpl_buf_append_str(gen, line_directive);
+    tmpl_buf_append_str(gen, template_path);
+    tmpl_buf_append_str(gen, "\"\n");
+    while(i < len) {
+        size_t j = i + 1;
+        if(text[i] == '@' && j < len && tmpl_is_ident_start(text[j])) {
+            while(j < len && tmpl_is_ident_char(text[j])) j++;
+            if(j < len && text[j] == '@') {
+                tmpl_emit_literal(gen, &text[start], i - start);
+                tmpl_buf_append_str(gen, "fputs(");
+                tmpl_buf_append(gen, &text[i + 1], j - i - 1);
+                tmpl_buf_append_str(gen, ", stdout); ");
+                i = start = j + 1;
+                continue;
+            }
+        }
+        i++;
+    }
+    tmpl_emit_literal(gen, &text[start], len - start);
+    tmpl_buf_append_str(gen, "\n");
+}
+
+/* how many braces a code block opens (or closes, if negative) */
+static int tmpl_code_depth(const char* code, size_t len) {
+    int depth = 0;
+    size_t i = 0;
+    while(i < len) {
+        size_t next = tmpl_skip_comment_or_literal(code, i, len);
+        if(next != i) {
+            i = next;
+            continue;
+        }
+        if(code[i] == '{') depth++;
+        if(code[i] == '}') depth--;
+        i++;
+    }
+    return depth;
+}
+
+static bool tmpl_build_generator(const char* template_path, const tmpl_buf_t* src, tmpl_buf_t* gen, size_t* out_nr_regions) {
+    size_t pos = 0, line = 1, nr_regions = 0;
+    int depth = 0;
+    char line_directive[32];
+
+    tmpl_buf_append_str(gen, "#include <stdio.h>\n#include <stdlib.h>\n#include <stdint.h>\n#include <stdbool.h>\n#include <string.h>\n");
+    tmpl_buf_append_str(gen, "int main(void) {\n");
+    while(pos < src->len) {
+        const char* open = strstr(&src->data[pos], "<?c");
+        const char* close;
+        size_t text_end = (open != NULL) ? (size_t)(open - src->data) : src->len;
+        int block_depth;
+
+        tmpl_emit_text(gen, template_path, line, &src->data[pos], text_end - pos);
+        for(size_t i = pos; i < text_end; i++) line += (src->data[i] == '\n');
+        if(open == NULL) break;
+
+        close = strstr(open + 3, "?>");
+        if(close == NULL) {
+            fprintf(stderr, "%s:%zu: <?c without ?>\n", template_path, line);
+            return false;
+        }
+        if(depth == 0) {
+            tmpl_buf_append_str(gen, "putchar(3);\n");
+            nr_regions++;
+        }
+        /* so the compiler errors point into the template */
+        snprintf(line_directive, sizeof(line_directive), "#line %zu \"", line);
+        tmpl_buf_append_str(gen, line_directive);
+        tmpl_buf_append_str(gen, template_path);
+        tmpl_buf_append_str(gen, "\"\n");
+        tmpl_buf_append(gen, open + 3, (size_t)(close - open - 3));
+        tmpl_buf_append_str(gen, "\n");
+
+        block_depth = tmpl_code_depth(open + 3, (size_t)(close - open - 3));
+        depth += block_depth;
+        if(depth < 0) {
+            fprintf(stderr, "%s:%zu: template code closes more braces than it opened\n", template_path, line);
+            return false;
+        }
+        if(depth == 0) {
+            tmpl_buf_append_str(gen, "putchar(4);\n");
+        }
+        for(const char* c = open; c < close; c++) line += (*c == '\n');
+
+        /* the line break after ?> belongs to the code block */
+        pos = (size_t)(close - src->data) + 2;
+        if(pos < src->len && src->data[pos] == '\r') pos++;
+        if(pos < src->len && src->data[pos] == '\n') {
+            pos++;
+            line++;
+        }
+    }
+    if(depth != 0) {
+        fprintf(stderr, "%s: template code ends with %d unclosed braces\n", template_path, depth);
+        return false;
+    }
+    tmpl_buf_append_str(gen, "return 0;\n}\n");
+    out_nr_regions[0] = nr_regions;
+    return true;
+}
+
+static bool tmpl_run_generator(const char* cc, const char* gen_src_path, const char* gen_exe_path, tmpl_buf_t* out) {
+    tmpl_buf_t cmd = {0};
+    char chunk[65536]; size_t n;
+    FILE* pipe;
+    int status;
+
+    tmpl_buf_append_str(&cmd, cc);
+    tmpl_buf_append_str(&cmd, " -w -o \"");
+    tmpl_buf_append_str(&cmd, gen_exe_path);
+    tmpl_buf_append_str(&cmd, "\" \"");
+    tmpl_buf_append_str(&cmd, gen_src_path);
+    tmpl_buf_append_str(&cmd, "\"");
+    status = system(cmd.data);
+    tmpl_buf_free(&cmd);
+    if(status != 0) {
+        fprintf(stderr, "tmpl: compiling the generator %s failed\n", gen_src_path);
+        return false;
+    }
+
+    tmpl_buf_append_str(&cmd, "\"");
+    if(strchr(gen_exe_path, '/') == NULL) tmpl_buf_append_str(&cmd, "./");
+    tmpl_buf_append_str(&cmd, gen_exe_path);
+    tmpl_buf_append_str(&cmd, "\"");
+    pipe = popen(cmd.data, "r");
+    tmpl_buf_free(&cmd);
+    if(pipe == NULL) {
+        fprintf(stderr, "tmpl: could not run the generator %s\n", gen_exe_path);
+        return false;
+    }
+    tmpl_buf_append(out, "", 0);
+    while((n = fread(chunk, 1, sizeof(chunk), pipe)) > 0) {
+        tmpl_buf_append(out, chunk, n);
+    }
+    if(pclose(pipe) != 0) {
+        fprintf(stderr, "tmpl: the generator %s failed\n", gen_exe_path);
+        return false;
+    }
+    return true;
+}
+
+
+
+
+/* pruning:
+    the text inside template regions is cut into top-level declarations: up to a ; at depth 0, or up to the brace
+    closing a function body. Comments in front of a declaration belong to it, preprocessor lines stand on their own
+    and are always kept. A declaration is kept if the name it declares is reachable; the identifiers in the -prune
+    files and in the text outside of the regions are the roots, and every kept declaration makes the identifiers it
+    uses reachable in turn. Several declarations can have the same name (prototype and definition, one typedef per
+    ISA), they are all kept together.
+*/
+
+typedef struct tmpl_decl_t {
+    size_t begin, end;
+    size_t name_begin, name_len;
+    bool keep;
+} tmpl_decl_t;
+
+typedef struct tmpl_set_t {
+    char** names;
+    size_t cap, nr;
+} tmpl_set_t;
+
+static bool tmpl_set_has(const tmpl_set_t* set, const char* name, size_t len) {
+    if(set->cap == 0) return false;
+    for(size_t i = tmpl_hash(TMPL_HASH_INIT, name, len) & (set->cap - 1); set->names[i] != NULL; i = (i + 1) & (set->cap - 1)) {
+        if(strncmp(set->names[i], name, len) == 0 && set->names[i][len] == '\0') return true;
+    }
+    return false;
+}
+static bool tmpl_set_add(tmpl_set_t* set, const char* name, size_t len) {
+    size_t i;
+    if(tmpl_set_has(set, name, len)) return false;
+    if((set->nr + 1) * 2 > set->cap) {
+        tmpl_set_t grown = {0};
+        grown.cap = set->cap ? set->cap * 2 : 1024;
+        grown.names = tmpl_realloc(NULL, grown.cap * sizeof(char*));
+        memset(grown.names, 0, grown.cap * sizeof(char*));
+        for(i = 0; i < set->cap; i++) {
+            if(set->names[i] != NULL) {
+                tmpl_set_add(&grown, set->names[i], strlen(set->names[i]));
+                free(set->names[i]);
+            }
+        }
+        free(set->names);
+        set[0] = grown;
+    }
+    for(i = tmpl_hash(TMPL_HASH_INIT, name, len) & (set->cap - 1); set->names[i] != NULL; i = (i + 1) & (set->cap - 1));
+    set->names[i] = tmpl_realloc(NULL, len + 1);
+    memcpy(set->names[i], name, len);
+    set->names[i][len] = '\0';
+    set->nr++;
+    return true;
+}
+static void tmpl_set_free(tmpl_set_t* set) {
+    for(size_t i = 0; i < set->cap; i++) free(set->names[i]);
+    free(set->names);
+    set[0] = (tmpl_set_t){0};
+}
+
+/* adds every identifier in s[begin, end) outside of comments and literals */
+static void tmpl_set_add_identifiers(tmpl_set_t* set, const char* s, size_t begin, size_t end) {
+    size_t i = begin;
+    while(i < end) {
+        size_t next = tmpl_skip_comment_or_literal(s, i, end);
+        if(next != i) {
+            i = next;
+        } else if(tmpl_is_ident_start(s[i])) {
+            size_t j = i;
+            while(j < end && tmpl_is_ident_char(s[j])) j++;
+            tmpl_set_add(set, &s[i], j - i);
+            i = j;
+        } else if(s[i] >= '0' && s[i] <= '9') {
+            while(i < end && tmpl_is_ident_char(s[i])) i++;
+        } else {
+            i++;
+        }
+    }
+}
+
+/* index after the (), [] or {} group starting at i */
+static size_t tmpl_skip_group(const char* s, size_t i, size_t end) {
+    int depth = 0;
+    while(i < end) {
+        size_t next = tmpl_skip_comment_or_literal(s, i, end);
+        if(next != i) {
+            i = next;
+            continue;
+        }
+        if(s[i] == '(' || s[i] == '[' || s[i] == '{') depth++;
+        if(s[i] == ')' || s[i] == ']' || s[i] == '}') depth--;
+        i++;
+        if(depth == 0) break;
+    }
+    return i;
+}
+
+/* the declared name is the identifier in front of the first parameter list, or the last identifier at depth 0
+   for typedefs and variables; __attribute__ lists don't count */
+static void tmpl_decl_name(const char* s, tmpl_decl_t* decl) {
+    size_t i = decl->begin;
+    bool is_typedef = false, after_attribute = false, first = true;
+    decl->name_len = 0;
+    while(i < decl->end) {
+        size_t next = tmpl_skip_comment_or_literal(s, i, decl->end);
+        if(next != i) {
+            i = next;
+        } else if(tmpl_is_ident_start(s[i])) {
+            size_t j = i;
+            while(j < decl->end && tmpl_is_ident_char(s[j])) j++;
+            if(j - i == 13 && memcmp(&s[i], "__attribute__", 13) == 0) {
+                after_attribute = true;
+            } else {
+                if(first && j - i == 7 && memcmp(&s[i], "typedef", 7) == 0) is_typedef = true;
+                decl->name_begin = i;
+                decl->name_len = j - i;
+            }
+            first = false;
+            i = j;
+        } else if(s[i] == '(' || s[i] == '[' || s[i] == '{') {
+            if(s[i] == '(' && !after_attribute && !is_typedef && decl->name_len > 0) return;
+            after_attribute = false;
+            i = tmpl_skip_group(s, i, decl->end);
+        } else if(s[i] == '=' || s[i] == ';') {
+            return;
+        } else {
+            i++;
+        }
+    }
+}
+
+/* cuts s[begin, end) into declarations */
+static void tmpl_split_decls(const char* s, size_t begin, size_t end, tmpl_decl_t** decls, size_t* nr_decls, size_t* cap_decls) {
+    size_t i = begin;
+    while(i < end) {
+        tmpl_decl_t decl = {0};
+        size_t line_begin;
+        while(i < end && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) i++;
+        if(i >= end) break;
+        line_begin = i;
+        while(line_begin > begin && (s[line_begin - 1] == ' ' || s[line_begin - 1] == '\t')) line_begin--;
+        decl.begin = line_begin;
+
+        if(s[i] == '#') {
+            while(i < end && s[i] != '\n') {
+                if(s[i] == '\\' && i + 1 < end && (s[i + 1] == '\n' || s[i + 1] == '\r')) i++;
+                i++;
+            }
+            decl.keep = true;
+        } else {
+            char prev = 0;
+            bool done = false;
+            while(i < end && !done) {
+                size_t next = tmpl_skip_comment_or_literal(s, i, end);
+                if(next != i) {
+                    i = next;
+                    continue;
+                }
+                if(s[i] == ';') {
+                    done = true;
+                } else if(s[i] == '{' && prev == ')') {
+                    /* a function body ends the declaration */
+                    i = tmpl_skip_group(s, i, end) - 1;
+                    done = true;
+                } else if(s[i] == '(' || s[i] == '[' || s[i] == '{') {
+                    i = tmpl_skip_group(s, i, end) - 1;
+                }
+                if(s[i] != ' ' && s[i] != '\t' && s[i] != '\r' && s[i] != '\n') prev = s[i];
+                i++;
+            }
+        }
+        /* the rest of the line goes with it */
+        while(i < end && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r')) i++;
+        if(i < end && s[i] == '\n') i++;
+        decl.end = i;
+        if(!decl.keep) {
+            tmpl_decl_name(s, &decl);
+            decl.keep = (decl.name_len == 0);
+        }
+
+        if(*nr_decls == *cap_decls) {
+            *cap_decls = *cap_decls ? *cap_decls * 2 : 1024;
+            *decls = tmpl_realloc(*decls, *cap_decls * sizeof(tmpl_decl_t));
+        }
+        (*decls)[(*nr_decls)++] = decl;
+    }
+}
+
+/* marks the reachable declarations as kept; roots must already hold the identifiers from outside the regions */
+static void tmpl_prune(const char* s, tmpl_decl_t* decls, size_t nr_decls, tmpl_set_t* roots) {
+    bool changed = true;
+    for(size_t i = 0; i < nr_decls; i++) {
+        if(decls[i].keep) tmpl_set_add_identifiers(roots, s, decls[i].begin, decls[i].end);
+    }
+    while(changed) {
+        changed = false;
+        for(size_t i = 0; i < nr_decls; i++) {
+            if(!decls[i].keep && tmpl_set_has(roots, &s[decls[i].name_begin], decls[i].name_len)) {
+                decls[i].keep = true;
+                tmpl_set_add_identifiers(roots, s, decls[i].begin, decls[i].end);
+                changed = true;
+            }
+        }
+    }
+}
+
+
+
+
+typedef struct tmpl_options_t {
+    const char* cc;
+    const char* template_path;
+    const char* output_path;
+    const char** prune_paths;
+    size_t nr_prune_paths;
+    bool split, measure, force, keep, verbose;
+} tmpl_options_t;
+
+typedef struct tmpl_region_t {
+    size_t begin, end;
+    size_t first_decl, nr_decls;
+} tmpl_region_t;
+
+static char* tmpl_path_with(const char* path, const char* suffix) {
+    char* result = tmpl_realloc(NULL, strlen(path) + strlen(suffix) + 1);
+    strcpy(result, path);
+    strcat(result, suffix);
+    return result;
+}
+/* output path of region n with -split: stem_n.ext */
+static char* tmpl_split_path(const char* path, size_t n) {
+    const char* slash = strrchr(path, '/');
+    const char* dot = strrchr(path, '.');
+    char number[32];
+    size_t stem_len = (dot != NULL && (slash == NULL || dot > slash)) ? (size_t)(dot - path) : strlen(path);
+    char* result;
+    snprintf(number, sizeof(number), "_%zu", n);
+    result = tmpl_realloc(NULL, strlen(path) + strlen(number) + 1);
+    memcpy(result, path, stem_len);
+    strcpy(&result[stem_len], number);
+    strcat(result, &path[stem_len]);
+    return result;
+}
+
+static double tmpl_measure_compile(const char* cc, const char* path, int* out_status) {
+    tmpl_buf_t cmd = {0};
+    double start;
+    tmpl_buf_append_str(&cmd, cc);
+    tmpl_buf_append_str(&cmd, " -fsyntax-only -w -x c \"");
+    tmpl_buf_append_str(&cmd, path);
+    tmpl_buf_append_str(&cmd, "\"");
+    start = tmpl_seconds();
+    out_status[0] = system(cmd.data);
+    tmpl_buf_free(&cmd);
+    return tmpl_seconds() - start;
+}
+
+static uint64_t tmpl_options_hash(const tmpl_options_t* opt, const tmpl_buf_t* src) {
+    uint64_t h = TMPL_HASH_INIT;
+    tmpl_buf_t prune_src = {0};
+    h = tmpl_hash(h, TMPL_VERSION, strlen(TMPL_VERSION) + 1);
+    h = tmpl_hash(h, opt->cc, strlen(opt->cc) + 1);
+    h = tmpl_hash(h, opt->split ? "s" : "-", 1);
+    h = tmpl_hash(h, src->data, src->len);
+    for(size_t i = 0; i < opt->nr_prune_paths; i++) {
+        h = tmpl_hash(h, opt->prune_paths[i], strlen(opt->prune_paths[i]) + 1);
+        if(tmpl_read_file(opt->prune_paths[i], &prune_src)) {
+            h = tmpl_hash(h, prune_src.data, prune_src.len);
+        }
+        tmpl_buf_free(&prune_src);
+    }
+    return h;
+}
+
+static int tmpl_expand(const tmpl_options_t* opt) {
+    tmpl_buf_t src = {0}, gen = {0}, expansion = {0}, pruned = {0}, stamp = {0};
+    tmpl_region_t* regions = NULL;
+    tmpl_decl_t* decls = NULL;
+    size_t nr_regions = 0, nr_found_regions = 0, nr_decls = 0, cap_decls = 0, nr_kept = 0;
+    tmpl_set_t roots = {0};
+    char* gen_src_path = tmpl_path_with(opt->output_path, ".gen.c");
+    char* gen_exe_path = tmpl_path_with(opt->output_path, ".gen");
+    char* stamp_path = tmpl_path_with(opt->output_path, ".stamp");
+    char hash_str[32];
+    double t_start = tmpl_seconds(), t_generated, t_expanded, t_pruned;
+    int result = EXIT_FAILURE;
+    FILE* existing;
+
+    if(!tmpl_read_file(opt->template_path, &src)) {
+        fprintf(stderr, "tmpl: could not read %s\n", opt->template_path);
+        goto cleanup;
+    }
+    snprintf(hash_str, sizeof(hash_str), "%016llx\n", (unsigned long long) tmpl_options_hash(opt, &src));
+    existing = fopen(opt->output_path, "rb");
+    if(existing != NULL) fclose(existing);
+    if(!opt->force && existing != NULL && tmpl_read_file(stamp_path, &stamp) && strcmp(stamp.data, hash_str) == 0) {
+        if(opt->verbose) printf("tmpl: %s is up to date\n", opt->output_path);
+        result = EXIT_SUCCESS;
+        goto cleanup;
+    }
+
+    if(!tmpl_build_generator(opt->template_path, &src, &gen, &nr_regions)) goto cleanup;
+    if(!tmpl_write_file(gen_src_path, gen.data, gen.len)) goto cleanup;
+    t_generated = tmpl_seconds();
+    if(!tmpl_run_generator(opt->cc, gen_src_path, gen_exe_path, &expansion)) goto cleanup;
+    t_expanded = tmpl_seconds();
+
+    /* find the regions, collect the roots outside of them and cut the regions into declarations */
+    regions = tmpl_realloc(NULL, (nr_regions + 1) * sizeof(tmpl_region_t));
+    for(size_t i = 0; i < expansion.len; i++) {
+        if((uint8_t) expansion.data[i] == TMPL_REGION_BEGIN) {
+            tmpl_region_t* r = &regions[nr_found_regions];
+            size_t outside_begin = (nr_found_regions > 0) ? regions[nr_found_regions - 1].end + 1 : 0;
+            if(nr_found_regions == nr_regions) break;
+            tmpl_set_add_identifiers(&roots, expansion.data, outside_begin, i);
+            r->begin = i + 1;
+            r->end = r->begin;
+            while(r->end < expansion.len && (uint8_t) expansion.data[r->end] != TMPL_REGION_END) r->end++;
+            r->first_decl = nr_decls;
+            tmpl_split_decls(expansion.data, r->begin, r->end, &decls, &nr_decls, &cap_decls);
+            r->nr_decls = nr_decls - r->first_decl;
+            nr_found_regions++;
+            i = r->end;
+        }
+    }
+    tmpl_set_add_identifiers(&roots, expansion.data, (nr_found_regions > 0) ? regions[nr_found_regions - 1].end + 1 : 0, expansion.len);
+
+    if(opt->nr_prune_paths > 0) {
+        for(size_t i = 0; i < opt->nr_prune_paths; i++) {
+            tmpl_buf_t prune_src = {0};
+            if(!tmpl_read_file(opt->prune_paths[i], &prune_src)) {
+                fprintf(stderr, "tmpl: could not read %s\n", opt->prune_paths[i]);
+                goto cleanup;
+            }
+            tmpl_set_add_identifiers(&roots, prune_src.data, 0, prune_src.len);
+            tmpl_buf_free(&prune_src);
+        }
+        tmpl_prune(expansion.data, decls, nr_decls, &roots);
+    } else {
+        for(size_t i = 0; i < nr_decls; i++) decls[i].keep = true;
+    }
+
+    /* write everything out, with the regions either inline or in their own files */
+    for(size_t r = 0, pos = 0; r <= nr_found_regions; r++) {
+        size_t outside_end = (r < nr_found_regions) ? regions[r].begin - 1 : expansion.len;
+        tmpl_buf_t region_text = {0};
+        tmpl_buf_t* target = opt->split ? &region_text : &pruned;
+
+        tmpl_buf_append(&pruned, &expansion.data[pos], outside_end - pos);
+        if(r == nr_found_regions) break;
+        tmpl_buf_append(target, "", 0);
+        for(size_t d = regions[r].first_decl, at = regions[r].begin; d <= regions[r].first_decl + regions[r].nr_decls; d++) {
+            size_t until = (d < regions[r].first_decl + regions[r].nr_decls) ? decls[d].begin : regions[r].end;
+            /* whitespace between declarations */
+            tmpl_buf_append(target, &expansion.data[at], until - at);
+            if(until == regions[r].end) break;
+            if(decls[d].keep) {
+                tmpl_buf_append(target, &expansion.data[decls[d].begin], decls[d].end - decls[d].begin);
+                nr_kept++;
+            }
+            at = decls[d].end;
+        }
+        if(opt->split) {
+            char* region_path = tmpl_split_path(opt->output_path, r);
+            const char* region_name = strrchr(region_path, '/') ? strrchr(region_path, '/') + 1 : region_path;
+            bool ok = tmpl_write_file(region_path, region_text.data, region_text.len);
+            tmpl_buf_append_str(&pruned, "#include \"");
+            tmpl_buf_append_str(&pruned, region_name);
+            tmpl_buf_append_str(&pruned, (strchr(src.data, '\r') != NULL) ? "\"\r\n" : "\"\n");
+            free(region_path);
+            tmpl_buf_free(&region_text);
+            if(!ok) goto cleanup;
+        }
+        pos = regions[r].end + 1;
+    }
+    if(!tmpl_write_file(opt->output_path, pruned.data, pruned.len)) goto cleanup;
+    t_pruned = tmpl_seconds();
+
+    if(opt->verbose) {
+        printf("tmpl: %s: %zu regions, %zu generated declarations, %zu kept, %zu bytes expanded, %zu bytes written\n",
+               opt->template_path, nr_found_regions, nr_decls, nr_kept, expansion.len - 2 * nr_found_regions, pruned.len);
+        printf("tmpl: %s: generator %.3fs, compile and run %.3fs, prune %.3fs\n",
+               opt->template_path, t_generated - t_start, t_expanded - t_generated, t_pruned - t_expanded);
+    }
+    if(opt->measure) {
+        /* the full expansion without the region markers, to compare against */
+        char* full_path = tmpl_path_with(opt->output_path, ".full.c");
+        tmpl_buf_t full = {0};
+        int status_full, status_pruned;
+        double t_full, t_output;
+        tmpl_buf_append(&full, "", 0);
+        for(size_t i = 0; i < expansion.len; i++) {
+            uint8_t c = (uint8_t) expansion.data[i];
+            if(c != TMPL_REGION_BEGIN && c != TMPL_REGION_END) tmpl_buf_append(&full, &expansion.data[i], 1);
+        }
+        if(tmpl_write_file(full_path, full.data, full.len)) {
+            t_full = tmpl_measure_compile(opt->cc, full_path, &status_full);
+            t_output = tmpl_measure_compile(opt->cc, opt->output_path, &status_pruned);
+            printf("tmpl: %s: syntax-only compile of the full expansion %.3fs%s, of the output %.3fs%s\n", opt->template_path,
+                   t_full, (status_full != 0) ? " (with errors)" : "", t_output, (status_pruned != 0) ? " (with errors)" : "");
+            if(!opt->keep) remove(full_path);
+        }
+        tmpl_buf_free(&full);
+        free(full_path);
+    }
+
+    if(!tmpl_write_file(stamp_path, hash_str, strlen(hash_str))) goto cleanup;
+    result = EXIT_SUCCESS;
+
+cleanup:
+    if(!opt->keep) {
+        remove(gen_src_path);
+        remove(gen_exe_path);
+    }
+    tmpl_buf_free(&src);
+    tmpl_buf_free(&gen);
+    tmpl_buf_free(&expansion);
+    tmpl_buf_free(&pruned);
+    tmpl_buf_free(&stamp);
+    tmpl_set_free(&roots);
+    free(regions);
+    free(decls);
+    free(gen_src_path);
+    free(gen_exe_path);
+    free(stamp_path);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    tmpl_options_t opt = {0};
+    const char* positional[2];
+    int nr_positional = 0, result;
+
+    opt.cc = getenv("CC");
+    if(opt.cc == NULL || opt.cc[0] == '\0') opt.cc = "cc";
+    opt.prune_paths = tmpl_realloc(NULL, (size_t) argc * sizeof(char*));
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-cc") == 0 && i + 1 < argc) {
+            opt.cc = argv[++i];
+        } else if(strcmp(argv[i], "-prune") == 0 && i + 1 < argc) {
+            opt.prune_paths[opt.nr_prune_paths++] = argv[++i];
+        } else if(strcmp(argv[i], "-split") == 0) {
+            opt.split = true;
+        } else if(strcmp(argv[i], "-measure") == 0) {
+            opt.measure = true;
+        } else if(strcmp(argv[i], "-force") == 0) {
+            opt.force = true;
+        } else if(strcmp(argv[i], "-keep") == 0) {
+            opt.keep = true;
+        } else if(strcmp(argv[i], "-v") == 0) {
+            opt.verbose = true;
+        } else if(argv[i][0] != '-' && nr_positional < 2) {
+            positional[nr_positional++] = argv[i];
+        } else {
+            nr_positional = -1;
+            break;
+        }
+    }
+    if(nr_positional != 2) {
+        fprintf(stderr, "usage: tmpl [-cc compiler] [-prune file]... [-split] [-measure] [-force] [-keep] [-v] template output\n");
+        free(opt.prune_paths);
+        return EXIT_FAILURE;
+    }
+    opt.template_path = positional[0];
+    opt.output_path = positional[1];
+
+    result = tmpl_expand(&opt);
+    free(opt.prune_paths);
+    return result;
+}